@@ -0,0 +1,628 @@
+/*aggregate.c*/
+
+//
+// Project: Hash aggregation operator for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdint.h>  // uintptr_t
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "operator.h"
+#include "util.h"
+
+//
+// Each group keeps one accumulator per output column; which fields
+// are used depends on the function (enum AST_COLUMN_FUNCTIONS):
+//
+struct Accumulator {
+  struct TupleValue value; // MIN, MAX, or first value (NO_FUNCTION)
+  long long count;         // COUNT, AVG
+  long long sumInt;        // SUM of an int column
+  double sum;              // SUM of a real column, AVG
+};
+
+//
+// The groups are kept in arrays indexed by group #, and a hash table
+// of buckets chains together the groups whose keys hash to the same
+// bucket. Like the join, strings are not copied: they point into the
+// tables read by child, which stay mapped until the pipeline is
+// destroyed.
+//
+// With partitions, each partition is aggregated by its own thread into
+// a partial AggregateState of its own, and the partials are then
+// merged, in partition order, into the operator's state.
+//
+// A string of a dictionary-encoded column (see table.h) always points
+// to the same place in the column's dictionary, so the pointer acts as
+// the string's code. When grouping by one string column, the group of
+// each pointer seen is remembered in a small direct-mapped cache, and
+// a tuple whose pointer hits the cache is grouped without hashing or
+// comparing its string. (A pointer into a data file identifies its
+// string as well, so a hit is always correct, just less likely.)
+//
+#define AGGREGATE_CODE_SLOTS 1024
+
+struct CodeSlot {
+  char *s; // the string, NULL => empty slot
+  int length;
+  int group; // its group #
+};
+
+struct AggregateState {
+  int *keys; // ARRAY: index in child's tuple of each group by column
+  int numKeys;
+  int *positions; // ARRAY: 0, 1, ..., numKeys-1 (keys of a group's key)
+
+  int *inputs;    // ARRAY: index in child's tuple of each output column
+  int *functions; // ARRAY: function of each output column
+  int numColumns;
+
+  struct TupleValue *groupKeys; // ARRAY: numKeys values per group
+  struct Accumulator *accs;     // ARRAY: numColumns accumulators per group
+  unsigned int *hashes;         // ARRAY: hash of each group's key
+  int *chain;                   // ARRAY: next group in the bucket, or -1
+  int numGroups;
+  int size; // # of groups the arrays have room for
+
+  int *buckets;            // ARRAY: first group in each bucket, or -1
+  unsigned int numBuckets; // a power of 2
+
+  bool built;    // true => child has been read
+  int nextGroup; // next group to output
+
+  struct Operator **partitions; // ARRAY: inputs, partitions[0] is child
+  int numPartitions;
+
+  bool byCode;            // true => one string group by column
+  struct CodeSlot *codes; // ARRAY of AGGREGATE_CODE_SLOTS, if byCode
+};
+
+//
+// aggregate_hash
+//
+// Hashes the group key values[keys[0]], values[keys[1]], ...
+//
+static unsigned int aggregate_hash(struct AggregateState *agg,
+                                   struct TupleValue *values, int *keys) {
+  unsigned int hash = 0;
+
+  for (int k = 0; k < agg->numKeys; k++)
+    hash = (hash * 31) + operator_hashValue(&values[keys[k]]);
+
+  return hash;
+}
+
+//
+// aggregate_rehash
+//
+// Doubles the # of buckets, and re-chains the groups.
+//
+static void aggregate_rehash(struct AggregateState *agg) {
+  agg->numBuckets = (agg->numBuckets == 0) ? 64 : agg->numBuckets * 2;
+
+  free(agg->buckets);
+  agg->buckets = (int *)malloc(sizeof(int) * agg->numBuckets);
+  if (agg->buckets == NULL)
+    panic("out of memory");
+
+  for (unsigned int b = 0; b < agg->numBuckets; b++)
+    agg->buckets[b] = -1;
+
+  for (int g = agg->numGroups - 1; g >= 0; g--) {
+    unsigned int b = agg->hashes[g] & (agg->numBuckets - 1);
+    agg->chain[g] = agg->buckets[b];
+    agg->buckets[b] = g;
+  }
+}
+
+//
+// aggregate_hashGroup
+//
+// Returns the group # of the group with key values[keys[0]],
+// values[keys[1]], ..., adding a new group (with empty accumulators)
+// if the group is not found.
+//
+static int aggregate_hashGroup(struct AggregateState *agg,
+                               struct TupleValue *values, int *keys) {
+  unsigned int hash = aggregate_hash(agg, values, keys);
+
+  int g = agg->buckets[hash & (agg->numBuckets - 1)];
+  while (g != -1) {
+    if (agg->hashes[g] == hash) {
+      struct TupleValue *key = &agg->groupKeys[g * agg->numKeys];
+      bool equal = true;
+
+      for (int k = 0; k < agg->numKeys && equal; k++)
+        equal = operator_equalValues(&key[k], &values[keys[k]]);
+
+      if (equal)
+        return g;
+    }
+    g = agg->chain[g];
+  }
+
+  // a new group:
+  if (agg->numGroups == agg->size) {
+    agg->size *= 2;
+    agg->groupKeys = (struct TupleValue *)realloc(
+        agg->groupKeys,
+        sizeof(struct TupleValue) * agg->size * (agg->numKeys + 1));
+    agg->accs = (struct Accumulator *)realloc(
+        agg->accs, sizeof(struct Accumulator) * agg->size * agg->numColumns);
+    agg->hashes = (unsigned int *)realloc(agg->hashes,
+                                          sizeof(unsigned int) * agg->size);
+    agg->chain = (int *)realloc(agg->chain, sizeof(int) * agg->size);
+
+    if (agg->groupKeys == NULL || agg->accs == NULL || agg->hashes == NULL ||
+        agg->chain == NULL)
+      panic("out of memory");
+  }
+
+  g = agg->numGroups++;
+
+  for (int k = 0; k < agg->numKeys; k++)
+    agg->groupKeys[(g * agg->numKeys) + k] = values[keys[k]];
+
+  memset(&agg->accs[g * agg->numColumns], 0,
+         sizeof(struct Accumulator) * agg->numColumns);
+
+  agg->hashes[g] = hash;
+
+  if ((unsigned int)agg->numGroups * 2 > agg->numBuckets) {
+    aggregate_rehash(agg); // also chains in the new group
+  } else {
+    unsigned int b = hash & (agg->numBuckets - 1);
+    agg->chain[g] = agg->buckets[b];
+    agg->buckets[b] = g;
+  }
+
+  return g;
+}
+
+//
+// aggregate_findGroup
+//
+// Same as aggregate_hashGroup(), trying the cache of codes first.
+//
+static int aggregate_findGroup(struct AggregateState *agg,
+                               struct TupleValue *values, int *keys) {
+  if (!agg->byCode)
+    return aggregate_hashGroup(agg, values, keys);
+
+  struct TupleValue *key = &values[keys[0]];
+  uintptr_t code = (uintptr_t)key->value.s;
+  struct CodeSlot *slot =
+      &agg->codes[(code ^ (code >> 10)) & (AGGREGATE_CODE_SLOTS - 1)];
+
+  if (slot->s != key->value.s || slot->length != key->length) {
+    slot->s = key->value.s;
+    slot->length = key->length;
+    slot->group = aggregate_hashGroup(agg, values, keys);
+  }
+
+  return slot->group;
+}
+
+//
+// aggregate_accumulate
+//
+// Adds the value to the accumulator of an output column.
+//
+static void aggregate_accumulate(struct Accumulator *acc, int function,
+                                 struct TupleValue *value) {
+  bool first = (acc->count == 0);
+
+  acc->count++;
+
+  switch (function) {
+  case NO_FUNCTION:
+    if (first)
+      acc->value = *value;
+    break;
+  case MIN_FUNCTION:
+    if (first || operator_compareValues(value, &acc->value) < 0)
+      acc->value = *value;
+    break;
+  case MAX_FUNCTION:
+    if (first || operator_compareValues(value, &acc->value) > 0)
+      acc->value = *value;
+    break;
+  case SUM_FUNCTION:
+  case AVG_FUNCTION:
+    if (value->valueType == COL_TYPE_INT) {
+      acc->sumInt += value->value.i;
+      acc->sum += value->value.i;
+    } else if (value->valueType == COL_TYPE_REAL) {
+      acc->sum += value->value.r;
+    }
+    break;
+  case COUNT_FUNCTION:
+    break;
+  }
+}
+
+//
+// aggregate_merge
+//
+// Adds the src accumulator, of another partition, to acc.
+//
+static void aggregate_merge(struct Accumulator *acc, int function,
+                            struct Accumulator *src) {
+  if (src->count == 0)
+    return;
+
+  bool first = (acc->count == 0);
+
+  switch (function) {
+  case NO_FUNCTION:
+    if (first)
+      acc->value = src->value;
+    break;
+  case MIN_FUNCTION:
+    if (first || operator_compareValues(&src->value, &acc->value) < 0)
+      acc->value = src->value;
+    break;
+  case MAX_FUNCTION:
+    if (first || operator_compareValues(&src->value, &acc->value) > 0)
+      acc->value = src->value;
+    break;
+  }
+
+  acc->count += src->count;
+  acc->sumInt += src->sumInt;
+  acc->sum += src->sum;
+}
+
+//
+// aggregate_consume
+//
+// Reads all of input, accumulating each tuple into its group.
+//
+static void aggregate_consume(struct AggregateState *agg,
+                              struct Operator *input) {
+  struct Tuple *tuple = NULL;
+
+  while ((tuple = operator_next(input)) != NULL) {
+    int g = aggregate_findGroup(agg, tuple->values, agg->keys);
+    struct Accumulator *accs = &agg->accs[g * agg->numColumns];
+
+    for (int i = 0; i < agg->numColumns; i++)
+      aggregate_accumulate(&accs[i], agg->functions[i],
+                           &tuple->values[agg->inputs[i]]);
+  }
+}
+
+//
+// aggregate_initGroups
+//
+// Allocates the (empty) groups and hash table of the state.
+//
+static void aggregate_initGroups(struct AggregateState *agg) {
+  agg->size = 64;
+  agg->numGroups = 0;
+  agg->groupKeys = (struct TupleValue *)malloc(
+      sizeof(struct TupleValue) * agg->size * (agg->numKeys + 1));
+  agg->accs = (struct Accumulator *)malloc(sizeof(struct Accumulator) *
+                                           agg->size * (agg->numColumns + 1));
+  agg->hashes = (unsigned int *)malloc(sizeof(unsigned int) * agg->size);
+  agg->chain = (int *)malloc(sizeof(int) * agg->size);
+  if (agg->groupKeys == NULL || agg->accs == NULL || agg->hashes == NULL ||
+      agg->chain == NULL)
+    panic("out of memory");
+
+  agg->buckets = NULL;
+  agg->numBuckets = 0;
+  aggregate_rehash(agg);
+
+  agg->codes = NULL;
+
+  if (agg->byCode) {
+    agg->codes = (struct CodeSlot *)calloc(AGGREGATE_CODE_SLOTS,
+                                           sizeof(struct CodeSlot));
+    if (agg->codes == NULL)
+      panic("out of memory");
+  }
+}
+
+static void aggregate_freeGroups(struct AggregateState *agg) {
+  free(agg->groupKeys);
+  free(agg->accs);
+  free(agg->hashes);
+  free(agg->chain);
+  free(agg->buckets);
+  free(agg->codes);
+}
+
+//
+// a thread aggregating one partition:
+//
+struct AggregateWorker {
+  pthread_t thread;
+  struct AggregateState partial; // groups of this partition only
+  struct Operator *input;
+};
+
+static void *aggregate_work(void *arg) {
+  struct AggregateWorker *worker = (struct AggregateWorker *)arg;
+
+  aggregate_consume(&worker->partial, worker->input);
+
+  return NULL;
+}
+
+//
+// aggregate_parallel
+//
+// Aggregates each partition on its own thread, and then merges the
+// partial groups in partition order. Since the partitions are in
+// file order, the groups end up in the order a single thread would
+// have first seen them.
+//
+static void aggregate_parallel(struct AggregateState *agg) {
+  int N = agg->numPartitions;
+  struct AggregateWorker *workers =
+      (struct AggregateWorker *)malloc(sizeof(struct AggregateWorker) * N);
+  if (workers == NULL)
+    panic("out of memory");
+
+  for (int p = 0; p < N; p++) {
+    workers[p].partial = *agg; // shares keys, inputs and functions
+    workers[p].input = agg->partitions[p];
+    aggregate_initGroups(&workers[p].partial);
+
+    if (pthread_create(&workers[p].thread, NULL, aggregate_work,
+                       &workers[p]) != 0)
+      panic("unable to create thread");
+  }
+
+  for (int p = 0; p < N; p++) {
+    pthread_join(workers[p].thread, NULL);
+
+    struct AggregateState *partial = &workers[p].partial;
+
+    for (int pg = 0; pg < partial->numGroups; pg++) {
+      int g = aggregate_findGroup(agg, &partial->groupKeys[pg * agg->numKeys],
+                                  agg->positions);
+      struct Accumulator *accs = &agg->accs[g * agg->numColumns];
+      struct Accumulator *src = &partial->accs[pg * agg->numColumns];
+
+      for (int i = 0; i < agg->numColumns; i++)
+        aggregate_merge(&accs[i], agg->functions[i], &src[i]);
+    }
+
+    aggregate_freeGroups(partial);
+  }
+
+  free(workers);
+}
+
+//
+// aggregate_build
+//
+// Reads all of the input, accumulating each tuple into its group.
+//
+static void aggregate_build(struct Operator *op) {
+  struct AggregateState *agg = (struct AggregateState *)op->state;
+
+  if (agg->numPartitions == 1)
+    aggregate_consume(agg, op->child);
+  else
+    aggregate_parallel(agg);
+
+  // without group by, there is always exactly one group
+  if (agg->numKeys == 0 && agg->numGroups == 0) {
+    agg->numGroups = 1;
+    memset(agg->accs, 0, sizeof(struct Accumulator) * op->numColumns);
+
+    for (int i = 0; i < op->numColumns; i++) {
+      agg->accs[i].value.valueType = op->child->columns[agg->inputs[i]].colType;
+      if (agg->accs[i].value.valueType == COL_TYPE_STRING)
+        agg->accs[i].value.value.s = "";
+    }
+  }
+
+  agg->built = true;
+}
+
+static struct Tuple *aggregate_next(struct Operator *op) {
+  struct AggregateState *agg = (struct AggregateState *)op->state;
+
+  if (!agg->built)
+    aggregate_build(op);
+
+  if (agg->nextGroup >= agg->numGroups)
+    return NULL;
+
+  struct Accumulator *accs = &agg->accs[agg->nextGroup * op->numColumns];
+  agg->nextGroup++;
+
+  for (int i = 0; i < op->numColumns; i++) {
+    struct TupleValue *value = &op->tuple.values[i];
+    struct Accumulator *acc = &accs[i];
+
+    value->valueType = op->columns[i].colType;
+
+    switch (agg->functions[i]) {
+    case COUNT_FUNCTION:
+      value->value.i = (int)acc->count;
+      break;
+    case SUM_FUNCTION:
+      if (value->valueType == COL_TYPE_INT)
+        value->value.i = (int)acc->sumInt;
+      else
+        value->value.r = acc->sum;
+      break;
+    case AVG_FUNCTION:
+      value->value.r = (acc->count > 0) ? acc->sum / acc->count : 0.0;
+      break;
+    default: // MIN, MAX, NO_FUNCTION
+      *value = acc->value;
+      break;
+    }
+  }
+
+  return &op->tuple;
+}
+
+static void aggregate_destroy(struct Operator *op) {
+  struct AggregateState *agg = (struct AggregateState *)op->state;
+
+  // partitions[0] is the child, destroyed along with the operator
+  for (int p = 1; p < agg->numPartitions; p++)
+    operator_destroy(agg->partitions[p]);
+
+  aggregate_freeGroups(agg);
+}
+
+static void aggregate_explain(struct Operator *op, struct OpExplain *info) {
+  static char *functions[] = {"MIN", "MAX", "SUM", "AVG", "COUNT"};
+
+  struct AggregateState *agg = (struct AggregateState *)op->state;
+
+  for (int i = 0; i < op->numColumns; i++) {
+    struct OpColumn *column = &op->columns[i];
+
+    if (i > 0)
+      operator_appendDetail(info, ", ");
+
+    if (agg->functions[i] == NO_FUNCTION)
+      operator_appendDetail(info, "%s.%s", column->tableName, column->colName);
+    else
+      operator_appendDetail(info, "%s(%s.%s)", functions[agg->functions[i]],
+                            column->tableName, column->colName);
+  }
+
+  for (int k = 0; k < agg->numKeys; k++) {
+    struct OpColumn *key = &op->child->columns[agg->keys[k]];
+
+    operator_appendDetail(info, "%s%s.%s", (k == 0) ? " GROUP BY " : ", ",
+                          key->tableName, key->colName);
+  }
+
+  //
+  // the other partitions are not inputs of the plan, so their tuples
+  // are counted here (the plan only shows partitions[0]):
+  //
+  if (agg->numPartitions > 1) {
+    operator_appendDetail(info, ", %d partitions in parallel",
+                          agg->numPartitions);
+
+    info->rowsIn = 0;
+    for (int p = 0; p < agg->numPartitions; p++) {
+      if (agg->partitions[p]->stats != NULL)
+        info->rowsIn += agg->partitions[p]->stats->rows;
+    }
+  }
+
+  info->memory =
+      (long long)agg->size *
+          (sizeof(struct TupleValue) * agg->numKeys +
+           sizeof(struct Accumulator) * agg->numColumns +
+           sizeof(unsigned int) + sizeof(int)) +
+      (long long)agg->numBuckets * sizeof(int);
+}
+
+//
+// operator_parallelAggregate
+//
+struct Operator *operator_parallelAggregate(struct Operator **partitions,
+                                            int numPartitions,
+                                            struct COLUMN *columns,
+                                            struct COLUMN *groupby) {
+  assert(numPartitions >= 1);
+
+  struct Operator *child = partitions[0];
+
+  int numColumns = 0;
+  for (struct COLUMN *column = columns; column != NULL; column = column->next)
+    numColumns++;
+
+  int numKeys = 0;
+  for (struct COLUMN *column = groupby; column != NULL; column = column->next)
+    numKeys++;
+
+  struct Operator *op = operator_create(OP_AGGREGATE, child, numColumns);
+
+  struct AggregateState *agg =
+      (struct AggregateState *)arena_alloc(sizeof(struct AggregateState));
+
+  agg->numKeys = numKeys;
+  agg->numColumns = numColumns;
+  agg->keys = (int *)arena_alloc(sizeof(int) * (numKeys + 1));
+  agg->positions = (int *)arena_alloc(sizeof(int) * (numKeys + 1));
+  agg->inputs = (int *)arena_alloc(sizeof(int) * (numColumns + 1));
+  agg->functions = (int *)arena_alloc(sizeof(int) * (numColumns + 1));
+  agg->partitions = (struct Operator **)arena_alloc(sizeof(struct Operator *) *
+                                                    numPartitions);
+
+  int k = 0;
+  for (struct COLUMN *column = groupby; column != NULL;
+       column = column->next, k++) {
+    agg->keys[k] = operator_findColumn(child, column->table, column->name);
+    agg->positions[k] = k;
+    assert(agg->keys[k] >= 0);
+  }
+
+  int i = 0;
+  for (struct COLUMN *column = columns; column != NULL;
+       column = column->next, i++) {
+    int index = operator_findColumn(child, column->table, column->name);
+    assert(index >= 0);
+
+    agg->inputs[i] = index;
+    agg->functions[i] = column->function;
+
+    op->columns[i] = child->columns[index];
+    op->columns[i].function = column->function;
+
+    // the type of the result depends on the function:
+    if (column->function == COUNT_FUNCTION)
+      op->columns[i].colType = COL_TYPE_INT;
+    else if (column->function == AVG_FUNCTION)
+      op->columns[i].colType = COL_TYPE_REAL;
+  }
+
+  agg->byCode =
+      (numKeys == 1 && child->columns[agg->keys[0]].colType == COL_TYPE_STRING);
+
+  aggregate_initGroups(agg);
+
+  agg->built = false;
+  agg->nextGroup = 0;
+
+  // the partitions all produce the same columns as the child
+  agg->numPartitions = numPartitions;
+  op->estimatedRows = 0;
+  for (int p = 0; p < numPartitions; p++) {
+    assert(partitions[p]->numColumns == child->numColumns);
+    agg->partitions[p] = partitions[p];
+    op->estimatedRows += partitions[p]->estimatedRows;
+  }
+
+  if (numKeys == 0)
+    op->estimatedRows = 1;
+
+  op->state = agg;
+  op->next = aggregate_next;
+  op->destroy = aggregate_destroy;
+  op->explain = aggregate_explain;
+
+  return op;
+}
+
+//
+// operator_aggregate
+//
+struct Operator *operator_aggregate(struct Operator *child,
+                                    struct COLUMN *columns,
+                                    struct COLUMN *groupby) {
+  return operator_parallelAggregate(&child, 1, columns, groupby);
+}
@@ -0,0 +1,126 @@
+/*arena.c*/
+
+//
+// Project: Per-query memory arena for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <stdalign.h> // max_align_t alignment
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+//
+// A chunk is a header followed by its memory; allocations come from
+// the chunk at the front of the "used" list, and a reset moves the
+// chunks onto the "available" list.
+//
+struct ArenaChunk {
+  struct ArenaChunk *next;
+  size_t size; // # of bytes of memory in the chunk
+  size_t used; // # of bytes allocated so far
+  alignas(max_align_t) char memory[];
+};
+
+struct Arena {
+  struct ArenaChunk *used;      // chunks in use, the newest first
+  struct ArenaChunk *available; // chunks kept for reuse
+};
+
+static _Thread_local struct Arena arena = {NULL, NULL};
+
+//
+// arena_newChunk
+//
+// Returns a chunk with room for at least size bytes, reusing an
+// available chunk if there is one.
+//
+static struct ArenaChunk *arena_newChunk(size_t size) {
+  if (size <= ARENA_CHUNK_SIZE && arena.available != NULL) {
+    struct ArenaChunk *chunk = arena.available;
+    arena.available = chunk->next;
+    chunk->used = 0;
+    return chunk;
+  }
+
+  if (size < ARENA_CHUNK_SIZE)
+    size = ARENA_CHUNK_SIZE;
+
+  struct ArenaChunk *chunk =
+      (struct ArenaChunk *)malloc(sizeof(struct ArenaChunk) + size);
+  if (chunk == NULL)
+    panic("out of memory");
+
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+//
+// arena_alloc
+//
+void *arena_alloc(size_t size) {
+  // every allocation is rounded up, so the next one stays aligned
+  size_t align = alignof(max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+
+  struct ArenaChunk *chunk = arena.used;
+
+  if (chunk == NULL || chunk->size - chunk->used < size) {
+    chunk = arena_newChunk(size);
+    chunk->next = arena.used;
+    arena.used = chunk;
+  }
+
+  void *p = chunk->memory + chunk->used;
+  chunk->used += size;
+
+  return p;
+}
+
+//
+// arena_dupString
+//
+char *arena_dupString(char *s) {
+  size_t length = strlen(s);
+  char *copy = (char *)arena_alloc(length + 1);
+
+  memcpy(copy, s, length + 1);
+
+  return copy;
+}
+
+//
+// arena_reset
+//
+void arena_reset(void) {
+  while (arena.used != NULL) {
+    struct ArenaChunk *chunk = arena.used;
+    arena.used = chunk->next;
+
+    if (chunk->size > ARENA_CHUNK_SIZE) {
+      free(chunk);
+    } else {
+      chunk->next = arena.available;
+      arena.available = chunk;
+    }
+  }
+}
+
+//
+// arena_release
+//
+void arena_release(void) {
+  arena_reset();
+
+  while (arena.available != NULL) {
+    struct ArenaChunk *chunk = arena.available;
+    arena.available = chunk->next;
+    free(chunk);
+  }
+}
@@ -0,0 +1,65 @@
+/*arena.h*/
+
+//
+// Project: Per-query memory arena for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+//
+// Most of the memory a query needs --- its operators, their state,
+// the scanner's tokens, and so on --- lives exactly as long as the
+// query. Rather than malloc'ing and freeing each of these separately,
+// they are allocated from an arena: a list of large chunks, where an
+// allocation just bumps a pointer within the current chunk. Nothing
+// is freed individually; instead, the main loop calls arena_reset()
+// once the query is done, which releases everything at once and
+// keeps the chunks to be reused by the next query.
+//
+// Each thread has its own arena, so threads never contend for it.
+// Memory that grows while a query runs (e.g. hash tables) is still
+// malloc'd, since an arena cannot grow an allocation in place.
+//
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+//
+// Functions:
+//
+
+//
+// arena_alloc
+//
+// Returns a pointer to size bytes from the calling thread's arena,
+// aligned for any type. The memory is valid until the next call to
+// arena_reset() by this thread; do NOT free it.
+//
+void *arena_alloc(size_t size);
+
+//
+// arena_dupString
+//
+// Same as dupString() (util.h), except that the copy is allocated
+// from the calling thread's arena.
+//
+char *arena_dupString(char *s);
+
+//
+// arena_reset
+//
+// Releases all the memory allocated from the calling thread's arena
+// since the last reset. Chunks of the usual size are kept for reuse,
+// larger ones are freed.
+//
+void arena_reset(void);
+
+//
+// arena_release
+//
+// Frees all of the calling thread's chunks, e.g. before the thread
+// (or program) exits.
+//
+void arena_release(void);
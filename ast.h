@@ -73,6 +73,14 @@ struct WHERE {
   struct EXPR *expr;
 };
 
+//
+// The analyzer does not know GROUP BY, so the clause is parsed by the
+// rewrite and kept in the Rewrite (see rewrite.h), not in the SELECT.
+//
+struct GROUPBY {
+  struct COLUMN *columns; // Linked-list of 1 or more columns
+};
+
 struct ORDERBY {
   struct COLUMN *column;
   bool ascending; // true => ascending, false => descending
@@ -106,16 +114,63 @@ struct EXPR {
 };
 
 //
-// Action queries: not yet supported
+// Compound where clauses: parsed by the rewrite (see rewrite.h) into a
+// tree of predicates, e.g. "Year > 2000 AND NOT Title LIKE 'The %'".
+// BETWEEN is parsed as the AND of two comparisons. Like GROUP BY, the
+// tree of a SELECT is kept in the Rewrite, not in the SELECT.
+//
+enum AST_PRED_TYPES {
+  PRED_COMPARE = 0, // expr, including EXPR_LIKE
+  PRED_IN,          // expr->column IN (values)
+  PRED_AND,         // left AND right
+  PRED_OR,          // left OR right
+  PRED_NOT          // NOT left
+};
+
+struct PRED {
+  int predType; // enum AST_PRED_TYPES
+
+  struct EXPR *expr; // PRED_COMPARE: the comparison, PRED_IN: the column
+  char **values;     // PRED_IN: ARRAY of literals in string form
+  int *litTypes;     // PRED_IN: ARRAY of enum AST_LITERAL_TYPES
+  int numValues;
+
+  struct PRED *left;  // PRED_AND, PRED_OR, PRED_NOT
+  struct PRED *right; // PRED_AND, PRED_OR
+};
+
+//
+// Action queries: parsed by the rewrite (see rewrite.h)
 //
 struct INSERT {
   char *table;
+
+  struct COLUMN *columns; // OPTIONAL: Linked-list of the columns given
+  struct VALUES *values;  // Linked-list of 1 or more rows
+  int numRows;
+};
+
+struct VALUES {
+  int numValues;
+  int *litTypes;   // ARRAY: enum AST_LITERAL_TYPES of each value
+  char **literals; // ARRAY: each value in string form, e.g. "123"
+  struct VALUES *next;
 };
 
 struct UPDATE {
   char *table;
+  struct SET *set;    // Linked-list of 1 or more assignments
+  struct PRED *where; // OPTIONAL where clause
+};
+
+struct SET {
+  struct COLUMN *column;
+  int litType; // enum AST_LITERAL_TYPES
+  char *value; // literal in string form, e.g. "123" or "The Matrix"
+  struct SET *next;
 };
 
 struct DELETE {
   char *table;
+  struct PRED *where; // OPTIONAL where clause
 };
@@ -0,0 +1,677 @@
+/*bench.c*/
+
+//
+// Program to benchmark SimpleSQL, from the scanner up to whole
+// queries.
+//
+// Usage: bench [-time seconds] [database ...]
+//
+// The scanner and result set benchmarks always run. For each database
+// given, the parser and analyzer, and then whole queries, are run
+// against it. The queries are generated from each table's schema ---
+// a scan, filters, an index lookup, an aggregate, a group by, a sort
+// and a join --- with literals taken from the table's middle record,
+// so they work on any database, e.g. one scaled up by datagen.
+//
+// Each benchmark runs with 1, 2, 4, ... iterations until they take at
+// least the given # of seconds (default 0.5), and then outputs one
+// line of JSON:
+//
+//   {"benchmark": "resultset/put", "iterations": 2048,
+//    "ns_per_op": 251304.2, "items_per_op": 4096, "items_per_sec": ...}
+//
+// where an item is a token, statement or row, depending on the
+// benchmark. Save the output of each commit, e.g.
+//
+//   bench MovieLens CTA > bench_output.txt
+//
+// and compare the outputs to find regressions.
+//
+// Randy Truong
+//
+
+#include <stdarg.h>  // va_list
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h> // clock_gettime
+
+#include "analyzer.h"
+#include "arena.h"
+#include "bufferpool.h"
+#include "database.h"
+#include "operator.h"
+#include "parser.h"
+#include "resultset.h"
+#include "rewrite.h"
+#include "scanner.h"
+#include "session.h"
+#include "table.h"
+#include "tokenqueue.h"
+#include "util.h"
+#include "wal.h"
+
+#define BENCH_MAX_QUERIES 256  // max # of queries generated per database
+#define BENCH_MAX_QUERY 1024   // max length of a generated query
+#define BENCH_ROWS 4096        // # of rows in the result set benchmarks
+#define BENCH_STATEMENTS 1000  // # of statements in the scanner's input
+
+//
+// a query generated for a database:
+//
+struct BenchQuery {
+  char name[BENCH_MAX_QUERY]; // e.g. "MovieLens/Movies/scan"
+  char text[BENCH_MAX_QUERY];
+  char parsed[BENCH_MAX_QUERY]; // text without extended clauses (rewrite.h)
+  long numRows; // # of rows in the tables queried, its items
+};
+
+struct BenchQueries {
+  struct Database *db;
+  struct BenchQuery queries[BENCH_MAX_QUERIES];
+  int numQueries;
+};
+
+//
+// the input to the scanner benchmark:
+//
+struct BenchText {
+  char *text;
+  int length;
+  long numTokens;
+};
+
+static double minSeconds = 0.5;
+
+//
+// now
+//
+// Returns the time in seconds, from a monotonic clock.
+//
+static double now(void) {
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+//
+// benchmark
+//
+// Calls run(arg, N) for N = 1, 2, 4, ... until the call takes at
+// least minSeconds, and outputs the result. Each of the N operations
+// run performs handles itemsPerOp items.
+//
+static void benchmark(char *name, void (*run)(void *arg, long N), void *arg,
+                      double itemsPerOp) {
+  long N = 1;
+  double elapsed = 0.0;
+
+  while (true) {
+    double start = now();
+
+    run(arg, N);
+
+    elapsed = now() - start;
+
+    if (elapsed >= minSeconds || N >= (1L << 40))
+      break;
+
+    N *= 2;
+  }
+
+  double nsPerOp = elapsed * 1e9 / N;
+
+  printf("{\"benchmark\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.1f, "
+         "\"items_per_op\": %.0f, \"items_per_sec\": %.1f}\n",
+         name, N, nsPerOp, itemsPerOp, itemsPerOp * 1e9 / nsPerOp);
+  fflush(stdout);
+}
+
+//
+// scanner
+//
+// Tokenizes the text.
+//
+static long scanText(struct BenchText *text, char *value) {
+  FILE *input = fmemopen(text->text, text->length, "r");
+  if (input == NULL)
+    panic("out of memory");
+
+  int lineNumber, colNumber;
+  long numTokens = 0;
+
+  scanner_init(&lineNumber, &colNumber, value);
+
+  while (scanner_nextToken(input, &lineNumber, &colNumber, value).id !=
+         SQL_EOS)
+    numTokens++;
+
+  fclose(input);
+
+  return numTokens;
+}
+
+static void benchScanner(void *arg, long N) {
+  struct BenchText *text = (struct BenchText *)arg;
+  char *value = (char *)malloc(sizeof(char) * (text->length + 1));
+  if (value == NULL)
+    panic("out of memory");
+
+  for (long n = 0; n < N; n++)
+    scanText(text, value);
+
+  free(value);
+}
+
+//
+// longText
+//
+// Returns BENCH_STATEMENTS statements, with long lists of columns
+// and every kind of literal, for the scanner.
+//
+static char *longText(void) {
+  int size = BENCH_STATEMENTS * 512;
+  char *text = (char *)malloc(sizeof(char) * size);
+  if (text == NULL)
+    panic("out of memory");
+
+  char *cp = text;
+
+  for (int s = 0; s < BENCH_STATEMENTS; s++) {
+    cp += sprintf(cp, "SELECT ");
+
+    for (int c = 0; c < 16; c++)
+      cp += sprintf(cp, "%sTable%d.Column%d", (c > 0) ? ", " : "", s, c);
+
+    cp += sprintf(cp,
+                  "\nFROM Table%d INNER JOIN Other ON Table%d.ID = Other.ID\n"
+                  "WHERE Title <> 'string literal %d' ORDER BY Rating DESC "
+                  "LIMIT %d;\n"
+                  "SELECT AVG(Revenue), MAX(Year) FROM Movies WHERE "
+                  "Revenue >= %d.25;\n",
+                  s, s, s, s, s);
+  }
+
+  return text;
+}
+
+//
+// parser and analyzer
+//
+static void benchParser(void *arg, long N) {
+  struct BenchQueries *bq = (struct BenchQueries *)arg;
+
+  for (long n = 0; n < N; n++) {
+    for (int q = 0; q < bq->numQueries; q++) {
+      char *text = bq->queries[q].parsed;
+      FILE *input = fmemopen(text, strlen(text), "r");
+      if (input == NULL)
+        panic("out of memory");
+
+      struct TokenQueue *tokens = parser_parse(input);
+
+      fclose(input);
+
+      if (tokens != NULL)
+        tokenqueue_destroy(tokens);
+    }
+  }
+}
+
+static void benchAnalyzer(void *arg, long N) {
+  struct BenchQueries *bq = (struct BenchQueries *)arg;
+
+  for (long n = 0; n < N; n++) {
+    for (int q = 0; q < bq->numQueries; q++) {
+      char *text = bq->queries[q].parsed;
+      FILE *input = fmemopen(text, strlen(text), "r");
+      if (input == NULL)
+        panic("out of memory");
+
+      struct TokenQueue *tokens = parser_parse(input);
+
+      fclose(input);
+
+      if (tokens == NULL)
+        continue;
+
+      struct QUERY *query = analyzer_build(bq->db, tokens);
+
+      tokenqueue_destroy(tokens);
+
+      if (query != NULL)
+        analyzer_destroy(query);
+    }
+  }
+}
+
+//
+// result set
+//
+// fillRows
+//
+// Adds BENCH_ROWS rows of an int, a real and a string to a new
+// result set.
+//
+static struct ResultSet *fillRows(void) {
+  struct ResultSet *rs = results_create();
+
+  results_insertColumn(rs, 1, "Bench", "ID", NO_FUNCTION, COL_TYPE_INT);
+  results_insertColumn(rs, 2, "Bench", "Rating", NO_FUNCTION, COL_TYPE_REAL);
+  results_insertColumn(rs, 3, "Bench", "Title", NO_FUNCTION, COL_TYPE_STRING);
+
+  for (int r = 1; r <= BENCH_ROWS; r++) {
+    int row = results_addRow(rs);
+
+    results_putInt(rs, row, 1, r);
+    results_putReal(rs, row, 2, r / 4.0);
+    results_putString(rs, row, 3, "The Shawshank Redemption");
+  }
+
+  return rs;
+}
+
+static void benchPut(void *arg, long N) {
+  (void)arg;
+
+  for (long n = 0; n < N; n++)
+    results_destroy(fillRows());
+}
+
+static void benchGet(void *arg, long N) {
+  struct ResultSet *rs = (struct ResultSet *)arg;
+  long sum = 0;
+
+  for (long n = 0; n < N; n++) {
+    for (int row = 1; row <= rs->numRows; row++) {
+      sum += results_getInt(rs, row, 1);
+      sum += (long)results_getReal(rs, row, 2);
+
+      char *title = results_getString(rs, row, 3);
+      sum += title[0];
+      free(title);
+    }
+  }
+
+  if (sum == 42) // so the reads are not optimized away
+    printf("\n");
+}
+
+//
+// benchDeleteHalf
+//
+// Fills a result set and deletes every other row, from the last row
+// back, as a WHERE clause applied to the result set would.
+//
+static void benchDeleteHalf(void *arg, long N) {
+  (void)arg;
+
+  for (long n = 0; n < N; n++) {
+    struct ResultSet *rs = fillRows();
+
+    for (int row = rs->numRows; row >= 1; row -= 2)
+      results_deleteRow(rs, row);
+
+    results_destroy(rs);
+  }
+}
+
+//
+// benchDeleteFirst
+//
+// Fills a result set and deletes the first row until it is empty,
+// reading the new first row after each delete.
+//
+static void benchDeleteFirst(void *arg, long N) {
+  (void)arg;
+
+  long sum = 0;
+
+  for (long n = 0; n < N; n++) {
+    struct ResultSet *rs = fillRows();
+
+    while (rs->numRows > 1) {
+      results_deleteRow(rs, 1);
+      sum += results_getInt(rs, 1, 1);
+    }
+
+    results_destroy(rs);
+  }
+
+  if (sum == 42)
+    printf("\n");
+}
+
+//
+// end-to-end queries
+//
+struct BenchRun {
+  struct Database *db;
+  char *text;
+};
+
+static void benchQuery(void *arg, long N) {
+  struct BenchRun *run = (struct BenchRun *)arg;
+
+  for (long n = 0; n < N; n++) {
+    FILE *input = fmemopen(run->text, strlen(run->text), "r");
+    if (input == NULL)
+      panic("out of memory");
+
+    session_run(run->db, input);
+
+    fclose(input);
+  }
+}
+
+//
+// literal
+//
+// Writes the value as a literal into buffer, returning false if it
+// cannot be written as one (a string containing both kinds of quote).
+//
+static bool literal(struct TupleValue *value, char *buffer) {
+  if (value->valueType == COL_TYPE_INT) {
+    sprintf(buffer, "%d", value->value.i);
+    return true;
+  }
+
+  if (value->valueType == COL_TYPE_REAL) {
+    sprintf(buffer, "%.2f", value->value.r);
+    return true;
+  }
+
+  char string[BENCH_MAX_QUERY / 4];
+  int length = value->length;
+
+  if (length >= (int)sizeof(string))
+    return false;
+
+  operator_copyString(value, string);
+
+  if (strchr(string, '\'') == NULL)
+    sprintf(buffer, "'%s'", string);
+  else if (strchr(string, '"') == NULL)
+    sprintf(buffer, "\"%s\"", string);
+  else
+    return false;
+
+  return true;
+}
+
+//
+// addQuery
+//
+// Adds a query named "database/table/kind" to bq, formatted as for
+// printf.
+//
+static void addQuery(struct BenchQueries *bq, char *table, char *kind,
+                     long numRows, char *format, ...) {
+  if (bq->numQueries == BENCH_MAX_QUERIES)
+    return;
+
+  struct BenchQuery *query = &bq->queries[bq->numQueries++];
+  va_list args;
+
+  snprintf(query->name, sizeof(query->name), "%s/%s/%s", bq->db->name, table,
+           kind);
+
+  va_start(args, format);
+  vsnprintf(query->text, sizeof(query->text), format, args);
+  va_end(args);
+
+  // the parser and analyzer only see the text without e.g. GROUP BY
+  struct Rewrite *rewrite = rewrite_statement(query->text);
+  if (rewrite == NULL)
+    panic("unable to rewrite generated query");
+
+  snprintf(query->parsed, sizeof(query->parsed), "%s", rewrite->text);
+  rewrite_destroy(rewrite);
+
+  query->numRows = numRows;
+}
+
+//
+// tableQueries
+//
+// Adds the queries on the given table to bq, returning its # of rows,
+// or -1 if the table could not be opened (msg already output).
+//
+static long tableQueries(struct BenchQueries *bq, struct TableMeta *meta) {
+  struct Table *table = table_open(bq->db, meta);
+
+  if (table == NULL) // msg already output
+    return -1;
+
+  long numRows = table->numRecords;
+  char *name = meta->name;
+
+  // the middle record's values are the literals
+  struct TupleValue values[meta->numColumns];
+  char literals[meta->numColumns][BENCH_MAX_QUERY / 2];
+  bool haveLiteral[meta->numColumns];
+
+  for (int c = 0; c < meta->numColumns; c++)
+    haveLiteral[c] = false;
+
+  if (numRows > 0) {
+    table_read(table, (int)(numRows / 2), NULL, values);
+
+    for (int c = 0; c < meta->numColumns; c++)
+      haveLiteral[c] = literal(&values[c], literals[c]);
+  }
+
+  table_close(table);
+
+  // the columns to query: a number that is not indexed (if possible),
+  // an indexed column, and a string
+  int number = -1, indexed = -1, string = -1;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    struct ColumnMeta *column = &meta->columns[c];
+
+    if (column->colType != COL_TYPE_STRING &&
+        (number < 0 || (meta->columns[number].indexType != COL_NON_INDEXED &&
+                        column->indexType == COL_NON_INDEXED)))
+      number = c;
+    if (column->indexType != COL_NON_INDEXED && indexed < 0)
+      indexed = c;
+    if (column->colType == COL_TYPE_STRING && string < 0)
+      string = c;
+  }
+
+  addQuery(bq, name, "scan", numRows, "SELECT * FROM %s;", name);
+
+  if (number >= 0) {
+    char *column = meta->columns[number].name;
+
+    if (haveLiteral[number])
+      addQuery(bq, name, "filter", numRows, "SELECT * FROM %s WHERE %s > %s;",
+               name, column, literals[number]);
+
+    addQuery(bq, name, "aggregate", numRows,
+             "SELECT COUNT(%s), MIN(%s), MAX(%s), AVG(%s) FROM %s;", column,
+             column, column, column, name);
+    addQuery(bq, name, "top10", numRows,
+             "SELECT * FROM %s ORDER BY %s DESC LIMIT 10;", name, column);
+  }
+
+  if (string >= 0 && haveLiteral[string])
+    addQuery(bq, name, "filter_string", numRows,
+             "SELECT * FROM %s WHERE %s = %s;", name,
+             meta->columns[string].name, literals[string]);
+
+  if (indexed >= 0 && haveLiteral[indexed])
+    addQuery(bq, name, "lookup", numRows, "SELECT * FROM %s WHERE %s = %s;",
+             name, meta->columns[indexed].name, literals[indexed]);
+
+  if (indexed >= 0 && number >= 0 && indexed != number)
+    addQuery(bq, name, "group_by", numRows,
+             "SELECT %s, COUNT(%s) FROM %s GROUP BY %s;",
+             meta->columns[indexed].name, meta->columns[number].name, name,
+             meta->columns[indexed].name);
+
+  return numRows;
+}
+
+//
+// joinQueries
+//
+// Adds a join for each pair of tables with an indexed column of the
+// same name, e.g. Movies.ID and Ratings.ID; numRows[t] is the # of
+// rows in table t, or -1 if it could not be opened.
+//
+static void joinQueries(struct BenchQueries *bq, long *numRows) {
+  struct Database *db = bq->db;
+
+  for (int t1 = 0; t1 < db->numTables; t1++) {
+    for (int t2 = t1 + 1; t2 < db->numTables; t2++) {
+      struct TableMeta *m1 = &db->tables[t1];
+      struct TableMeta *m2 = &db->tables[t2];
+
+      if (numRows[t1] < 0 || numRows[t2] < 0)
+        continue;
+
+      for (int c1 = 0; c1 < m1->numColumns; c1++) {
+        int c2 = 0;
+
+        while (c2 < m2->numColumns &&
+               icmpStrings(m1->columns[c1].name, m2->columns[c2].name) != 0)
+          c2++;
+
+        if (c2 == m2->numColumns ||
+            m1->columns[c1].indexType == COL_NON_INDEXED ||
+            m2->columns[c2].indexType == COL_NON_INDEXED)
+          continue;
+
+        char tables[2 * DATABASE_MAX_ID_LENGTH + 2];
+        snprintf(tables, sizeof(tables), "%s_%s", m1->name, m2->name);
+
+        addQuery(bq, tables, "join", numRows[t1] + numRows[t2],
+                 "SELECT COUNT(%s.%s) FROM %s JOIN %s ON %s.%s = %s.%s;",
+                 m1->name, m1->columns[c1].name, m1->name, m2->name,
+                 m1->name, m1->columns[c1].name, m2->name,
+                 m2->columns[c2].name);
+        break;
+      }
+    }
+  }
+}
+
+//
+// benchDatabase
+//
+static void benchDatabase(char *name) {
+  struct BenchQueries *bq =
+      (struct BenchQueries *)malloc(sizeof(struct BenchQueries));
+  if (bq == NULL)
+    panic("out of memory");
+
+  bq->db = database_open(name);
+  bq->numQueries = 0;
+
+  if (bq->db == NULL) {
+    printf("**Error: unable to open database '%s'\n", name);
+    free(bq);
+    return;
+  }
+
+  wal_recover(bq->db);
+
+  struct Database *db = bq->db;
+  long numRows[db->numTables];
+
+  for (int t = 0; t < db->numTables; t++)
+    numRows[t] = tableQueries(bq, &db->tables[t]);
+
+  joinQueries(bq, numRows);
+
+  arena_reset(); // done with the rewrites' tokens
+
+  // the parser and analyzer print any error messages to stdout
+  char benchName[BENCH_MAX_QUERY + 8]; // "query/" + name
+
+  snprintf(benchName, sizeof(benchName), "parser/%s", db->name);
+  benchmark(benchName, benchParser, bq, bq->numQueries);
+
+  snprintf(benchName, sizeof(benchName), "parser+analyzer/%s", db->name);
+  benchmark(benchName, benchAnalyzer, bq, bq->numQueries);
+
+  //
+  // the queries' output goes nowhere; each is run once before it is
+  // timed, which builds any index it uses:
+  //
+  FILE *null = fopen("/dev/null", "w");
+  if (null == NULL)
+    panic("unable to open /dev/null");
+
+  session_setOutput(null);
+
+  for (int q = 0; q < bq->numQueries; q++) {
+    struct BenchRun run = {db, bq->queries[q].text};
+
+    benchQuery(&run, 1);
+
+    snprintf(benchName, sizeof(benchName), "query/%s", bq->queries[q].name);
+    benchmark(benchName, benchQuery, &run, bq->queries[q].numRows);
+  }
+
+  session_setOutput(NULL);
+  fclose(null);
+
+  wal_close(db);
+  database_close(db);
+  free(bq);
+}
+
+//
+// main
+//
+int main(int argc, char *argv[]) {
+  int arg = 1;
+
+  if (argc >= 3 && strcmp(argv[1], "-time") == 0) {
+    minSeconds = atof(argv[2]);
+    arg = 3;
+  }
+
+  parser_init();
+
+  // scanner:
+  struct BenchText text;
+
+  text.text = longText();
+  text.length = strlen(text.text);
+
+  char *value = (char *)malloc(sizeof(char) * (text.length + 1));
+  if (value == NULL)
+    panic("out of memory");
+
+  text.numTokens = scanText(&text, value);
+  free(value);
+
+  benchmark("scanner/tokens", benchScanner, &text, text.numTokens);
+  free(text.text);
+
+  // result set:
+  benchmark("resultset/put", benchPut, NULL, BENCH_ROWS);
+
+  struct ResultSet *rs = fillRows();
+  benchmark("resultset/get", benchGet, rs, BENCH_ROWS);
+  results_destroy(rs);
+
+  benchmark("resultset/delete_half", benchDeleteHalf, NULL, BENCH_ROWS);
+  benchmark("resultset/delete_first", benchDeleteFirst, NULL, BENCH_ROWS);
+
+  // parser, analyzer and queries:
+  for (; arg < argc; arg++)
+    benchDatabase(argv[arg]);
+
+  bufferpool_release();
+  arena_release();
+
+  return 0;
+}
@@ -0,0 +1,282 @@
+/*bufferpool.c*/
+
+//
+// Project: Buffer pool for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <fcntl.h> // open
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // stat, fstat
+#include <unistd.h>   // read, close
+
+#include "bufferpool.h"
+#include "util.h"
+
+struct BufferPool {
+  struct PoolFile **files; // ARRAY: the files in the pool, in clock order
+  int numFiles;
+  int size;   // # of array locations (used + unused)
+  int hand;   // index of the clock hand in files
+  long used;  // total # of bytes of the files in the pool
+  long limit; // -1 => not read from the environment yet
+};
+
+static struct BufferPool pool = {NULL, 0, 0, 0, 0, -1};
+
+// held while the pool is searched or changed (see server.h)
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// poolLimit
+//
+// Returns the # of bytes the pool may hold: the value of the
+// SIMPLESQL_BUFFER_POOL environment variable if set, otherwise
+// BUFFERPOOL_DEFAULT_SIZE.
+//
+static long poolLimit(void) {
+  if (pool.limit < 0) {
+    char *value = getenv("SIMPLESQL_BUFFER_POOL");
+
+    if (value != NULL && atol(value) >= 0)
+      pool.limit = atol(value);
+    else
+      pool.limit = BUFFERPOOL_DEFAULT_SIZE;
+  }
+
+  return pool.limit;
+}
+
+static long long modifiedOf(struct stat *info) {
+  return (info->st_mtim.tv_sec * 1000000000LL) + info->st_mtim.tv_nsec;
+}
+
+//
+// readFile
+//
+// Fallback for when a file cannot be mapped: reads the entire file
+// into a malloc'd buffer instead.
+//
+static char *readFile(int fd, size_t size) {
+  char *data = (char *)malloc(sizeof(char) * (size + 1));
+  if (data == NULL)
+    panic("out of memory");
+
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = read(fd, data + total, size - total);
+    if (n <= 0)
+      break;
+    total += n;
+  }
+
+  return data;
+}
+
+//
+// mapFile
+//
+// Maps the file at the given path into memory, returning a new
+// PoolFile, or NULL if the file could not be opened.
+//
+static struct PoolFile *mapFile(char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) < 0) // unable to open:
+  {
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  struct PoolFile *file = (struct PoolFile *)malloc(sizeof(struct PoolFile));
+  if (file == NULL)
+    panic("out of memory");
+
+  file->path = dupString(path);
+  file->data = NULL;
+  file->size = info.st_size;
+  file->mapped = false;
+  file->modified = modifiedOf(&info);
+  file->inode = info.st_ino;
+  file->users = 1;
+  file->referenced = true;
+  file->stale = false;
+
+  // mmap fails on an empty file, in which case there is nothing to read
+  if (file->size > 0) {
+    void *contents = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (contents != MAP_FAILED) {
+      madvise(contents, file->size, MADV_SEQUENTIAL);
+      file->data = (char *)contents;
+      file->mapped = true;
+    } else {
+      file->data = readFile(fd, file->size);
+    }
+  }
+
+  close(fd);
+  return file;
+}
+
+static void freeFile(struct PoolFile *file) {
+  if (file->mapped)
+    munmap(file->data, file->size);
+  else
+    free(file->data);
+
+  free(file->path);
+  free(file);
+}
+
+//
+// removeFile
+//
+// Removes the file at index i from the pool, keeping the clock order
+// of the others.
+//
+static void removeFile(int i) {
+  struct PoolFile *file = pool.files[i];
+
+  pool.used -= file->size;
+  pool.numFiles--;
+  memmove(&pool.files[i], &pool.files[i + 1],
+          sizeof(struct PoolFile *) * (pool.numFiles - i));
+
+  if (pool.hand > i)
+    pool.hand--;
+  if (pool.hand >= pool.numFiles)
+    pool.hand = 0;
+
+  if (file->users == 0)
+    freeFile(file);
+  else
+    file->stale = true; // freed by the last bufferpool_close()
+}
+
+//
+// evict
+//
+// Evicts unused files with the CLOCK policy until the pool is within
+// its limit, or every file left is in use.
+//
+static void evict(void) {
+  long limit = poolLimit();
+  int passed = 0; // # of files passed over since the last eviction
+
+  while (pool.used > limit && passed < 2 * pool.numFiles) {
+    struct PoolFile *file = pool.files[pool.hand];
+
+    if (file->users == 0 && !file->referenced) {
+      removeFile(pool.hand);
+      passed = 0;
+    } else {
+      file->referenced = false;
+      pool.hand = (pool.hand + 1) % pool.numFiles;
+      passed++;
+    }
+  }
+}
+
+//
+// bufferpool_open
+//
+struct PoolFile *bufferpool_open(char *path) {
+  struct stat info;
+
+  if (stat(path, &info) < 0)
+    return NULL;
+
+  pthread_mutex_lock(&poolLock);
+
+  struct PoolFile *file = NULL;
+
+  for (int i = 0; i < pool.numFiles; i++) {
+    if (strcmp(pool.files[i]->path, path) != 0)
+      continue;
+
+    if (pool.files[i]->size == (size_t)info.st_size &&
+        pool.files[i]->modified == modifiedOf(&info) &&
+        pool.files[i]->inode == (long long)info.st_ino) {
+      file = pool.files[i];
+      file->users++;
+      file->referenced = true;
+    } else {
+      removeFile(i); // the file has changed since it was mapped
+    }
+    break;
+  }
+
+  if (file == NULL) {
+    file = mapFile(path);
+
+    if (file != NULL) {
+      if (pool.numFiles == pool.size) {
+        pool.size = (pool.size > 0) ? pool.size * 2 : 16;
+        pool.files = (struct PoolFile **)realloc(
+            pool.files, sizeof(struct PoolFile *) * pool.size);
+        if (pool.files == NULL)
+          panic("out of memory");
+      }
+
+      pool.files[pool.numFiles] = file;
+      pool.numFiles++;
+      pool.used += file->size;
+
+      evict();
+    }
+  }
+
+  pthread_mutex_unlock(&poolLock);
+
+  return file;
+}
+
+//
+// bufferpool_close
+//
+void bufferpool_close(struct PoolFile *file) {
+  if (file == NULL)
+    return;
+
+  pthread_mutex_lock(&poolLock);
+
+  file->users--;
+
+  if (file->stale) {
+    if (file->users == 0)
+      freeFile(file);
+  } else {
+    evict();
+  }
+
+  pthread_mutex_unlock(&poolLock);
+}
+
+//
+// bufferpool_release
+//
+void bufferpool_release(void) {
+  pthread_mutex_lock(&poolLock);
+
+  for (int i = pool.numFiles - 1; i >= 0; i--) {
+    if (pool.files[i]->users == 0)
+      removeFile(i);
+  }
+
+  if (pool.numFiles == 0) {
+    free(pool.files);
+    pool.files = NULL;
+    pool.size = 0;
+  }
+
+  pthread_mutex_unlock(&poolLock);
+}
@@ -0,0 +1,77 @@
+/*bufferpool.h*/
+
+//
+// Project: Buffer pool for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+#include <stddef.h>  // size_t
+
+//
+// Table files (data and column files) are memory-mapped, and values
+// are handed out as pointers into the mapping. Rather than mapping
+// a file for each query and unmapping it at the end, the buffer pool
+// keeps the mappings of recently used files across queries, so a
+// repeated query finds its pages already mapped and in memory.
+//
+// A file is reused as long as its size, modification time and inode
+// are unchanged; otherwise the stale mapping is dropped (once no
+// query is using it) and the file is mapped afresh.
+//
+// Files in use are never evicted. Once the pool holds more than its
+// limit of bytes, unused files are evicted with the CLOCK policy:
+// each file has a reference bit, set when it is opened. The clock
+// hand sweeps the files, evicting the first unused one whose bit is
+// clear and clearing the bits it passes. The limit defaults to
+// BUFFERPOOL_DEFAULT_SIZE; set the SIMPLESQL_BUFFER_POOL environment
+// variable to the number of bytes to change it (0 disables caching).
+//
+#define BUFFERPOOL_DEFAULT_SIZE (256L * 1024 * 1024)
+
+struct PoolFile {
+  char *path;
+  char *data;  // contents of the file, NULL if the file is empty
+  size_t size; // # of bytes in data
+  bool mapped; // true => data is mmap'd, false => data is malloc'd
+
+  long long modified; // modification time of the file (ns)
+  long long inode;    // inode # of the file
+
+  int users;       // # of opens not yet closed
+  bool referenced; // CLOCK reference bit
+  bool stale;      // true => no longer in the pool, free when unused
+};
+
+//
+// Functions:
+//
+
+//
+// bufferpool_open
+//
+// Returns the contents of the file at the given path, mapping it if
+// the pool does not hold an up-to-date copy. Returns NULL if the file
+// could not be opened. The contents remain valid until the matching
+// call to bufferpool_close().
+//
+struct PoolFile *bufferpool_open(char *path);
+
+//
+// bufferpool_close
+//
+// Releases a file returned by bufferpool_open(). The file stays in
+// the pool for later queries, unless it has gone stale.
+//
+void bufferpool_close(struct PoolFile *file);
+
+//
+// bufferpool_release
+//
+// Unmaps every unused file in the pool, e.g. before the program
+// exits.
+//
+void bufferpool_release(void);
@@ -0,0 +1,71 @@
+/*convert.c*/
+
+//
+// Program to convert the tables of a database from the text
+// "<table>.data" layout to columnar "<table>.<column>.col" files
+// (see table.h). Once converted, queries read the column files
+// instead, until the data file changes.
+//
+// Usage: convert database [table ...]
+//
+// Converts the given tables, or every table if none are given.
+//
+// Randy Truong
+//
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "database.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+//
+// main
+//
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("usage: %s database [table ...]\n", argv[0]);
+    return -1;
+  }
+
+  struct Database *db = database_open(argv[1]);
+
+  if (db == NULL) {
+    printf("**Error: unable to open database '%s'\n", argv[1]);
+    return -1;
+  }
+
+  wal_recover(db); // the log's changes must be in the data files first
+
+  bool success = true;
+
+  if (argc == 2) {
+    for (int t = 0; t < db->numTables; t++) {
+      if (table_convert(db, &db->tables[t]))
+        printf("%s: converted\n", db->tables[t].name);
+      else
+        success = false;
+    }
+  } else {
+    for (int i = 2; i < argc; i++) {
+      struct TableMeta *meta = table_find(db, argv[i]);
+
+      if (meta == NULL) {
+        printf("**Error: table '%s' does not exist\n", argv[i]);
+        success = false;
+      } else if (table_convert(db, meta)) {
+        printf("%s: converted\n", meta->name);
+      } else {
+        success = false;
+      }
+    }
+  }
+
+  wal_close(db);
+  database_close(db);
+
+  return success ? 0 : -1;
+}
@@ -0,0 +1,859 @@
+/*datagen.c*/
+
+//
+// Program to generate synthetic tables, of any size, for the schema
+// of a database, e.g. to benchmark queries against millions of rows.
+//
+// Usage: datagen [options] database table rows [table rows ...]
+//
+// Writes "<database>/<table>.data" with the given # of rows for each
+// table, in the same fixed-width layout as the sample data: values
+// separated by spaces, strings in quotes, padded with '.' to the
+// table's record size and ended by "$\n". Options:
+//
+//   -schema name     copy the .meta files of database 'name' into the
+//                    (possibly new) database first, e.g. to scale up
+//                    MovieLens without overwriting its data
+//   -seed N          seed of the values (default 1); the output does
+//                    not depend on the # of threads
+//   -threads N       # of threads writing (default: # of cores)
+//   -column T.C=D    distribution of column C of table T, where D is
+//                    one of
+//                      uniform:lo:hi     uniform over [lo, hi]
+//                      zipf:lo:hi[:s]    Zipfian over [lo, hi] with
+//                                        exponent s (default 1.0)
+//                      unique:lo         distinct values from lo, in
+//                                        random order
+//                      sequential:lo     lo, lo + 1, lo + 2, ...
+//
+// By default, a COL_UNIQUE_INDEXED column gets unique values from 1.
+// A COL_INDEXED column gets Zipfian keys over the unique values of
+// the same column of another table being generated, if any, so that
+// joins match (e.g. Ratings.ID over Movies.ID), otherwise over [1,
+// rows]. Other ints and reals are uniform over [0, 1000000]. Strings
+// are words derived from a key drawn the same way, so that equal keys
+// give equal strings; their length is limited by the record size.
+//
+// For example, 10 million ratings of 1 million movies:
+//
+//   datagen -schema MovieLens Big Movies 1000000 Ratings 10000000
+//
+// Randy Truong
+//
+
+#include <errno.h>
+#include <fcntl.h> // open
+#include <math.h>  // exp, log1p, expm1
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdint.h>  // uint64_t
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // mkdir
+#include <time.h>     // clock_gettime
+#include <unistd.h>   // pwrite, sysconf
+
+#include "database.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+#define DATAGEN_BATCH 4096        // # of records formatted per write
+#define DATAGEN_MAX_STRING 40     // max length of a generated string
+#define DATAGEN_MAX_TABLES 64     // max # of tables per run
+#define DATAGEN_MAX_VALUE 1000000 // default upper bound of ints, reals
+
+enum Distribution {
+  DIST_DEFAULT = 0, // chosen from the column's type and index
+  DIST_UNIFORM,
+  DIST_ZIPF,
+  DIST_UNIQUE,
+  DIST_SEQUENTIAL
+};
+
+//
+// how the values of a column are generated: each value is drawn as a
+// key in [lo, hi] and then formatted --- an int as is, a real as
+// key / 100, a string as a word derived from the key:
+//
+struct ColumnGen {
+  int distribution;
+  long long lo, hi;
+  double s; // DIST_ZIPF: exponent
+
+  // DIST_ZIPF: constants of the sampler (see zipfSample)
+  double hX1, hN, sTest;
+
+  // DIST_UNIQUE, DIST_ZIPF: key i maps to lo + (i * mult) % n
+  long long mult;
+
+  int width;     // max # of chars of a value
+  int minLength; // COL_TYPE_STRING: min # of chars
+};
+
+struct TableGen {
+  struct TableMeta *meta;
+  long long rows;
+  struct ColumnGen *columns;
+  uint64_t seed;
+};
+
+//
+// a thread writes records [start, end) of the table:
+//
+struct Writer {
+  pthread_t thread;
+  struct TableGen *gen;
+  int fd;
+  long long start, end;
+  bool failed;
+};
+
+//
+// splitmix64
+//
+// Advances the state and returns the next 64 pseudo-random bits.
+//
+static inline uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static inline double uniform01(uint64_t *state) {
+  return (splitmix64(state) >> 11) * 0x1.0p-53;
+}
+
+//
+// Zipf sampling by rejection-inversion (Hormann and Derflinger, 1996),
+// which needs no table of probabilities however large the range:
+//
+static double helper1(double x) {
+  return (fabs(x) > 1e-8) ? log1p(x) / x
+                          : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double helper2(double x) {
+  return (fabs(x) > 1e-8) ? expm1(x) / x
+                          : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static double hIntegral(double x, double s) {
+  double logX = log(x);
+
+  return helper2((1 - s) * logX) * logX;
+}
+
+static double h(double x, double s) { return exp(-s * log(x)); }
+
+static double hIntegralInverse(double x, double s) {
+  double t = x * (1 - s);
+
+  if (t < -1)
+    t = -1;
+
+  return exp(helper1(t) * x);
+}
+
+static void zipfSetup(struct ColumnGen *gen) {
+  double n = (double)(gen->hi - gen->lo + 1);
+
+  gen->hX1 = hIntegral(1.5, gen->s) - 1;
+  gen->hN = hIntegral(n + 0.5, gen->s);
+  gen->sTest =
+      2 - hIntegralInverse(hIntegral(2.5, gen->s) - h(2, gen->s), gen->s);
+}
+
+//
+// zipfSample
+//
+// Returns a rank in [1, n], rank k having probability ~ 1 / k^s.
+//
+static long long zipfSample(struct ColumnGen *gen, uint64_t *state) {
+  long long n = gen->hi - gen->lo + 1;
+
+  while (true) {
+    double u = gen->hN + uniform01(state) * (gen->hX1 - gen->hN);
+    double x = hIntegralInverse(u, gen->s);
+    long long k = (long long)(x + 0.5);
+
+    if (k < 1)
+      k = 1;
+    else if (k > n)
+      k = n;
+
+    if (k - x <= gen->sTest ||
+        u >= hIntegral(k + 0.5, gen->s) - h((double)k, gen->s))
+      return k;
+  }
+}
+
+static long long gcd(long long a, long long b) {
+  while (b != 0) {
+    long long t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+//
+// multiplierFor
+//
+// Returns a multiplier coprime to n, so that i -> (i * mult) % n is a
+// permutation of [0, n) that scatters neighbouring i.
+//
+static long long multiplierFor(long long n) {
+  if (n <= 2)
+    return 1;
+
+  long long mult = (long long)(n * 0.6180339887) | 1;
+
+  while (gcd(mult, n) != 1)
+    mult += 2;
+
+  return mult % n;
+}
+
+//
+// widthOf
+//
+// Returns the # of chars of the key formatted as an int (scale 1) or
+// as a real with 2 decimals (scale 100).
+//
+static int widthOf(long long key, int scale) {
+  int width = (key < 0) ? 2 : 1;
+
+  for (long long value = llabs(key) / scale; value >= 10; value /= 10)
+    width++;
+
+  return (scale > 1) ? width + 3 : width; // + ".00"
+}
+
+//
+// keyOf
+//
+// Draws the key of the column for the given row.
+//
+static long long keyOf(struct ColumnGen *gen, long long row,
+                       uint64_t *state) {
+  long long n = gen->hi - gen->lo + 1;
+
+  switch (gen->distribution) {
+  case DIST_SEQUENTIAL:
+    return gen->lo + row;
+  case DIST_UNIQUE:
+    return gen->lo + (long long)(((unsigned __int128)row * gen->mult) % n);
+  case DIST_ZIPF: {
+    // scattered, so that the most frequent keys are not all small
+    long long rank = zipfSample(gen, state) - 1;
+
+    return gen->lo + (long long)(((unsigned __int128)rank * gen->mult) % n);
+  }
+  default:
+    return gen->lo + (long long)(splitmix64(state) % (uint64_t)n);
+  }
+}
+
+//
+// formatNumber
+//
+// Writes the key as an int (scale 1) or as a real with 2 decimals
+// (scale 100), returning its # of chars; faster than sprintf.
+//
+static int formatNumber(long long key, int scale, char *out) {
+  char digits[24];
+  int n = 0;
+  unsigned long long value = llabs(key);
+
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+
+    if (scale > 1 && n == 2)
+      digits[n++] = '.';
+  } while (value > 0 || (scale > 1 && n < 4));
+
+  char *cp = out;
+
+  if (key < 0)
+    *cp++ = '-';
+
+  while (n > 0)
+    *cp++ = digits[--n];
+
+  return (int)(cp - out);
+}
+
+//
+// formatString
+//
+// Writes the word of the key, in quotes, returning its # of chars. A
+// key's word is always the same; for unique or sequential keys the
+// letters spell the key in base 26, so the words are distinct too.
+//
+static int formatString(struct ColumnGen *gen, long long key, int row,
+                        char *out) {
+  char quote = (row % 2 == 0) ? '\'' : '"';
+  char *cp = out;
+
+  *cp++ = quote;
+
+  if (gen->distribution == DIST_UNIQUE ||
+      gen->distribution == DIST_SEQUENTIAL) {
+    int length = gen->width - 2;
+
+    for (int i = length - 1; i >= 0; i--) {
+      cp[i] = 'a' + (key % 26);
+      key /= 26;
+    }
+    cp[0] = cp[0] - 'a' + 'A';
+    cp += length;
+  } else {
+    uint64_t state = (uint64_t)key * 0xD1B54A32D192ED03ULL;
+    int max = gen->width - 2;
+    int length =
+        gen->minLength + (int)(splitmix64(&state) % (max - gen->minLength + 1));
+
+    int word = 0; // # of letters of the current word
+
+    uint64_t bits = 0;
+
+    for (int i = 0; i < length; i++) {
+      if (i % 8 == 0) // a byte of bits per char
+        bits = splitmix64(&state);
+
+      int byte = (int)(bits & 0xFF);
+      bits >>= 8;
+
+      // words of 3 or more letters, separated by single spaces
+      if (word >= 3 && i < length - 1 && byte < 43) {
+        *cp++ = ' ';
+        word = 0;
+      } else {
+        *cp++ = ((word == 0) ? 'A' : 'a') + byte % 26;
+        word++;
+      }
+    }
+  }
+
+  *cp++ = quote;
+
+  return (int)(cp - out);
+}
+
+//
+// formatRecord
+//
+// Formats the given row of the table into record, which holds the
+// record size + 2 chars.
+//
+static void formatRecord(struct TableGen *gen, long long row, char *record) {
+  struct TableMeta *meta = gen->meta;
+  uint64_t state = gen->seed ^ ((uint64_t)row * 0x9E3779B97F4A7C15ULL);
+  char *cp = record;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    struct ColumnGen *column = &gen->columns[c];
+    long long key = keyOf(column, row, &state);
+
+    if (meta->columns[c].colType == COL_TYPE_INT)
+      cp += formatNumber(key, 1, cp);
+    else if (meta->columns[c].colType == COL_TYPE_REAL)
+      cp += formatNumber(key, 100, cp);
+    else
+      cp += formatString(column, key, (int)row, cp);
+
+    *cp++ = ' ';
+  }
+
+  memset(cp, '.', record + meta->recordSize - cp);
+  record[meta->recordSize] = '$';
+  record[meta->recordSize + 1] = '\n';
+}
+
+//
+// writeRecords
+//
+// Thread that formats and writes its range of records, a batch at a
+// time, at their place in the file.
+//
+static void *writeRecords(void *arg) {
+  struct Writer *writer = (struct Writer *)arg;
+  struct TableGen *gen = writer->gen;
+  long long recordLength = gen->meta->recordSize + 2;
+
+  // + 64 so that formatting never writes past the last record
+  char *buffer = (char *)malloc(recordLength * DATAGEN_BATCH + 64);
+  if (buffer == NULL)
+    panic("out of memory");
+
+  for (long long row = writer->start; row < writer->end && !writer->failed;
+       row += DATAGEN_BATCH) {
+    long long count = writer->end - row;
+
+    if (count > DATAGEN_BATCH)
+      count = DATAGEN_BATCH;
+
+    for (long long r = 0; r < count; r++)
+      formatRecord(gen, row + r, buffer + r * recordLength);
+
+    size_t length = count * recordLength;
+    off_t offset = row * recordLength;
+
+    for (size_t done = 0; done < length;) {
+      ssize_t n = pwrite(writer->fd, buffer + done, length - done,
+                         offset + done);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0) {
+        writer->failed = true;
+        break;
+      }
+
+      done += n;
+    }
+  }
+
+  free(buffer);
+
+  return NULL;
+}
+
+//
+// parseDistribution
+//
+// Parses the D of a -column T.C=D option into gen, returning false if
+// it is not valid.
+//
+static bool parseDistribution(char *text, struct ColumnGen *gen) {
+  char name[16];
+  long long lo = 0, hi = 0;
+  double s = 1.0;
+  int n = sscanf(text, "%15[a-z]:%lld:%lld:%lf", name, &lo, &hi, &s);
+
+  if (n >= 3 && strcmp(name, "uniform") == 0)
+    gen->distribution = DIST_UNIFORM;
+  else if (n >= 3 && strcmp(name, "zipf") == 0 && s > 0)
+    gen->distribution = DIST_ZIPF;
+  else if (n == 2 && strcmp(name, "unique") == 0)
+    gen->distribution = DIST_UNIQUE;
+  else if (n == 2 && strcmp(name, "sequential") == 0)
+    gen->distribution = DIST_SEQUENTIAL;
+  else
+    return false;
+
+  gen->lo = lo;
+  gen->hi = (n >= 3) ? hi : lo; // unique, sequential: set per table
+  gen->s = s;
+
+  return gen->lo <= gen->hi;
+}
+
+//
+// uniqueRows
+//
+// Returns the # of rows of the table being generated whose column of
+// the given name is COL_UNIQUE_INDEXED, or 0 if there is none.
+//
+static long long uniqueRows(struct TableGen *gens, int numTables,
+                            char *column) {
+  for (int t = 0; t < numTables; t++) {
+    int c = table_findColumn(gens[t].meta, column);
+
+    if (c >= 0 && gens[t].meta->columns[c].indexType == COL_UNIQUE_INDEXED)
+      return gens[t].rows;
+  }
+
+  return 0;
+}
+
+//
+// planTable
+//
+// Completes the distributions of the table's columns, and sizes its
+// strings to fit the record. Returns false if it does not fit.
+//
+static bool planTable(struct TableGen *gens, int numTables,
+                      struct TableGen *gen) {
+  struct TableMeta *meta = gen->meta;
+  int used = meta->numColumns; // a space after each value
+  int numStrings = 0;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    struct ColumnMeta *column = &meta->columns[c];
+    struct ColumnGen *cg = &gen->columns[c];
+    int scale = (column->colType == COL_TYPE_REAL) ? 100 : 1;
+
+    if (cg->distribution == DIST_DEFAULT) {
+      long long keys = uniqueRows(gens, numTables, column->name);
+
+      if (column->indexType == COL_UNIQUE_INDEXED) {
+        cg->distribution = DIST_UNIQUE;
+        cg->lo = 1;
+      } else if (column->indexType == COL_INDEXED) {
+        cg->distribution = DIST_ZIPF;
+        cg->lo = 1;
+        cg->hi = (keys > 0) ? keys : gen->rows;
+        cg->s = 1.0;
+      } else if (column->colType == COL_TYPE_STRING) {
+        cg->distribution = DIST_UNIFORM;
+        cg->lo = 1;
+        cg->hi = gen->rows;
+      } else {
+        cg->distribution = DIST_UNIFORM;
+        cg->lo = 0;
+        cg->hi = DATAGEN_MAX_VALUE * (long long)scale;
+      }
+    } else if (cg->distribution != DIST_UNIQUE &&
+               cg->distribution != DIST_SEQUENTIAL) {
+      cg->lo *= scale;
+      cg->hi *= scale;
+    } else {
+      cg->lo *= scale;
+    }
+
+    if (cg->distribution == DIST_UNIQUE ||
+        cg->distribution == DIST_SEQUENTIAL)
+      cg->hi = cg->lo + ((gen->rows > 0) ? gen->rows : 1) - 1;
+
+    cg->mult = multiplierFor(cg->hi - cg->lo + 1);
+
+    if (cg->distribution == DIST_ZIPF)
+      zipfSetup(cg);
+
+    if (column->colType == COL_TYPE_INT &&
+        (cg->lo < -2147483647LL || cg->hi > 2147483647LL)) {
+      printf("**Error: values of column '%s' do not fit in an int\n",
+             column->name);
+      return false;
+    }
+
+    if (column->colType == COL_TYPE_STRING) {
+      numStrings++;
+      used += 2; // quotes
+    } else {
+      cg->width = widthOf(cg->lo, scale);
+
+      if (widthOf(cg->hi, scale) > cg->width)
+        cg->width = widthOf(cg->hi, scale);
+
+      used += cg->width;
+    }
+  }
+
+  // the rest of the record is shared by the strings
+  int length = (numStrings > 0) ? (meta->recordSize - used) / numStrings : 0;
+
+  if (length > DATAGEN_MAX_STRING)
+    length = DATAGEN_MAX_STRING;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    struct ColumnGen *cg = &gen->columns[c];
+
+    if (meta->columns[c].colType != COL_TYPE_STRING)
+      continue;
+
+    int needed = 1; // unique, sequential: enough letters for hi
+    for (long long key = cg->hi; key >= 26; key /= 26)
+      needed++;
+
+    bool spelled = (cg->distribution == DIST_UNIQUE ||
+                    cg->distribution == DIST_SEQUENTIAL);
+
+    if (length < 1 || (spelled && length < needed)) {
+      used = meta->recordSize + 1; // does not fit
+      break;
+    }
+
+    cg->width = (spelled ? needed : length) + 2;
+    cg->minLength = (length + 3) / 4;
+    used += cg->width - 2;
+  }
+
+  if (used > meta->recordSize) {
+    printf("**Error: the values of table '%s' do not fit in its record "
+           "size of %d\n",
+           meta->name, meta->recordSize);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// generateTable
+//
+// Writes the table's data file with the given # of threads, via a
+// temporary file. Returns true if successful.
+//
+static bool generateTable(struct Database *db, struct TableGen *gen,
+                          int numThreads) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  char temp[TABLE_MAX_PATH_LENGTH + 8];
+
+  table_path(path, db, gen->meta->name, ".data");
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("**Error: unable to write data file '%s'\n", path);
+    return false;
+  }
+
+  long long length = gen->rows * (gen->meta->recordSize + 2);
+  bool success = (ftruncate(fd, length) == 0);
+
+  if (numThreads > gen->rows / DATAGEN_BATCH + 1)
+    numThreads = (int)(gen->rows / DATAGEN_BATCH) + 1;
+
+  struct Writer writers[numThreads];
+
+  for (int i = 0; i < numThreads && success; i++) {
+    writers[i].gen = gen;
+    writers[i].fd = fd;
+    writers[i].start = gen->rows * i / numThreads;
+    writers[i].end = gen->rows * (i + 1) / numThreads;
+    writers[i].failed = false;
+  }
+
+  for (int i = 1; i < numThreads && success; i++) {
+    if (pthread_create(&writers[i].thread, NULL, writeRecords,
+                       &writers[i]) != 0)
+      panic("unable to create thread");
+  }
+
+  if (success) {
+    writeRecords(&writers[0]);
+
+    for (int i = 1; i < numThreads; i++) {
+      pthread_join(writers[i].thread, NULL);
+      success = success && !writers[i].failed;
+    }
+
+    success = success && !writers[0].failed;
+  }
+
+  if (close(fd) != 0 || !success || rename(temp, path) != 0) {
+    printf("**Error: unable to write data file '%s'\n", path);
+    remove(temp);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// copyFile
+//
+static bool copyFile(char *from, char *to) {
+  FILE *input = fopen(from, "rb");
+  FILE *output = (input != NULL) ? fopen(to, "wb") : NULL;
+  bool success = (output != NULL);
+  char buffer[4096];
+  size_t n;
+
+  while (success && (n = fread(buffer, 1, sizeof(buffer), input)) > 0)
+    success = (fwrite(buffer, 1, n, output) == n);
+
+  if (input != NULL)
+    fclose(input);
+  if (output != NULL && fclose(output) != 0)
+    success = false;
+
+  return success;
+}
+
+//
+// copySchema
+//
+// Copies the .meta files of database 'from' into database 'to',
+// creating its directory if need be. Returns true if successful.
+//
+static bool copySchema(char *from, char *to) {
+  struct Database *schema = database_open(from);
+
+  if (schema == NULL) {
+    printf("**Error: unable to open database '%s'\n", from);
+    return false;
+  }
+
+  if (mkdir(to, 0755) != 0 && errno != EEXIST) {
+    printf("**Error: unable to create database '%s'\n", to);
+    database_close(schema);
+    return false;
+  }
+
+  char source[TABLE_MAX_PATH_LENGTH];
+  char target[TABLE_MAX_PATH_LENGTH];
+
+  snprintf(source, sizeof(source), "%s/%s.meta", from, from);
+  snprintf(target, sizeof(target), "%s/%s.meta", to, to);
+
+  bool success = copyFile(source, target);
+
+  for (int t = 0; t < schema->numTables && success; t++) {
+    snprintf(source, sizeof(source), "%s/%s.meta", from,
+             schema->tables[t].name);
+    snprintf(target, sizeof(target), "%s/%s.meta", to,
+             schema->tables[t].name);
+    success = copyFile(source, target);
+  }
+
+  if (!success)
+    printf("**Error: unable to copy the schema of '%s' to '%s'\n", from, to);
+
+  database_close(schema);
+
+  return success;
+}
+
+static void usage(char *program) {
+  printf("usage: %s [-schema database] [-seed N] [-threads N] "
+         "[-column table.column=distribution ...] database table rows "
+         "[table rows ...]\n",
+         program);
+}
+
+//
+// main
+//
+int main(int argc, char *argv[]) {
+  char *schema = NULL;
+  uint64_t seed = 1;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int numThreads = (cores > 0) ? (int)cores : 1;
+  char *columns[argc]; // the -column options
+  int numColumns = 0;
+  int i = 1;
+
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (strcmp(argv[i], "-schema") == 0)
+      schema = argv[i + 1];
+    else if (strcmp(argv[i], "-seed") == 0)
+      seed = strtoull(argv[i + 1], NULL, 10);
+    else if (strcmp(argv[i], "-threads") == 0 && atoi(argv[i + 1]) > 0)
+      numThreads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-column") == 0)
+      columns[numColumns++] = argv[i + 1];
+    else
+      break;
+  }
+
+  int numTables = (argc - i - 1) / 2;
+
+  if (i >= argc || argv[i][0] == '-' || numTables < 1 ||
+      (argc - i - 1) % 2 != 0 || numTables > DATAGEN_MAX_TABLES) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char *database = argv[i];
+
+  if (schema != NULL && !copySchema(schema, database))
+    return -1;
+
+  struct Database *db = database_open(database);
+
+  if (db == NULL) {
+    printf("**Error: unable to open database '%s'\n", database);
+    return -1;
+  }
+
+  wal_recover(db); // before the tables are overwritten
+
+  struct TableGen gens[DATAGEN_MAX_TABLES];
+  bool success = true;
+
+  for (int t = 0; t < numTables; t++) {
+    char *name = argv[i + 1 + 2 * t];
+    long long rows = atoll(argv[i + 2 + 2 * t]);
+    struct TableMeta *meta = table_find(db, name);
+
+    if (meta == NULL) {
+      printf("**Error: table '%s' does not exist\n", name);
+      success = false;
+      numTables = t;
+      break;
+    }
+
+    if (rows < 0 || rows > 2147483647LL) {
+      printf("**Error: invalid # of rows '%s'\n", argv[i + 2 + 2 * t]);
+      success = false;
+      numTables = t;
+      break;
+    }
+
+    gens[t].meta = meta;
+    gens[t].rows = rows;
+    gens[t].seed = seed * 0xA0761D6478BD642FULL + t;
+    gens[t].columns =
+        (struct ColumnGen *)calloc(meta->numColumns, sizeof(struct ColumnGen));
+    if (gens[t].columns == NULL)
+      panic("out of memory");
+  }
+
+  // then the distributions given for some columns:
+  for (int o = 0; o < numColumns && success; o++) {
+    char table[DATABASE_MAX_ID_LENGTH + 1], column[DATABASE_MAX_ID_LENGTH + 1];
+    int length = 0;
+    int t, c = -1;
+
+    if (sscanf(columns[o], "%31[^.].%31[^=]=%n", table, column, &length) != 2 ||
+        length == 0) {
+      printf("**Error: invalid option '-column %s'\n", columns[o]);
+      success = false;
+      break;
+    }
+
+    for (t = 0; t < numTables; t++) {
+      if (icmpStrings(gens[t].meta->name, table) == 0) {
+        c = table_findColumn(gens[t].meta, column);
+        break;
+      }
+    }
+
+    if (c < 0) {
+      printf("**Error: column '%s.%s' is not being generated\n", table,
+             column);
+      success = false;
+    } else if (!parseDistribution(columns[o] + length, &gens[t].columns[c])) {
+      printf("**Error: invalid distribution '%s'\n", columns[o] + length);
+      success = false;
+    }
+  }
+
+  for (int t = 0; t < numTables && success; t++)
+    success = planTable(gens, numTables, &gens[t]);
+
+  for (int t = 0; t < numTables && success; t++) {
+    struct timespec start, stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    success = generateTable(db, &gens[t], numThreads);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    double seconds =
+        (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (success)
+      printf("%s: %lld rows, %lld bytes, %.2f secs\n", gens[t].meta->name,
+             gens[t].rows, gens[t].rows * (gens[t].meta->recordSize + 2),
+             seconds);
+  }
+
+  for (int t = 0; t < numTables; t++)
+    free(gens[t].columns);
+
+  wal_close(db);
+  database_close(db);
+
+  return success ? 0 : -1;
+}
@@ -15,24 +15,412 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>   // clock_gettime
+#include <unistd.h> // sysconf
 
 //
 // #include any other of our ".h" files?
 //
+#include "arena.h"
 #include "ast.h"
 #include "database.h"
+#include "index.h"
+#include "insert.h"
+#include "modify.h"
+#include "operator.h"
+#include "predicate.h"
 #include "resultset.h"
+#include "rewrite.h"
+#include "session.h"
+#include "table.h"
 #include "util.h"
+#include "vector.h"
+#include "zonemap.h"
 
 //
-// execute_query
+// # of bytes a sort may use before spilling, see sortMemory():
 //
-// execute a select query, which for now means print the resulting parts of a
-// database reference in the query
+#define SORT_MEMORY_DEFAULT (64L * 1024 * 1024)
+
 //
-void execute_query(struct Database *db, struct QUERY *query,
-                   struct ResultSet *rSet) {
+// a table is only partitioned for parallel aggregation if each
+// partition gets at least this many records, see numPartitions():
+//
+#define PARTITION_MIN_RECORDS 65536
+
+//
+// useIndex
+//
+// Returns true if the where expression compares a column that is
+// indexed in the meta-data, with an operator the index supports.
+//
+static bool useIndex(struct TableMeta *tablemeta, struct EXPR *expr) {
+  if (!index_supports(expr->operator))
+    return false;
+
+  for (int i = 0; i < tablemeta->numColumns; i++) {
+    if (strcasecmp(tablemeta->columns[i].name, expr->column->name) == 0) {
+      return tablemeta->columns[i].indexType != COL_NON_INDEXED;
+    }
+  }
+
+  return false;
+}
+
+//
+// useSelectScan
+//
+// Returns true if the where expression compares an int or real
+// column with an operator the vectorized kernels support.
+//
+static bool useSelectScan(struct TableMeta *tablemeta, struct EXPR *expr) {
+  if (!vector_supports(expr->operator))
+    return false;
+
+  for (int i = 0; i < tablemeta->numColumns; i++) {
+    if (strcasecmp(tablemeta->columns[i].name, expr->column->name) == 0) {
+      return tablemeta->columns[i].colType != COL_TYPE_STRING;
+    }
+  }
+
+  return false;
+}
+
+//
+// markColumns
+//
+// Marks each column in the linked-list that belongs to the given
+// table as used; a column without a table name may belong to any.
+//
+static void markColumns(struct TableMeta *tablemeta, struct COLUMN *column,
+                        bool *used) {
+  for (; column != NULL; column = column->next) {
+    if (column->table != NULL &&
+        icmpStrings(column->table, tablemeta->name) != 0)
+      continue;
+
+    for (int i = 0; i < tablemeta->numColumns; i++) {
+      if (icmpStrings(tablemeta->columns[i].name, column->name) == 0)
+        used[i] = true;
+    }
+  }
+}
+
+//
+// markPred
+//
+// Marks the columns of the compound where clause, see markColumns().
+//
+static void markPred(struct TableMeta *tablemeta, struct PRED *pred,
+                     bool *used) {
+  if (pred == NULL)
+    return;
+
+  if (pred->expr != NULL)
+    markColumns(tablemeta, pred->expr->column, used);
+
+  markPred(tablemeta, pred->left, used);
+  markPred(tablemeta, pred->right, used);
+}
+
+//
+// usedColumns
+//
+// Returns an array with one entry per column of the table, true if
+// the column is referenced anywhere in the query, including the
+// rewrite's extended clauses. Only these columns are read from the
+// table.
+//
+static bool *usedColumns(struct TableMeta *tablemeta, struct SELECT *select,
+                         struct Rewrite *rewrite) {
+  bool *used = (bool *)arena_alloc(sizeof(bool) * (tablemeta->numColumns + 1));
+
+  for (int i = 0; i < tablemeta->numColumns; i++)
+    used[i] = false;
+
+  markColumns(tablemeta, select->columns, used);
+
+  if (select->join != NULL) {
+    markColumns(tablemeta, select->join->left, used);
+    markColumns(tablemeta, select->join->right, used);
+  }
+  if (select->where != NULL)
+    markColumns(tablemeta, select->where->expr->column, used);
+  if (rewrite->pred != NULL)
+    markPred(tablemeta, rewrite->pred, used);
+  if (select->orderby != NULL)
+    markColumns(tablemeta, select->orderby->column, used);
+  if (rewrite->groupby != NULL)
+    markColumns(tablemeta, rewrite->groupby->columns, used);
+
+  return used;
+}
+
+//
+// accessTable
+//
+// Returns an operator producing the rows of the given table that
+// satisfy the where expression (pass NULL for all rows): an index
+// scan if the expression can use an index, a select scan if it
+// compares a number or a dictionary-encoded string, otherwise a scan
+// of the whole table followed by a filter. Both scans skip the blocks
+// of records that the zone map rules out. Only the columns the query
+// uses are read. Returns NULL if the table's data file could not be
+// opened; an error message was output.
+//
+static struct Operator *accessTable(struct Database *db,
+                                    struct TableMeta *tablemeta,
+                                    struct SELECT *select,
+                                    struct Rewrite *rewrite,
+                                    struct EXPR *where) {
+  bool *columns = usedColumns(tablemeta, select, rewrite);
+
+  if (where != NULL && useIndex(tablemeta, where)) {
+    // the index scan applies the where clause itself
+    return operator_indexScan(db, tablemeta, where, columns);
+  }
+
+  struct Operator *op = operator_scan(db, tablemeta, columns);
+
+  if (op == NULL || where == NULL)
+    return op;
+
+  // skipping the blocks the column's zone map rules out, see zonemap.h
+  if (zonemap_supports(where->operator)) {
+    operator_scanZones(op, db, where);
+  }
+
+  // evaluated on batches of the column if possible, see vector.h
+  if (!vector_supports(where->operator) || !operator_scanSelect(op, where)) {
+    op = operator_filter(op, where);
+  }
+
+  return op;
+}
+
+//
+// drivingConjunct
+//
+// Returns the index of the conjunct the table is best accessed by, or
+// -1 if none: a comparison that can use an index, else one a select
+// scan supports, else one a zone map can skip blocks for.
+//
+static int drivingConjunct(struct TableMeta *tablemeta, struct PRED **preds,
+                           int N) {
+  int driver = -1;
+  int best = 0;
+
+  for (int i = 0; i < N; i++) {
+    struct EXPR *expr = preds[i]->expr;
+
+    if (preds[i]->predType != PRED_COMPARE || expr->operator == EXPR_LIKE)
+      continue;
+
+    int score = 0;
+
+    if (useIndex(tablemeta, expr))
+      score = 3;
+    else if (useSelectScan(tablemeta, expr))
+      score = 2;
+    else if (zonemap_supports(expr->operator))
+      score = 1;
+
+    if (score > best) {
+      driver = i;
+      best = score;
+    }
+  }
+
+  return driver;
+}
+
+//
+// filterTable
+//
+// Returns an operator producing the rows of the given table that
+// satisfy the where expression, or the AND of the N conjuncts of a
+// compound where clause. The table is accessed by the driving conjunct
+// (see accessTable), and the others are checked on the rows it yields.
+// Returns NULL if the table's data file could not be opened.
+//
+static struct Operator *filterTable(struct Database *db,
+                                    struct TableMeta *tablemeta,
+                                    struct SELECT *select,
+                                    struct Rewrite *rewrite, struct EXPR *where,
+                                    struct PRED **preds, int N) {
+  if (N == 0)
+    return accessTable(db, tablemeta, select, rewrite, where);
 
+  int driver = drivingConjunct(tablemeta, preds, N);
+  struct Operator *op =
+      accessTable(db, tablemeta, select, rewrite,
+                  (driver >= 0) ? preds[driver]->expr : NULL);
+
+  if (op == NULL || (N == 1 && driver == 0))
+    return op;
+
+  struct PRED **rest = (struct PRED **)arena_alloc(sizeof(struct PRED *) * N);
+  int numRest = 0;
+
+  for (int i = 0; i < N; i++) {
+    if (i != driver)
+      rest[numRest++] = preds[i];
+  }
+
+  return operator_predicate(op, rest, numRest);
+}
+
+//
+// halt
+//
+// Called when a table's data file could not be opened (msg already
+// output). The interactive program stops, as it always has; a server
+// session, whose output is a client's socket, only fails the query,
+// since exiting would end every other client's session too.
+//
+static void halt(void) {
+  if (session_output() == stdout) {
+    panic("execution halted");
+    exit(-1);
+  }
+
+  fprintf(session_output(), "**INTERNAL ERROR: execution halted.\n");
+}
+
+//
+// parallelism
+//
+// Returns the # of threads a query may use: the value of the
+// SIMPLESQL_THREADS environment variable if set, otherwise the # of
+// cores.
+//
+static int parallelism(void) {
+  char *value = getenv("SIMPLESQL_THREADS");
+
+  if (value != NULL && atoi(value) > 0) {
+    return atoi(value);
+  }
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return (cores > 0) ? (int)cores : 1;
+}
+
+//
+// bottomOf
+//
+// Returns the operator at the bottom of the pipeline, e.g. the scan
+// under a filter.
+//
+static struct Operator *bottomOf(struct Operator *op) {
+  while (op->child != NULL) {
+    op = op->child;
+  }
+
+  return op;
+}
+
+//
+// numPartitions
+//
+// Returns the # of partitions to split the input op into, one per
+// thread, which is 1 unless op is a (filtered) scan of a table large
+// enough to give every partition PARTITION_MIN_RECORDS records.
+//
+static int numPartitions(struct Operator *op) {
+  struct Operator *scan = bottomOf(op);
+
+  if (scan->opType != OP_SCAN) {
+    return 1;
+  }
+
+  int N = parallelism();
+  int most = scan->estimatedRows / PARTITION_MIN_RECORDS;
+
+  if (N > most) {
+    N = most;
+  }
+
+  return (N > 1) ? N : 1;
+}
+
+//
+// findColumnIn
+//
+// Returns the index of the given column in the output of op, where
+// both the name and the function applied (if any) must match, or -1
+// if not found.
+//
+static int findColumnIn(struct Operator *op, struct COLUMN *column) {
+  for (int i = 0; i < op->numColumns; i++) {
+    if (icmpStrings(op->columns[i].tableName, column->table) == 0 &&
+        icmpStrings(op->columns[i].colName, column->name) == 0 &&
+        op->columns[i].function == column->function) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+//
+// inColumns
+//
+// Returns true if the column (with the same function) is in the
+// linked-list of columns.
+//
+static bool inColumns(struct COLUMN *columns, struct COLUMN *column) {
+  for (struct COLUMN *c = columns; c != NULL; c = c->next) {
+    if (icmpStrings(c->table, column->table) == 0 &&
+        icmpStrings(c->name, column->name) == 0 &&
+        c->function == column->function) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//
+// sortMemory
+//
+// Returns the # of bytes a sort may use in memory before spilling to
+// temporary files: the value of the SIMPLESQL_SORT_MEMORY environment
+// variable if set, otherwise SORT_MEMORY_DEFAULT.
+//
+static long sortMemory(void) {
+  char *value = getenv("SIMPLESQL_SORT_MEMORY");
+
+  if (value != NULL && atol(value) > 0) {
+    return atol(value);
+  }
+
+  return SORT_MEMORY_DEFAULT;
+}
+
+//
+// sortOn
+//
+// Returns a sort of op's output on the order by column, keeping only
+// the first N rows if there is a limit (pass NULL for none).
+//
+static struct Operator *sortOn(struct Operator *op, struct ORDERBY *orderby,
+                               struct LIMIT *limit) {
+  int key = findColumnIn(op, orderby->column);
+  assert(key >= 0);
+
+  int N = (limit != NULL) ? limit->N : -1;
+
+  return operator_sort(op, key, orderby->ascending, N, sortMemory());
+}
+
+//
+// isSelect
+//
+// Returns true if the query is a SELECT, the only kind we plan;
+// otherwise outputs an error message.
+//
+static bool isSelect(struct Database *db, struct QUERY *query) {
   // Ensuring the database and query exist
   if (db == NULL)
     panic("db is NULL (execute)");
@@ -42,278 +430,354 @@ void execute_query(struct Database *db, struct QUERY *query,
   // Ensuring that only the select type is in the query, since it is the focus
   // of this project
   if (query->queryType != SELECT_QUERY) {
-    printf("**INTERNAL ERROR: execute() only supports SELECT queries.\n");
-    return;
+    fprintf(session_output(),
+            "**INTERNAL ERROR: execute() only supports SELECT queries.\n");
+    return false;
   }
 
-  struct SELECT *select = query->q.select; // alias for less typing:
+  return true;
+}
 
+//
+// plan
+//
+// Builds the pipeline of operators that executes the select query,
+// with the extended clauses in the rewrite. Returns NULL if there is
+// an error; in this case an error message was output.
+//
+static struct Operator *plan(struct Database *db, struct SELECT *select,
+                             struct Rewrite *rewrite) {
   //
   // the query has been analyzed and so we know it's correct: the
   // database exists, the table(s) exist, the column(s) exist, etc.
   //
 
   //
-  // (1) we need a pointer to the table meta data, so find it:
+  // (1) we need a pointer to the table meta data, so find it (and
+  // the meta data for the joined table, if any):
   //
-  struct TableMeta *tablemeta = NULL;
-
-  // Going through database to find right table
-  for (int t = 0; t < db->numTables; t++) {
-    if (icmpStrings(db->tables[t].name, select->table) == 0) // found it:
-    {
-      tablemeta = &db->tables[t];
-      break;
-    }
-  }
+  struct TableMeta *tablemeta = table_find(db, select->table);
+  struct TableMeta *joinmeta = NULL;
 
   // Ensuring that the table meta data exists
   assert(tablemeta != NULL);
 
-  // Going through table meta data and inserting relevant columns into the
-  // resultset
-  for (int i = 0; i < tablemeta->numColumns; i++) {
-    resultset_insertColumn(rSet, i + 1, tablemeta->name,
-                           (tablemeta->columns[i]).name, NO_FUNCTION,
-                           (tablemeta->columns[i]).colType);
+  if (select->join != NULL) {
+    joinmeta = table_find(db, select->join->table);
+    assert(joinmeta != NULL);
   }
 
   //
-  // (2) open the table's data file
+  // (2) build the pipeline of operators: scan the table's data file,
+  // keep the rows satisfying the where clause (if any), keep only the
+  // columns in the query, and stop once the limit (if any) is reached.
+  // This way a row or column that is not part of the result is never
+  // stored in the resultset.
   //
-  // the table exists within a sub-directory under the executable
-  // where the directory has the same name as the database, and with
-  // a "TABLE-NAME.data" filename within that sub-directory:
-  //
-  char path[(2 * DATABASE_MAX_ID_LENGTH) + 10];
+  struct EXPR *where = (select->where != NULL) ? select->where->expr : NULL;
+  struct Operator *op = NULL;
 
-  strcpy(path, db->name); // name/name.data
-  strcat(path, "/");
-  strcat(path, tablemeta->name);
-  strcat(path, ".data");
+  // a compound where clause is the AND of its conjuncts
+  struct PRED **preds = NULL;
+  int numPreds = 0;
 
-  FILE *datafile = fopen(path, "r");
-  if (datafile == NULL) // unable to open:
-  {
-    printf("**INTERNAL ERROR: table's data file '%s' not found.\n", path);
-    panic("execution halted");
-    exit(-1);
-  }
+  if (rewrite->pred != NULL)
+    preds = predicate_conjuncts(rewrite->pred, &numPreds);
 
   //
-  // (3) allocate a buffer for input, and start reading the data:
+  // with functions or a group by clause, the rows are aggregated into
+  // one row per group (one row in total without group by); otherwise
+  // only the columns in the query are kept:
   //
-  int dataBufferSize =
-      tablemeta->recordSize + 3; // ends with $\n + null terminator
-  char *dataBuffer = (char *)malloc(sizeof(char) * dataBufferSize);
-  if (dataBuffer == NULL)
-    panic("out of memory");
-
-  // Going through each column and breaking each line into the relevant columns
-  // Then inserting the relevant type of data into the corresponding column
-  while (true) {
-    fgets(dataBuffer, dataBufferSize, datafile);
-    if (feof(datafile)) {
-      break;
-    }
-    char *cp = dataBuffer;
-    char *end = NULL;
-    int rowNumber = resultset_addRow(rSet);
-    for (int i = 0; i < tablemeta->numColumns; i++) {
-      int colNumber = i + 1;
-      if ((tablemeta->columns[i]).colType == COL_TYPE_INT) {
-        end = strchr(cp, ' ');
-        *end = '\0';
-        int value = atoi(cp);
-        resultset_putInt(rSet, rowNumber, colNumber, value);
-        cp = end + 1;
-      } else if (tablemeta->columns[i].colType == COL_TYPE_REAL) {
-        end = strchr(cp, ' ');
-        assert(end != NULL);
-        *end = '\0';
-        double value = atof(cp);
-        resultset_putReal(rSet, rowNumber, colNumber, value);
-        cp = end + 1;
-      } else {
-        char quote = *cp;
-        end = cp;
-        end++;
-        while (*end != quote) {
-          end++;
-        }
-        *end = '\0';
-        resultset_putString(rSet, rowNumber, colNumber, cp + 1);
-        cp = end + 2;
-      }
+  bool hasFunction = false;
+  for (struct COLUMN *column = select->columns; column != NULL;
+       column = column->next) {
+    if (column->function != NO_FUNCTION) {
+      hasFunction = true;
     }
   }
-  // Freeing memory associated with the buffer for reading each row
-  free(dataBuffer);
 
-  // Checking to see if there is a where clause
-  if (select->where != NULL) {
-    // And if there is, determining the relevant column
-    int index = 0;
-    for (int i = 0; i < tablemeta->numColumns; i++) {
-      if (strcasecmp(tablemeta->columns[i].name,
-                     select->where->expr->column->name) == 0) {
-        index = i;
-      }
-    }
-    // And deleting the row from the resultset if the data doesn't satisfy the
-    // conditions from the query
-    if (tablemeta->columns[index].colType == COL_TYPE_INT) {
-      int rh_val = atoi(select->where->expr->value);
-
-      for (int i = rSet->numRows; i > 0; i--) {
-        int lh_val = resultset_getInt(rSet, i, index + 1);
-        bool result = NULL;
-        switch (select->where->expr->operator) {
-        case EXPR_LT:
-          result = lh_val < rh_val;
-          break;
-        case EXPR_LTE:
-          result = lh_val <= rh_val;
-          break;
-        case EXPR_GT:
-          result = lh_val > rh_val;
-          break;
-        case EXPR_GTE:
-          result = lh_val >= rh_val;
-          break;
-        case EXPR_EQUAL:
-          result = lh_val == rh_val;
-          break;
-        case EXPR_NOT_EQUAL:
-          result = lh_val != rh_val;
-          break;
-        }
+  bool aggregating = hasFunction || (rewrite->groupby != NULL);
+  bool aggregated = false;
+  struct COLUMN *groupby =
+      (rewrite->groupby != NULL) ? rewrite->groupby->columns : NULL;
 
-        if (result == false) {
-          resultset_deleteRow(rSet, i);
-        }
-      }
-    } else if (tablemeta->columns[index].colType == COL_TYPE_REAL) {
-      double rh_val = atof(select->where->expr->value);
-
-      for (int i = rSet->numRows; i > 0; i--) {
-        double lh_val = resultset_getReal(rSet, i, index + 1);
-        bool result = NULL;
-        switch (select->where->expr->operator) {
-        case EXPR_LT:
-          result = lh_val < rh_val;
-          break;
-        case EXPR_LTE:
-          result = lh_val <= rh_val;
-          break;
-        case EXPR_GT:
-          result = lh_val > rh_val;
-          break;
-        case EXPR_GTE:
-          result = lh_val >= rh_val;
-          break;
-        case EXPR_EQUAL:
-          result = lh_val == rh_val;
-          break;
-        case EXPR_NOT_EQUAL:
-          result = lh_val != rh_val;
-          break;
-        }
+  if (joinmeta == NULL) {
+    op = filterTable(db, tablemeta, select, rewrite, where, preds, numPreds);
+
+    int N = (op != NULL && aggregating) ? numPartitions(op) : 1;
 
-        if (result == false) {
-          resultset_deleteRow(rSet, i);
+    if (N > 1) {
+      //
+      // a large table is split into ranges of records, each scanned,
+      // filtered and aggregated by its own thread:
+      //
+      struct Operator *partitions[N];
+
+      partitions[0] = op;
+      for (int p = 1; p < N; p++) {
+        partitions[p] = filterTable(db, tablemeta, select, rewrite, where,
+                                    preds, numPreds);
+        if (partitions[p] == NULL) {
+          for (int q = 0; q < p; q++)
+            operator_destroy(partitions[q]);
+          halt();
+          return NULL;
         }
       }
-    } else {
-      char *rh_val = select->where->expr->value;
-      int result = 0;
-
-      for (int i = rSet->numRows; i > 0; i--) {
-        char *lh_val = resultset_getString(rSet, i, index + 1);
-        bool result = NULL;
-        switch (select->where->expr->operator) {
-        case EXPR_LT:
-          result = (strcasecmp(lh_val, rh_val) < 0);
-          break;
-        case EXPR_LTE:
-          result = (strcasecmp(lh_val, rh_val) <= 0);
-          break;
-        case EXPR_GT:
-          result = (strcasecmp(lh_val, rh_val) > 0);
-          break;
-        case EXPR_GTE:
-          result = (strcasecmp(lh_val, rh_val) >= 0);
-          break;
-        case EXPR_EQUAL:
-          result = (strcasecmp(lh_val, rh_val) == 0);
-          break;
-        case EXPR_NOT_EQUAL:
-          result = (strcasecmp(lh_val, rh_val) != 0);
-          break;
-        }
 
-        if (result == false) {
-          resultset_deleteRow(rSet, i);
-        }
-        // Freeing memory associated with copying strings from the resultset
-        free(lh_val);
+      for (int p = 0; p < N; p++) {
+        operator_scanPartition(bottomOf(partitions[p]), p, N);
       }
+
+      op = operator_parallelAggregate(partitions, N, select->columns, groupby);
+      aggregated = true;
+    }
+  } else {
+    //
+    // the where clause is applied to whichever table it refers to,
+    // before the join, so fewer rows reach the join:
+    //
+    bool whereOnJoin = (where != NULL && where->column->table != NULL &&
+                        icmpStrings(where->column->table, joinmeta->name) == 0);
+
+    //
+    // and so is each conjunct of a compound where clause that refers
+    // to one table only; the others are checked after the join:
+    //
+    struct PRED **leftPreds =
+        (struct PRED **)arena_alloc(sizeof(struct PRED *) * (numPreds + 1));
+    struct PRED **rightPreds =
+        (struct PRED **)arena_alloc(sizeof(struct PRED *) * (numPreds + 1));
+    struct PRED **joinPreds =
+        (struct PRED **)arena_alloc(sizeof(struct PRED *) * (numPreds + 1));
+    int numLeft = 0, numRight = 0, numJoin = 0;
+
+    for (int i = 0; i < numPreds; i++) {
+      if (predicate_refersTo(preds[i], tablemeta))
+        leftPreds[numLeft++] = preds[i];
+      else if (predicate_refersTo(preds[i], joinmeta))
+        rightPreds[numRight++] = preds[i];
+      else
+        joinPreds[numJoin++] = preds[i];
     }
+
+    struct Operator *left =
+        filterTable(db, tablemeta, select, rewrite, whereOnJoin ? NULL : where,
+                    leftPreds, numLeft);
+    struct Operator *right =
+        filterTable(db, joinmeta, select, rewrite, whereOnJoin ? where : NULL,
+                    rightPreds, numRight);
+
+    if (left == NULL || right == NULL) {
+      operator_destroy(left);
+      operator_destroy(right);
+      halt();
+      return NULL;
+    }
+
+    // the ON clause may name the columns in either order
+    struct COLUMN *leftColumn = select->join->left;
+    struct COLUMN *rightColumn = select->join->right;
+
+    int leftKey =
+        operator_findColumn(left, leftColumn->table, leftColumn->name);
+    if (leftKey < 0) {
+      leftColumn = select->join->right;
+      rightColumn = select->join->left;
+      leftKey = operator_findColumn(left, leftColumn->table, leftColumn->name);
+    }
+    int rightKey =
+        operator_findColumn(right, rightColumn->table, rightColumn->name);
+
+    assert(leftKey >= 0 && rightKey >= 0);
+
+    op = operator_hashJoin(left, right, leftKey, rightKey);
+
+    if (numJoin > 0)
+      op = operator_predicate(op, joinPreds, numJoin);
   }
 
-  // Now checking whether the column is in the query, and if it isn't, deleting
-  // it from the resultset
-  bool inAST = false;
-  for (int i = tablemeta->numColumns; i > 0; i--) {
-    struct COLUMN *column = query->q.select->columns;
-    while (column != NULL) {
-      if (strcasecmp(column->name, tablemeta->columns[i - 1].name) == 0) {
-        inAST = true;
-      }
-      column = column->next;
+  if (op == NULL) // unable to open, msg already output
+  {
+    halt();
+    return NULL;
+  }
+
+  bool sorted = false;
+  bool limited = false;
+
+  if (aggregating) {
+    if (!aggregated) {
+      op = operator_aggregate(op, select->columns, groupby);
     }
-    if (inAST == false) {
-      resultset_deleteColumn(rSet, i);
+  } else {
+    // ordering by a column that is not in the query: sort first, since
+    // the projection drops the column
+    if (select->orderby != NULL &&
+        findColumnIn(op, select->orderby->column) >= 0 &&
+        !inColumns(select->columns, select->orderby->column)) {
+      op = sortOn(op, select->orderby, select->limit);
+      sorted = true;
+      limited = (select->limit != NULL);
     }
-    inAST = false;
-  }
-
-  // And now changing the order of columns as they appear in the dataset
-  struct COLUMN *column_pos = query->q.select->columns;
-  int index_col_pos = 1;
-  int col_pos = 0;
-  while (column_pos != NULL) {
-    col_pos = resultset_findColumn(rSet, index_col_pos, tablemeta->name,
-                                   column_pos->name);
-    resultset_moveColumn(rSet, col_pos, index_col_pos);
-    index_col_pos++;
-    column_pos = column_pos->next;
-  }
-
-  // And now adding in aggregate functions from the query to the dataset (if
-  // there are any)
-  struct COLUMN *agg_function = query->q.select->columns;
-  int agg_func_pos = 1;
-  while (agg_function != NULL) {
-    if (agg_function->function != NO_FUNCTION) {
-      resultset_applyFunction(rSet, agg_function->function, agg_func_pos);
+
+    op = operator_project(op, select->columns);
+  }
+
+  if (select->orderby != NULL && !sorted) {
+    if (findColumnIn(op, select->orderby->column) < 0) {
+      fprintf(session_output(),
+              "**INTERNAL ERROR: ORDER BY column '%s' is not in the query.\n",
+              select->orderby->column->name);
+      operator_destroy(op);
+      return NULL;
     }
-    agg_func_pos++;
-    agg_function = agg_function->next;
+
+    // with a limit, the sort only keeps the first N rows
+    op = sortOn(op, select->orderby, select->limit);
+    limited = (select->limit != NULL);
+  }
+
+  if (select->limit != NULL && !limited) {
+    op = operator_limit(op, select->limit->N);
+  }
+
+  return op;
+}
+
+//
+// execute_query
+//
+// execute a select query, which for now means print the resulting parts of a
+// database reference in the query; an insert appends its rows instead, and
+// an update or delete changes them in place
+//
+void execute_query(struct Database *db, struct QUERY *query,
+                   struct Rewrite *rewrite, struct ResultSet *rSet) {
+  if (query != NULL && query->queryType == INSERT_QUERY) {
+    insert_execute(db, query->q.insert);
+    return;
+  }
+
+  if (query != NULL && query->queryType == UPDATE_QUERY) {
+    modify_update(db, query->q.update);
+    return;
+  }
+
+  if (query != NULL && query->queryType == DELETE_QUERY) {
+    modify_delete(db, query->q.delete);
+    return;
+  }
+
+  if (!isSelect(db, query))
+    return;
+
+  struct SELECT *select = query->q.select; // alias for less typing:
+
+  struct Operator *op = plan(db, select, rewrite);
+
+  if (op == NULL) // msg already output
+    return;
+
+  //
+  // (3) the output of the pipeline forms the resultset, with the
+  // columns in the order they appear in the query:
+  //
+  for (int i = 0; i < op->numColumns; i++) {
+    results_insertColumn(rSet, i + 1, op->columns[i].tableName,
+                         op->columns[i].colName, op->columns[i].function,
+                         op->columns[i].colType);
+  }
+
+  // strings in the tuples are not null-terminated, and are copied into
+  // this buffer as they reach the resultset; no string can be longer
+  // than a record
+  int maxRecordSize = table_find(db, select->table)->recordSize;
+  if (select->join != NULL) {
+    struct TableMeta *joinmeta = table_find(db, select->join->table);
+
+    if (joinmeta->recordSize > maxRecordSize)
+      maxRecordSize = joinmeta->recordSize;
   }
 
-  // And lastly adding the limit clause, which deletes all rows past the limit
-  if (select->limit != NULL) {
-    for (int i = rSet->numRows; i > select->limit->N; i--) {
-      resultset_deleteRow(rSet, i);
+  char *stringBuffer = (char *)arena_alloc(sizeof(char) * (maxRecordSize + 1));
+
+  struct Tuple *tuple = NULL;
+  while ((tuple = operator_next(op)) != NULL) {
+    int rowNumber = results_addRow(rSet);
+    for (int i = 0; i < tuple->numValues; i++) {
+      int colNumber = i + 1;
+      struct TupleValue *value = &tuple->values[i];
+      if (value->valueType == COL_TYPE_INT) {
+        results_putInt(rSet, rowNumber, colNumber, value->value.i);
+      } else if (value->valueType == COL_TYPE_REAL) {
+        results_putReal(rSet, rowNumber, colNumber, value->value.r);
+      } else {
+        results_putString(rSet, rowNumber, colNumber,
+                          operator_copyString(value, stringBuffer));
+      }
     }
   }
 
-  resultset_print(rSet);
-  // Freeing memory associated with the datafile
-  fclose(datafile);
+  // Freeing memory associated with the pipeline, which also unmaps
+  // the datafile
+  operator_destroy(op);
+
+  results_print(rSet);
 
   //
   // done!
   //
 }
+
+//
+// execute_explain
+//
+void execute_explain(struct Database *db, struct QUERY *query,
+                     struct Rewrite *rewrite) {
+  if (!isSelect(db, query))
+    return;
+
+  bool analyze = rewrite->analyze;
+
+  // under ANALYZE, every operator of the plan keeps OpStats
+  operator_analyze(analyze);
+
+  struct Operator *op = plan(db, query->q.select, rewrite);
+
+  operator_analyze(false);
+
+  if (op == NULL) // msg already output
+    return;
+
+  //
+  // running the plan to completion, discarding its tuples, so each
+  // operator has counted its tuples and time:
+  //
+  long long numRows = 0;
+  struct timespec start, stop;
+
+  if (analyze) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (operator_next(op) != NULL)
+      numRows++;
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+  }
+
+  FILE *output = session_output();
+
+  fprintf(output, "**QUERY PLAN:\n");
+  operator_explain(op, output, analyze);
+
+  if (analyze) {
+    double ms = (stop.tv_sec - start.tv_sec) * 1e3 +
+                (stop.tv_nsec - start.tv_nsec) / 1e6;
+
+    fprintf(output, "**EXECUTION: %lld rows, %.3f ms\n", numRows, ms);
+  }
+
+  operator_destroy(op);
+}
@@ -8,12 +8,15 @@
 
 #pragma once
 
+#include <stdbool.h> // true, false
+
 #include "analyzer.h"
 #include "ast.h"
 #include "database.h"
 #include "execute.h"
 #include "parser.h"
 #include "resultset.h"
+#include "rewrite.h"
 #include "scanner.h"
 #include "token.h"
 #include "tokenqueue.h"
@@ -27,6 +30,13 @@
 // function declarations:
 //
 
-// Executing the query
+// Executing the query, along with the extended clauses of its rewrite
+// (see rewrite.h)
 void execute_query(struct Database *db, struct QUERY *query,
-                   struct ResultSet *rSet);
+                   struct Rewrite *rewrite, struct ResultSet *rSet);
+
+// Outputting the plan of the query (EXPLAIN); under rewrite->analyze,
+// the plan is also run, and each operator's rows, time, bytes read and
+// memory are output (EXPLAIN ANALYZE)
+void execute_explain(struct Database *db, struct QUERY *query,
+                     struct Rewrite *rewrite);
@@ -0,0 +1,491 @@
+/*index.c*/
+
+//
+// Project: Column indexes for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "index.h"
+#include "util.h"
+
+//
+// The index file is a header followed by the array of entries:
+//
+#define INDEX_MAGIC "SSQLIDX1"
+
+struct IndexHeader {
+  char magic[8];
+  long long dataSize;     // size of the data file the index was built from
+  long long dataModified; // modification time of that data file (ns)
+  int colType;
+  int numEntries;
+};
+
+//
+// used to sort the entries of a string column while building:
+//
+struct StringKey {
+  char *s;
+  int length;
+  int recordNum;
+};
+
+// held while an index is read, or built and written
+static pthread_mutex_t indexLock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// indexKey
+//
+// Returns the value of the indexed column in the given record.
+//
+static struct TupleValue *indexKey(struct Index *index, int recordNum) {
+  table_read(index->table, recordNum, index->columns, index->values);
+
+  return &index->values[index->column];
+}
+
+//
+// comparators for qsort:
+//
+static int compareInts(const void *a, const void *b) {
+  const struct IndexEntry *e1 = (const struct IndexEntry *)a;
+  const struct IndexEntry *e2 = (const struct IndexEntry *)b;
+
+  if (e1->key.i != e2->key.i)
+    return (e1->key.i > e2->key.i) - (e1->key.i < e2->key.i);
+
+  return e1->recordNum - e2->recordNum;
+}
+
+static int compareReals(const void *a, const void *b) {
+  const struct IndexEntry *e1 = (const struct IndexEntry *)a;
+  const struct IndexEntry *e2 = (const struct IndexEntry *)b;
+
+  if (e1->key.r != e2->key.r)
+    return (e1->key.r > e2->key.r) - (e1->key.r < e2->key.r);
+
+  return e1->recordNum - e2->recordNum;
+}
+
+static int compareStrings(const void *a, const void *b) {
+  const struct StringKey *k1 = (const struct StringKey *)a;
+  const struct StringKey *k2 = (const struct StringKey *)b;
+
+  int cmp = operator_compareString(k1->s, k1->length, k2->s, k2->length);
+  if (cmp != 0)
+    return cmp;
+
+  return k1->recordNum - k2->recordNum;
+}
+
+//
+// buildEntries
+//
+// Fills the array with the entries of records [first, last), sorted
+// by key.
+//
+static void buildEntries(struct Index *index, int first, int last,
+                         struct IndexEntry *entries) {
+  int N = last - first;
+
+  if (index->colType == COL_TYPE_STRING) {
+    struct StringKey *keys =
+        (struct StringKey *)malloc(sizeof(struct StringKey) * (N + 1));
+    if (keys == NULL)
+      panic("out of memory");
+
+    for (int i = 0; i < N; i++) {
+      struct TupleValue *key = indexKey(index, first + i);
+      keys[i].s = key->value.s;
+      keys[i].length = key->length;
+      keys[i].recordNum = first + i;
+    }
+
+    qsort(keys, N, sizeof(struct StringKey), compareStrings);
+
+    for (int i = 0; i < N; i++) {
+      entries[i].key.i = 0;
+      entries[i].recordNum = keys[i].recordNum;
+    }
+
+    free(keys);
+    return;
+  }
+
+  for (int i = 0; i < N; i++) {
+    struct TupleValue *key = indexKey(index, first + i);
+    if (index->colType == COL_TYPE_INT)
+      entries[i].key.i = key->value.i;
+    else
+      entries[i].key.r = key->value.r;
+    entries[i].recordNum = first + i;
+  }
+
+  if (index->colType == COL_TYPE_INT)
+    qsort(entries, N, sizeof(struct IndexEntry), compareInts);
+  else
+    qsort(entries, N, sizeof(struct IndexEntry), compareReals);
+}
+
+//
+// index_build
+//
+// Builds the entries of the index from the table's data.
+//
+static void index_build(struct Index *index) {
+  int N = index->table->numRecords;
+
+  index->numEntries = N;
+  index->entries =
+      (struct IndexEntry *)malloc(sizeof(struct IndexEntry) * (N + 1));
+  if (index->entries == NULL)
+    panic("out of memory");
+
+  buildEntries(index, 0, N, index->entries);
+}
+
+//
+// index_read
+//
+// Reads the index file, returning true if it exists and matches the
+// data file of the given size, modification time and # of records,
+// and false if it must be rebuilt. Room is left in the entries for
+// the table's current # of records.
+//
+static bool index_read(struct Index *index, char *path, long long dataSize,
+                       long long dataModified, int numRecords) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+
+  struct IndexHeader header;
+  bool valid = (fread(&header, sizeof(header), 1, file) == 1) &&
+               (memcmp(header.magic, INDEX_MAGIC, 8) == 0) &&
+               (header.dataSize == dataSize) &&
+               (header.dataModified == dataModified) &&
+               (header.colType == index->colType) &&
+               (header.numEntries == numRecords) &&
+               (numRecords <= index->table->numRecords);
+
+  if (valid) {
+    int N = header.numEntries;
+
+    index->numEntries = N;
+    index->entries = (struct IndexEntry *)malloc(
+        sizeof(struct IndexEntry) * (index->table->numRecords + 1));
+    if (index->entries == NULL)
+      panic("out of memory");
+
+    if (fread(index->entries, sizeof(struct IndexEntry), N, file) !=
+        (size_t)N) {
+      free(index->entries);
+      index->entries = NULL;
+      valid = false;
+    }
+  }
+
+  fclose(file);
+  return valid;
+}
+
+//
+// index_write
+//
+// Writes the index file; it is written to a temporary file and then
+// renamed, so a reader never sees a partially-written index.
+//
+static void index_write(struct Index *index, char *path) {
+  char temp[TABLE_MAX_PATH_LENGTH + 8];
+
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  FILE *file = fopen(temp, "wb");
+  if (file == NULL) // e.g. read-only database, keep it in memory
+    return;
+
+  struct IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INDEX_MAGIC, 8);
+  header.dataSize = index->table->size;
+  header.dataModified = index->table->modified;
+  header.colType = index->colType;
+  header.numEntries = index->numEntries;
+
+  bool written =
+      (fwrite(&header, sizeof(header), 1, file) == 1) &&
+      (fwrite(index->entries, sizeof(struct IndexEntry), index->numEntries,
+              file) == (size_t)index->numEntries);
+
+  if (fclose(file) != 0 || !written || rename(temp, path) != 0)
+    remove(temp);
+}
+
+//
+// createIndex
+//
+// Returns an index on the column of the table, with no entries yet,
+// and the path of its file.
+//
+static struct Index *createIndex(struct Database *db, struct Table *table,
+                                 int column, char *path) {
+  struct TableMeta *meta = table->meta;
+
+  assert(column >= 0 && column < meta->numColumns);
+
+  struct Index *index = (struct Index *)malloc(sizeof(struct Index));
+  if (index == NULL)
+    panic("out of memory");
+
+  index->table = table;
+  index->column = column;
+  index->colType = meta->columns[column].colType;
+  index->entries = NULL;
+  index->numEntries = 0;
+  index->values = (struct TupleValue *)malloc(sizeof(struct TupleValue) *
+                                              (meta->numColumns + 1));
+  index->columns = (bool *)malloc(sizeof(bool) * (meta->numColumns + 1));
+  if (index->values == NULL || index->columns == NULL)
+    panic("out of memory");
+
+  for (int i = 0; i < meta->numColumns; i++)
+    index->columns[i] = (i == column);
+
+  char extension[DATABASE_MAX_ID_LENGTH + 8];
+
+  snprintf(extension, sizeof(extension), ".%s.idx",
+           meta->columns[column].name);
+  table_path(path, db, meta->name, extension);
+
+  return index;
+}
+
+//
+// index_open
+//
+struct Index *index_open(struct Database *db, struct Table *table,
+                         int column) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  struct Index *index = createIndex(db, table, column, path);
+
+  //
+  // concurrent sessions (see server.h) may open the same index; one
+  // at a time, so only the first builds it and they never write the
+  // same temporary file:
+  //
+  pthread_mutex_lock(&indexLock);
+
+  if (!index_read(index, path, table->size, table->modified,
+                  table->numRecords)) {
+    index_build(index);
+    index_write(index, path);
+  }
+
+  pthread_mutex_unlock(&indexLock);
+
+  return index;
+}
+
+//
+// compareEntries
+//
+// Compares entries e1 and e2 of the index by key, then record #.
+//
+static int compareEntries(struct Index *index, struct IndexEntry *e1,
+                          struct IndexEntry *e2) {
+  if (index->colType == COL_TYPE_INT)
+    return compareInts(e1, e2);
+  else if (index->colType == COL_TYPE_REAL)
+    return compareReals(e1, e2);
+
+  // the keys point into the table's data, so stay valid as the
+  // values are read again
+  struct TupleValue *key = indexKey(index, e1->recordNum);
+  struct StringKey k1 = {key->value.s, key->length, e1->recordNum};
+
+  key = indexKey(index, e2->recordNum);
+  struct StringKey k2 = {key->value.s, key->length, e2->recordNum};
+
+  return compareStrings(&k1, &k2);
+}
+
+//
+// index_update
+//
+void index_update(struct Database *db, struct Table *table, int column,
+                  long long oldSize, long long oldModified, int oldRecords) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  struct Index *index = createIndex(db, table, column, path);
+
+  pthread_mutex_lock(&indexLock);
+
+  if (index_read(index, path, oldSize, oldModified, oldRecords)) {
+    int N = table->numRecords;
+    int numAdded = N - oldRecords;
+
+    struct IndexEntry *added =
+        (struct IndexEntry *)malloc(sizeof(struct IndexEntry) * (numAdded + 1));
+    struct IndexEntry *merged =
+        (struct IndexEntry *)malloc(sizeof(struct IndexEntry) * (N + 1));
+    if (added == NULL || merged == NULL)
+      panic("out of memory");
+
+    buildEntries(index, oldRecords, N, added);
+
+    // merging the sorted old and added entries:
+    int i = 0, j = 0, k = 0;
+
+    while (i < oldRecords && j < numAdded) {
+      if (compareEntries(index, &index->entries[i], &added[j]) <= 0)
+        merged[k++] = index->entries[i++];
+      else
+        merged[k++] = added[j++];
+    }
+
+    while (i < oldRecords)
+      merged[k++] = index->entries[i++];
+    while (j < numAdded)
+      merged[k++] = added[j++];
+
+    free(index->entries);
+    free(added);
+
+    index->entries = merged;
+    index->numEntries = N;
+
+    index_write(index, path);
+  }
+
+  pthread_mutex_unlock(&indexLock);
+
+  index_close(index);
+}
+
+//
+// index_close
+//
+void index_close(struct Index *index) {
+  if (index == NULL)
+    return;
+
+  free(index->entries);
+  free(index->values);
+  free(index->columns);
+  free(index);
+}
+
+//
+// index_supports
+//
+bool index_supports(int operator) {
+  switch (operator) {
+  case EXPR_LT:
+  case EXPR_LTE:
+  case EXPR_GT:
+  case EXPR_GTE:
+  case EXPR_EQUAL:
+    return true;
+  }
+
+  return false;
+}
+
+//
+// compareEntry
+//
+// Compares the key of entry e against the literal, returning
+// < 0, 0, or > 0.
+//
+static int compareEntry(struct Index *index, int e, char *literal,
+                        int literalLength) {
+  struct IndexEntry *entry = &index->entries[e];
+
+  if (index->colType == COL_TYPE_INT) {
+    int value = atoi(literal);
+    return (entry->key.i > value) - (entry->key.i < value);
+  } else if (index->colType == COL_TYPE_REAL) {
+    double value = atof(literal);
+    return (entry->key.r > value) - (entry->key.r < value);
+  } else {
+    struct TupleValue *key = indexKey(index, entry->recordNum);
+    return operator_compareString(key->value.s, key->length, literal,
+                                  literalLength);
+  }
+}
+
+//
+// lowerBound, upperBound
+//
+// Binary search for the position of the first entry whose key is
+// >= literal (lowerBound) or > literal (upperBound).
+//
+static int lowerBound(struct Index *index, char *literal, int literalLength) {
+  int lo = 0;
+  int hi = index->numEntries;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (compareEntry(index, mid, literal, literalLength) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static int upperBound(struct Index *index, char *literal, int literalLength) {
+  int lo = 0;
+  int hi = index->numEntries;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (compareEntry(index, mid, literal, literalLength) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+//
+// index_lookup
+//
+void index_lookup(struct Index *index, int operator, char *literal,
+                  int *first, int *last) {
+  assert(index_supports(operator));
+
+  int literalLength = strlen(literal);
+
+  switch (operator) {
+  case EXPR_LT:
+    *first = 0;
+    *last = lowerBound(index, literal, literalLength);
+    break;
+  case EXPR_LTE:
+    *first = 0;
+    *last = upperBound(index, literal, literalLength);
+    break;
+  case EXPR_GT:
+    *first = upperBound(index, literal, literalLength);
+    *last = index->numEntries;
+    break;
+  case EXPR_GTE:
+    *first = lowerBound(index, literal, literalLength);
+    *last = index->numEntries;
+    break;
+  case EXPR_EQUAL:
+    *first = lowerBound(index, literal, literalLength);
+    *last = upperBound(index, literal, literalLength);
+    break;
+  }
+}
@@ -0,0 +1,115 @@
+/*index.h*/
+
+//
+// Project: Column indexes for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+
+#include "database.h"
+#include "table.h"
+
+//
+// An index on a column of a table is a sorted array of entries,
+// one per record, that maps the column's value (the key) to the
+// record number. A lookup is then a binary search --- O(log n) ---
+// instead of a scan of the entire table.
+//
+// Indexes are built for the columns marked COL_INDEXED or
+// COL_UNIQUE_INDEXED in the meta-data, and are stored next to the
+// data file as "<database>/<table>.<column>.idx". The index file
+// records the size and modification time of the data file it was
+// built from, and is rebuilt when the data file changes (an INSERT
+// merges its records into the index instead, see index_update).
+//
+// A deleted record keeps its entry, whose key is still in the record
+// (see table.h); whoever looks up an index skips the deleted records.
+//
+struct IndexEntry {
+  union {
+    int i;
+    double r;
+  } key;         // key for int and real columns (strings: see below)
+  int recordNum; // 0-based record # within the data file
+};
+
+struct Index {
+  struct Table *table; // table the index is on (not owned)
+  int column;          // 0-based index of the column in the table
+  int colType;         // enum ColumnType (database.h)
+
+  //
+  // string keys are not stored in the entries, they are compared
+  // by looking at the record itself:
+  //
+  struct IndexEntry *entries; // ARRAY of entries sorted by key
+  int numEntries;
+  struct TupleValue *values; // ARRAY used to read a record's columns
+  bool *columns;             // ARRAY: true for the indexed column only
+};
+
+//
+// Functions:
+//
+
+//
+// index_open
+//
+// Returns the index on the given column (0-based) of the table,
+// building it from the data file if the index file does not exist
+// or is out of date. If the index file cannot be written, the index
+// is still returned but only kept in memory.
+//
+// NOTE: it is the callers responsibility to free the resources
+// used by the index by calling index_close().
+//
+struct Index *index_open(struct Database *db, struct Table *table,
+                         int column);
+
+//
+// index_update
+//
+// Brings the index file on the given column up to date after records
+// were appended to the table, which is open on the data file as it is
+// now. If the index file matches the data file as it was before ---
+// of the given size, modification time and # of records --- the
+// entries of the new records are merged into it. Otherwise nothing is
+// done, and the index is rebuilt when next opened.
+//
+// Records changed in place, without changing the column's values,
+// leave the entries as they are: pass the current # of records and
+// the index file is simply marked as matching the data file.
+//
+void index_update(struct Database *db, struct Table *table, int column,
+                  long long oldSize, long long oldModified, int oldRecords);
+
+//
+// index_close
+//
+// Frees the memory associated with the index; the table is not closed.
+//
+void index_close(struct Index *index);
+
+//
+// index_supports
+//
+// Returns true if the index can answer a comparison with the given
+// operator (enum AST_EXPR_OPERATORS), false if not.
+//
+bool index_supports(int operator);
+
+//
+// index_lookup
+//
+// Finds the entries whose key satisfies "key <operator> literal",
+// where the literal is in string form as in the AST. These entries
+// are consecutive; their positions [*first, *last) are returned via
+// the parameters. The operator must be supported by the index, see
+// index_supports().
+//
+void index_lookup(struct Index *index, int operator, char *literal,
+                  int *first, int *last);
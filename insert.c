@@ -0,0 +1,438 @@
+/*insert.c*/
+
+//
+// Project: Inserts for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index.h"
+#include "insert.h"
+#include "operator.h"
+#include "session.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+//
+// An INSERT's records, to be appended to the table (see wal.h):
+//
+struct Insert {
+  char *records; // numRows records, back to back
+  size_t length;
+  int numRows;
+
+  struct WalWrite writes[2]; // the final record's end if needed, then records
+};
+
+//
+// The INSERTs of a group, while they are checked against the table's
+// unique columns:
+//
+struct Group {
+  struct Table *table; // NULL if no unique columns
+
+  int numUnique;
+  int *columns;              // ARRAY: each COL_UNIQUE_INDEXED column
+  struct Index **indexes;    // ARRAY: the index on each of them
+  struct TupleValue **keys;  // ARRAY: the group's keys so far, sorted
+  int *numKeys;
+};
+
+static char recordEnd[] = "$\n"; // the last 2 bytes of every record
+
+//
+// formatRecords
+//
+// Formats the rows of the INSERT as records of the table, back to
+// back. A column without a value is empty: 0, 0.00 or ''. Returns
+// false if a row does not fit in the record size; an error message
+// was output.
+//
+static bool formatRecords(struct TableMeta *meta, struct INSERT *insert,
+                          char *records) {
+  int numColumns = meta->numColumns;
+  int valueOf[numColumns]; // position of each column's value, -1 => none
+
+  for (int c = 0; c < numColumns; c++)
+    valueOf[c] = (insert->columns == NULL) ? c : -1;
+
+  int v = 0;
+  for (struct COLUMN *column = insert->columns; column != NULL;
+       column = column->next)
+    valueOf[table_findColumn(meta, column->name)] = v++;
+
+  char *record = records;
+  int rowNumber = 1;
+
+  for (struct VALUES *row = insert->values; row != NULL;
+       row = row->next, rowNumber++) {
+    char *cp = record;
+    char *end = record + meta->recordSize;
+
+    for (int c = 0; c < numColumns; c++) {
+      int colType = meta->columns[c].colType;
+      char *literal = (valueOf[c] >= 0) ? row->literals[valueOf[c]]
+                      : (colType == COL_TYPE_INT)  ? "0"
+                      : (colType == COL_TYPE_REAL) ? "0.00"
+                                                   : "";
+
+      cp = table_formatValue(cp, end, literal, colType);
+
+      if (cp == NULL) {
+        fprintf(session_output(),
+                "**SEMANTIC ERROR: row %d of INSERT does not fit in the "
+                "record size of table '%s' (%d)\n",
+                rowNumber, meta->name, meta->recordSize);
+        return false;
+      }
+    }
+
+    memset(cp, '.', end - cp);
+    end[0] = '$';
+    end[1] = '\n';
+
+    record += meta->recordSize + 2;
+  }
+
+  return true;
+}
+
+//
+// compareValues
+//
+// Comparator for qsort and bsearch of TupleValues of the same type.
+//
+static int compareValues(const void *a, const void *b) {
+  const struct TupleValue *v1 = (const struct TupleValue *)a;
+  const struct TupleValue *v2 = (const struct TupleValue *)b;
+
+  if (v1->valueType == COL_TYPE_INT)
+    return (v1->value.i > v2->value.i) - (v1->value.i < v2->value.i);
+  else if (v1->valueType == COL_TYPE_REAL)
+    return (v1->value.r > v2->value.r) - (v1->value.r < v2->value.r);
+  else
+    return operator_compareString(v1->value.s, v1->length, v2->value.s,
+                                  v2->length);
+}
+
+//
+// literalOf
+//
+// Writes the value in string form, as in the AST, into the buffer
+// (which holds 32 chars more than a record), and returns it.
+//
+static char *literalOf(struct TupleValue *value, char *buffer) {
+  if (value->valueType == COL_TYPE_INT)
+    sprintf(buffer, "%d", value->value.i);
+  else if (value->valueType == COL_TYPE_REAL)
+    sprintf(buffer, "%.17g", value->value.r);
+  else
+    operator_copyString(value, buffer);
+
+  return buffer;
+}
+
+//
+// closeGroup
+//
+// Closes the table and indexes of the group, and frees it.
+//
+static void closeGroup(struct Group *group) {
+  for (int u = 0; u < group->numUnique; u++) {
+    index_close(group->indexes[u]);
+    free(group->keys[u]);
+  }
+
+  table_close(group->table);
+
+  free(group->columns);
+  free(group->indexes);
+  free(group->keys);
+  free(group->numKeys);
+  free(group);
+}
+
+//
+// openGroup
+//
+// Opens the table and the index on each of its unique columns, to
+// check the group's INSERTs against. Returns NULL if the table could
+// not be opened; an error message was output.
+//
+static struct Group *openGroup(struct Database *db, struct TableMeta *meta) {
+  int N = meta->numColumns;
+  struct Group *group = (struct Group *)malloc(sizeof(struct Group));
+  if (group == NULL)
+    panic("out of memory");
+
+  group->table = NULL;
+  group->numUnique = 0;
+  group->columns = (int *)malloc(sizeof(int) * N);
+  group->indexes = (struct Index **)malloc(sizeof(struct Index *) * N);
+  group->keys = (struct TupleValue **)malloc(sizeof(struct TupleValue *) * N);
+  group->numKeys = (int *)malloc(sizeof(int) * N);
+  if (group->columns == NULL || group->indexes == NULL ||
+      group->keys == NULL || group->numKeys == NULL)
+    panic("out of memory");
+
+  for (int c = 0; c < N; c++) {
+    if (meta->columns[c].indexType == COL_UNIQUE_INDEXED)
+      group->columns[group->numUnique++] = c;
+  }
+
+  if (group->numUnique == 0)
+    return group;
+
+  group->table = table_open(db, meta);
+
+  if (group->table == NULL) {
+    group->numUnique = 0;
+    closeGroup(group);
+    return NULL;
+  }
+
+  for (int u = 0; u < group->numUnique; u++) {
+    group->indexes[u] = index_open(db, group->table, group->columns[u]);
+    group->keys[u] = NULL;
+    group->numKeys[u] = 0;
+  }
+
+  return group;
+}
+
+//
+// inTable
+//
+// Returns true if the entries [first, last) of the index are not all
+// of deleted records.
+//
+static bool inTable(struct Index *index, int first, int last) {
+  for (int e = first; e < last; e++) {
+    if (!table_deleted(index->table, index->entries[e].recordNum))
+      return true;
+  }
+
+  return false;
+}
+
+//
+// checkUnique
+//
+// Returns true if none of the INSERT's values in a unique column is
+// in the table, in an earlier INSERT of the group, or twice in the
+// INSERT; its values are then added to the group's. Otherwise outputs
+// an error message and returns false.
+//
+static bool checkUnique(struct Group *group, struct TableMeta *meta,
+                        struct Insert *insert) {
+  int N = insert->numRows;
+  struct TupleValue values[meta->numColumns];
+  struct TupleValue *keys[group->numUnique];
+  bool unique = true;
+
+  for (int u = 0; u < group->numUnique; u++) {
+    int column = group->columns[u];
+
+    keys[u] = (struct TupleValue *)malloc(sizeof(struct TupleValue) * N);
+    if (keys[u] == NULL)
+      panic("out of memory");
+
+    // the strings point into the INSERT's records
+    for (int r = 0; r < N; r++) {
+      table_parseRecord(group->table,
+                        insert->records + (size_t)r * (meta->recordSize + 2),
+                        NULL, values);
+      keys[u][r] = values[column];
+    }
+
+    qsort(keys[u], N, sizeof(struct TupleValue), compareValues);
+
+    for (int r = 0; r < N && unique; r++) {
+      char literal[meta->recordSize + 32];
+      int first, last;
+
+      index_lookup(group->indexes[u], EXPR_EQUAL,
+                   literalOf(&keys[u][r], literal), &first, &last);
+
+      unique = (r == 0 || compareValues(&keys[u][r - 1], &keys[u][r]) != 0) &&
+               !inTable(group->indexes[u], first, last) &&
+               (bsearch(&keys[u][r], group->keys[u], group->numKeys[u],
+                        sizeof(struct TupleValue), compareValues) == NULL);
+
+      if (!unique)
+        fprintf(session_output(),
+                "**SEMANTIC ERROR: value '%s' is already in unique column "
+                "'%s.%s'\n",
+                literal, meta->name, meta->columns[column].name);
+    }
+  }
+
+  for (int u = 0; u < group->numUnique; u++) {
+    if (unique) {
+      int M = group->numKeys[u];
+
+      group->keys[u] = (struct TupleValue *)realloc(
+          group->keys[u], sizeof(struct TupleValue) * (M + N));
+      if (group->keys[u] == NULL)
+        panic("out of memory");
+
+      memcpy(group->keys[u] + M, keys[u], sizeof(struct TupleValue) * N);
+      group->numKeys[u] = M + N;
+      qsort(group->keys[u], M + N, sizeof(struct TupleValue), compareValues);
+    }
+
+    free(keys[u]);
+  }
+
+  return unique;
+}
+
+//
+// prepareInsert
+//
+// Appends the INSERT's records after those of the group's earlier
+// INSERTs, if they pass the unique checks (see wal.h).
+//
+static bool prepareInsert(struct WalChange *change, struct WalGroup *group) {
+  struct Insert *insert = (struct Insert *)change->arg;
+  struct TableMeta *meta = change->meta;
+  long long recordLength = meta->recordSize + 2;
+
+  if (group->size < 0) {
+    char path[TABLE_MAX_PATH_LENGTH];
+
+    table_path(path, change->db, meta->name, ".data");
+    fprintf(session_output(),
+            "**INTERNAL ERROR: table's data file '%s' not found.\n", path);
+    return false;
+  }
+
+  //
+  // as in table_open(), the final record may be missing its "\n", or
+  // its "$\n"; the file is then completed first, so the new records
+  // start at a multiple of the record length. Any other size means
+  // the file is damaged, and appending would misalign every record:
+  //
+  long long partial = group->end % recordLength;
+
+  if (partial != 0 && partial < meta->recordSize) {
+    char path[TABLE_MAX_PATH_LENGTH];
+
+    table_path(path, change->db, meta->name, ".data");
+    fprintf(session_output(),
+            "**INTERNAL ERROR: table's data file '%s' ends in a partial "
+            "record.\n",
+            path);
+    return false;
+  }
+
+  if (group->state == NULL)
+    group->state = openGroup(change->db, meta);
+
+  struct Group *unique = (struct Group *)group->state;
+
+  if (unique == NULL ||
+      (unique->numUnique > 0 && !checkUnique(unique, meta, insert)))
+    return false;
+
+  int w = 0;
+
+  if (partial != 0) {
+    insert->writes[w].offset = group->end;
+    insert->writes[w].bytes = recordEnd + (partial - meta->recordSize);
+    insert->writes[w++].length = recordLength - partial;
+    group->end += recordLength - partial;
+  }
+
+  insert->writes[w].offset = group->end;
+  insert->writes[w].bytes = insert->records;
+  insert->writes[w++].length = insert->length;
+  group->end += insert->length;
+
+  change->writes = insert->writes;
+  change->numWrites = w;
+  change->numRows = insert->numRows;
+
+  return true;
+}
+
+static void releaseInsert(struct WalGroup *group) {
+  if (group->state != NULL)
+    closeGroup((struct Group *)group->state);
+
+  group->state = NULL;
+}
+
+//
+// finishInsert
+//
+// Merges the group's records into the index files that match the
+// data file as it was.
+//
+static void finishInsert(struct WalGroup *group) {
+  struct TableMeta *meta = group->meta;
+  long long recordLength = meta->recordSize + 2;
+  struct Table *table = NULL;
+
+  // as in table_open(), the final record may be missing its newline
+  int oldRecords = group->size / recordLength;
+  if (group->size % recordLength >= meta->recordSize)
+    oldRecords++;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    if (meta->columns[c].indexType == COL_NON_INDEXED)
+      continue;
+
+    if (table == NULL)
+      table = table_open(group->db, meta);
+
+    if (table != NULL)
+      index_update(group->db, table, c, group->size, group->modified,
+                   oldRecords);
+  }
+
+  table_close(table);
+}
+
+//
+// insert_execute
+//
+void insert_execute(struct Database *db, struct INSERT *insert) {
+  struct TableMeta *meta = table_find(db, insert->table);
+
+  if (meta == NULL)
+    panic("INSERT table does not exist (insert)");
+
+  struct Insert rows;
+
+  rows.numRows = insert->numRows;
+  rows.length = (size_t)insert->numRows * (meta->recordSize + 2);
+  rows.records = (char *)malloc(rows.length + 1);
+  if (rows.records == NULL)
+    panic("out of memory");
+
+  if (formatRecords(meta, insert, rows.records)) {
+    struct WalChange change;
+
+    change.db = db;
+    change.meta = meta;
+    change.append = true;
+    change.prepare = prepareInsert;
+    change.release = releaseInsert;
+    change.finish = finishInsert;
+    change.arg = &rows;
+
+    wal_commit(&change);
+
+    if (change.committed)
+      fprintf(session_output(), "**INSERTED: %d rows\n", rows.numRows);
+  }
+
+  free(rows.records);
+}
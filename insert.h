@@ -0,0 +1,40 @@
+/*insert.h*/
+
+//
+// Project: Inserts for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include "ast.h"
+#include "database.h"
+
+//
+// An INSERT formats its rows as fixed-width records, in the layout of
+// the data file (see table.h), and appends them to "<table>.data" with
+// one write, once they are in the database's log (see wal.h); the rows
+// are durable once the INSERT reports them. The table's index files
+// are then brought up to date (see index_update). A value already in a
+// COL_UNIQUE_INDEXED column is rejected, along with the whole INSERT.
+//
+// INSERTs from concurrent sessions are group committed, see wal.h:
+// those to the same table are appended together, with one write.
+//
+// The column files of a converted table (see table_convert) are not
+// updated; the table is read from its data file until converted again.
+//
+
+//
+// Functions:
+//
+
+//
+// insert_execute
+//
+// Appends the rows of the INSERT, which rewrite_apply() has checked,
+// to the table, and outputs the # of rows inserted, or else an error
+// message.
+//
+void insert_execute(struct Database *db, struct INSERT *insert);
@@ -0,0 +1,231 @@
+/*join.c*/
+
+//
+// Project: Hash join operator for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "operator.h"
+#include "util.h"
+
+//
+// The hash table is built by reading every tuple of the build input
+// and copying its values into one growing array; the strings are not
+// copied, since they point into the build input's table, which stays
+// mapped until the join is destroyed. Entries with the same hash
+// bucket are chained together via their index in the array.
+//
+struct HashJoinState {
+  struct Operator *build; // input the hash table is built on
+  struct Operator *probe; // input streamed against the hash table
+  bool buildIsLeft;       // true => build is the left input
+  int buildKey;           // index of the join column in build's tuples
+  int probeKey;           // index of the join column in probe's tuples
+
+  struct TupleValue *values; // ARRAY: build->numColumns values per entry
+  unsigned int *hashes;      // ARRAY: hash of each entry's key
+  int *chain;                // ARRAY: next entry in the same bucket, or -1
+  int numEntries;
+  int size; // # of entries the arrays have room for
+
+  int *buckets; // ARRAY: first entry in each bucket, or -1
+  unsigned int numBuckets; // a power of 2
+
+  struct Tuple *probeTuple; // current tuple of probe, NULL => fetch next
+  int match;                // next entry to check against probeTuple
+};
+
+//
+// hashJoin_build
+//
+// Reads all of the build input into the hash table.
+//
+static void hashJoin_build(struct HashJoinState *join) {
+  int width = join->build->numColumns;
+  struct Tuple *tuple = NULL;
+
+  while ((tuple = operator_next(join->build)) != NULL) {
+    if (join->numEntries == join->size) {
+      join->size *= 2;
+      join->values = (struct TupleValue *)realloc(
+          join->values, sizeof(struct TupleValue) * join->size * width);
+      join->hashes = (unsigned int *)realloc(
+          join->hashes, sizeof(unsigned int) * join->size);
+      join->chain = (int *)realloc(join->chain, sizeof(int) * join->size);
+
+      if (join->values == NULL || join->hashes == NULL || join->chain == NULL)
+        panic("out of memory");
+    }
+
+    int e = join->numEntries;
+    memcpy(&join->values[e * width], tuple->values,
+           sizeof(struct TupleValue) * width);
+    join->hashes[e] = operator_hashValue(&tuple->values[join->buildKey]);
+    join->numEntries++;
+  }
+
+  // at least twice as many buckets as entries keeps the chains short
+  join->numBuckets = 16;
+  while (join->numBuckets < 2 * (unsigned int)join->numEntries)
+    join->numBuckets *= 2;
+
+  join->buckets = (int *)malloc(sizeof(int) * join->numBuckets);
+  if (join->buckets == NULL)
+    panic("out of memory");
+
+  for (unsigned int b = 0; b < join->numBuckets; b++)
+    join->buckets[b] = -1;
+
+  // inserting in reverse so each chain lists entries in input order
+  for (int e = join->numEntries - 1; e >= 0; e--) {
+    unsigned int b = join->hashes[e] & (join->numBuckets - 1);
+    join->chain[e] = join->buckets[b];
+    join->buckets[b] = e;
+  }
+}
+
+static struct Tuple *hashJoin_next(struct Operator *op) {
+  struct HashJoinState *join = (struct HashJoinState *)op->state;
+
+  if (join->buckets == NULL)
+    hashJoin_build(join);
+
+  int width = join->build->numColumns;
+
+  while (true) {
+    if (join->probeTuple == NULL) {
+      join->probeTuple = operator_next(join->probe);
+      if (join->probeTuple == NULL)
+        return NULL;
+
+      unsigned int hash =
+          operator_hashValue(&join->probeTuple->values[join->probeKey]);
+      join->match = join->buckets[hash & (join->numBuckets - 1)];
+    }
+
+    struct TupleValue *key = &join->probeTuple->values[join->probeKey];
+
+    while (join->match != -1) {
+      int e = join->match;
+      join->match = join->chain[e];
+
+      struct TupleValue *entry = &join->values[e * width];
+      if (!operator_equalValues(&entry[join->buildKey], key))
+        continue;
+
+      // output is always the left columns followed by the right columns
+      struct TupleValue *left = join->buildIsLeft ? entry
+                                                  : join->probeTuple->values;
+      struct TupleValue *right = join->buildIsLeft ? join->probeTuple->values
+                                                   : entry;
+
+      memcpy(op->tuple.values, left,
+             sizeof(struct TupleValue) * op->child->numColumns);
+      memcpy(op->tuple.values + op->child->numColumns, right,
+             sizeof(struct TupleValue) * op->right->numColumns);
+
+      return &op->tuple;
+    }
+
+    // no more matches for this probe tuple
+    join->probeTuple = NULL;
+  }
+}
+
+static void hashJoin_destroy(struct Operator *op) {
+  struct HashJoinState *join = (struct HashJoinState *)op->state;
+
+  free(join->values);
+  free(join->hashes);
+  free(join->chain);
+  free(join->buckets);
+}
+
+static void hashJoin_explain(struct Operator *op, struct OpExplain *info) {
+  struct HashJoinState *join = (struct HashJoinState *)op->state;
+  struct OpColumn *buildKey = &join->build->columns[join->buildKey];
+  struct OpColumn *probeKey = &join->probe->columns[join->probeKey];
+
+  operator_appendDetail(info, "%s.%s = %s.%s, hash table on %s",
+                        probeKey->tableName, probeKey->colName,
+                        buildKey->tableName, buildKey->colName,
+                        buildKey->tableName);
+
+  info->memory =
+      (long long)join->size * (sizeof(struct TupleValue) *
+                                   join->build->numColumns +
+                               sizeof(unsigned int) + sizeof(int)) +
+      (long long)join->numBuckets * sizeof(int);
+}
+
+//
+// operator_hashJoin
+//
+struct Operator *operator_hashJoin(struct Operator *left,
+                                   struct Operator *right, int leftKey,
+                                   int rightKey) {
+  assert(leftKey >= 0 && leftKey < left->numColumns);
+  assert(rightKey >= 0 && rightKey < right->numColumns);
+
+  struct Operator *op = operator_create(
+      OP_HASH_JOIN, left, left->numColumns + right->numColumns);
+  op->right = right;
+
+  memcpy(op->columns, left->columns,
+         sizeof(struct OpColumn) * left->numColumns);
+  memcpy(op->columns + left->numColumns, right->columns,
+         sizeof(struct OpColumn) * right->numColumns);
+
+  struct HashJoinState *join =
+      (struct HashJoinState *)arena_alloc(sizeof(struct HashJoinState));
+
+  // build on the smaller input, the one expected to produce fewer tuples
+  join->buildIsLeft = (left->estimatedRows < right->estimatedRows);
+
+  if (join->buildIsLeft) {
+    join->build = left;
+    join->probe = right;
+    join->buildKey = leftKey;
+    join->probeKey = rightKey;
+  } else {
+    join->build = right;
+    join->probe = left;
+    join->buildKey = rightKey;
+    join->probeKey = leftKey;
+  }
+
+  join->size = 64;
+  join->numEntries = 0;
+  join->values = (struct TupleValue *)malloc(sizeof(struct TupleValue) *
+                                             join->size *
+                                             join->build->numColumns);
+  join->hashes = (unsigned int *)malloc(sizeof(unsigned int) * join->size);
+  join->chain = (int *)malloc(sizeof(int) * join->size);
+  if (join->values == NULL || join->hashes == NULL || join->chain == NULL)
+    panic("out of memory");
+
+  // the hash table is built on the first call to operator_next()
+  join->buckets = NULL;
+  join->numBuckets = 0;
+  join->probeTuple = NULL;
+  join->match = -1;
+
+  // every probe tuple matches at most one entry of a unique key, and
+  // we don't know better otherwise
+  op->estimatedRows = join->probe->estimatedRows;
+
+  op->state = join;
+  op->next = hashJoin_next;
+  op->destroy = hashJoin_destroy;
+  op->explain = hashJoin_explain;
+
+  return op;
+}
@@ -0,0 +1,138 @@
+/*kernel.c*/
+
+//
+// Project: Type-specialized comparison kernels for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <stdbool.h> // true, false
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ast.h"
+#include "database.h"
+#include "kernel.h"
+
+//
+// NUMBER_KERNELS
+//
+// Generates the six kernels of a number type, named e.g. intLT ...
+// intNE, comparing the given field of the values' union.
+//
+#define NUMBER_KERNEL(name, field, op)                                        \
+  static bool name(struct TupleValue *value, struct TupleValue *literal) {    \
+    return value->value.field op literal->value.field;                        \
+  }
+
+#define NUMBER_KERNELS(type, field)                                           \
+  NUMBER_KERNEL(type##LT, field, <)                                           \
+  NUMBER_KERNEL(type##LTE, field, <=)                                         \
+  NUMBER_KERNEL(type##GT, field, >)                                           \
+  NUMBER_KERNEL(type##GTE, field, >=)                                         \
+  NUMBER_KERNEL(type##EQ, field, ==)                                          \
+  NUMBER_KERNEL(type##NE, field, !=)
+
+NUMBER_KERNELS(int, i)
+NUMBER_KERNELS(real, r)
+
+//
+// STRING_KERNEL
+//
+// Generates a kernel ordering strings as operator_compareString()
+// does; = and <> only need to compare strings of the same length.
+//
+#define STRING_KERNEL(name, op)                                               \
+  static bool name(struct TupleValue *value, struct TupleValue *literal) {    \
+    return operator_compareString(value->value.s, value->length,              \
+                                  literal->value.s, literal->length) op 0;    \
+  }
+
+STRING_KERNEL(stringLT, <)
+STRING_KERNEL(stringLTE, <=)
+STRING_KERNEL(stringGT, >)
+STRING_KERNEL(stringGTE, >=)
+
+static bool stringEQ(struct TupleValue *value, struct TupleValue *literal) {
+  return value->length == literal->length &&
+         strncasecmp(value->value.s, literal->value.s, literal->length) == 0;
+}
+
+static bool stringNE(struct TupleValue *value, struct TupleValue *literal) {
+  return !stringEQ(value, literal);
+}
+
+//
+// the kernels, by column type and then by operator:
+//
+static Kernel kernels[][EXPR_NOT_EQUAL + 1] = {
+    {intLT, intLTE, intGT, intGTE, intEQ, intNE},                   // int
+    {realLT, realLTE, realGT, realGTE, realEQ, realNE},             // real
+    {stringLT, stringLTE, stringGT, stringGTE, stringEQ, stringNE}, // string
+};
+
+//
+// the orderings:
+//
+static int intOrder(const void *value1, const void *value2) {
+  int i1 = ((struct TupleValue *)value1)->value.i;
+  int i2 = ((struct TupleValue *)value2)->value.i;
+
+  return (i1 > i2) - (i1 < i2);
+}
+
+static int realOrder(const void *value1, const void *value2) {
+  double r1 = ((struct TupleValue *)value1)->value.r;
+  double r2 = ((struct TupleValue *)value2)->value.r;
+
+  return (r1 > r2) - (r1 < r2);
+}
+
+static int stringOrder(const void *value1, const void *value2) {
+  struct TupleValue *s1 = (struct TupleValue *)value1;
+  struct TupleValue *s2 = (struct TupleValue *)value2;
+
+  return operator_compareString(s1->value.s, s1->length, s2->value.s,
+                                s2->length);
+}
+
+//
+// kernel_literal
+//
+void kernel_literal(char *literal, int colType, struct TupleValue *value) {
+  value->valueType = colType;
+  value->length = 0;
+
+  if (colType == COL_TYPE_INT)
+    value->value.i = atoi(literal);
+  else if (colType == COL_TYPE_REAL)
+    value->value.r = atof(literal);
+  else {
+    value->value.s = literal;
+    value->length = strlen(literal);
+  }
+}
+
+//
+// kernel_compare
+//
+Kernel kernel_compare(int colType, int operator) {
+  assert(colType >= COL_TYPE_INT && colType <= COL_TYPE_STRING);
+  assert(operator >= EXPR_LT && operator <= EXPR_NOT_EQUAL);
+
+  return kernels[colType - COL_TYPE_INT][operator];
+}
+
+//
+// kernel_order
+//
+KernelOrder kernel_order(int colType) {
+  if (colType == COL_TYPE_INT)
+    return intOrder;
+  else if (colType == COL_TYPE_REAL)
+    return realOrder;
+  else
+    return stringOrder;
+}
@@ -0,0 +1,64 @@
+/*kernel.h*/
+
+//
+// Project: Type-specialized comparison kernels for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+
+#include "operator.h"
+
+//
+// A filter compares one value of each tuple against a literal. Rather
+// than deciding per tuple what type the value is and what the operator
+// is, the filter picks a kernel once, when it is built: a function that
+// performs exactly one comparison, e.g. "int < int" or "string =
+// string", against a literal that was converted once to the column's
+// type. The tuple-at-a-time loop then makes one indirect call per
+// tuple, with no branching on the type or the operator. The kernels
+// are generated by macros, see kernel.c.
+//
+// (vector.h has the kernels that compare a batch of values at once.)
+//
+typedef bool (*Kernel)(struct TupleValue *value, struct TupleValue *literal);
+
+//
+// An ordering compares two values of the same type, returning < 0, 0
+// or > 0, in the form qsort() and bsearch() take.
+//
+typedef int (*KernelOrder)(const void *value1, const void *value2);
+
+//
+// Functions:
+//
+
+//
+// kernel_literal
+//
+// Converts the literal, in string form as in the AST, to a value of
+// the given column type (enum ColumnType, database.h). A string value
+// points to the literal, which is not copied.
+//
+void kernel_literal(char *literal, int colType, struct TupleValue *value);
+
+//
+// kernel_compare
+//
+// Returns the kernel that checks "value operator literal" for values
+// of the given column type, where the operator is one of <, <=, >,
+// >=, = and <> (enum AST_EXPR_OPERATORS).
+//
+Kernel kernel_compare(int colType, int operator);
+
+//
+// kernel_order
+//
+// Returns the ordering of values (struct TupleValue) of the given
+// column type; strings are ordered case-insensitively, as by
+// operator_compareString().
+//
+KernelOrder kernel_order(int colType);
@@ -15,17 +15,41 @@
 #include <stdlib.h>
 #include <string.h> // strcpy, strcat
 #include <strings.h>
+#include <unistd.h> // sysconf
 
+#include "arena.h"
+#include "bufferpool.h"
 #include "execute.h"
+#include "resultcache.h"
+#include "server.h"
+#include "session.h"
+#include "wal.h"
+
 //
 // main
 //
 // Prompt for database, open, and then input and
 // execute SimpleSQL queries...
 //
-int main() {
+// Or, when run as "ssql -server path [threads]", serve sessions
+// over the Unix domain socket at path (see server.h); the # of
+// threads defaults to the # of cores.
+//
+int main(int argc, char *argv[]) {
   struct Database *db = NULL;
 
+  if (argc >= 3 && strcmp(argv[1], "-server") == 0) {
+    long numThreads =
+        (argc >= 4) ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (numThreads < 1)
+      numThreads = 1;
+
+    parser_init();
+
+    return server_run(argv[2], (int)numThreads);
+  }
+
   //
   // first we need the database name, and then let's
   // try to open it:
@@ -46,6 +70,8 @@ int main() {
     exit(-1);
   }
 
+  wal_recover(db); // redo any changes a crash left in the log
+
   //
   // print the schema:
   //
@@ -56,70 +82,19 @@ int main() {
   //
   parser_init();
 
-  while (true) {
-    printf("query? ");
-
-    struct TokenQueue *tokens = NULL;
-
-    //
-    // first we check for syntax errors / EOF:
-    //
-    tokens = parser_parse(stdin);
-
-    if (tokens == NULL) {
-      //
-      // EOF, or syntax error (error msg already output by parser if so):
-      //
-      if (parser_eof())
-        break;
-      else // syntax error, loop around and try another query;
-        continue;
-    } else // successful parse:
-    {
-      //
-      // analyze the query for semantic errors, and build AST if successful:
-      //
-      struct QUERY *query = NULL;
-
-      query = analyzer_build(db, tokens);
-
-      tokenqueue_destroy(tokens); // done with the tokens, free memory:
-
-      if (query == NULL) // semantic error, msg already output
-      {
-        //
-        // nothing to do, ignore and loop around and try again:
-        //
-        continue;
-      } else {
-        //
-        // print AST and output first 5 lines of the table
-        // given in the FROM clause of the query:
-        //
-        // print_ast(query);
-
-        // Creating a resultset struct
-        struct ResultSet *rSet;
-        rSet = resultset_create();
-
-        // Executing the query
-        execute_query(db, query, rSet);
-
-        // Freeing memory associated with the query
-        analyzer_destroy(query);
-
-        // Freeing memory associated with the Resultset
-        resultset_destroy(rSet);
-      }
-    } // else
-  }   // while
+  session_run(db, stdin);
 
   //
   // done!
   //
 
   // Freeing memory associated with the database
+  wal_close(db);
   database_close(db);
 
+  resultcache_clear();
+  bufferpool_release();
+  arena_release();
+
   return 0;
 }
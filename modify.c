@@ -0,0 +1,488 @@
+/*modify.c*/
+
+//
+// Project: Updates and deletes for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <fcntl.h>   // open
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // pread
+
+#include "index.h"
+#include "modify.h"
+#include "operator.h"
+#include "predicate.h"
+#include "session.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+//
+// An UPDATE or DELETE, and what it writes to the table (see wal.h):
+//
+struct Modify {
+  struct SET *set;     // UPDATE: the assignments, NULL => a DELETE
+  struct PRED *where;  // OPTIONAL where clause
+  char **values; // UPDATE: ARRAY, each column's new value, NULL => same
+
+  char *records;           // UPDATE: the updated records, back to back
+  struct WalWrite *writes; // ARRAY
+};
+
+static char deleted[] = {TABLE_DELETED, '\0'};
+
+static int compareRecordNums(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+//
+// markColumns
+//
+// Sets columns[c] to true for each column c of the where clause.
+//
+static void markColumns(struct TableMeta *meta, struct PRED *pred,
+                        bool *columns) {
+  if (pred == NULL)
+    return;
+
+  if (pred->expr != NULL)
+    columns[table_findColumn(meta, pred->expr->column->name)] = true;
+
+  markColumns(meta, pred->left, columns);
+  markColumns(meta, pred->right, columns);
+}
+
+//
+// findRecords
+//
+// Returns the #s of the table's records that satisfy the where clause
+// (NULL => every record), in file order, storing how many in *N. The
+// deleted records are skipped. If a conjunct of the where clause
+// compares a column whose index supports the operator, only the
+// records the index finds are checked, otherwise the table is scanned.
+//
+static int *findRecords(struct Database *db, struct Table *table,
+                        struct PRED *where, int *N) {
+  struct TableMeta *meta = table->meta;
+
+  int *recordNums = (int *)malloc(sizeof(int) * (table->numRecords + 1));
+  if (recordNums == NULL)
+    panic("out of memory");
+
+  *N = 0;
+
+  if (where == NULL) {
+    for (int recordNum = 0; recordNum < table->numRecords; recordNum++) {
+      if (!table_deleted(table, recordNum))
+        recordNums[(*N)++] = recordNum;
+    }
+
+    return recordNums;
+  }
+
+  //
+  // the where clause is compiled for tuples of all the table's
+  // columns, of which only its own are read:
+  //
+  struct OpColumn opColumns[meta->numColumns + 1];
+  bool columns[meta->numColumns + 1];
+  struct TupleValue values[meta->numColumns + 1];
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    opColumns[c].tableName = meta->name;
+    opColumns[c].colName = meta->columns[c].name;
+    opColumns[c].function = NO_FUNCTION;
+    opColumns[c].colType = meta->columns[c].colType;
+    columns[c] = false;
+  }
+
+  int numPreds;
+  struct PRED **preds = predicate_conjuncts(where, &numPreds);
+  struct Predicate *predicate =
+      predicate_compile(preds, numPreds, opColumns, meta->numColumns);
+  struct EXPR *lookup = NULL;
+  int lookupColumn = -1;
+
+  for (int p = 0; p < numPreds; p++) {
+    struct EXPR *expr = preds[p]->expr;
+
+    if (preds[p]->predType != PRED_COMPARE || !index_supports(expr->operator))
+      continue;
+
+    int column = table_findColumn(meta, expr->column->name);
+
+    if (meta->columns[column].indexType != COL_NON_INDEXED) {
+      lookup = expr;
+      lookupColumn = column;
+      break;
+    }
+  }
+
+  markColumns(meta, where, columns);
+
+  int first = 0, last = table->numRecords;
+  struct Index *index = NULL;
+
+  if (lookup != NULL) {
+    index = index_open(db, table, lookupColumn);
+    index_lookup(index, lookup->operator, lookup->value, &first, &last);
+  }
+
+  for (int i = first; i < last; i++) {
+    int recordNum = (index != NULL) ? index->entries[i].recordNum : i;
+
+    if (table_deleted(table, recordNum))
+      continue;
+
+    table_read(table, recordNum, columns, values);
+
+    if (predicate_check(predicate, values))
+      recordNums[(*N)++] = recordNum;
+  }
+
+  if (index != NULL) {
+    index_close(index);
+    qsort(recordNums, *N, sizeof(int), compareRecordNums);
+  }
+
+  return recordNums;
+}
+
+//
+// checkUnique
+//
+// Returns true if the UPDATE does not set a unique column to a value
+// that another record has, or for more than one record. Otherwise
+// outputs an error message and returns false.
+//
+static bool checkUnique(struct Database *db, struct Table *table,
+                        struct Modify *modify, int *recordNums, int N) {
+  struct TableMeta *meta = table->meta;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    char *value = modify->values[c];
+
+    if (value == NULL || meta->columns[c].indexType != COL_UNIQUE_INDEXED ||
+        N == 0)
+      continue;
+
+    if (N > 1) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: UPDATE would set unique column '%s.%s' of %d "
+              "rows to '%s'\n",
+              meta->name, meta->columns[c].name, N, value);
+      return false;
+    }
+
+    struct Index *index = index_open(db, table, c);
+    int first, last;
+    bool unique = true;
+
+    index_lookup(index, EXPR_EQUAL, value, &first, &last);
+
+    for (int e = first; e < last && unique; e++) {
+      int recordNum = index->entries[e].recordNum;
+
+      unique = (recordNum == recordNums[0]) || table_deleted(table, recordNum);
+    }
+
+    index_close(index);
+
+    if (!unique) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: value '%s' is already in unique column "
+              "'%s.%s'\n",
+              value, meta->name, meta->columns[c].name);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// formatUpdate
+//
+// Formats the updated record from the old one: each column's new
+// value if it is set, otherwise its value as written in the old
+// record. Returns false if the record does not fit in the record
+// size.
+//
+static bool formatUpdate(struct TableMeta *meta, char *old, char **values,
+                         char *record) {
+  char *cp = record;
+  char *end = record + meta->recordSize;
+  char *op = old;
+  char *oldEnd = old + meta->recordSize;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    int colType = meta->columns[c].colType;
+    char *start = op;
+
+    // the old value, with its quotes, as in table_parseRecord()
+    if (colType == COL_TYPE_STRING)
+      op = (char *)memchr(op + 1, *op, oldEnd - (op + 1)) + 1;
+    else
+      op = (char *)memchr(op, ' ', oldEnd - op);
+
+    assert(op != NULL && op < oldEnd);
+
+    int length = op - start;
+    op++; // the space that follows it
+
+    if (values[c] != NULL) {
+      cp = table_formatValue(cp, end, values[c], colType);
+
+      if (cp == NULL)
+        return false;
+    } else {
+      if (length + 1 > end - cp)
+        return false;
+
+      memcpy(cp, start, length);
+      cp += length;
+      *cp++ = ' ';
+    }
+  }
+
+  memset(cp, '.', end - cp);
+
+  return true;
+}
+
+//
+// updateRecords
+//
+// Formats the updated records, and a write for each one that changed.
+// The old records are read from the data file (fd) if the table is
+// open on its column files. Returns false if a record does not fit in
+// the record size; an error message was output.
+//
+static bool updateRecords(struct Table *table, int fd, struct Modify *modify,
+                          int *recordNums, int N, struct WalChange *change) {
+  struct TableMeta *meta = table->meta;
+  size_t recordLength = meta->recordSize + 2;
+  char buffer[recordLength];
+
+  modify->records = (char *)malloc(recordLength * N + 1);
+  if (modify->records == NULL)
+    panic("out of memory");
+
+  for (int i = 0; i < N; i++) {
+    long long offset = (long long)recordNums[i] * recordLength;
+    char *record = modify->records + (recordLength * change->numWrites);
+    char *old = buffer;
+
+    if (table->format == TABLE_TEXT)
+      old = table_record(table, recordNums[i]);
+    else if (fd < 0 ||
+             pread(fd, buffer, meta->recordSize, offset) != meta->recordSize) {
+      fprintf(session_output(),
+              "**INTERNAL ERROR: unable to read data file of table '%s'.\n",
+              meta->name);
+      return false;
+    }
+
+    if (!formatUpdate(meta, old, modify->values, record)) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: updated row does not fit in the record size "
+              "of table '%s' (%d)\n",
+              meta->name, meta->recordSize);
+      return false;
+    }
+
+    if (memcmp(record, old, meta->recordSize) == 0) // unchanged
+      continue;
+
+    // the whole record, so the writes of neighbouring records are back
+    // to back (see wal.h)
+    record[meta->recordSize] = '$';
+    record[meta->recordSize + 1] = '\n';
+
+    struct WalWrite *write = &modify->writes[change->numWrites++];
+
+    write->offset = offset;
+    write->bytes = record;
+    write->length = recordLength;
+  }
+
+  return true;
+}
+
+//
+// prepareModify
+//
+// Finds the records the UPDATE or DELETE matches, and writes each of
+// them (see wal.h).
+//
+static bool prepareModify(struct WalChange *change, struct WalGroup *group) {
+  struct Modify *modify = (struct Modify *)change->arg;
+  struct TableMeta *meta = change->meta;
+  char path[TABLE_MAX_PATH_LENGTH];
+
+  table_path(path, change->db, meta->name, ".data");
+
+  if (group->size < 0) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: table's data file '%s' not found.\n", path);
+    return false;
+  }
+
+  struct Table *table = table_open(change->db, meta);
+  if (table == NULL) // msg already output
+    return false;
+
+  int N;
+  int *recordNums = findRecords(change->db, table, modify->where, &N);
+
+  modify->writes =
+      (struct WalWrite *)malloc(sizeof(struct WalWrite) * (N + 1));
+  if (modify->writes == NULL)
+    panic("out of memory");
+
+  change->writes = modify->writes;
+  change->numRows = N;
+
+  bool success = true;
+
+  if (modify->set == NULL) {
+    // a DELETE only marks each record deleted
+    for (int i = 0; i < N; i++) {
+      struct WalWrite *write = &modify->writes[change->numWrites++];
+
+      write->offset = ((long long)recordNums[i] * (meta->recordSize + 2)) +
+                      meta->recordSize;
+      write->bytes = deleted;
+      write->length = 1;
+    }
+  } else if (checkUnique(change->db, table, modify, recordNums, N)) {
+    int fd = (table->format == TABLE_TEXT) ? -1 : open(path, O_RDONLY);
+
+    success = updateRecords(table, fd, modify, recordNums, N, change);
+
+    if (fd >= 0)
+      close(fd);
+  } else {
+    success = false;
+  }
+
+  // the finish needs to know which columns were set
+  group->state = modify;
+
+  free(recordNums);
+  table_close(table);
+
+  return success;
+}
+
+//
+// finishModify
+//
+// Marks the index files on the columns that were not set as matching
+// the data file again; a deleted record keeps its entries.
+//
+static void finishModify(struct WalGroup *group) {
+  struct Modify *modify = (struct Modify *)group->state;
+  struct TableMeta *meta = group->meta;
+  struct Table *table = NULL;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    if (meta->columns[c].indexType == COL_NON_INDEXED ||
+        (modify->set != NULL && modify->values[c] != NULL))
+      continue;
+
+    if (table == NULL)
+      table = table_open(group->db, meta);
+
+    if (table != NULL)
+      index_update(group->db, table, c, group->size, group->modified,
+                   table->numRecords);
+  }
+
+  table_close(table);
+}
+
+//
+// modify
+//
+// Commits the UPDATE or DELETE to the table, returning the # of rows
+// changed, or -1 if it failed; an error message was output.
+//
+static int modify(struct Database *db, struct TableMeta *meta,
+                  struct Modify *modify) {
+  struct WalChange change;
+
+  modify->records = NULL;
+  modify->writes = NULL;
+
+  change.db = db;
+  change.meta = meta;
+  change.append = false;
+  change.prepare = prepareModify;
+  change.release = NULL;
+  change.finish = finishModify;
+  change.arg = modify;
+
+  wal_commit(&change);
+
+  free(modify->records);
+  free(modify->writes);
+
+  return change.committed ? change.numRows : -1;
+}
+
+//
+// modify_update
+//
+void modify_update(struct Database *db, struct UPDATE *update) {
+  struct TableMeta *meta = table_find(db, update->table);
+
+  if (meta == NULL)
+    panic("UPDATE table does not exist (modify)");
+
+  char *values[meta->numColumns + 1];
+
+  for (int c = 0; c < meta->numColumns; c++)
+    values[c] = NULL;
+
+  for (struct SET *set = update->set; set != NULL; set = set->next)
+    values[table_findColumn(meta, set->column->name)] = set->value;
+
+  struct Modify m;
+
+  m.set = update->set;
+  m.where = update->where;
+  m.values = values;
+
+  int numRows = modify(db, meta, &m);
+
+  if (numRows >= 0)
+    fprintf(session_output(), "**UPDATED: %d rows\n", numRows);
+}
+
+//
+// modify_delete
+//
+void modify_delete(struct Database *db, struct DELETE *delete) {
+  struct TableMeta *meta = table_find(db, delete->table);
+
+  if (meta == NULL)
+    panic("DELETE table does not exist (modify)");
+
+  struct Modify m;
+
+  m.set = NULL;
+  m.where = delete->where;
+  m.values = NULL;
+
+  int numRows = modify(db, meta, &m);
+
+  if (numRows >= 0)
+    fprintf(session_output(), "**DELETED: %d rows\n", numRows);
+}
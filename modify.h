@@ -0,0 +1,50 @@
+/*modify.h*/
+
+//
+// Project: Updates and deletes for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include "ast.h"
+#include "database.h"
+
+//
+// UPDATE and DELETE change the matching records of "<table>.data" in
+// place: records are fixed-width, so an UPDATE rewrites each one at
+// the same offset, and a DELETE only changes its terminator to mark it
+// deleted (see table.h). The records matching the WHERE clause are
+// found with the column's index if it has one, otherwise by a scan.
+// Like an INSERT, the change is durable once it is reported, thanks to
+// the database's log (see wal.h).
+//
+// A deleted record keeps its place, and its entries in the indexes, so
+// the index files stay up to date; so do those on columns an UPDATE
+// does not set. The index on a column that is set is rebuilt when next
+// opened. A value that would end up in a COL_UNIQUE_INDEXED column
+// twice is rejected, along with the whole UPDATE.
+//
+
+//
+// Functions:
+//
+
+//
+// modify_update
+//
+// Updates the records matching the UPDATE, which rewrite_apply() has
+// checked, and outputs the # of rows updated, or else an error
+// message.
+//
+void modify_update(struct Database *db, struct UPDATE *update);
+
+//
+// modify_delete
+//
+// Deletes the records matching the DELETE, which rewrite_apply() has
+// checked, and outputs the # of rows deleted, or else an error
+// message.
+//
+void modify_delete(struct Database *db, struct DELETE *delete);
@@ -0,0 +1,987 @@
+/*operator.c*/
+
+//
+// Project: Query operators for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <ctype.h>  // tolower
+#include <stdarg.h> // va_list
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h> // clock_gettime
+
+#include "arena.h"
+#include "index.h"
+#include "kernel.h"
+#include "operator.h"
+#include "table.h"
+#include "util.h"
+#include "vector.h"
+#include "zonemap.h"
+
+//
+// operator-specific state:
+//
+struct ScanState {
+  struct Table *table;
+  bool *columns;  // ARRAY: true => column is read, see table_read()
+  int firstRecord; // first record to read (0, or a partition's)
+  int recordNum;   // next record to read (0-based)
+  int lastRecord;  // stop before this record (numRecords, or a partition's)
+
+  //
+  // a select scan evaluates the where clause on a batch of the
+  // column's values at a time (see vector.h), NULL selection => none:
+  //
+  int whereColumn;  // index of the column being compared
+  int operator;     // enum AST_EXPR_OPERATORS
+  int codeOperator; // string column: the operator applied to the codes
+  int i;            // literal, converted according to the column type
+  double r;         // (string column: i is the code compared to)
+  char *value;      // the literal as given, for EXPLAIN
+  void *batch;      // ARRAY: buffer for a batch of the column's values
+  int *selection;   // ARRAY: positions of the matches within the batch
+  int batchStart;   // record # of the batch's first value
+  int numSelected;  // # of positions in selection
+  int nextSelected; // next position in selection to output
+
+  //
+  // the blocks of records that the zone map on the where clause's
+  // column rules out are skipped (see zonemap.h), NULL zones => none:
+  //
+  struct ZoneMap *zones;
+  int zoneOperator;         // enum AST_EXPR_OPERATORS
+  char *zoneValue;          // the literal
+  int zoneEnd;              // record # where the next block to check starts
+  int zonesSkipped;         // # of blocks skipped
+  long long recordsSkipped; // # of records in them
+};
+
+struct IndexScanState {
+  struct Table *table;
+  bool *columns; // ARRAY: true => column is read, see table_read()
+  struct Index *index;
+  int operator;    // enum AST_EXPR_OPERATORS
+  char *value;     // the literal, for EXPLAIN
+  int *recordNums; // ARRAY of matching record #s, in file order
+  int numRecords;
+  int next; // next position in recordNums
+};
+
+struct FilterState {
+  int index;                 // index of the column being compared
+  int operator;              // enum AST_EXPR_OPERATORS
+  char *value;               // the literal, for EXPLAIN
+  struct TupleValue literal; // converted according to the column type
+  Kernel kernel;             // compares the column to the literal
+};
+
+struct ProjectState {
+  int *indices; // ARRAY: for each output column, index in child's tuple
+};
+
+struct LimitState {
+  int N;     // max # of tuples to output
+  int count; // # of tuples output so far
+};
+
+// true => operators created by this thread keep OpStats
+static _Thread_local bool analyzing = false;
+
+//
+// operator_create
+//
+struct Operator *operator_create(int opType, struct Operator *child,
+                                 int numColumns) {
+  struct Operator *op =
+      (struct Operator *)arena_alloc(sizeof(struct Operator));
+
+  op->opType = opType;
+  op->child = child;
+  op->right = NULL;
+  op->estimatedRows = (child != NULL) ? child->estimatedRows : 0;
+  op->numColumns = numColumns;
+  op->columns = (struct OpColumn *)arena_alloc(sizeof(struct OpColumn) *
+                                               (numColumns + 1));
+  op->tuple.values = (struct TupleValue *)arena_alloc(
+      sizeof(struct TupleValue) * (numColumns + 1));
+  op->tuple.numValues = numColumns;
+  op->state = NULL;
+  op->stats = NULL;
+  op->next = NULL;
+  op->destroy = NULL;
+  op->explain = NULL;
+
+  if (analyzing) {
+    op->stats = (struct OpStats *)arena_alloc(sizeof(struct OpStats));
+    op->stats->rows = 0;
+    op->stats->nanos = 0;
+  }
+
+  return op;
+}
+
+//
+// operator_appendDetail
+//
+void operator_appendDetail(struct OpExplain *info, char *format, ...) {
+  int length = strlen(info->detail);
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(info->detail + length, OPERATOR_MAX_DETAIL - length, format, args);
+  va_end(args);
+}
+
+//
+// appendWhere
+//
+// Appends "column op literal" to info->detail.
+//
+static void appendWhere(struct OpExplain *info, struct OpColumn *column,
+                        int operator, char *value) {
+  static char *operators[] = {"<", "<=", ">", ">=", "=", "<>", "LIKE"};
+
+  char *quote = (column->colType == COL_TYPE_STRING) ? "'" : "";
+
+  operator_appendDetail(info, "%s.%s %s %s%s%s", column->tableName,
+                        column->colName, operators[operator], quote, value,
+                        quote);
+}
+
+//
+// appendColumns
+//
+// Appends the table's format, and the # of its columns that are read
+// (NULL => all), to info->detail.
+//
+static void appendColumns(struct OpExplain *info, struct Table *table,
+                          bool *columns) {
+  int numRead = 0;
+
+  for (int c = 0; c < table->meta->numColumns; c++) {
+    if (columns == NULL || columns[c])
+      numRead++;
+  }
+
+  operator_appendDetail(info, " (%s, %d of %d columns)",
+                        (table->format == TABLE_COLUMNAR) ? "columnar"
+                                                          : "text",
+                        numRead, table->meta->numColumns);
+}
+
+//
+// skipZones
+//
+// Moves the scan past the blocks of records the zone map rules out,
+// once it reaches the start of a block it has not checked.
+//
+static void skipZones(struct ScanState *scan) {
+  while (scan->recordNum >= scan->zoneEnd &&
+         scan->recordNum < scan->lastRecord) {
+    int zone = scan->recordNum / ZONEMAP_BLOCK_SIZE;
+
+    scan->zoneEnd = (zone + 1) * ZONEMAP_BLOCK_SIZE;
+
+    if (zonemap_mayMatch(scan->zones, zone, scan->zoneOperator,
+                         scan->zoneValue))
+      return;
+
+    int end = (scan->zoneEnd < scan->lastRecord) ? scan->zoneEnd
+                                                 : scan->lastRecord;
+
+    scan->zonesSkipped++;
+    scan->recordsSkipped += end - scan->recordNum;
+    scan->recordNum = end;
+  }
+}
+
+//
+// scan
+//
+static struct Tuple *scan_next(struct Operator *op) {
+  struct ScanState *scan = (struct ScanState *)op->state;
+
+  while (true) {
+    if (scan->zones != NULL)
+      skipZones(scan);
+
+    if (scan->recordNum >= scan->lastRecord)
+      return NULL;
+
+    if (!table_deleted(scan->table, scan->recordNum))
+      break;
+
+    scan->recordNum++;
+  }
+
+  table_read(scan->table, scan->recordNum, scan->columns, op->tuple.values);
+  scan->recordNum++;
+
+  return &op->tuple;
+}
+
+static void scan_destroy(struct Operator *op) {
+  struct ScanState *scan = (struct ScanState *)op->state;
+
+  zonemap_close(scan->zones);
+  table_close(scan->table);
+}
+
+static void scan_explain(struct Operator *op, struct OpExplain *info) {
+  struct ScanState *scan = (struct ScanState *)op->state;
+
+  operator_appendDetail(info, "%s", scan->table->meta->name);
+  appendColumns(info, scan->table, scan->columns);
+
+  if (scan->selection != NULL) { // a select scan:
+    operator_appendDetail(info, " WHERE ");
+    appendWhere(info, &op->columns[scan->whereColumn], scan->operator,
+                scan->value);
+    operator_appendDetail(info, ", vectorized");
+
+    if (op->columns[scan->whereColumn].colType == COL_TYPE_STRING)
+      operator_appendDetail(info, " on dictionary codes");
+  }
+
+  if (scan->firstRecord > 0 || scan->lastRecord < scan->table->numRecords)
+    operator_appendDetail(info, ", records %d..%d", scan->firstRecord,
+                          scan->lastRecord - 1);
+
+  if (scan->zones != NULL) {
+    operator_appendDetail(
+        info, ", zone map on %s",
+        scan->table->meta->columns[scan->zones->column].name);
+
+    if (op->stats != NULL) { // analyzed, so the scan has run
+      int numZones = 0;
+
+      if (scan->lastRecord > scan->firstRecord)
+        numZones = ((scan->lastRecord - 1) / ZONEMAP_BLOCK_SIZE) -
+                   (scan->firstRecord / ZONEMAP_BLOCK_SIZE) + 1;
+
+      operator_appendDetail(info, " (%d of %d blocks skipped)",
+                            scan->zonesSkipped, numZones);
+    }
+  }
+
+  info->rowsIn = scan->recordNum - scan->firstRecord - scan->recordsSkipped;
+  info->bytesRead = scan->table->bytesRead;
+}
+
+//
+// copyColumns
+//
+// Returns a copy of the columns to read (NULL => all columns).
+//
+static bool *copyColumns(struct TableMeta *table, bool *columns) {
+  if (columns == NULL)
+    return NULL;
+
+  bool *copy = (bool *)arena_alloc(sizeof(bool) * (table->numColumns + 1));
+
+  memcpy(copy, columns, sizeof(bool) * table->numColumns);
+
+  return copy;
+}
+
+struct Operator *operator_scan(struct Database *db, struct TableMeta *table,
+                               bool *columns) {
+  struct Table *data = table_open(db, table);
+  if (data == NULL) // unable to open, msg already output
+    return NULL;
+
+  struct Operator *op = operator_create(OP_SCAN, NULL, table->numColumns);
+
+  for (int i = 0; i < table->numColumns; i++) {
+    op->columns[i].tableName = table->name;
+    op->columns[i].colName = table->columns[i].name;
+    op->columns[i].function = NO_FUNCTION;
+    op->columns[i].colType = table->columns[i].colType;
+  }
+
+  struct ScanState *scan =
+      (struct ScanState *)arena_alloc(sizeof(struct ScanState));
+
+  scan->table = data;
+  scan->columns = copyColumns(table, columns);
+  scan->firstRecord = 0;
+  scan->recordNum = 0;
+  scan->lastRecord = data->numRecords;
+  scan->batch = NULL;
+  scan->selection = NULL;
+  scan->zones = NULL;
+  scan->zonesSkipped = 0;
+  scan->recordsSkipped = 0;
+
+  op->estimatedRows = data->numRecords;
+
+  op->state = scan;
+  op->next = scan_next;
+  op->destroy = scan_destroy;
+  op->explain = scan_explain;
+
+  return op;
+}
+
+//
+// operator_scanPartition
+//
+void operator_scanPartition(struct Operator *op, int partition,
+                            int numPartitions) {
+  assert(op->opType == OP_SCAN);
+  assert(partition >= 0 && partition < numPartitions);
+
+  struct ScanState *scan = (struct ScanState *)op->state;
+  long long N = scan->table->numRecords;
+
+  // records are fixed-width, so a partition is simply a range of them
+  scan->firstRecord = (int)((N * partition) / numPartitions);
+  scan->recordNum = scan->firstRecord;
+  scan->lastRecord = (int)((N * (partition + 1)) / numPartitions);
+
+  op->estimatedRows = scan->lastRecord - scan->recordNum;
+}
+
+//
+// operator_scanZones
+//
+void operator_scanZones(struct Operator *op, struct Database *db,
+                        struct EXPR *expr) {
+  assert(op->opType == OP_SCAN);
+  assert(zonemap_supports(expr->operator));
+
+  struct ScanState *scan = (struct ScanState *)op->state;
+  int column = operator_findColumn(op, expr->column->table, expr->column->name);
+  assert(column >= 0);
+
+  scan->zones = zonemap_open(db, scan->table, column);
+  scan->zoneOperator = expr->operator;
+  scan->zoneValue = expr->value;
+  scan->zoneEnd = 0;
+}
+
+//
+// select scan
+//
+// selectScan_batch
+//
+// Evaluates the where clause on the next batch of records, filling
+// in the selection.
+//
+static void selectScan_batch(struct ScanState *scan) {
+  int count = scan->lastRecord - scan->recordNum;
+  if (count > VECTOR_BATCH_SIZE)
+    count = VECTOR_BATCH_SIZE;
+
+  // a batch stops at the end of a block, which may be skipped
+  if (scan->zones != NULL && scan->recordNum + count > scan->zoneEnd)
+    count = scan->zoneEnd - scan->recordNum;
+
+  void *values = table_column(scan->table, scan->whereColumn, scan->recordNum,
+                              count, scan->batch);
+
+  int colType = scan->table->meta->columns[scan->whereColumn].colType;
+
+  if (colType == COL_TYPE_INT)
+    scan->numSelected = vector_selectInts((int *)values, count, scan->operator,
+                                          scan->i, scan->selection);
+  else if (colType == COL_TYPE_REAL)
+    scan->numSelected = vector_selectReals(
+        (double *)values, count, scan->operator, scan->r, scan->selection);
+  else // the codes of a dictionary-encoded string column
+    scan->numSelected = vector_selectInts(
+        (int *)values, count, scan->codeOperator, scan->i, scan->selection);
+
+  scan->batchStart = scan->recordNum;
+  scan->recordNum += count;
+  scan->nextSelected = 0;
+}
+
+static struct Tuple *selectScan_next(struct Operator *op) {
+  struct ScanState *scan = (struct ScanState *)op->state;
+
+  int recordNum;
+
+  do {
+    while (scan->nextSelected >= scan->numSelected) {
+      if (scan->zones != NULL)
+        skipZones(scan);
+
+      if (scan->recordNum >= scan->lastRecord)
+        return NULL;
+
+      selectScan_batch(scan);
+    }
+
+    // only the records that satisfy the where clause are read in full
+    recordNum = scan->batchStart + scan->selection[scan->nextSelected];
+    scan->nextSelected++;
+  } while (table_deleted(scan->table, recordNum));
+
+  table_read(scan->table, recordNum, scan->columns, op->tuple.values);
+
+  return &op->tuple;
+}
+
+//
+// codeComparison
+//
+// Rewrites "string operator literal", for a dictionary-encoded column,
+// as "code operator' code'", storing them in *codeOperator and *code.
+// The codes are in the strings' order (see table_codes), so this is
+// possible unless = or <> would have to match more than one code.
+//
+static bool codeComparison(struct Table *table, int column, int operator,
+                           char *literal, int *codeOperator, int *code) {
+  int first, last;
+
+  table_codes(table, column, literal, &first, &last);
+
+  switch (operator) {
+  case EXPR_LT:
+    *codeOperator = EXPR_LT;
+    *code = first;
+    return true;
+  case EXPR_LTE:
+    *codeOperator = EXPR_LT;
+    *code = last;
+    return true;
+  case EXPR_GT:
+    *codeOperator = EXPR_GTE;
+    *code = last;
+    return true;
+  case EXPR_GTE:
+    *codeOperator = EXPR_GTE;
+    *code = first;
+    return true;
+  case EXPR_EQUAL: // no code is < 0, every code is >= 0
+    *codeOperator = (first == last) ? EXPR_LT : EXPR_EQUAL;
+    *code = (first == last) ? 0 : first;
+    return last - first <= 1;
+  case EXPR_NOT_EQUAL:
+    *codeOperator = (first == last) ? EXPR_GTE : EXPR_NOT_EQUAL;
+    *code = (first == last) ? 0 : first;
+    return last - first <= 1;
+  }
+
+  return false;
+}
+
+bool operator_scanSelect(struct Operator *op, struct EXPR *expr) {
+  assert(op->opType == OP_SCAN);
+  assert(vector_supports(expr->operator));
+
+  struct ScanState *scan = (struct ScanState *)op->state;
+  int column = operator_findColumn(op, expr->column->table, expr->column->name);
+  assert(column >= 0);
+
+  if (op->columns[column].colType == COL_TYPE_STRING &&
+      (!table_encoded(scan->table, column) ||
+       !codeComparison(scan->table, column, expr->operator, expr->value,
+                       &scan->codeOperator, &scan->i)))
+    return false;
+
+  // converting the literal once, as the filter does
+  scan->whereColumn = column;
+  scan->operator = expr->operator;
+  scan->value = expr->value;
+
+  if (op->columns[column].colType != COL_TYPE_STRING) {
+    scan->i = atoi(expr->value);
+    scan->r = atof(expr->value);
+  }
+
+  scan->batch = arena_alloc(sizeof(double) * VECTOR_BATCH_SIZE);
+  scan->selection = (int *)arena_alloc(sizeof(int) * VECTOR_BATCH_SIZE);
+
+  scan->batchStart = 0;
+  scan->numSelected = 0;
+  scan->nextSelected = 0;
+
+  op->next = selectScan_next;
+
+  return true;
+}
+
+//
+// index scan
+//
+static struct Tuple *indexScan_next(struct Operator *op) {
+  struct IndexScanState *scan = (struct IndexScanState *)op->state;
+
+  if (scan->next >= scan->numRecords)
+    return NULL;
+
+  table_read(scan->table, scan->recordNums[scan->next], scan->columns,
+             op->tuple.values);
+  scan->next++;
+
+  return &op->tuple;
+}
+
+static void indexScan_destroy(struct Operator *op) {
+  struct IndexScanState *scan = (struct IndexScanState *)op->state;
+
+  index_close(scan->index);
+  table_close(scan->table);
+}
+
+static void indexScan_explain(struct Operator *op, struct OpExplain *info) {
+  struct IndexScanState *scan = (struct IndexScanState *)op->state;
+
+  operator_appendDetail(info, "%s", scan->table->meta->name);
+  appendColumns(info, scan->table, scan->columns);
+  operator_appendDetail(info, " WHERE ");
+  appendWhere(info, &op->columns[scan->index->column], scan->operator,
+              scan->value);
+  operator_appendDetail(info, ", index on %s",
+                        scan->table->meta->columns[scan->index->column].name);
+
+  // the matching entries of the index, and then their records
+  info->rowsIn = scan->numRecords;
+  info->bytesRead = scan->table->bytesRead +
+                    (long long)scan->numRecords * sizeof(struct IndexEntry);
+}
+
+static int compareRecordNums(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+struct Operator *operator_indexScan(struct Database *db,
+                                    struct TableMeta *table,
+                                    struct EXPR *expr, bool *columns) {
+  struct Table *data = table_open(db, table);
+  if (data == NULL) // unable to open, msg already output
+    return NULL;
+
+  struct Operator *op = operator_create(OP_INDEX_SCAN, NULL, table->numColumns);
+
+  int column = -1;
+  for (int i = 0; i < table->numColumns; i++) {
+    op->columns[i].tableName = table->name;
+    op->columns[i].colName = table->columns[i].name;
+    op->columns[i].function = NO_FUNCTION;
+    op->columns[i].colType = table->columns[i].colType;
+
+    if (strcasecmp(table->columns[i].name, expr->column->name) == 0)
+      column = i;
+  }
+  assert(column >= 0);
+
+  struct IndexScanState *scan =
+      (struct IndexScanState *)arena_alloc(sizeof(struct IndexScanState));
+
+  scan->table = data;
+  scan->columns = copyColumns(table, columns);
+  scan->index = index_open(db, data, column);
+  scan->operator = expr->operator;
+  scan->value = expr->value;
+  scan->next = 0;
+
+  int first = 0;
+  int last = 0;
+  index_lookup(scan->index, expr->operator, expr->value, &first, &last);
+
+  // the matching entries are in key order; we return the records in
+  // the order they appear in the file, the same as a full scan would
+  scan->numRecords = 0;
+  scan->recordNums = (int *)arena_alloc(sizeof(int) * (last - first + 1));
+
+  // an index keeps the entries of deleted records, see modify.h
+  for (int i = first; i < last; i++) {
+    int recordNum = scan->index->entries[i].recordNum;
+
+    if (!table_deleted(data, recordNum))
+      scan->recordNums[scan->numRecords++] = recordNum;
+  }
+
+  qsort(scan->recordNums, scan->numRecords, sizeof(int), compareRecordNums);
+
+  op->estimatedRows = scan->numRecords;
+
+  op->state = scan;
+  op->next = indexScan_next;
+  op->destroy = indexScan_destroy;
+  op->explain = indexScan_explain;
+
+  return op;
+}
+
+//
+// filter
+//
+static struct Tuple *filter_next(struct Operator *op) {
+  struct FilterState *filter = (struct FilterState *)op->state;
+
+  while (true) {
+    struct Tuple *tuple = operator_next(op->child);
+    if (tuple == NULL)
+      return NULL;
+
+    if (filter->kernel(&tuple->values[filter->index], &filter->literal))
+      return tuple;
+  }
+}
+
+static void filter_explain(struct Operator *op, struct OpExplain *info) {
+  struct FilterState *filter = (struct FilterState *)op->state;
+
+  appendWhere(info, &op->columns[filter->index], filter->operator,
+              filter->value);
+}
+
+struct Operator *operator_filter(struct Operator *child, struct EXPR *expr) {
+  struct Operator *op = operator_create(OP_FILTER, child, child->numColumns);
+
+  memcpy(op->columns, child->columns,
+         sizeof(struct OpColumn) * child->numColumns);
+
+  struct FilterState *filter =
+      (struct FilterState *)arena_alloc(sizeof(struct FilterState));
+
+  filter->index =
+      operator_findColumn(child, expr->column->table, expr->column->name);
+  assert(filter->index >= 0);
+
+  // converting the literal and choosing the kernel once, rather than
+  // once per tuple (see kernel.h)
+  int colType = child->columns[filter->index].colType;
+
+  filter->operator = expr->operator;
+  filter->value = expr->value;
+  kernel_literal(expr->value, colType, &filter->literal);
+  filter->kernel = kernel_compare(colType, expr->operator);
+
+  op->state = filter;
+  op->next = filter_next;
+  op->explain = filter_explain;
+
+  return op;
+}
+
+//
+// project
+//
+static struct Tuple *project_next(struct Operator *op) {
+  struct ProjectState *project = (struct ProjectState *)op->state;
+
+  struct Tuple *tuple = operator_next(op->child);
+  if (tuple == NULL)
+    return NULL;
+
+  for (int i = 0; i < op->numColumns; i++)
+    op->tuple.values[i] = tuple->values[project->indices[i]];
+
+  return &op->tuple;
+}
+
+// the projection of every column of child, in order, passes the
+// child's tuples through as they are
+static struct Tuple *project_passNext(struct Operator *op) {
+  return operator_next(op->child);
+}
+
+static void project_explain(struct Operator *op, struct OpExplain *info) {
+  for (int i = 0; i < op->numColumns; i++)
+    operator_appendDetail(info, "%s%s.%s", (i > 0) ? ", " : "",
+                          op->columns[i].tableName, op->columns[i].colName);
+}
+
+struct Operator *operator_project(struct Operator *child,
+                                  struct COLUMN *columns) {
+  int numColumns = 0;
+  for (struct COLUMN *column = columns; column != NULL; column = column->next)
+    numColumns++;
+
+  struct Operator *op = operator_create(OP_PROJECT, child, numColumns);
+
+  struct ProjectState *project =
+      (struct ProjectState *)arena_alloc(sizeof(struct ProjectState));
+  project->indices = (int *)arena_alloc(sizeof(int) * (numColumns + 1));
+
+  int i = 0;
+  for (struct COLUMN *column = columns; column != NULL;
+       column = column->next, i++) {
+    int index = operator_findColumn(child, column->table, column->name);
+    assert(index >= 0);
+
+    project->indices[i] = index;
+    op->columns[i] = child->columns[index];
+  }
+
+  bool identity = (numColumns == child->numColumns);
+
+  for (i = 0; identity && i < numColumns; i++)
+    identity = (project->indices[i] == i);
+
+  op->state = project;
+  op->next = identity ? project_passNext : project_next;
+  op->explain = project_explain;
+
+  return op;
+}
+
+//
+// limit
+//
+static struct Tuple *limit_next(struct Operator *op) {
+  struct LimitState *limit = (struct LimitState *)op->state;
+
+  // once the limit is reached we stop pulling, so the rest of the
+  // input is never read
+  if (limit->count >= limit->N)
+    return NULL;
+
+  struct Tuple *tuple = operator_next(op->child);
+  if (tuple == NULL)
+    return NULL;
+
+  limit->count++;
+  return tuple;
+}
+
+static void limit_explain(struct Operator *op, struct OpExplain *info) {
+  struct LimitState *limit = (struct LimitState *)op->state;
+
+  operator_appendDetail(info, "%d", limit->N);
+}
+
+struct Operator *operator_limit(struct Operator *child, int N) {
+  struct Operator *op = operator_create(OP_LIMIT, child, child->numColumns);
+
+  memcpy(op->columns, child->columns,
+         sizeof(struct OpColumn) * child->numColumns);
+
+  struct LimitState *limit =
+      (struct LimitState *)arena_alloc(sizeof(struct LimitState));
+
+  limit->N = N;
+  limit->count = 0;
+
+  if (N < op->estimatedRows)
+    op->estimatedRows = N;
+
+  op->state = limit;
+  op->next = limit_next;
+  op->explain = limit_explain;
+
+  return op;
+}
+
+//
+// operator_findColumn
+//
+int operator_findColumn(struct Operator *op, char *tableName,
+                        char *columnName) {
+  for (int i = 0; i < op->numColumns; i++) {
+    if (tableName != NULL &&
+        strcasecmp(op->columns[i].tableName, tableName) != 0)
+      continue;
+    if (strcasecmp(op->columns[i].colName, columnName) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+//
+// operator_compareString
+//
+int operator_compareString(char *s1, int length1, char *s2, int length2) {
+  int n = (length1 < length2) ? length1 : length2;
+  int cmp = strncasecmp(s1, s2, n);
+
+  if (cmp != 0)
+    return cmp;
+
+  return length1 - length2;
+}
+
+//
+// operator_hashValue
+//
+unsigned int operator_hashValue(struct TupleValue *value) {
+  unsigned int hash = 2166136261u; // FNV-1a
+
+  if (value->valueType == COL_TYPE_STRING) {
+    for (int i = 0; i < value->length; i++) {
+      hash ^= (unsigned char)tolower((unsigned char)value->value.s[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  // ints and reals that are equal must hash the same, so hash
+  // everything as a real (with -0.0 the same as 0.0)
+  double r = (value->valueType == COL_TYPE_INT) ? value->value.i
+                                                 : value->value.r;
+  if (r == 0.0)
+    r = 0.0;
+
+  unsigned char bytes[sizeof(double)];
+  memcpy(bytes, &r, sizeof(double));
+
+  for (size_t i = 0; i < sizeof(double); i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+//
+// operator_equalValues
+//
+bool operator_equalValues(struct TupleValue *v1, struct TupleValue *v2) {
+  if (v1->valueType == COL_TYPE_STRING || v2->valueType == COL_TYPE_STRING) {
+    if (v1->valueType != v2->valueType)
+      return false;
+    return operator_compareString(v1->value.s, v1->length, v2->value.s,
+                                  v2->length) == 0;
+  }
+
+  if (v1->valueType == COL_TYPE_INT && v2->valueType == COL_TYPE_INT)
+    return v1->value.i == v2->value.i;
+
+  double r1 = (v1->valueType == COL_TYPE_INT) ? v1->value.i : v1->value.r;
+  double r2 = (v2->valueType == COL_TYPE_INT) ? v2->value.i : v2->value.r;
+
+  return r1 == r2;
+}
+
+//
+// operator_compareValues
+//
+int operator_compareValues(struct TupleValue *v1, struct TupleValue *v2) {
+  if (v1->valueType == COL_TYPE_STRING)
+    return operator_compareString(v1->value.s, v1->length, v2->value.s,
+                                  v2->length);
+
+  double r1 = (v1->valueType == COL_TYPE_INT) ? v1->value.i : v1->value.r;
+  double r2 = (v2->valueType == COL_TYPE_INT) ? v2->value.i : v2->value.r;
+
+  return (r1 > r2) - (r1 < r2);
+}
+
+//
+// operator_copyString
+//
+char *operator_copyString(struct TupleValue *value, char *buffer) {
+  memcpy(buffer, value->value.s, value->length);
+  buffer[value->length] = '\0';
+
+  return buffer;
+}
+
+//
+// operator_analyze
+//
+void operator_analyze(bool analyze) { analyzing = analyze; }
+
+//
+// explainOperator
+//
+// Outputs the line for op, indented by depth, and then its inputs.
+//
+static void explainOperator(struct Operator *op, FILE *output, bool analyze,
+                            int depth) {
+  static char *names[] = {"Scan",  "Index Scan", "Filter",    "Project",
+                          "Limit", "Hash Join",  "Aggregate", "Sort"};
+
+  struct OpExplain info;
+
+  info.detail[0] = '\0';
+  info.rowsIn = -1;
+  info.bytesRead = 0;
+  info.memory = 0;
+
+  if (op->explain != NULL)
+    op->explain(op, &info);
+
+  fprintf(output, "%*s-> %s%s%s (~%d rows)\n", 2 * depth, "",
+          names[op->opType], (info.detail[0] != '\0') ? ": " : "",
+          info.detail, op->estimatedRows);
+
+  if (analyze && op->stats != NULL) {
+    if (info.rowsIn < 0) {
+      info.rowsIn = 0;
+      if (op->child != NULL && op->child->stats != NULL)
+        info.rowsIn += op->child->stats->rows;
+      if (op->right != NULL && op->right->stats != NULL)
+        info.rowsIn += op->right->stats->rows;
+    }
+
+    fprintf(output,
+            "%*s   actual: %lld rows in, %lld rows out, %.3f ms, "
+            "%lld bytes read, %lld bytes of memory\n",
+            2 * depth, "", info.rowsIn, op->stats->rows,
+            op->stats->nanos / 1e6, info.bytesRead, info.memory);
+  }
+
+  if (op->child != NULL)
+    explainOperator(op->child, output, analyze, depth + 1);
+  if (op->right != NULL)
+    explainOperator(op->right, output, analyze, depth + 1);
+}
+
+//
+// operator_explain
+//
+void operator_explain(struct Operator *op, FILE *output, bool analyze) {
+  explainOperator(op, output, analyze, 0);
+}
+
+//
+// timedNext
+//
+// operator_next() for an operator being analyzed.
+//
+static struct Tuple *timedNext(struct Operator *op) {
+  struct timespec start, stop;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  struct Tuple *tuple = op->next(op);
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  op->stats->nanos += (stop.tv_sec - start.tv_sec) * 1000000000LL +
+                      (stop.tv_nsec - start.tv_nsec);
+  if (tuple != NULL)
+    op->stats->rows++;
+
+  return tuple;
+}
+
+//
+// operator_next
+//
+struct Tuple *operator_next(struct Operator *op) {
+  if (op->stats != NULL)
+    return timedNext(op);
+
+  return op->next(op);
+}
+
+//
+// operator_destroy
+//
+void operator_destroy(struct Operator *op) {
+  if (op == NULL)
+    return;
+
+  operator_destroy(op->child);
+  operator_destroy(op->right);
+
+  // the operator and its state are in the query's arena, only the
+  // resources the state holds (e.g. an open table) need releasing
+  if (op->destroy != NULL)
+    op->destroy(op);
+}
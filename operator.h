@@ -0,0 +1,418 @@
+/*operator.h*/
+
+//
+// Project: Query operators for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+
+#include "ast.h"
+#include "database.h"
+
+//
+// A query is executed as a pipeline of operators, e.g.
+//
+//   scan -> filter -> project -> limit
+//
+// where each operator pulls tuples from its child one at a time
+// via operator_next(). This way only the rows that survive the
+// pipeline (and only the columns that are requested) are ever
+// stored in the result set, and an operator such as LIMIT can
+// stop the pipeline early without reading the rest of the table.
+//
+
+//
+// This is one value in a tuple. Like a value in the result set,
+// we have 3 types of values: int, real, or string. Strings are
+// NOT owned by the tuple and are NOT null-terminated: they are a
+// (pointer, length) view into the table's data (see table.h), and
+// are only copied once a row reaches the result set. Since a table
+// stays mapped until the scan reading it is destroyed, an operator
+// may keep string values (e.g. in a hash table) for as long as the
+// pipeline exists.
+//
+struct TupleValue {
+  union {
+    int i;
+    double r;
+    char *s;
+  } value;
+
+  int length;    // # of chars in value.s (strings only)
+  int valueType; // enum ColumnType (database.h)
+};
+
+//
+// A tuple is one row flowing through the pipeline. A tuple returned
+// by operator_next() is only valid until the next call to
+// operator_next() on the same operator; copy the values (e.g. via
+// operator_copyString) to keep them.
+//
+struct Tuple {
+  struct TupleValue *values; // ARRAY of values, one per output column
+  int numValues;
+};
+
+//
+// Describes one column of an operator's output. The names are
+// borrowed from the database schema or the AST, not copied.
+//
+struct OpColumn {
+  char *tableName; // table name
+  char *colName;   // column name
+  int function;    // enum AST_COLUMN_FUNCTIONS (ast.h) applied, if any
+  int colType;     // enum ColumnType (database.h)
+};
+
+enum OperatorTypes {
+  OP_SCAN = 0,
+  OP_INDEX_SCAN,
+  OP_FILTER,
+  OP_PROJECT,
+  OP_LIMIT,
+  OP_HASH_JOIN,
+  OP_AGGREGATE,
+  OP_SORT
+};
+
+//
+// For EXPLAIN, an operator describes itself by filling in one of
+// these (see operator_explain):
+//
+#define OPERATOR_MAX_DETAIL 512
+
+struct OpExplain {
+  char detail[OPERATOR_MAX_DETAIL]; // e.g. "Movies WHERE Year > 2005"
+  long long rowsIn;    // # of input tuples, -1 => what the inputs output
+  long long bytesRead; // # of bytes of table and index files read
+  long long memory;    // # of bytes held by the operator's state
+};
+
+//
+// Under EXPLAIN ANALYZE, each operator also counts the tuples it
+// outputs, and the time spent producing them --- including the time
+// spent in its inputs:
+//
+struct OpStats {
+  long long rows;  // # of tuples output
+  long long nanos; // time spent in operator_next()
+};
+
+struct Operator {
+  int opType; // enum OperatorTypes
+
+  struct OpColumn *columns; // ARRAY describing the output columns
+  int numColumns;
+
+  struct Operator *child; // input operator, NULL for a scan
+  struct Operator *right; // second input operator (joins only), or NULL
+  struct Tuple tuple;     // output tuple returned by operator_next()
+  void *state;            // operator-specific state
+
+  int estimatedRows; // estimate of the # of output tuples
+
+  struct OpStats *stats; // NULL unless analyzing, see operator_analyze()
+
+  struct Tuple *(*next)(struct Operator *op);
+  void (*destroy)(struct Operator *op); // frees operator-specific state
+  void (*explain)(struct Operator *op, struct OpExplain *info); // or NULL
+};
+
+//
+// Functions:
+//
+
+//
+// operator_create
+//
+// Allocates an operator with room for numColumns output columns
+// and an output tuple of the same width; the caller fills in the
+// columns, state, next, destroy and explain. Used to implement
+// operators.
+//
+struct Operator *operator_create(int opType, struct Operator *child,
+                                 int numColumns);
+
+//
+// operator_scan
+//
+// Creates an operator that reads the records of the given table
+// from its data file (or column files, see table.h), one record per
+// call to operator_next(). The files are memory-mapped, and the
+// strings in the output tuples point directly into the mapping. The
+// output columns are the table's columns, in the order given by the
+// meta-data; only the columns i with columns[i] true are read, the
+// others are 0 or "" (pass NULL to read every column).
+//
+// Returns NULL if the data file could not be opened; in this case
+// an error message was output.
+//
+struct Operator *operator_scan(struct Database *db, struct TableMeta *table,
+                               bool *columns);
+
+//
+// operator_scanPartition
+//
+// Restricts a scan (from operator_scan(), and before its first call
+// to operator_next()) to partition # partition (0-based) of
+// numPartitions equal ranges of the table's records. The partitions
+// can be scanned in parallel, one scan per thread.
+//
+void operator_scanPartition(struct Operator *op, int partition,
+                            int numPartitions);
+
+//
+// operator_scanZones
+//
+// Has a scan (from operator_scan(), and before its first call to
+// operator_next()) skip the blocks of records
+// that cannot satisfy the WHERE expression, according to the zone map
+// on the expression's column (see zonemap.h). The other records are
+// output as before, so a plain scan still needs a filter. The operator
+// must be supported by zonemap_supports().
+//
+void operator_scanZones(struct Operator *op, struct Database *db,
+                        struct EXPR *expr);
+
+//
+// operator_scanSelect
+//
+// Turns a scan (from operator_scan(), and before its first call to
+// operator_next()) into a select scan, which outputs only the records
+// satisfying the WHERE expression. The operator must be supported by
+// vector_supports() (see vector.h). The expression is evaluated on a
+// batch of the column's values at a time, producing a selection
+// vector, and only the selected records are read in full. A string
+// column is compared by the codes of its dictionary (see table.h).
+//
+// Returns false, leaving the scan as it was, if the column is a string
+// column that is not dictionary-encoded, or the comparison cannot be
+// made on its codes; the scan then needs a filter.
+//
+bool operator_scanSelect(struct Operator *op, struct EXPR *expr);
+
+//
+// operator_indexScan
+//
+// Creates an operator that outputs the records of the given table
+// that satisfy the WHERE expression, found via the index on the
+// expression's column (see index.h) rather than a full scan. The
+// records are output in the order they appear in the data file.
+// The column must be indexed, and the operator must be supported
+// by the index (see index_supports()). The columns to read are given
+// as for operator_scan().
+//
+// Returns NULL if the data file could not be opened; in this case
+// an error message was output.
+//
+struct Operator *operator_indexScan(struct Database *db,
+                                    struct TableMeta *table,
+                                    struct EXPR *expr, bool *columns);
+
+//
+// operator_filter
+//
+// Creates an operator that passes through only those tuples of
+// child that satisfy the given WHERE expression. The literal in
+// the expression is converted once, when the filter is created.
+//
+struct Operator *operator_filter(struct Operator *child, struct EXPR *expr);
+
+//
+// operator_predicate
+//
+// Creates an operator that passes through only those tuples of child
+// that satisfy all N of the given predicates, e.g. the conjuncts of a
+// compound where clause that refer to child's columns. The predicates
+// are compiled once, when the operator is created, and checked in one
+// pass per tuple (see predicate.h).
+//
+struct Operator *operator_predicate(struct Operator *child,
+                                    struct PRED **preds, int N);
+
+//
+// operator_project
+//
+// Creates an operator that outputs the given linked-list of columns,
+// in order, taken from each tuple of child. A column may appear more
+// than once. No functions are applied here: a query with functions
+// (or a group by clause) is aggregated instead, see operator_aggregate().
+// If the columns are exactly child's, in order, child's tuples are
+// passed through as they are, without being copied.
+//
+struct Operator *operator_project(struct Operator *child,
+                                  struct COLUMN *columns);
+
+//
+// operator_limit
+//
+// Creates an operator that outputs at most N tuples of child; once
+// N tuples have been returned, child is no longer pulled from.
+//
+struct Operator *operator_limit(struct Operator *child, int N);
+
+//
+// operator_hashJoin
+//
+// Creates an operator that performs an inner join of left and right,
+// outputting each pair of tuples where the value of column leftKey
+// (0-based) in left equals the value of column rightKey in right.
+// The output columns are the columns of left followed by those of
+// right. A hash table is built on the input with the smaller
+// estimatedRows, and the other input is streamed against it.
+//
+struct Operator *operator_hashJoin(struct Operator *left,
+                                   struct Operator *right, int leftKey,
+                                   int rightKey);
+
+//
+// operator_aggregate
+//
+// Creates an operator that groups the tuples of child on the given
+// linked-list of groupby columns (pass NULL for a single group of all
+// tuples), and outputs one tuple per group with the given linked-list
+// of columns: a column with a function (MIN, MAX, SUM, AVG or COUNT)
+// outputs the function applied to the group, a column without one
+// outputs its value in the group's first tuple.
+//
+// This is a single-pass hash aggregation, so memory is proportional to
+// the # of groups rather than the # of tuples. Groups are output in the
+// order they are first seen. Without groupby columns, exactly one
+// tuple is output, even if child has no tuples.
+//
+struct Operator *operator_aggregate(struct Operator *child,
+                                    struct COLUMN *columns,
+                                    struct COLUMN *groupby);
+
+//
+// operator_parallelAggregate
+//
+// Same as operator_aggregate(), except the input comes from the given
+// array of numPartitions operators (e.g. scans of each partition of a
+// table, see operator_scanPartition()), which must all output the same
+// columns. Each partition is aggregated on its own thread, and the
+// partial groups are merged once all threads are done. Groups are
+// output in the order they are first seen in partitions[0], then
+// partitions[1], and so on.
+//
+// The aggregate takes over the partitions: partitions[0] becomes its
+// child, and the others are destroyed along with it.
+//
+struct Operator *operator_parallelAggregate(struct Operator **partitions,
+                                            int numPartitions,
+                                            struct COLUMN *columns,
+                                            struct COLUMN *groupby);
+
+//
+// operator_sort
+//
+// Creates an operator that outputs the tuples of child sorted on
+// column key (0-based), ascending or descending; tuples with equal
+// keys keep their order. Pass N >= 0 to output only the first N
+// tuples (as for ORDER BY ... LIMIT N), in which case only the best N
+// tuples are ever kept, in a heap; pass -1 for no limit.
+//
+// At most memoryBudget bytes of tuples are sorted in memory; beyond
+// that, sorted runs are spilled to temporary files and merged. The
+// strings of a tuple that comes from a spilled run are only valid
+// until the next call to operator_next().
+//
+struct Operator *operator_sort(struct Operator *child, int key, bool ascending,
+                               int N, long memoryBudget);
+
+//
+// operator_findColumn
+//
+// Searches the output columns of op for the given table and column
+// name --- case-insensitive. Returns the 0-based index if found, and
+// -1 if not found.
+//
+int operator_findColumn(struct Operator *op, char *tableName,
+                        char *columnName);
+
+//
+// operator_compareString
+//
+// Case-insensitive comparison of two strings that are not necessarily
+// null-terminated, given as (pointer, length). Like strcasecmp, returns
+// < 0, 0, or > 0.
+//
+int operator_compareString(char *s1, int length1, char *s2, int length2);
+
+//
+// operator_hashValue
+//
+// Returns a hash of the given value, such that values which are
+// equal according to operator_equalValues() hash the same.
+//
+unsigned int operator_hashValue(struct TupleValue *value);
+
+//
+// operator_equalValues
+//
+// Returns true if the two values are equal: ints and reals compare
+// numerically, strings compare case-insensitively.
+//
+bool operator_equalValues(struct TupleValue *v1, struct TupleValue *v2);
+
+//
+// operator_compareValues
+//
+// Compares two values of the same type: ints and reals compare
+// numerically, strings compare case-insensitively. Returns < 0, 0,
+// or > 0.
+//
+int operator_compareValues(struct TupleValue *v1, struct TupleValue *v2);
+
+//
+// operator_copyString
+//
+// Copies the string value into buffer, which must have room for
+// value->length + 1 chars, and null-terminates it. Returns buffer.
+//
+char *operator_copyString(struct TupleValue *value, char *buffer);
+
+//
+// operator_analyze
+//
+// With true, every operator the calling thread creates from now on
+// keeps OpStats, until called again with false.
+//
+void operator_analyze(bool analyze);
+
+//
+// operator_explain
+//
+// Outputs the plan rooted at op, one line per operator, indented
+// under its parent. With analyze, each line also gives the operator's
+// OpStats, so the operators must have been created while analyzing
+// and the plan must have been run.
+//
+void operator_explain(struct Operator *op, FILE *output, bool analyze);
+
+//
+// operator_appendDetail
+//
+// Appends printf-style text to info->detail, as much as fits. Used
+// by the operators' explain functions.
+//
+void operator_appendDetail(struct OpExplain *info, char *format, ...);
+
+//
+// operator_next
+//
+// Returns the next tuple of op, or NULL if there are no more tuples.
+//
+struct Tuple *operator_next(struct Operator *op);
+
+//
+// operator_destroy
+//
+// Frees the memory associated with op and (recursively) its child.
+//
+void operator_destroy(struct Operator *op);
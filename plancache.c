@@ -0,0 +1,157 @@
+/*plancache.c*/
+
+//
+// Project: Plan cache for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyzer.h"
+#include "plancache.h"
+#include "util.h"
+
+//
+// hashShape
+//
+// FNV-1a hash of the shape.
+//
+static unsigned int hashShape(char *shape) {
+  unsigned int hash = 2166136261u;
+
+  for (char *cp = shape; *cp != '\0'; cp++) {
+    hash ^= (unsigned char)*cp;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+//
+// unlinkEntry
+//
+// Removes the entry from the cache's list.
+//
+static void unlinkEntry(struct PlanCache *cache, struct PlanCacheEntry *e) {
+  if (e->prev != NULL)
+    e->prev->next = e->next;
+  else
+    cache->first = e->next;
+
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  else
+    cache->last = e->prev;
+}
+
+//
+// pushFront
+//
+// Makes the entry the most recently used.
+//
+static void pushFront(struct PlanCache *cache, struct PlanCacheEntry *e) {
+  e->prev = NULL;
+  e->next = cache->first;
+
+  if (cache->first != NULL)
+    cache->first->prev = e;
+  else
+    cache->last = e;
+
+  cache->first = e;
+}
+
+static void freeEntry(struct PlanCacheEntry *e) {
+  analyzer_destroy(e->query);
+  free(e->shape);
+  free(e);
+}
+
+//
+// plancache_create
+//
+struct PlanCache *plancache_create(int capacity) {
+  struct PlanCache *cache =
+      (struct PlanCache *)malloc(sizeof(struct PlanCache));
+  if (cache == NULL)
+    panic("out of memory");
+
+  cache->first = NULL;
+  cache->last = NULL;
+  cache->numEntries = 0;
+  cache->capacity = capacity;
+  cache->hits = 0;
+  cache->misses = 0;
+
+  return cache;
+}
+
+//
+// plancache_lookup
+//
+struct QUERY *plancache_lookup(struct PlanCache *cache, char *shape) {
+  unsigned int hash = hashShape(shape);
+
+  for (struct PlanCacheEntry *e = cache->first; e != NULL; e = e->next) {
+    if (e->hash == hash && strcmp(e->shape, shape) == 0) {
+      unlinkEntry(cache, e);
+      pushFront(cache, e);
+      cache->hits++;
+      return e->query;
+    }
+  }
+
+  cache->misses++;
+  return NULL;
+}
+
+//
+// plancache_insert
+//
+void plancache_insert(struct PlanCache *cache, char *shape,
+                      struct QUERY *query) {
+  if (cache->capacity < 1) {
+    analyzer_destroy(query);
+    return;
+  }
+
+  if (cache->numEntries == cache->capacity) {
+    struct PlanCacheEntry *victim = cache->last;
+
+    unlinkEntry(cache, victim);
+    freeEntry(victim);
+    cache->numEntries--;
+  }
+
+  struct PlanCacheEntry *e =
+      (struct PlanCacheEntry *)malloc(sizeof(struct PlanCacheEntry));
+  if (e == NULL)
+    panic("out of memory");
+
+  e->shape = dupString(shape);
+  e->hash = hashShape(shape);
+  e->query = query;
+
+  pushFront(cache, e);
+  cache->numEntries++;
+}
+
+//
+// plancache_destroy
+//
+void plancache_destroy(struct PlanCache *cache) {
+  if (cache == NULL)
+    return;
+
+  struct PlanCacheEntry *e = cache->first;
+
+  while (e != NULL) {
+    struct PlanCacheEntry *next = e->next;
+    freeEntry(e);
+    e = next;
+  }
+
+  free(cache);
+}
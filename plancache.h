@@ -0,0 +1,80 @@
+/*plancache.h*/
+
+//
+// Project: Plan cache for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include "ast.h"
+
+//
+// Parsing and analyzing a statement builds its AST from scratch. A
+// workload that repeats a handful of statements with different
+// literals keeps rebuilding the same ASTs, so each session caches
+// the ASTs it has built, keyed by the shape of the statement (see
+// rewrite.h). A statement whose shape is in the cache skips the
+// scanner, parser and analyzer: the cached AST is reused, with the
+// statement's literals bound into it.
+//
+// The cache holds at most PLANCACHE_SIZE ASTs; when full, the least
+// recently used one is destroyed to make room.
+//
+#define PLANCACHE_SIZE 64
+
+struct PlanCacheEntry {
+  char *shape;
+  unsigned int hash; // of shape, checked before comparing shapes
+  struct QUERY *query;
+  struct PlanCacheEntry *prev; // toward the most recently used
+  struct PlanCacheEntry *next; // toward the least recently used
+};
+
+struct PlanCache {
+  struct PlanCacheEntry *first; // the most recently used
+  struct PlanCacheEntry *last;  // the least recently used
+  int numEntries;
+  int capacity;
+
+  long hits;   // # of lookups that found an AST
+  long misses; // # of lookups that did not
+};
+
+//
+// Functions:
+//
+
+//
+// plancache_create
+//
+// Creates an empty cache holding at most capacity ASTs.
+//
+struct PlanCache *plancache_create(int capacity);
+
+//
+// plancache_lookup
+//
+// Returns the cached AST for the given shape, making it the most
+// recently used, or NULL if there is none. The AST stays owned by
+// the cache.
+//
+struct QUERY *plancache_lookup(struct PlanCache *cache, char *shape);
+
+//
+// plancache_insert
+//
+// Adds the AST for the given shape to the cache, which takes ownership
+// of it (the AST must not have literals or clauses bound to it by a
+// Rewrite, see rewrite_detach).
+//
+void plancache_insert(struct PlanCache *cache, char *shape,
+                      struct QUERY *query);
+
+//
+// plancache_destroy
+//
+// Destroys the cached ASTs and frees the cache.
+//
+void plancache_destroy(struct PlanCache *cache);
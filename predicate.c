@@ -0,0 +1,676 @@
+/*predicate.c*/
+
+//
+// Project: Compound WHERE predicates for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <ctype.h>   // tolower
+#include <math.h>    // log2
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "arena.h"
+#include "kernel.h"
+#include "predicate.h"
+#include "util.h"
+
+//
+// A LIKE pattern, split at its %s: a string matches if it starts
+// with the first part (unless the pattern starts with %), ends with
+// the last part (unless the pattern ends with %), and contains the
+// parts in between, in order and without overlapping. A _ in a part
+// matches any one char. The parts are in lower case, since strings
+// compare case-insensitively.
+//
+struct Like {
+  char **parts; // ARRAY of parts, none empty
+  int *lengths; // ARRAY: # of chars in each part
+  int numParts;
+  bool anchorStart; // true => the pattern does not start with %
+  bool anchorEnd;   // true => the pattern does not end with %
+  bool exact;       // true => the pattern has no %, the one part is all
+};
+
+enum NodeTypes {
+  NODE_COMPARE = 0, // column compared to the literal
+  NODE_LIKE,        // string column LIKE the pattern
+  NODE_IN,          // column IN the sorted values
+  NODE_AND,
+  NODE_OR,
+  NODE_NOT
+};
+
+//
+// A node of the compiled tree. Each node's check function is chosen
+// when it is compiled, for its type of node and --- for a comparison
+// --- its column type and operator (see kernel.h), so checking a tuple
+// never branches on either:
+//
+struct Node {
+  int nodeType;      // enum NodeTypes
+  struct PRED *pred; // what it was compiled from, for EXPLAIN
+  bool (*check)(struct Node *node, struct TupleValue *values);
+
+  int column;                // leaves: position of the column in the tuple
+  int colType;               // leaves: enum ColumnType (database.h)
+  struct TupleValue literal; // NODE_COMPARE: converted to the column type
+  Kernel kernel;             // NODE_COMPARE: compares the column to it
+  struct Like *like;         // NODE_LIKE
+
+  struct TupleValue *values; // NODE_IN: ARRAY of the values, sorted
+  int numValues;
+  KernelOrder order; // NODE_IN: ordering of the values
+
+  struct Node **children; // AND, OR: ARRAY of operands, in the order checked
+  int numChildren;        // (NOT: the one operand)
+
+  //
+  // for ordering the operands of an AND or OR:
+  //
+  double cost;        // estimated cost of checking the node
+  double selectivity; // estimated fraction of tuples that pass
+  long long checked;  // # of times checked, since the last reordering
+  long long passed;   // # of those that passed
+  int untilReorder;   // AND, OR: # of checks left until reordering
+};
+
+struct Predicate {
+  struct Node *root;
+};
+
+//
+// a node's measured fraction of tuples passing is blended with its
+// estimated selectivity, as if the estimate came from this many
+// checks:
+//
+#define PREDICATE_ESTIMATE_WEIGHT 16
+
+//
+// predicate_conjuncts
+//
+static void addConjuncts(struct PRED *pred, struct PRED **conjuncts, int *N) {
+  if (pred->predType == PRED_AND) {
+    addConjuncts(pred->left, conjuncts, N);
+    addConjuncts(pred->right, conjuncts, N);
+  } else {
+    if (conjuncts != NULL)
+      conjuncts[*N] = pred;
+    (*N)++;
+  }
+}
+
+struct PRED **predicate_conjuncts(struct PRED *pred, int *N) {
+  *N = 0;
+  addConjuncts(pred, NULL, N); // counting them
+
+  struct PRED **conjuncts =
+      (struct PRED **)arena_alloc(sizeof(struct PRED *) * (*N + 1));
+
+  *N = 0;
+  addConjuncts(pred, conjuncts, N);
+
+  return conjuncts;
+}
+
+//
+// predicate_refersTo
+//
+bool predicate_refersTo(struct PRED *pred, struct TableMeta *meta) {
+  switch (pred->predType) {
+  case PRED_AND:
+  case PRED_OR:
+    return predicate_refersTo(pred->left, meta) &&
+           predicate_refersTo(pred->right, meta);
+  case PRED_NOT:
+    return predicate_refersTo(pred->left, meta);
+  }
+
+  return icmpStrings(pred->expr->column->table, meta->name) == 0;
+}
+
+//
+// compileLike
+//
+// Splits the pattern at its %s, see struct Like.
+//
+static struct Like *compileLike(char *pattern) {
+  struct Like *like = (struct Like *)arena_alloc(sizeof(struct Like));
+  int length = strlen(pattern);
+
+  like->parts = (char **)arena_alloc(sizeof(char *) * (length + 1));
+  like->lengths = (int *)arena_alloc(sizeof(int) * (length + 1));
+  like->numParts = 0;
+  like->anchorStart = (length == 0 || pattern[0] != '%');
+  like->anchorEnd = (length == 0 || pattern[length - 1] != '%');
+  like->exact = (strchr(pattern, '%') == NULL);
+
+  char *lower = arena_dupString(pattern);
+
+  for (int i = 0; i < length; i++)
+    lower[i] = tolower((unsigned char)lower[i]);
+
+  for (int start = 0; start < length;) {
+    int end = start;
+
+    while (end < length && lower[end] != '%')
+      end++;
+
+    if (end > start) {
+      like->parts[like->numParts] = lower + start;
+      like->lengths[like->numParts++] = end - start;
+    }
+
+    start = end + 1;
+  }
+
+  return like;
+}
+
+//
+// matchAt
+//
+// Returns true if the part matches the chars of s it lines up with.
+//
+static bool matchAt(char *s, char *part, int length) {
+  for (int i = 0; i < length; i++) {
+    if (part[i] != '_' && tolower((unsigned char)s[i]) != part[i])
+      return false;
+  }
+
+  return true;
+}
+
+//
+// matchLike
+//
+// Returns true if the string s of the given length matches the
+// pattern.
+//
+static bool matchLike(struct Like *like, char *s, int length) {
+  if (like->exact)
+    return (like->numParts == 0)
+               ? (length == 0)
+               : (length == like->lengths[0] &&
+                  matchAt(s, like->parts[0], length));
+
+  int first = 0;
+  int last = like->numParts; // the parts [first, last) are unanchored
+  int start = 0;
+  int end = length; // the parts must lie within s[start, end)
+
+  if (like->anchorStart) {
+    int n = like->lengths[0];
+
+    if (n > length || !matchAt(s, like->parts[0], n))
+      return false;
+
+    start = n;
+    first++;
+  }
+
+  if (like->anchorEnd) {
+    int n = like->lengths[last - 1];
+
+    if (n > end - start || !matchAt(s + end - n, like->parts[last - 1], n))
+      return false;
+
+    end -= n;
+    last--;
+  }
+
+  // each part as early as possible leaves the most room for the rest
+  for (int p = first; p < last; p++) {
+    int n = like->lengths[p];
+
+    while (start + n <= end && !matchAt(s + start, like->parts[p], n))
+      start++;
+
+    if (start + n > end)
+      return false;
+
+    start += n;
+  }
+
+  return true;
+}
+
+//
+// estimateSelectivity
+//
+// Returns the estimated fraction of tuples that pass a comparison with
+// the given operator.
+//
+static double estimateSelectivity(int operator) {
+  switch (operator) {
+  case EXPR_EQUAL:
+    return 0.05;
+  case EXPR_NOT_EQUAL:
+    return 0.95;
+  case EXPR_LIKE:
+    return 0.25;
+  }
+
+  return 0.33; // a range
+}
+
+//
+// findColumn
+//
+// Returns the position of the column in the tuples, as for
+// operator_findColumn().
+//
+static int findColumn(struct COLUMN *column, struct OpColumn *columns,
+                      int numColumns) {
+  for (int i = 0; i < numColumns; i++) {
+    if (column->table != NULL &&
+        strcasecmp(columns[i].tableName, column->table) != 0)
+      continue;
+    if (strcasecmp(columns[i].colName, column->name) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+//
+// the check functions of the leaves:
+//
+static bool checkCompare(struct Node *node, struct TupleValue *values) {
+  return node->kernel(&values[node->column], &node->literal);
+}
+
+static bool checkLike(struct Node *node, struct TupleValue *values) {
+  struct TupleValue *value = &values[node->column];
+
+  return matchLike(node->like, value->value.s, value->length);
+}
+
+static bool checkIn(struct Node *node, struct TupleValue *values) {
+  return bsearch(&values[node->column], node->values, node->numValues,
+                 sizeof(struct TupleValue), node->order) != NULL;
+}
+
+static struct Node *compileNode(struct PRED *pred, struct OpColumn *columns,
+                                int numColumns);
+
+//
+// compileLeaf
+//
+// Compiles a comparison, LIKE or IN.
+//
+static void compileLeaf(struct Node *node, struct PRED *pred,
+                        struct OpColumn *columns, int numColumns) {
+  struct EXPR *expr = pred->expr;
+
+  node->column = findColumn(expr->column, columns, numColumns);
+  assert(node->column >= 0);
+  node->colType = columns[node->column].colType;
+
+  if (pred->predType == PRED_IN) {
+    node->nodeType = NODE_IN;
+    node->check = checkIn;
+    node->numValues = pred->numValues;
+    node->values = (struct TupleValue *)arena_alloc(
+        sizeof(struct TupleValue) * (pred->numValues + 1));
+    node->order = kernel_order(node->colType);
+
+    for (int v = 0; v < pred->numValues; v++)
+      kernel_literal(pred->values[v], node->colType, &node->values[v]);
+
+    qsort(node->values, node->numValues, sizeof(struct TupleValue),
+          node->order);
+
+    node->cost = 1.0 + log2(node->numValues + 1);
+    node->selectivity = 0.05 * node->numValues;
+    if (node->selectivity > 0.5)
+      node->selectivity = 0.5;
+  } else if (expr->operator == EXPR_LIKE) {
+    node->nodeType = NODE_LIKE;
+    node->check = checkLike;
+    node->like = compileLike(expr->value);
+    node->cost = 4.0 + node->like->numParts;
+    node->selectivity = estimateSelectivity(EXPR_LIKE);
+  } else {
+    node->nodeType = NODE_COMPARE;
+    node->check = checkCompare;
+    kernel_literal(expr->value, node->colType, &node->literal);
+    node->kernel = kernel_compare(node->colType, expr->operator);
+    node->cost = 1.0;
+    node->selectivity = estimateSelectivity(expr->operator);
+  }
+
+  // comparing strings costs more than comparing numbers
+  if (node->colType == COL_TYPE_STRING)
+    node->cost *= 3.0;
+}
+
+//
+// addOperands
+//
+// Compiles the operands of a chain of ANDs (or ORs) into the node's
+// children, flattening the chain.
+//
+static void addOperands(struct Node *node, struct PRED *pred,
+                        struct OpColumn *columns, int numColumns) {
+  if (pred->predType == node->pred->predType) {
+    addOperands(node, pred->left, columns, numColumns);
+    addOperands(node, pred->right, columns, numColumns);
+  } else {
+    node->children[node->numChildren++] =
+        compileNode(pred, columns, numColumns);
+  }
+}
+
+//
+// countOperands
+//
+static int countOperands(struct PRED *pred, int predType) {
+  if (pred->predType != predType)
+    return 1;
+
+  return countOperands(pred->left, predType) +
+         countOperands(pred->right, predType);
+}
+
+//
+// rank
+//
+// Returns the rank of an operand of an AND (and = true) or an OR: the
+// operands are checked in increasing order of rank, i.e. cheapest per
+// tuple it settles first.
+//
+static double rank(struct Node *node, bool and) {
+  double passing =
+      (node->passed + node->selectivity * PREDICATE_ESTIMATE_WEIGHT) /
+      (node->checked + PREDICATE_ESTIMATE_WEIGHT);
+
+  // a false operand settles an AND, a true one an OR
+  double settles = and ? (1.0 - passing) : passing;
+
+  return node->cost / (settles + 1e-6);
+}
+
+//
+// reorder
+//
+// Sorts the operands of an AND or OR by rank; the sort is stable, so
+// operands of equal rank keep their order.
+//
+static void reorder(struct Node *node) {
+  bool and = (node->nodeType == NODE_AND);
+  double ranks[node->numChildren + 1];
+
+  for (int c = 0; c < node->numChildren; c++)
+    ranks[c] = rank(node->children[c], and);
+
+  for (int c = 1; c < node->numChildren; c++) {
+    struct Node *child = node->children[c];
+    double r = ranks[c];
+    int i = c - 1;
+
+    while (i >= 0 && ranks[i] > r) {
+      node->children[i + 1] = node->children[i];
+      ranks[i + 1] = ranks[i];
+      i--;
+    }
+
+    node->children[i + 1] = child;
+    ranks[i + 1] = r;
+  }
+
+  // halving the counts, so the order follows changes in the data
+  for (int c = 0; c < node->numChildren; c++) {
+    node->children[c]->checked /= 2;
+    node->children[c]->passed /= 2;
+  }
+
+  node->untilReorder = PREDICATE_REORDER_INTERVAL;
+}
+
+//
+// checkOperands
+//
+// Checks the operands of an AND (and = true) or an OR, stopping at the
+// first one that settles it, and keeping count of how often each one
+// passes.
+//
+static inline bool checkOperands(struct Node *node, struct TupleValue *values,
+                                 bool and) {
+  bool result = and;
+
+  for (int c = 0; c < node->numChildren; c++) {
+    struct Node *child = node->children[c];
+    bool passed = child->check(child, values);
+
+    child->checked++;
+    child->passed += passed;
+
+    if (passed != and) {
+      result = passed;
+      break;
+    }
+  }
+
+  if (--node->untilReorder == 0)
+    reorder(node);
+
+  return result;
+}
+
+static bool checkAnd(struct Node *node, struct TupleValue *values) {
+  return checkOperands(node, values, true);
+}
+
+static bool checkOr(struct Node *node, struct TupleValue *values) {
+  return checkOperands(node, values, false);
+}
+
+static bool checkNot(struct Node *node, struct TupleValue *values) {
+  struct Node *child = node->children[0];
+
+  return !child->check(child, values);
+}
+
+//
+// compileNode
+//
+static struct Node *compileNode(struct PRED *pred, struct OpColumn *columns,
+                                int numColumns) {
+  struct Node *node = (struct Node *)arena_alloc(sizeof(struct Node));
+
+  memset(node, 0, sizeof(struct Node));
+  node->pred = pred;
+
+  switch (pred->predType) {
+  case PRED_AND:
+  case PRED_OR: {
+    bool and = (pred->predType == PRED_AND);
+    int N = countOperands(pred, pred->predType);
+
+    node->nodeType = and ? NODE_AND : NODE_OR;
+    node->check = and ? checkAnd : checkOr;
+    node->children =
+        (struct Node **)arena_alloc(sizeof(struct Node *) * (N + 1));
+    addOperands(node, pred, columns, numColumns);
+
+    // an AND passes if all operands do, an OR unless none does
+    double all = 1.0, none = 1.0;
+
+    for (int c = 0; c < node->numChildren; c++) {
+      node->cost += node->children[c]->cost;
+      all *= node->children[c]->selectivity;
+      none *= 1.0 - node->children[c]->selectivity;
+    }
+
+    node->selectivity = and ? all : 1.0 - none;
+
+    reorder(node);
+    break;
+  }
+  case PRED_NOT:
+    node->nodeType = NODE_NOT;
+    node->check = checkNot;
+    node->children = (struct Node **)arena_alloc(sizeof(struct Node *));
+    node->children[0] = compileNode(pred->left, columns, numColumns);
+    node->numChildren = 1;
+    node->cost = node->children[0]->cost;
+    node->selectivity = 1.0 - node->children[0]->selectivity;
+    break;
+  default:
+    compileLeaf(node, pred, columns, numColumns);
+  }
+
+  return node;
+}
+
+//
+// predicate_compile
+//
+struct Predicate *predicate_compile(struct PRED **preds, int N,
+                                    struct OpColumn *columns,
+                                    int numColumns) {
+  assert(N > 0);
+
+  struct Predicate *predicate =
+      (struct Predicate *)arena_alloc(sizeof(struct Predicate));
+
+  if (N == 1) {
+    predicate->root = compileNode(preds[0], columns, numColumns);
+    return predicate;
+  }
+
+  // the AND of the predicates
+  struct Node *node = (struct Node *)arena_alloc(sizeof(struct Node));
+
+  memset(node, 0, sizeof(struct Node));
+  node->nodeType = NODE_AND;
+  node->check = checkAnd;
+  node->children = (struct Node **)arena_alloc(sizeof(struct Node *) * N);
+
+  for (int p = 0; p < N; p++) {
+    struct Node *child = compileNode(preds[p], columns, numColumns);
+
+    node->children[node->numChildren++] = child;
+    node->cost += child->cost;
+  }
+
+  reorder(node);
+
+  predicate->root = node;
+  return predicate;
+}
+
+//
+// predicate_check
+//
+bool predicate_check(struct Predicate *predicate, struct TupleValue *values) {
+  struct Node *root = predicate->root;
+
+  return root->check(root, values);
+}
+
+//
+// appendNode
+//
+// Appends the node to info->detail, the operands of an AND or OR in
+// parentheses if they are themselves an AND or OR.
+//
+static void appendNode(struct Node *node, struct OpExplain *info) {
+  static char *operators[] = {"<", "<=", ">", ">=", "=", "<>", "LIKE"};
+
+  if (node->nodeType == NODE_AND || node->nodeType == NODE_OR) {
+    for (int c = 0; c < node->numChildren; c++) {
+      struct Node *child = node->children[c];
+      bool nested =
+          (child->nodeType == NODE_AND || child->nodeType == NODE_OR);
+
+      if (c > 0)
+        operator_appendDetail(info, (node->nodeType == NODE_AND) ? " AND "
+                                                                 : " OR ");
+      operator_appendDetail(info, nested ? "(" : "");
+      appendNode(child, info);
+      operator_appendDetail(info, nested ? ")" : "");
+    }
+    return;
+  }
+
+  if (node->nodeType == NODE_NOT) {
+    struct Node *child = node->children[0];
+    bool nested = (child->nodeType == NODE_AND || child->nodeType == NODE_OR);
+
+    operator_appendDetail(info, nested ? "NOT (" : "NOT ");
+    appendNode(child, info);
+    operator_appendDetail(info, nested ? ")" : "");
+    return;
+  }
+
+  struct EXPR *expr = node->pred->expr;
+  char *quote = (node->colType == COL_TYPE_STRING) ? "'" : "";
+
+  operator_appendDetail(info, "%s.%s ", expr->column->table,
+                        expr->column->name);
+
+  if (node->nodeType != NODE_IN) {
+    operator_appendDetail(info, "%s %s%s%s", operators[expr->operator], quote,
+                          expr->value, quote);
+    return;
+  }
+
+  operator_appendDetail(info, "IN (");
+
+  for (int v = 0; v < node->pred->numValues; v++)
+    operator_appendDetail(info, "%s%s%s%s", (v > 0) ? ", " : "", quote,
+                          node->pred->values[v], quote);
+
+  operator_appendDetail(info, ")");
+}
+
+//
+// predicate_explain
+//
+void predicate_explain(struct Predicate *predicate, struct OpExplain *info) {
+  appendNode(predicate->root, info);
+}
+
+//
+// the filter operator:
+//
+static struct Tuple *predicate_next(struct Operator *op) {
+  struct Predicate *predicate = (struct Predicate *)op->state;
+
+  while (true) {
+    struct Tuple *tuple = operator_next(op->child);
+    if (tuple == NULL)
+      return NULL;
+
+    if (predicate_check(predicate, tuple->values))
+      return tuple;
+  }
+}
+
+static void predicate_explainOp(struct Operator *op, struct OpExplain *info) {
+  predicate_explain((struct Predicate *)op->state, info);
+}
+
+//
+// operator_predicate
+//
+struct Operator *operator_predicate(struct Operator *child,
+                                    struct PRED **preds, int N) {
+  struct Operator *op = operator_create(OP_FILTER, child, child->numColumns);
+
+  memcpy(op->columns, child->columns,
+         sizeof(struct OpColumn) * child->numColumns);
+
+  op->state = predicate_compile(preds, N, child->columns, child->numColumns);
+  op->next = predicate_next;
+  op->explain = predicate_explainOp;
+
+  return op;
+}
@@ -0,0 +1,83 @@
+/*predicate.h*/
+
+//
+// Project: Compound WHERE predicates for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+
+#include "ast.h"
+#include "database.h"
+#include "operator.h"
+
+//
+// A compound where clause is a tree of predicates (struct PRED, see
+// ast.h). Before it is used, it is compiled for the columns of the
+// tuples it checks: each column becomes a position in the tuple, each
+// literal is converted once to the column's type, each comparison gets
+// the kernel for its type and operator (see kernel.h), an IN list is
+// sorted for a binary search, and a LIKE pattern is split at its %s
+// into the parts to look for, so no pattern is interpreted per tuple.
+//
+// A tuple is then checked in one pass over the tree: an AND stops at
+// its first false operand, an OR at its first true one. The operands
+// are first ordered by their estimated cost and selectivity --- cheap
+// and selective first under an AND, cheap and likely first under an
+// OR --- and every PREDICATE_REORDER_INTERVAL checks they are ordered
+// again by the fraction of tuples each one actually passed, so the
+// order adapts to the data.
+//
+#define PREDICATE_REORDER_INTERVAL 1024
+
+struct Predicate; // compiled predicate, see predicate.c
+
+//
+// Functions:
+//
+
+//
+// predicate_conjuncts
+//
+// Returns the operands of the predicate's top-level ANDs --- or just
+// the predicate, if it is not an AND --- as an ARRAY allocated from
+// the arena (see arena.h), storing their # in *N.
+//
+struct PRED **predicate_conjuncts(struct PRED *pred, int *N);
+
+//
+// predicate_refersTo
+//
+// Returns true if every column of the predicate is a column of the
+// given table; the rewrite has filled in the columns' table names.
+//
+bool predicate_refersTo(struct PRED *pred, struct TableMeta *meta);
+
+//
+// predicate_compile
+//
+// Compiles the AND of the N given predicates for tuples with the given
+// columns, which must include every column of the predicates. The
+// compiled predicate is allocated from the arena.
+//
+struct Predicate *predicate_compile(struct PRED **preds, int N,
+                                    struct OpColumn *columns,
+                                    int numColumns);
+
+//
+// predicate_check
+//
+// Returns true if the tuple's values satisfy the compiled predicate.
+//
+bool predicate_check(struct Predicate *predicate, struct TupleValue *values);
+
+//
+// predicate_explain
+//
+// Appends the compiled predicate to info->detail, with the operands in
+// the order they are currently checked.
+//
+void predicate_explain(struct Predicate *predicate, struct OpExplain *info);
@@ -0,0 +1,319 @@
+/*resultcache.c*/
+
+//
+// Project: Result cache for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "resultcache.h"
+#include "table.h"
+#include "util.h"
+
+struct ResultCache {
+  struct ResultCacheEntry *first; // the most recently used
+  struct ResultCacheEntry *last;  // the least recently used
+  int numEntries;
+  long used;  // total size of the cached results
+  long limit; // -1 => not read from the environment yet
+
+  long hits;   // # of lookups that found a result
+  long misses; // # of lookups that did not
+};
+
+static struct ResultCache cache = {NULL, NULL, 0, 0, -1, 0, 0};
+
+// held while the cache is searched or changed (see server.h)
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// cacheLimit
+//
+// Returns the # of bytes the cache may hold: the value of the
+// SIMPLESQL_RESULT_CACHE environment variable if set, otherwise 0.
+// The caller holds cacheLock.
+//
+static long cacheLimit(void) {
+  if (cache.limit < 0) {
+    char *value = getenv("SIMPLESQL_RESULT_CACHE");
+
+    cache.limit = (value != NULL && atol(value) > 0) ? atol(value) : 0;
+  }
+
+  return cache.limit;
+}
+
+//
+// sizeOf
+//
+// Returns roughly the # of bytes used by the result set.
+//
+static long sizeOf(struct ResultSet *rs) {
+  long size = sizeof(struct ResultSet) + rs->heapSize + rs->deletedSize +
+              sizeof(size_t) * rs->numSlots;
+
+  for (int c = 0; c < rs->numCols; c++) {
+    struct RSColumn *column = &rs->columns[c];
+
+    size += sizeof(struct RSColumn) + strlen(column->tableName) +
+            strlen(column->colName) + 2;
+
+    if (column->coltype == COL_TYPE_INT)
+      size += sizeof(int) * column->size;
+    else if (column->coltype == COL_TYPE_REAL)
+      size += sizeof(double) * column->size;
+    else
+      size += sizeof(size_t) * column->size;
+  }
+
+  return size;
+}
+
+static bool sameVersions(struct ResultCacheEntry *entry,
+                         struct ResultKey *key) {
+  for (int t = 0; t < key->numTables; t++) {
+    struct TableVersion *v1 = &entry->versions[t];
+    struct TableVersion *v2 = &key->versions[t];
+
+    if (v1->size != v2->size || v1->modified != v2->modified ||
+        v1->inode != v2->inode)
+      return false;
+  }
+
+  return entry->numTables == key->numTables;
+}
+
+//
+// unlinkEntry, pushFront
+//
+// Remove an entry from / add an entry to the front of the LRU list.
+//
+static void unlinkEntry(struct ResultCacheEntry *e) {
+  if (e->prev != NULL)
+    e->prev->next = e->next;
+  else
+    cache.first = e->next;
+
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  else
+    cache.last = e->prev;
+}
+
+static void pushFront(struct ResultCacheEntry *e) {
+  e->prev = NULL;
+  e->next = cache.first;
+
+  if (cache.first != NULL)
+    cache.first->prev = e;
+  else
+    cache.last = e;
+
+  cache.first = e;
+}
+
+static void freeEntry(struct ResultCacheEntry *e) {
+  results_destroy(e->rs);
+  free(e->text);
+  free(e);
+}
+
+//
+// removeEntry
+//
+// Removes the entry from the cache; it is freed now if unused, and
+// otherwise by the last resultcache_release().
+//
+static void removeEntry(struct ResultCacheEntry *e) {
+  unlinkEntry(e);
+  cache.numEntries--;
+  cache.used -= e->size;
+
+  if (e->users == 0)
+    freeEntry(e);
+  else
+    e->stale = true;
+}
+
+//
+// resultcache_key
+//
+bool resultcache_key(struct Database *db, struct Rewrite *rewrite,
+                     struct QUERY *query, struct ResultKey *key) {
+  pthread_mutex_lock(&cacheLock);
+
+  bool enabled = (cacheLimit() > 0);
+
+  pthread_mutex_unlock(&cacheLock);
+
+  if (!enabled || query->queryType != SELECT_QUERY)
+    return false;
+
+  struct SELECT *select = query->q.select;
+  char *names[2] = {select->table,
+                    (select->join != NULL) ? select->join->table : NULL};
+
+  key->numTables = 0;
+
+  for (int t = 0; t < 2 && names[t] != NULL; t++) {
+    struct TableMeta *meta = table_find(db, names[t]);
+
+    if (meta == NULL || !table_version(db, meta, &key->versions[t]))
+      return false;
+
+    key->numTables++;
+  }
+
+  //
+  // "database\n" + shape, then each literal as "length:literal", so
+  // that no two statements have the same text:
+  //
+  int length = strlen(db->name) + strlen(rewrite->shape) + 2;
+
+  for (int l = 0; l < rewrite->numLiterals; l++)
+    length += strlen(rewrite->literals[l]) + 16;
+
+  key->text = (char *)arena_alloc(sizeof(char) * length);
+
+  char *cp = key->text;
+  cp += sprintf(cp, "%s\n%s", db->name, rewrite->shape);
+
+  for (int l = 0; l < rewrite->numLiterals; l++)
+    cp += sprintf(cp, "%d:%s", (int)strlen(rewrite->literals[l]),
+                  rewrite->literals[l]);
+
+  return true;
+}
+
+//
+// resultcache_lookup
+//
+struct ResultCacheEntry *resultcache_lookup(struct ResultKey *key) {
+  struct ResultCacheEntry *entry = NULL;
+
+  pthread_mutex_lock(&cacheLock);
+
+  for (struct ResultCacheEntry *e = cache.first; e != NULL; e = e->next) {
+    if (strcmp(e->text, key->text) != 0)
+      continue;
+
+    if (sameVersions(e, key)) {
+      entry = e;
+      entry->users++;
+      unlinkEntry(entry);
+      pushFront(entry);
+    } else {
+      removeEntry(e); // a table has changed since
+    }
+    break;
+  }
+
+  if (entry != NULL)
+    cache.hits++;
+  else
+    cache.misses++;
+
+  pthread_mutex_unlock(&cacheLock);
+
+  return entry;
+}
+
+//
+// resultcache_release
+//
+void resultcache_release(struct ResultCacheEntry *entry) {
+  pthread_mutex_lock(&cacheLock);
+
+  entry->users--;
+
+  if (entry->stale && entry->users == 0)
+    freeEntry(entry);
+
+  pthread_mutex_unlock(&cacheLock);
+}
+
+//
+// resultcache_insert
+//
+void resultcache_insert(struct ResultKey *key, struct ResultSet *rs) {
+  long size = sizeOf(rs);
+
+  pthread_mutex_lock(&cacheLock);
+
+  if (size > cacheLimit()) {
+    pthread_mutex_unlock(&cacheLock);
+    results_destroy(rs);
+    return;
+  }
+
+  // another session may have cached the same result meanwhile
+  for (struct ResultCacheEntry *e = cache.first; e != NULL; e = e->next) {
+    if (strcmp(e->text, key->text) == 0) {
+      removeEntry(e);
+      break;
+    }
+  }
+
+  // evicting the least recently used results to make room
+  while (cache.used + size > cacheLimit())
+    removeEntry(cache.last);
+
+  struct ResultCacheEntry *entry =
+      (struct ResultCacheEntry *)malloc(sizeof(struct ResultCacheEntry));
+  if (entry == NULL)
+    panic("out of memory");
+
+  entry->text = dupString(key->text);
+  entry->numTables = key->numTables;
+  memcpy(entry->versions, key->versions, sizeof(entry->versions));
+  entry->rs = rs;
+  entry->size = size;
+  entry->users = 0;
+  entry->stale = false;
+
+  pushFront(entry);
+  cache.numEntries++;
+  cache.used += size;
+
+  pthread_mutex_unlock(&cacheLock);
+}
+
+//
+// resultcache_print
+//
+void resultcache_print(FILE *output) {
+  pthread_mutex_lock(&cacheLock);
+
+  fprintf(output,
+          "**RESULT CACHE: %ld hits, %ld misses, %d results, %ld bytes\n",
+          cache.hits, cache.misses, cache.numEntries, cache.used);
+
+  pthread_mutex_unlock(&cacheLock);
+}
+
+//
+// resultcache_clear
+//
+void resultcache_clear(void) {
+  pthread_mutex_lock(&cacheLock);
+
+  struct ResultCacheEntry *e = cache.first;
+
+  while (e != NULL) {
+    struct ResultCacheEntry *next = e->next;
+
+    if (e->users == 0)
+      removeEntry(e);
+
+    e = next;
+  }
+
+  pthread_mutex_unlock(&cacheLock);
+}
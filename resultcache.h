@@ -0,0 +1,105 @@
+/*resultcache.h*/
+
+//
+// Project: Result cache for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+
+#include "ast.h"
+#include "database.h"
+#include "resultset.h"
+#include "rewrite.h"
+#include "table.h"
+
+//
+// The result cache keeps the ResultSets of recent SELECTs, shared by
+// every session. A SELECT whose key and tables match a cached result
+// is answered by printing the cached ResultSet, without executing it.
+//
+// The key is the database name plus the statement's tokens (its shape
+// and literals, see rewrite.h). Each result also records the version
+// of the tables it read (see table_version); once either table's data
+// file changes, e.g. by an INSERT, the result is dropped.
+//
+// The cache is off by default. Set the SIMPLESQL_RESULT_CACHE
+// environment variable to the # of bytes it may hold to enable it;
+// when full, the least recently used results are evicted.
+//
+struct ResultKey {
+  char *text; // database, shape and literals (in the query's arena)
+  int numTables;
+  struct TableVersion versions[2]; // FROM, then JOIN table, before executing
+};
+
+struct ResultCacheEntry {
+  char *text; // the key
+  int numTables;
+  struct TableVersion versions[2];
+
+  struct ResultSet *rs;
+  long size; // # of bytes used by rs, roughly
+
+  int users;  // # of lookups not yet released
+  bool stale; // true => no longer in the cache, free when unused
+  struct ResultCacheEntry *prev; // toward the most recently used
+  struct ResultCacheEntry *next; // toward the least recently used
+};
+
+//
+// Functions:
+//
+
+//
+// resultcache_key
+//
+// Builds the key of the query into key, reading the current versions
+// of its tables. Returns false if the query's result cannot be cached:
+// the cache is off, it is not a SELECT, or a table has no files.
+//
+bool resultcache_key(struct Database *db, struct Rewrite *rewrite,
+                     struct QUERY *query, struct ResultKey *key);
+
+//
+// resultcache_lookup
+//
+// Returns the entry holding the cached result for the key, or NULL if
+// there is none (or it is out of date). Call resultcache_release()
+// when done with entry->rs, and do not modify it.
+//
+struct ResultCacheEntry *resultcache_lookup(struct ResultKey *key);
+
+//
+// resultcache_release
+//
+// Releases an entry returned by resultcache_lookup().
+//
+void resultcache_release(struct ResultCacheEntry *entry);
+
+//
+// resultcache_insert
+//
+// Adds the result of the query with the given key to the cache, which
+// takes ownership of rs (it is destroyed if too large to cache).
+//
+void resultcache_insert(struct ResultKey *key, struct ResultSet *rs);
+
+//
+// resultcache_print
+//
+// Outputs the cache's hit and miss counters, # of results and bytes.
+//
+void resultcache_print(FILE *output);
+
+//
+// resultcache_clear
+//
+// Destroys every unused result in the cache, e.g. before the program
+// exits.
+//
+void resultcache_clear(void);
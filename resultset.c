@@ -0,0 +1,642 @@
+/*resultset.c*/
+
+//
+// Project: Result sets for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resultset.h"
+#include "session.h"
+#include "util.h"
+
+//
+// Offset 0 of the heap always holds "", the value of a new row
+// in a string column.
+//
+#define EMPTY_STRING 0
+
+//
+// getColumn
+//
+// Returns the column at position col (1-based).
+//
+static struct RSColumn *getColumn(struct ResultSet *rs, int col) {
+  if (col < 1 || col > rs->numCols)
+    panic("resultset: column # out of range");
+
+  return &rs->columns[col - 1];
+}
+
+//
+// isDeleted
+//
+// Returns true if row index i (0-based) is a tombstone.
+//
+static bool isDeleted(struct ResultSet *rs, int i) {
+  return i < rs->deletedSize && rs->deleted[i];
+}
+
+//
+// compact
+//
+// Removes the tombstones from every column, in one pass per column,
+// so that row # r is once again at index r-1 of each column's array.
+//
+static void compact(struct ResultSet *rs) {
+  if (rs->numDeleted == 0)
+    return;
+
+  for (int c = 0; c < rs->numCols; c++) {
+    struct RSColumn *column = &rs->columns[c];
+    int n = rs->firstDeleted; // rows before the first tombstone stay put
+
+    for (int i = rs->firstDeleted; i < column->N; i++) {
+      if (isDeleted(rs, i))
+        continue;
+
+      if (column->coltype == COL_TYPE_INT)
+        column->ints[n] = column->ints[i];
+      else if (column->coltype == COL_TYPE_REAL)
+        column->reals[n] = column->reals[i];
+      else
+        column->strings[n] = column->strings[i];
+      n++;
+    }
+
+    if (n < column->N) // a column shorter than firstDeleted is unchanged
+      column->N = n;
+  }
+
+  memset(rs->deleted, 0, sizeof(bool) * rs->deletedSize);
+  rs->numDeleted = 0;
+}
+
+//
+// rowIndex
+//
+// Returns the index of row # row (1-based) in the columns' arrays.
+// Rows before the first tombstone have not been renumbered, so they
+// are still at index row-1; otherwise the tombstones are compacted
+// first. Deleting or visiting rows from the last one backwards thus
+// never compacts.
+//
+static int rowIndex(struct ResultSet *rs, int row) {
+  if (rs->numDeleted > 0 && row - 1 >= rs->firstDeleted)
+    compact(rs);
+
+  return row - 1;
+}
+
+//
+// getCell
+//
+// Returns the column at position col, checking that row is a valid
+// (1-based) row of that column, and that the column has the given
+// type.
+//
+static struct RSColumn *getCell(struct ResultSet *rs, int row, int col,
+                                int colType) {
+  struct RSColumn *column = getColumn(rs, col);
+
+  if (row < 1 || rowIndex(rs, row) >= column->N)
+    panic("resultset: row # out of range");
+  if (column->coltype != colType)
+    panic("resultset: value type does not match column type");
+
+  return column;
+}
+
+//
+// heap_add
+//
+// Copies the string into the heap, returning its offset.
+//
+static size_t heap_add(struct ResultSet *rs, char *s) {
+  size_t length = strlen(s) + 1;
+
+  if (rs->heapUsed + length > rs->heapSize) {
+    while (rs->heapUsed + length > rs->heapSize)
+      rs->heapSize *= 2;
+
+    rs->heap = (char *)realloc(rs->heap, sizeof(char) * rs->heapSize);
+    if (rs->heap == NULL)
+      panic("out of memory");
+  }
+
+  size_t offset = rs->heapUsed;
+  memcpy(rs->heap + offset, s, length);
+  rs->heapUsed += length;
+
+  return offset;
+}
+
+//
+// hashString
+//
+// FNV-1a, as for a table's dictionary.
+//
+static unsigned int hashString(char *s) {
+  unsigned int hash = 2166136261u;
+
+  for (; *s != '\0'; s++)
+    hash = (hash ^ (unsigned char)*s) * 16777619u;
+
+  return hash;
+}
+
+//
+// intern_resize
+//
+// (Re)allocates the table of interned strings with numSlots slots,
+// and re-inserts the strings interned so far.
+//
+static void intern_resize(struct ResultSet *rs, unsigned int numSlots) {
+  size_t *old = rs->interned;
+  unsigned int oldSlots = rs->numSlots;
+
+  rs->interned = (size_t *)calloc(numSlots, sizeof(size_t)); // all empty
+  if (rs->interned == NULL)
+    panic("out of memory");
+  rs->numSlots = numSlots;
+
+  for (unsigned int i = 0; i < oldSlots; i++) {
+    if (old[i] == EMPTY_STRING)
+      continue;
+
+    unsigned int slot = hashString(rs->heap + old[i]) & (numSlots - 1);
+    while (rs->interned[slot] != EMPTY_STRING)
+      slot = (slot + 1) & (numSlots - 1);
+
+    rs->interned[slot] = old[i];
+  }
+
+  free(old);
+}
+
+//
+// heap_intern
+//
+// Returns the offset of the string in the heap, copying it into the
+// heap only if it is short and has not been interned already.
+//
+static size_t heap_intern(struct ResultSet *rs, char *s) {
+  size_t length = strlen(s);
+
+  if (length == 0)
+    return EMPTY_STRING;
+  if (length > RESULTSET_INTERN_LENGTH)
+    return heap_add(rs, s);
+
+  if (rs->numSlots == 0)
+    intern_resize(rs, RESULTSET_INTERN_SLOTS);
+
+  unsigned int mask = rs->numSlots - 1;
+  unsigned int slot = hashString(s) & mask;
+
+  while (rs->interned[slot] != EMPTY_STRING) {
+    if (strcmp(rs->heap + rs->interned[slot], s) == 0)
+      return rs->interned[slot];
+    slot = (slot + 1) & mask;
+  }
+
+  size_t offset = heap_add(rs, s);
+
+  if (rs->numInterned < RESULTSET_INTERN_MAX) {
+    rs->interned[slot] = offset;
+    rs->numInterned++;
+
+    // at most half full, so a probe ends soon at an empty slot
+    if ((unsigned int)rs->numInterned * 2 > rs->numSlots)
+      intern_resize(rs, rs->numSlots * 2);
+  }
+
+  return offset;
+}
+
+//
+// column_alloc
+//
+// (Re)allocates the column's array of values, for its type, so it
+// has room for size values.
+//
+static void column_alloc(struct RSColumn *column, int size) {
+  column->size = size;
+
+  if (column->coltype == COL_TYPE_INT) {
+    column->ints = (int *)realloc(column->ints, sizeof(int) * size);
+    if (column->ints == NULL)
+      panic("out of memory");
+  } else if (column->coltype == COL_TYPE_REAL) {
+    column->reals = (double *)realloc(column->reals, sizeof(double) * size);
+    if (column->reals == NULL)
+      panic("out of memory");
+  } else {
+    column->strings =
+        (size_t *)realloc(column->strings, sizeof(size_t) * size);
+    if (column->strings == NULL)
+      panic("out of memory");
+  }
+}
+
+//
+// column_setDefault
+//
+// Sets the value in row index i (0-based) to 0, 0.0, or "".
+//
+static void column_setDefault(struct RSColumn *column, int i) {
+  if (column->coltype == COL_TYPE_INT)
+    column->ints[i] = 0;
+  else if (column->coltype == COL_TYPE_REAL)
+    column->reals[i] = 0.0;
+  else
+    column->strings[i] = EMPTY_STRING;
+}
+
+static void column_free(struct RSColumn *column) {
+  free(column->tableName);
+  free(column->colName);
+  free(column->ints);
+  free(column->reals);
+  free(column->strings);
+}
+
+//
+// results_create
+//
+struct ResultSet *results_create(void) {
+  struct ResultSet *rs = (struct ResultSet *)malloc(sizeof(struct ResultSet));
+  if (rs == NULL)
+    panic("out of memory");
+
+  rs->numRows = 0;
+  rs->numCols = 0;
+  rs->colSize = 4;
+  rs->columns =
+      (struct RSColumn *)malloc(sizeof(struct RSColumn) * rs->colSize);
+
+  rs->heapSize = 1024;
+  rs->heapUsed = 0;
+  rs->heap = (char *)malloc(sizeof(char) * rs->heapSize);
+
+  // allocated by the first string stored, see heap_intern()
+  rs->interned = NULL;
+  rs->numSlots = 0;
+  rs->numInterned = 0;
+
+  if (rs->columns == NULL || rs->heap == NULL)
+    panic("out of memory");
+
+  rs->deleted = NULL;
+  rs->deletedSize = 0;
+  rs->numDeleted = 0;
+  rs->firstDeleted = 0;
+
+  heap_add(rs, ""); // EMPTY_STRING
+
+  return rs;
+}
+
+//
+// results_destroy
+//
+void results_destroy(struct ResultSet *rs) {
+  if (rs == NULL)
+    return;
+
+  for (int c = 0; c < rs->numCols; c++)
+    column_free(&rs->columns[c]);
+
+  free(rs->columns);
+  free(rs->heap);
+  free(rs->interned);
+  free(rs->deleted);
+  free(rs);
+}
+
+//
+// results_insertColumn
+//
+int results_insertColumn(struct ResultSet *rs, int position, char *tableName,
+                         char *columnName, int function, int colType) {
+  if (position < 1 || position > rs->numCols + 1)
+    panic("resultset: column position out of range");
+
+  compact(rs); // the new column has exactly rs->numRows values
+
+  if (rs->numCols == rs->colSize) {
+    rs->colSize *= 2;
+    rs->columns = (struct RSColumn *)realloc(
+        rs->columns, sizeof(struct RSColumn) * rs->colSize);
+    if (rs->columns == NULL)
+      panic("out of memory");
+  }
+
+  // shifting the columns at position and beyond over by one
+  memmove(&rs->columns[position], &rs->columns[position - 1],
+          sizeof(struct RSColumn) * (rs->numCols - (position - 1)));
+  rs->numCols++;
+
+  struct RSColumn *column = &rs->columns[position - 1];
+
+  column->tableName = dupString(tableName);
+  column->colName = dupString(columnName);
+  column->function = function;
+  column->coltype = colType;
+  column->ints = NULL;
+  column->reals = NULL;
+  column->strings = NULL;
+
+  // the new column has a default value in each existing row
+  column->N = rs->numRows;
+  column_alloc(column, (rs->numRows > 0) ? rs->numRows * 2 : 16);
+
+  for (int i = 0; i < column->N; i++)
+    column_setDefault(column, i);
+
+  return position;
+}
+
+//
+// results_findColumn
+//
+int results_findColumn(struct ResultSet *rs, int startPos, char *tableName,
+                       char *columnName) {
+  for (int p = startPos; p <= rs->numCols; p++) {
+    struct RSColumn *column = &rs->columns[p - 1];
+
+    if (icmpStrings(column->tableName, tableName) == 0 &&
+        icmpStrings(column->colName, columnName) == 0)
+      return p;
+  }
+
+  return -1;
+}
+
+//
+// results_deleteColumn
+//
+void results_deleteColumn(struct ResultSet *rs, int position) {
+  column_free(getColumn(rs, position));
+
+  memmove(&rs->columns[position - 1], &rs->columns[position],
+          sizeof(struct RSColumn) * (rs->numCols - position));
+  rs->numCols--;
+}
+
+//
+// results_moveColumn
+//
+void results_moveColumn(struct ResultSet *rs, int fromPos, int toPos) {
+  struct RSColumn column = *getColumn(rs, fromPos);
+
+  if (toPos < 1 || toPos > rs->numCols + 1)
+    panic("resultset: column position out of range");
+
+  // the column ends up just before the column now at toPos
+  if (toPos > fromPos)
+    toPos--;
+
+  if (toPos == fromPos)
+    return;
+
+  if (fromPos < toPos)
+    memmove(&rs->columns[fromPos - 1], &rs->columns[fromPos],
+            sizeof(struct RSColumn) * (toPos - fromPos));
+  else
+    memmove(&rs->columns[toPos], &rs->columns[toPos - 1],
+            sizeof(struct RSColumn) * (fromPos - toPos));
+
+  rs->columns[toPos - 1] = column;
+}
+
+//
+// results_addRow
+//
+int results_addRow(struct ResultSet *rs) {
+  compact(rs);
+
+  for (int c = 0; c < rs->numCols; c++) {
+    struct RSColumn *column = &rs->columns[c];
+
+    if (column->N == column->size)
+      column_alloc(column, column->size * 2);
+
+    column_setDefault(column, column->N);
+    column->N++;
+  }
+
+  rs->numRows++;
+
+  return rs->numRows;
+}
+
+//
+// results_deleteRow
+//
+void results_deleteRow(struct ResultSet *rs, int rowNum) {
+  if (rowNum < 1 || rowNum > rs->numRows)
+    panic("resultset: row # out of range");
+
+  int i = rowIndex(rs, rowNum);
+
+  if (i >= rs->deletedSize) {
+    int size = (rs->deletedSize > 0) ? rs->deletedSize : 16;
+
+    while (size <= i)
+      size *= 2;
+
+    rs->deleted = (bool *)realloc(rs->deleted, sizeof(bool) * size);
+    if (rs->deleted == NULL)
+      panic("out of memory");
+
+    memset(rs->deleted + rs->deletedSize, 0,
+           sizeof(bool) * (size - rs->deletedSize));
+    rs->deletedSize = size;
+  }
+
+  rs->deleted[i] = true;
+  rs->numDeleted++;
+  rs->firstDeleted = i;
+  rs->numRows--;
+}
+
+//
+// results_applyFunction
+//
+void results_applyFunction(struct ResultSet *rs, int function, int colNum) {
+  compact(rs);
+
+  struct RSColumn *column = getColumn(rs, colNum);
+  int N = column->N;
+
+  if (function == NO_FUNCTION) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: results_applyFunction() called with "
+            "NO_FUNCTION\n");
+    return;
+  }
+
+  if (column->coltype == COL_TYPE_STRING && function != MIN_FUNCTION &&
+      function != MAX_FUNCTION && function != COUNT_FUNCTION) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: only MIN, MAX and COUNT apply to strings\n");
+    return;
+  }
+
+  //
+  // compute the result, along with its type:
+  //
+  int resultType = column->coltype;
+  int i = 0;
+  double r = 0.0;
+  size_t s = EMPTY_STRING;
+
+  if (function == COUNT_FUNCTION) {
+    resultType = COL_TYPE_INT;
+    i = N;
+  } else if (column->coltype == COL_TYPE_STRING) {
+    for (int row = 0; row < N; row++) {
+      char *value = rs->heap + column->strings[row];
+      int cmp = icmpStrings(value, rs->heap + s);
+
+      if (row == 0 || (function == MIN_FUNCTION && cmp < 0) ||
+          (function == MAX_FUNCTION && cmp > 0))
+        s = column->strings[row];
+    }
+  } else {
+    bool isInt = (column->coltype == COL_TYPE_INT);
+    long long sumInt = 0;
+    double sum = 0.0;
+
+    for (int row = 0; row < N; row++) {
+      double value = isInt ? column->ints[row] : column->reals[row];
+
+      if (isInt)
+        sumInt += column->ints[row];
+      sum += value;
+
+      if (row == 0 || (function == MIN_FUNCTION && value < r) ||
+          (function == MAX_FUNCTION && value > r))
+        r = value;
+    }
+
+    if (function == AVG_FUNCTION) {
+      resultType = COL_TYPE_REAL;
+      r = (N > 0) ? sum / N : 0.0;
+    } else if (function == SUM_FUNCTION) {
+      r = sum;
+      i = (int)sumInt;
+    } else {
+      i = (int)r; // MIN, MAX of an int column
+    }
+  }
+
+  //
+  // the column now holds just the result, in row 1:
+  //
+  free(column->ints);
+  free(column->reals);
+  free(column->strings);
+  column->ints = NULL;
+  column->reals = NULL;
+  column->strings = NULL;
+
+  column->coltype = resultType;
+  column->function = function;
+  column_alloc(column, 16);
+  column->N = 1;
+
+  if (resultType == COL_TYPE_INT)
+    column->ints[0] = i;
+  else if (resultType == COL_TYPE_REAL)
+    column->reals[0] = r;
+  else
+    column->strings[0] = s;
+
+  rs->numRows = 1;
+}
+
+//
+// results_putInt, putReal, putString
+//
+void results_putInt(struct ResultSet *rs, int row, int col, int value) {
+  getCell(rs, row, col, COL_TYPE_INT)->ints[row - 1] = value;
+}
+
+void results_putReal(struct ResultSet *rs, int row, int col, double value) {
+  getCell(rs, row, col, COL_TYPE_REAL)->reals[row - 1] = value;
+}
+
+void results_putString(struct ResultSet *rs, int row, int col, char *value) {
+  struct RSColumn *column = getCell(rs, row, col, COL_TYPE_STRING);
+
+  // the previous value, if any, is left in the heap
+  column->strings[row - 1] = heap_intern(rs, value);
+}
+
+//
+// results_getInt, getReal, getString
+//
+int results_getInt(struct ResultSet *rs, int row, int col) {
+  return getCell(rs, row, col, COL_TYPE_INT)->ints[row - 1];
+}
+
+double results_getReal(struct ResultSet *rs, int row, int col) {
+  return getCell(rs, row, col, COL_TYPE_REAL)->reals[row - 1];
+}
+
+char *results_getString(struct ResultSet *rs, int row, int col) {
+  struct RSColumn *column = getCell(rs, row, col, COL_TYPE_STRING);
+
+  return dupString(rs->heap + column->strings[row - 1]);
+}
+
+//
+// results_print
+//
+void results_print(struct ResultSet *rs) {
+  static char *functions[] = {"MIN", "MAX", "SUM", "AVG", "COUNT"};
+
+  FILE *output = session_output();
+
+  fprintf(output, "**RESULT SET: %d rows, %d cols\n", rs->numRows,
+          rs->numCols);
+
+  for (int c = 0; c < rs->numCols; c++) {
+    struct RSColumn *column = &rs->columns[c];
+
+    if (column->function == NO_FUNCTION)
+      fprintf(output, "| %s.%s ", column->tableName, column->colName);
+    else
+      fprintf(output, "| %s(%s.%s) ", functions[column->function],
+              column->tableName, column->colName);
+  }
+  fprintf(output, "|\n");
+
+  // tombstones are skipped rather than compacted away
+  for (int i = 0, row = 0; row < rs->numRows; i++) {
+    if (isDeleted(rs, i))
+      continue;
+
+    row++;
+
+    for (int c = 0; c < rs->numCols; c++) {
+      struct RSColumn *column = &rs->columns[c];
+
+      if (column->coltype == COL_TYPE_INT)
+        fprintf(output, "| %d ", column->ints[i]);
+      else if (column->coltype == COL_TYPE_REAL)
+        fprintf(output, "| %.2f ", column->reals[i]);
+      else
+        fprintf(output, "| '%s' ", rs->heap + column->strings[i]);
+    }
+    fprintf(output, "|\n");
+  }
+}
@@ -6,27 +6,63 @@
 
 #pragma once
 
+#include <stdbool.h> // true, false
+#include <stddef.h>  // size_t
+
 #include "ast.h"
 #include "database.h"
 
 //
 // A ResultSet is the result of a query, which conceptually
 // is a table of rows and columns. In terms of implementation,
-// we build a linked-list of columns, where each column stores
-// its data in a dynamically-allocated array (that grows and
-// shrinks as necessary).
+// we keep an array of columns, so column P (1-based) is simply
+// columns[P-1], and each column stores its data in a typed,
+// dynamically-allocated array (that grows as necessary): ints,
+// doubles, or --- for strings --- offsets into a string heap
+// shared by the entire result set.
+//
+// Short strings are interned: a low-cardinality column, e.g. a day
+// type or a genre, repeats a few values over and over, so each
+// distinct string of at most RESULTSET_INTERN_LENGTH chars is stored
+// in the heap only once, and its rows share its offset, the way a
+// dictionary-encoded column shares its strings (see table.h). At most
+// RESULTSET_INTERN_MAX strings are interned; longer or later strings
+// are copied as before. The table of interned strings is allocated by
+// the first string stored, starting at RESULTSET_INTERN_SLOTS slots,
+// and doubles as it fills.
+#define RESULTSET_INTERN_LENGTH 32
+#define RESULTSET_INTERN_MAX 4096
+#define RESULTSET_INTERN_SLOTS 16
+
+//
+// Deleting a row only marks it as a tombstone. The rows are
+// compacted all at once by the next call that needs row numbers
+// to match array positions, and printing simply skips them.
 //
 struct ResultSet {
-  struct RSColumn *columns; // a linked-list of columns (forming a table)
+  struct RSColumn *columns; // ARRAY of columns (forming a table)
   int numRows;              // number of rows
   int numCols;              // number of columns
+  int colSize;              // # of array locations for columns
+
+  char *heap;      // strings, each null-terminated, back to back
+  size_t heapUsed; // # of bytes of heap in use
+  size_t heapSize; // # of bytes of heap (used + unused)
+
+  size_t *interned;      // ARRAY: offsets of interned strings, 0 => empty
+  unsigned int numSlots; // # of array locations, a power of 2, or 0
+  int numInterned;       // # of strings interned
+
+  bool *deleted;    // ARRAY: deleted[i] => row index i is a tombstone
+  int deletedSize;  // # of array locations for tombstones
+  int numDeleted;   // # of tombstones not yet compacted away
+  int firstDeleted; // lowest row index that is a tombstone
 };
 
 //
 // This is one column in the result set, which conceptually
-// forms a column in a table. The column is actually a
-// dynamically-allocated array that is reallocated when it
-// fills.
+// forms a column in a table. Only the array matching the
+// column's type is used; it is reallocated when it fills.
 //
 struct RSColumn {
   char *tableName; // table name
@@ -34,47 +70,37 @@ struct RSColumn {
   int function;    // enum AST_COLUMN_FUNCTIONS (ast.h)
   int coltype;     // enum ColumnType (database.h)
 
-  struct RSColumn *next; // columns form a LL
-  struct RSValue *data;  // column data form an array
-  int N;                 // # of data values in array
-  int cursor;            // index of "current" data value
-  int size;              // # of array locations (used + unused)
-};
-
-//
-// This is one value in the result set / table. We have 3
-// types of values: int, real, or string.
-//
-struct RSValue {
-  union {
-    int i;
-    double r;
-    char *s;
-  } value;
-
-  int valueType; // enum ColumnType (database.h)
+  int *ints;       // COL_TYPE_INT: value of each row
+  double *reals;   // COL_TYPE_REAL: value of each row
+  size_t *strings; // COL_TYPE_STRING: offset of each row's value in heap
+  int N;           // # of data values in array
+  int size;        // # of array locations (used + unused)
 };
 
 //
 // Functions:
 //
+// compiler.o still exports the original resultset_* functions, which
+// work on the original, row-based ResultSet; these are named results_*
+// so both can be linked into one program.
+//
 
 //
-// resultset_create
+// results_create
 //
 // Creates and returns a new, empty result set.
 //
-struct ResultSet *resultset_create(void);
+struct ResultSet *results_create(void);
 
 //
-// resultset_destroy
+// results_destroy
 //
 // Frees all the memory associated with the result set.
 //
-void resultset_destroy(struct ResultSet *rs);
+void results_destroy(struct ResultSet *rs);
 
 //
-// resultset_insertColumn
+// results_insertColumn
 //
 // Inserts a new column into the result set such that
 // the new column ends up at the requested position.
@@ -91,57 +117,58 @@ void resultset_destroy(struct ResultSet *rs);
 // Returns the position where the column was inserted; this
 // will be the same as the position value you passed in.
 //
-int resultset_insertColumn(struct ResultSet *rs, int position /*1..N+1*/,
-                           char *tableName, char *columnName,
-                           int function /*enum AST_COLUMN_FUNCTIONS*/,
-                           int colType /*enum ColumnType*/);
+int results_insertColumn(struct ResultSet *rs, int position /*1..N+1*/,
+                         char *tableName, char *columnName,
+                         int function /*enum AST_COLUMN_FUNCTIONS*/,
+                         int colType /*enum ColumnType*/);
 
 //
-// resultset_findColumn
+// results_findColumn
 //
 // Starting from startPos (which is 1-based), searches for the first
 // column with the matching table and column name --- case-insensitive.
 // Returns -1 if not found, otherwise returns position P where found
 // such that startPos <= P <= rs->numCols.
 //
-int resultset_findColumn(struct ResultSet *rs, int startPos /*1..N*/,
-                         char *tableName, char *columnName);
+int results_findColumn(struct ResultSet *rs, int startPos /*1..N*/,
+                       char *tableName, char *columnName);
 
 //
-// resultset_deleteColumn
+// results_deleteColumn
 //
 // Deletes the column at position P, where 1 <= P <= rs->numCols.
 //
-void resultset_deleteColumn(struct ResultSet *rs, int position /*1..N*/);
+void results_deleteColumn(struct ResultSet *rs, int position /*1..N*/);
 
 //
-// resultset_moveColumn
+// results_moveColumn
 //
 // Moves the column at position fromPos (1 <= fromPos <= rs->numCols)
 // to position toPos (1 <= toPos <= rs->numCols+1).
 //
-void resultset_moveColumn(struct ResultSet *rs, int fromPos /*1..N*/,
-                          int toPos /*1..N+1*/);
+void results_moveColumn(struct ResultSet *rs, int fromPos /*1..N*/,
+                        int toPos /*1..N+1*/);
 
 //
-// resultset_addRow
+// results_addRow
 //
 // Adds a new row to the end of each column; the values will
 // be set to default values (0, 0.0, or ""). Returns the row
 // # of this new row, 1-based.
 //
-int resultset_addRow(struct ResultSet *rs);
+int results_addRow(struct ResultSet *rs);
 
 //
-// resultset_deleteRow
+// results_deleteRow
 //
 // Deletes the given row from each column, where
-// 1 <= rowNum <= rs->numRows;
+// 1 <= rowNum <= rs->numRows; the rows after it are renumbered.
+// Deleting rows from the last one backwards takes O(1) per row.
 //
-void resultset_deleteRow(struct ResultSet *rs, int rowNum /*1..N*/);
+void results_deleteRow(struct ResultSet *rs, int rowNum /*1..N*/);
 
 //
-// resultset_applyFunction
+// results_applyFunction
 //
 // Applies the given function --- one of enum AST_COLUMN_FUNCTIONS --- to
 // the specified colNum (1 <= colNum <= rs->numCols). Howeer, do not pass
@@ -152,23 +179,24 @@ void resultset_deleteRow(struct ResultSet *rs, int rowNum /*1..N*/);
 // additional functions can be applied. But when printing the result set,
 // at most one row will be printed.
 //
-void resultset_applyFunction(struct ResultSet *rs,
-                             int function /*enum AST_COLUMN_FUNCTIONS*/,
-                             int colNum /*1..N*/);
+void results_applyFunction(struct ResultSet *rs,
+                           int function /*enum AST_COLUMN_FUNCTIONS*/,
+                           int colNum /*1..N*/);
 
 //
-// resultset_putInt, putReal, putString
+// results_putInt, putReal, putString
 //
 // These functions store a value into the given row and column of
 // the result set; row and col are 1-based. When a string is stored,
-// it is duplicated so that a copy is stored.
+// it is duplicated so that a copy is stored, unless an equal string
+// has been interned (see above).
 //
-void resultset_putInt(struct ResultSet *rs, int row, int col, int value);
-void resultset_putReal(struct ResultSet *rs, int row, int col, double value);
-void resultset_putString(struct ResultSet *rs, int row, int col, char *value);
+void results_putInt(struct ResultSet *rs, int row, int col, int value);
+void results_putReal(struct ResultSet *rs, int row, int col, double value);
+void results_putString(struct ResultSet *rs, int row, int col, char *value);
 
 //
-// resultset_getInt, getReal, getString
+// results_getInt, getReal, getString
 //
 // These functions retrieve a value from the given row and column of
 // the result set; row and col are 1-based. When a string is retrieved,
@@ -179,13 +207,13 @@ void resultset_putString(struct ResultSet *rs, int row, int col, char *value);
 // CALLER's responsibility to free the memory when they are done with
 // the returned value.
 //
-int resultset_getInt(struct ResultSet *rs, int row, int col);
-double resultset_getReal(struct ResultSet *rs, int row, int col);
-char *resultset_getString(struct ResultSet *rs, int row, int col);
+int results_getInt(struct ResultSet *rs, int row, int col);
+double results_getReal(struct ResultSet *rs, int row, int col);
+char *results_getString(struct ResultSet *rs, int row, int col);
 
 //
-// resultset_print
+// results_print
 //
 // Prints the contents of the resultset to the console window.
 //
-void resultset_print(struct ResultSet *rs);
+void results_print(struct ResultSet *rs);
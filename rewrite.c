@@ -0,0 +1,1813 @@
+/*rewrite.c*/
+
+//
+// Project: Rewriting of extended SimpleSQL statements
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <limits.h>  // INT_MIN, INT_MAX
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "arena.h"
+#include "rewrite.h"
+#include "scanner.h"
+#include "session.h"
+#include "table.h"
+#include "util.h"
+
+//
+// A token of the statement, along with where it starts in the text:
+//
+struct RWToken {
+  int id;      // enum TokenID (token.h)
+  char *value; // token in string form
+  int line;    // line containing the token (1-based)
+  int col;     // column where the token starts (1-based)
+  int offset;  // where the token starts in the text (0-based)
+};
+
+struct RWTokens {
+  struct RWToken *tokens; // ARRAY of tokens, ending with SQL_EOS
+  int numTokens;
+};
+
+//
+// rewrite_read
+//
+char *rewrite_read(FILE *input) {
+  int size = 256;
+  int N = 0;
+  char *statement = (char *)malloc(sizeof(char) * size);
+  if (statement == NULL)
+    panic("out of memory");
+
+  char quote = '\0'; // != '\0' => inside a string literal
+  int c;
+
+  while ((c = fgetc(input)) != EOF) {
+    // skipping whitespace before the statement starts
+    if (N == 0 && (c == ' ' || c == '\t' || c == '\n' || c == '\r'))
+      continue;
+
+    if (N + 2 > size) {
+      size *= 2;
+      statement = (char *)realloc(statement, sizeof(char) * size);
+      if (statement == NULL)
+        panic("out of memory");
+    }
+
+    statement[N++] = c;
+
+    if (quote != '\0') {
+      if (c == quote)
+        quote = '\0';
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+    } else if (c == ';') {
+      break;
+    }
+  }
+
+  if (N == 0) // EOF:
+  {
+    free(statement);
+    return NULL;
+  }
+
+  statement[N] = '\0';
+  return statement;
+}
+
+//
+// tokenize
+//
+// Breaks the statement into tokens using the scanner. The tokens are
+// allocated from the arena (see arena.h).
+//
+static void tokenize(char *statement, struct RWTokens *tokens) {
+  int length = strlen(statement);
+
+  // where each line starts, to turn the scanner's (line, col) into
+  // an offset
+  int *lineStarts = (int *)arena_alloc(sizeof(int) * (length + 2));
+  char *value = (char *)arena_alloc(sizeof(char) * (length + 2));
+
+  int numLines = 1;
+  lineStarts[0] = 0;
+  for (int i = 0; i < length; i++) {
+    if (statement[i] == '\n')
+      lineStarts[numLines++] = i + 1;
+  }
+
+  FILE *input = fmemopen(statement, length, "r");
+  if (input == NULL)
+    panic("out of memory");
+
+  // every token but the last (SQL_EOS) is at least 1 char long
+  tokens->numTokens = 0;
+  tokens->tokens =
+      (struct RWToken *)arena_alloc(sizeof(struct RWToken) * (length + 2));
+
+  int lineNumber, colNumber;
+  scanner_init(&lineNumber, &colNumber, value);
+
+  while (true) {
+    struct Token token =
+        scanner_nextToken(input, &lineNumber, &colNumber, value);
+
+    assert(tokens->numTokens < length + 2);
+
+    struct RWToken *t = &tokens->tokens[tokens->numTokens++];
+    t->id = token.id;
+    t->value = arena_dupString(value);
+    t->line = token.line;
+    t->col = token.col;
+
+    if (token.id == SQL_EOS || token.line < 1 || token.line > numLines)
+      t->offset = length;
+    else
+      t->offset = lineStarts[token.line - 1] + token.col - 1;
+
+    if (token.id == SQL_EOS)
+      break;
+  }
+
+  fclose(input);
+}
+
+//
+// isWord
+//
+// Returns true if the token is an identifier spelled like the given
+// word, e.g. "GROUP", which is not a keyword of the scanner.
+//
+static bool isWord(struct RWToken *token, char *word) {
+  return token->id == SQL_IDENTIFIER && strcasecmp(token->value, word) == 0;
+}
+
+static void syntaxError(struct RWToken *token, char *expected) {
+  fprintf(session_output(),
+          "**SYNTAX ERROR: expected %s, found '%s' (line %d, col %d)\n",
+          expected, token->value, token->line, token->col);
+}
+
+static void freeColumns(struct COLUMN *column) {
+  while (column != NULL) {
+    struct COLUMN *next = column->next;
+    free(column->table);
+    free(column->name);
+    free(column);
+    column = next;
+  }
+}
+
+//
+// parseColumn
+//
+// Parses "name" or "table.name" starting at token *t, advancing *t
+// past the column. Returns NULL if there is a syntax error.
+//
+static struct COLUMN *parseColumn(struct RWTokens *tokens, int *t) {
+  struct RWToken *token = &tokens->tokens[*t];
+
+  if (token->id != SQL_IDENTIFIER) {
+    syntaxError(token, "column name");
+    return NULL;
+  }
+
+  struct COLUMN *column = (struct COLUMN *)malloc(sizeof(struct COLUMN));
+  if (column == NULL)
+    panic("out of memory");
+
+  column->table = NULL;
+  column->name = dupString(token->value);
+  column->function = NO_FUNCTION;
+  column->next = NULL;
+  (*t)++;
+
+  if (tokens->tokens[*t].id == SQL_DOT) {
+    token = &tokens->tokens[*t + 1];
+    if (token->id != SQL_IDENTIFIER) {
+      syntaxError(token, "column name");
+      freeColumns(column);
+      return NULL;
+    }
+
+    column->table = column->name;
+    column->name = dupString(token->value);
+    *t += 2;
+  }
+
+  return column;
+}
+
+//
+// parseGroupBy
+//
+// Looks for "GROUP BY column, column, ..." and if found, parses it
+// into rewrite->groupby and removes it from rewrite->text. Returns
+// false if there is a syntax error.
+//
+static bool parseGroupBy(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  int start = -1;
+
+  for (int t = 0; t + 1 < tokens->numTokens; t++) {
+    if (isWord(&tokens->tokens[t], "GROUP") &&
+        tokens->tokens[t + 1].id == SQL_KEYW_BY) {
+      start = t;
+      break;
+    }
+  }
+
+  if (start < 0) // no group by clause
+    return true;
+
+  rewrite->groupby = (struct GROUPBY *)malloc(sizeof(struct GROUPBY));
+  if (rewrite->groupby == NULL)
+    panic("out of memory");
+  rewrite->groupby->columns = NULL;
+
+  struct COLUMN **tail = &rewrite->groupby->columns;
+  int t = start + 2;
+
+  while (true) {
+    struct COLUMN *column = parseColumn(tokens, &t);
+    if (column == NULL)
+      return false;
+
+    *tail = column;
+    tail = &column->next;
+
+    if (tokens->tokens[t].id != SQL_COMMA)
+      break;
+    t++;
+  }
+
+  // removing the clause, up to the start of whatever follows it:
+  int from = tokens->tokens[start].offset;
+  int to = tokens->tokens[t].offset;
+
+  memmove(rewrite->text + from, rewrite->text + to,
+          strlen(rewrite->text + to) + 1);
+
+  return true;
+}
+
+//
+// parseExplain
+//
+// Looks for "EXPLAIN [ANALYZE]" at the start of the statement, and if
+// found, blanks it out of rewrite->text and skips its tokens.
+//
+static void parseExplain(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  if (!isWord(&tokens->tokens[0], "EXPLAIN"))
+    return;
+
+  rewrite->explain = true;
+  rewrite->analyze = isWord(&tokens->tokens[1], "ANALYZE");
+
+  int skip = rewrite->analyze ? 2 : 1;
+
+  // blanking rather than removing keeps the offsets of the other
+  // tokens, and the positions in the parser's error messages
+  memset(rewrite->text, ' ', tokens->tokens[skip].offset);
+
+  tokens->tokens += skip;
+  tokens->numTokens -= skip;
+}
+
+//
+// isLiteral
+//
+static bool isLiteral(struct RWToken *token) {
+  return token->id == SQL_INT_LITERAL || token->id == SQL_REAL_LITERAL ||
+         token->id == SQL_STR_LITERAL;
+}
+
+//
+// literalType
+//
+// Returns the enum AST_LITERAL_TYPES of a literal token.
+//
+static int literalType(struct RWToken *token) {
+  if (token->id == SQL_INT_LITERAL)
+    return INTEGER_LITERAL;
+  else if (token->id == SQL_REAL_LITERAL)
+    return REAL_LITERAL;
+  else
+    return STRING_LITERAL;
+}
+
+//
+// parseRow
+//
+// Parses "(literal, literal, ...)" starting at token *t, advancing *t
+// past the row. The row and its values are allocated from the arena.
+// Returns NULL if there is a syntax error.
+//
+static struct VALUES *parseRow(struct RWTokens *tokens, int *t) {
+  struct RWToken *token = tokens->tokens;
+
+  if (token[*t].id != SQL_LEFT_PAREN) {
+    syntaxError(&token[*t], "(");
+    return NULL;
+  }
+  (*t)++;
+
+  // n values take 2n - 1 tokens, up to the ')':
+  int end = *t;
+  while (token[end].id != SQL_RIGHT_PAREN && token[end].id != SQL_EOS)
+    end++;
+
+  int maxValues = (end - *t) / 2 + 1;
+
+  struct VALUES *row = (struct VALUES *)arena_alloc(sizeof(struct VALUES));
+  row->litTypes = (int *)arena_alloc(sizeof(int) * maxValues);
+  row->literals = (char **)arena_alloc(sizeof(char *) * maxValues);
+  row->numValues = 0;
+  row->next = NULL;
+
+  while (true) {
+    if (!isLiteral(&token[*t])) {
+      syntaxError(&token[*t], "literal");
+      return NULL;
+    }
+
+    row->litTypes[row->numValues] = literalType(&token[*t]);
+    row->literals[row->numValues++] = token[*t].value;
+    (*t)++;
+
+    if (token[*t].id != SQL_COMMA)
+      break;
+    (*t)++;
+  }
+
+  if (token[*t].id != SQL_RIGHT_PAREN) {
+    syntaxError(&token[*t], ")");
+    return NULL;
+  }
+  (*t)++;
+
+  return row;
+}
+
+//
+// parseInsert
+//
+// If the statement is "INSERT INTO table [(column, ...)] VALUES
+// (literal, ...), (literal, ...), ...;", parses it into rewrite->query.
+// Returns false if there is a syntax error.
+//
+static bool parseInsert(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  struct RWToken *token = tokens->tokens;
+
+  if (token[0].id != SQL_KEYW_INSERT)
+    return true;
+
+  if (token[1].id != SQL_KEYW_INTO) {
+    syntaxError(&token[1], "INTO");
+    return false;
+  }
+
+  if (token[2].id != SQL_IDENTIFIER) {
+    syntaxError(&token[2], "table name");
+    return false;
+  }
+
+  struct INSERT *insert = (struct INSERT *)malloc(sizeof(struct INSERT));
+  struct QUERY *query = (struct QUERY *)malloc(sizeof(struct QUERY));
+  if (insert == NULL || query == NULL)
+    panic("out of memory");
+
+  insert->table = dupString(token[2].value);
+  insert->columns = NULL;
+  insert->values = NULL;
+  insert->numRows = 0;
+
+  query->queryType = INSERT_QUERY;
+  query->q.insert = insert;
+
+  rewrite->query = query; // freed by rewrite_destroy(), even on error
+
+  int t = 3;
+
+  if (token[t].id == SQL_LEFT_PAREN) {
+    struct COLUMN **tail = &insert->columns;
+    t++;
+
+    while (true) {
+      struct COLUMN *column = parseColumn(tokens, &t);
+      if (column == NULL)
+        return false;
+
+      *tail = column;
+      tail = &column->next;
+
+      if (token[t].id != SQL_COMMA)
+        break;
+      t++;
+    }
+
+    if (token[t].id != SQL_RIGHT_PAREN) {
+      syntaxError(&token[t], ")");
+      return false;
+    }
+    t++;
+  }
+
+  if (token[t].id != SQL_KEYW_VALUES) {
+    syntaxError(&token[t], "VALUES");
+    return false;
+  }
+  t++;
+
+  struct VALUES **tail = &insert->values;
+
+  while (true) {
+    struct VALUES *row = parseRow(tokens, &t);
+    if (row == NULL)
+      return false;
+
+    *tail = row;
+    tail = &row->next;
+    insert->numRows++;
+
+    if (token[t].id != SQL_COMMA)
+      break;
+    t++;
+  }
+
+  if (token[t].id != SQL_SEMI_COLON) {
+    syntaxError(&token[t], ";");
+    return false;
+  }
+
+  return true;
+}
+
+//
+// operatorOf
+//
+// Returns the enum AST_EXPR_OPERATORS of a comparison token, or -1 if
+// the token is not one.
+//
+static int operatorOf(struct RWToken *token) {
+  switch (token->id) {
+  case SQL_LT:
+    return EXPR_LT;
+  case SQL_LTE:
+    return EXPR_LTE;
+  case SQL_GT:
+    return EXPR_GT;
+  case SQL_GTE:
+    return EXPR_GTE;
+  case SQL_EQUAL:
+    return EXPR_EQUAL;
+  case SQL_NOT_EQUAL:
+    return EXPR_NOT_EQUAL;
+  }
+
+  return -1;
+}
+
+//
+// freePred
+//
+// Frees a where clause parsed here; its literals are in the arena.
+//
+static void freePred(struct PRED *pred) {
+  if (pred == NULL)
+    return;
+
+  freePred(pred->left);
+  freePred(pred->right);
+
+  if (pred->expr != NULL) {
+    freeColumns(pred->expr->column);
+    free(pred->expr);
+  }
+
+  free(pred);
+}
+
+//
+// newPred
+//
+// Returns a predicate of the given enum AST_PRED_TYPES, with the
+// given operands (NULL => none).
+//
+static struct PRED *newPred(int predType, struct PRED *left,
+                            struct PRED *right) {
+  struct PRED *pred = (struct PRED *)malloc(sizeof(struct PRED));
+  if (pred == NULL)
+    panic("out of memory");
+
+  pred->predType = predType;
+  pred->expr = NULL;
+  pred->values = NULL;
+  pred->litTypes = NULL;
+  pred->numValues = 0;
+  pred->left = left;
+  pred->right = right;
+
+  return pred;
+}
+
+//
+// newCompare
+//
+// Returns the comparison "column operator literal", which takes over
+// the column.
+//
+static struct PRED *newCompare(struct COLUMN *column, int operator,
+                               struct RWToken *literal) {
+  struct PRED *pred = newPred(PRED_COMPARE, NULL, NULL);
+
+  pred->expr = (struct EXPR *)malloc(sizeof(struct EXPR));
+  if (pred->expr == NULL)
+    panic("out of memory");
+
+  pred->expr->column = column;
+  pred->expr->operator = operator;
+  pred->expr->litType = literalType(literal);
+  pred->expr->value = literal->value;
+
+  return pred;
+}
+
+//
+// copyColumn
+//
+static struct COLUMN *copyColumn(struct COLUMN *column) {
+  struct COLUMN *copy = (struct COLUMN *)malloc(sizeof(struct COLUMN));
+  if (copy == NULL)
+    panic("out of memory");
+
+  copy->table = (column->table != NULL) ? dupString(column->table) : NULL;
+  copy->name = dupString(column->name);
+  copy->function = column->function;
+  copy->next = NULL;
+
+  return copy;
+}
+
+//
+// parseIn
+//
+// Parses "(literal, literal, ...)" after "column IN", starting at
+// token *t, into the predicate "column IN (...)", which takes over
+// the column. Returns NULL if there is a syntax error.
+//
+static struct PRED *parseIn(struct RWTokens *tokens, int *t,
+                            struct COLUMN *column) {
+  // the values are a row, see parseRow()
+  struct VALUES *row = parseRow(tokens, t);
+
+  if (row == NULL) {
+    freeColumns(column);
+    return NULL;
+  }
+
+  struct PRED *pred = newPred(PRED_IN, NULL, NULL);
+
+  pred->expr = (struct EXPR *)malloc(sizeof(struct EXPR));
+  if (pred->expr == NULL)
+    panic("out of memory");
+
+  pred->expr->column = column;
+  pred->expr->operator = EXPR_EQUAL;
+  pred->expr->litType = row->litTypes[0];
+  pred->expr->value = row->literals[0];
+  pred->values = row->literals;
+  pred->litTypes = row->litTypes;
+  pred->numValues = row->numValues;
+
+  return pred;
+}
+
+//
+// parseComparison
+//
+// Parses one of
+//
+//   column operator literal
+//   column [NOT] IN (literal, ...)
+//   column [NOT] BETWEEN literal AND literal
+//   column [NOT] LIKE 'pattern'
+//
+// starting at token *t, advancing *t past it. Returns NULL if there
+// is a syntax error.
+//
+static struct PRED *parseComparison(struct RWTokens *tokens, int *t) {
+  struct RWToken *token = tokens->tokens;
+  struct COLUMN *column = parseColumn(tokens, t);
+
+  if (column == NULL)
+    return NULL;
+
+  bool not = isWord(&token[*t], "NOT");
+
+  if (not)
+    (*t)++;
+
+  struct PRED *pred = NULL;
+  int operator = operatorOf(&token[*t]);
+
+  if (isWord(&token[*t], "IN")) {
+    (*t)++;
+    pred = parseIn(tokens, t, column);
+  } else if (isWord(&token[*t], "BETWEEN")) {
+    struct RWToken *low = &token[*t + 1];
+    struct RWToken *high = &token[*t + 3];
+
+    if (!isLiteral(low) || !isWord(&token[*t + 2], "AND") ||
+        !isLiteral(high)) {
+      if (!isLiteral(low))
+        syntaxError(low, "literal");
+      else if (!isWord(&token[*t + 2], "AND"))
+        syntaxError(&token[*t + 2], "AND");
+      else
+        syntaxError(high, "literal");
+
+      freeColumns(column);
+      return NULL;
+    }
+
+    // BETWEEN is inclusive at both ends
+    pred = newPred(PRED_AND, newCompare(copyColumn(column), EXPR_GTE, low),
+                   newCompare(column, EXPR_LTE, high));
+    *t += 4;
+  } else if (token[*t].id == SQL_KEYW_LIKE) {
+    if (token[*t + 1].id != SQL_STR_LITERAL) {
+      syntaxError(&token[*t + 1], "string literal");
+      freeColumns(column);
+      return NULL;
+    }
+
+    pred = newCompare(column, EXPR_LIKE, &token[*t + 1]);
+    *t += 2;
+  } else if (!not && operator >= 0) {
+    if (!isLiteral(&token[*t + 1])) {
+      syntaxError(&token[*t + 1], "literal");
+      freeColumns(column);
+      return NULL;
+    }
+
+    pred = newCompare(column, operator, &token[*t + 1]);
+    *t += 2;
+  } else {
+    syntaxError(&token[*t], not ? "IN, BETWEEN or LIKE"
+                                : "comparison operator");
+    freeColumns(column);
+    return NULL;
+  }
+
+  if (pred != NULL && not)
+    pred = newPred(PRED_NOT, pred, NULL);
+
+  return pred;
+}
+
+static struct PRED *parsePredicate(struct RWTokens *tokens, int *t);
+
+//
+// parseTerm
+//
+// Parses "NOT term", "(predicate)" or a comparison, starting at token
+// *t and advancing *t past it. Returns NULL if there is a syntax
+// error.
+//
+static struct PRED *parseTerm(struct RWTokens *tokens, int *t) {
+  struct RWToken *token = tokens->tokens;
+
+  if (isWord(&token[*t], "NOT")) {
+    (*t)++;
+
+    struct PRED *term = parseTerm(tokens, t);
+    return (term != NULL) ? newPred(PRED_NOT, term, NULL) : NULL;
+  }
+
+  if (token[*t].id != SQL_LEFT_PAREN)
+    return parseComparison(tokens, t);
+
+  (*t)++;
+
+  struct PRED *pred = parsePredicate(tokens, t);
+  if (pred == NULL)
+    return NULL;
+
+  if (token[*t].id != SQL_RIGHT_PAREN) {
+    syntaxError(&token[*t], ")");
+    freePred(pred);
+    return NULL;
+  }
+  (*t)++;
+
+  return pred;
+}
+
+//
+// parsePredicate
+//
+// Parses "term AND term OR term ...", where AND binds tighter than
+// OR, starting at token *t and advancing *t past it. Returns NULL if
+// there is a syntax error.
+//
+static struct PRED *parsePredicate(struct RWTokens *tokens, int *t) {
+  struct RWToken *token = tokens->tokens;
+  struct PRED *pred = NULL;
+
+  while (true) {
+    struct PRED *conjunction = parseTerm(tokens, t);
+
+    while (conjunction != NULL && isWord(&token[*t], "AND")) {
+      (*t)++;
+
+      struct PRED *term = parseTerm(tokens, t);
+
+      if (term == NULL) {
+        freePred(conjunction);
+        conjunction = NULL;
+      } else {
+        conjunction = newPred(PRED_AND, conjunction, term);
+      }
+    }
+
+    if (conjunction == NULL) {
+      freePred(pred);
+      return NULL;
+    }
+
+    pred = (pred == NULL) ? conjunction : newPred(PRED_OR, pred, conjunction);
+
+    if (!isWord(&token[*t], "OR"))
+      return pred;
+    (*t)++;
+  }
+}
+
+//
+// parseWhere
+//
+// If token *t is WHERE, parses the where clause that follows into
+// *where, advancing *t past it; the literals are in the arena.
+// Returns false if there is a syntax error.
+//
+static bool parseWhere(struct RWTokens *tokens, int *t, struct PRED **where) {
+  if (tokens->tokens[*t].id != SQL_KEYW_WHERE)
+    return true;
+  (*t)++;
+
+  *where = parsePredicate(tokens, t);
+
+  return *where != NULL;
+}
+
+//
+// parseSelectWhere
+//
+// Looks for the where clause of a SELECT, and if it is more than one
+// comparison (or a LIKE), parses it into rewrite->pred and blanks it
+// out of rewrite->text; a single comparison is left to the parser.
+// Returns false if there is a syntax error.
+//
+static bool parseSelectWhere(struct Rewrite *rewrite,
+                             struct RWTokens *tokens) {
+  struct RWToken *token = tokens->tokens;
+
+  if (token[0].id != SQL_KEYW_SELECT)
+    return true;
+
+  int start = 0;
+
+  while (token[start].id != SQL_KEYW_WHERE && token[start].id != SQL_EOS)
+    start++;
+
+  if (token[start].id == SQL_EOS) // no where clause
+    return true;
+
+  int t = start;
+  struct PRED *pred = NULL;
+
+  if (!parseWhere(tokens, &t, &pred))
+    return false;
+
+  // "column op literal" or "table.column op literal":
+  int numTokens = t - (start + 1);
+
+  if (pred->predType == PRED_COMPARE && pred->expr->operator != EXPR_LIKE &&
+      (numTokens == 3 || numTokens == 5)) {
+    freePred(pred);
+    return true;
+  }
+
+  rewrite->pred = pred;
+
+  // blanking keeps the offsets of the other tokens, as for EXPLAIN
+  memset(rewrite->text + token[start].offset, ' ',
+         token[t].offset - token[start].offset);
+
+  return true;
+}
+
+//
+// parseUpdate
+//
+// If the statement is "UPDATE table SET column = literal, ... [WHERE
+// ...];", parses it into rewrite->query. Returns false if there is a
+// syntax error.
+//
+static bool parseUpdate(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  struct RWToken *token = tokens->tokens;
+
+  if (token[0].id != SQL_KEYW_UPDATE)
+    return true;
+
+  if (token[1].id != SQL_IDENTIFIER) {
+    syntaxError(&token[1], "table name");
+    return false;
+  }
+
+  struct UPDATE *update = (struct UPDATE *)malloc(sizeof(struct UPDATE));
+  struct QUERY *query = (struct QUERY *)malloc(sizeof(struct QUERY));
+  if (update == NULL || query == NULL)
+    panic("out of memory");
+
+  update->table = dupString(token[1].value);
+  update->set = NULL;
+  update->where = NULL;
+
+  query->queryType = UPDATE_QUERY;
+  query->q.update = update;
+
+  rewrite->query = query; // freed by rewrite_destroy(), even on error
+
+  if (token[2].id != SQL_KEYW_SET) {
+    syntaxError(&token[2], "SET");
+    return false;
+  }
+
+  struct SET **tail = &update->set;
+  int t = 3;
+
+  while (true) {
+    struct COLUMN *column = parseColumn(tokens, &t);
+    if (column == NULL)
+      return false;
+
+    struct SET *set = (struct SET *)malloc(sizeof(struct SET));
+    if (set == NULL)
+      panic("out of memory");
+
+    set->column = column;
+    set->next = NULL;
+
+    *tail = set;
+    tail = &set->next;
+
+    if (token[t].id != SQL_EQUAL) {
+      syntaxError(&token[t], "=");
+      return false;
+    }
+
+    if (!isLiteral(&token[t + 1])) {
+      syntaxError(&token[t + 1], "literal");
+      return false;
+    }
+
+    set->litType = literalType(&token[t + 1]);
+    set->value = token[t + 1].value;
+    t += 2;
+
+    if (token[t].id != SQL_COMMA)
+      break;
+    t++;
+  }
+
+  if (!parseWhere(tokens, &t, &update->where))
+    return false;
+
+  if (token[t].id != SQL_SEMI_COLON) {
+    syntaxError(&token[t], ";");
+    return false;
+  }
+
+  return true;
+}
+
+//
+// parseDelete
+//
+// If the statement is "DELETE FROM table [WHERE ...];", parses it into
+// rewrite->query. Returns false if there is a syntax error.
+//
+static bool parseDelete(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  struct RWToken *token = tokens->tokens;
+
+  if (token[0].id != SQL_KEYW_DELETE)
+    return true;
+
+  if (token[1].id != SQL_KEYW_FROM) {
+    syntaxError(&token[1], "FROM");
+    return false;
+  }
+
+  if (token[2].id != SQL_IDENTIFIER) {
+    syntaxError(&token[2], "table name");
+    return false;
+  }
+
+  struct DELETE *delete = (struct DELETE *)malloc(sizeof(struct DELETE));
+  struct QUERY *query = (struct QUERY *)malloc(sizeof(struct QUERY));
+  if (delete == NULL || query == NULL)
+    panic("out of memory");
+
+  delete->table = dupString(token[2].value);
+  delete->where = NULL;
+
+  query->queryType = DELETE_QUERY;
+  query->q.delete = delete;
+
+  rewrite->query = query; // freed by rewrite_destroy(), even on error
+
+  int t = 3;
+
+  if (!parseWhere(tokens, &t, &delete->where))
+    return false;
+
+  if (token[t].id != SQL_SEMI_COLON) {
+    syntaxError(&token[t], ";");
+    return false;
+  }
+
+  return true;
+}
+
+//
+// freeQuery
+//
+// Frees the AST of an INSERT, UPDATE or DELETE built here; the
+// literals are in the arena.
+//
+static void freeQuery(struct QUERY *query) {
+  if (query->queryType == INSERT_QUERY) {
+    freeColumns(query->q.insert->columns);
+    free(query->q.insert->table);
+    free(query->q.insert);
+  } else if (query->queryType == UPDATE_QUERY) {
+    struct SET *set = query->q.update->set;
+
+    while (set != NULL) {
+      struct SET *next = set->next;
+      freeColumns(set->column);
+      free(set);
+      set = next;
+    }
+
+    freePred(query->q.update->where);
+    free(query->q.update->table);
+    free(query->q.update);
+  } else {
+    freePred(query->q.delete->where);
+    free(query->q.delete->table);
+    free(query->q.delete);
+  }
+
+  free(query);
+}
+
+//
+// parseShape
+//
+// Builds rewrite->shape from the tokens, and collects the literals
+// into rewrite->literals.
+//
+static void parseShape(struct Rewrite *rewrite, struct RWTokens *tokens) {
+  int length = 1; // null terminator
+  int numLiterals = 0;
+
+  for (int t = 0; t < tokens->numTokens - 1; t++) { // skipping SQL_EOS
+    length += strlen(tokens->tokens[t].value) + 8; // + "?string "
+    if (isLiteral(&tokens->tokens[t]))
+      numLiterals++;
+  }
+
+  rewrite->shape = (char *)malloc(sizeof(char) * length);
+  rewrite->literals = (char **)malloc(sizeof(char *) * (numLiterals + 1));
+  if (rewrite->shape == NULL || rewrite->literals == NULL)
+    panic("out of memory");
+
+  char *cp = rewrite->shape;
+
+  for (int t = 0; t < tokens->numTokens - 1; t++) {
+    struct RWToken *token = &tokens->tokens[t];
+
+    if (token->id == SQL_INT_LITERAL)
+      cp = stpcpy(cp, "?int ");
+    else if (token->id == SQL_REAL_LITERAL)
+      cp = stpcpy(cp, "?real ");
+    else if (token->id == SQL_STR_LITERAL)
+      cp = stpcpy(cp, "?string ");
+    else {
+      cp = stpcpy(cp, token->value);
+      cp = stpcpy(cp, " ");
+    }
+
+    if (isLiteral(token))
+      rewrite->literals[rewrite->numLiterals++] = dupString(token->value);
+  }
+
+  *cp = '\0';
+}
+
+//
+// rewrite_statement
+//
+struct Rewrite *rewrite_statement(char *statement) {
+  struct Rewrite *rewrite = (struct Rewrite *)malloc(sizeof(struct Rewrite));
+  if (rewrite == NULL)
+    panic("out of memory");
+
+  rewrite->text = dupString(statement);
+  rewrite->groupby = NULL;
+  rewrite->pred = NULL;
+  rewrite->numLiterals = 0;
+  rewrite->bound = false;
+  rewrite->savedValue = NULL;
+  rewrite->savedLimit = 0;
+  rewrite->explain = false;
+  rewrite->analyze = false;
+  rewrite->query = NULL;
+
+  struct RWTokens tokens;
+  tokenize(statement, &tokens);
+
+  // the shape leaves out EXPLAIN, so the plain statement's AST is used
+  parseExplain(rewrite, &tokens);
+
+  // GROUP BY has no literals, so removing it below leaves the
+  // literals of the text in the same order
+  parseShape(rewrite, &tokens);
+
+  // the tokens are in the query's arena, so are not freed here
+  bool success = parseInsert(rewrite, &tokens) &&
+                 parseUpdate(rewrite, &tokens) &&
+                 parseDelete(rewrite, &tokens);
+
+  if (success && rewrite->query == NULL)
+    success = parseGroupBy(rewrite, &tokens) &&
+              parseSelectWhere(rewrite, &tokens);
+
+  if (!success) {
+    rewrite_destroy(rewrite);
+    return NULL;
+  }
+
+  return rewrite;
+}
+
+//
+// findPrepared
+//
+// Returns a pointer to the link to the prepared statement with the
+// given name, or NULL if there is none.
+//
+static struct Prepared **findPrepared(struct Prepared **prepared,
+                                      char *name) {
+  for (; *prepared != NULL; prepared = &(*prepared)->next) {
+    if (icmpStrings((*prepared)->name, name) == 0)
+      return prepared;
+  }
+
+  return NULL;
+}
+
+static void notPrepared(char *name) {
+  fprintf(session_output(),
+          "**SEMANTIC ERROR: prepared statement '%s' does not exist\n",
+          name);
+}
+
+static bool isParameter(struct RWToken *token) {
+  return token->id == SQL_UNKNOWN && strcmp(token->value, "?") == 0;
+}
+
+//
+// prepare
+//
+// PREPARE name AS statement;
+//
+static void prepare(char *statement, struct RWTokens *tokens,
+                    struct Prepared **prepared) {
+  struct RWToken *name = &tokens->tokens[1];
+
+  if (name->id != SQL_IDENTIFIER) {
+    syntaxError(name, "statement name");
+    return;
+  }
+
+  if (!isWord(&tokens->tokens[2], "AS")) {
+    syntaxError(&tokens->tokens[2], "AS");
+    return;
+  }
+
+  if (tokens->tokens[3].id == SQL_SEMI_COLON ||
+      tokens->tokens[3].id == SQL_EOS) {
+    syntaxError(&tokens->tokens[3], "statement");
+    return;
+  }
+
+  struct Prepared **link = findPrepared(prepared, name->value);
+  struct Prepared *p;
+
+  if (link != NULL) { // replacing the existing one:
+    p = *link;
+    free(p->text);
+  } else {
+    p = (struct Prepared *)malloc(sizeof(struct Prepared));
+    if (p == NULL)
+      panic("out of memory");
+
+    p->name = dupString(name->value);
+    p->next = *prepared;
+    *prepared = p;
+  }
+
+  p->text = dupString(statement + tokens->tokens[3].offset);
+  p->numParams = 0;
+
+  for (int t = 3; t < tokens->numTokens; t++) {
+    if (isParameter(&tokens->tokens[t]))
+      p->numParams++;
+  }
+}
+
+//
+// deallocate
+//
+// DEALLOCATE name;
+//
+static void deallocate(struct RWTokens *tokens, struct Prepared **prepared) {
+  struct RWToken *name = &tokens->tokens[1];
+
+  if (name->id != SQL_IDENTIFIER) {
+    syntaxError(name, "statement name");
+    return;
+  }
+
+  struct Prepared **link = findPrepared(prepared, name->value);
+
+  if (link == NULL) {
+    notPrepared(name->value);
+    return;
+  }
+
+  struct Prepared *p = *link;
+
+  *link = p->next;
+  p->next = NULL;
+  rewrite_freePrepared(p);
+}
+
+//
+// executePrepared
+//
+// EXECUTE name (literal, literal, ...);
+//
+// Returns the prepared statement with each ? replaced by the matching
+// literal, or NULL on error.
+//
+static char *executePrepared(struct RWTokens *tokens,
+                             struct Prepared **prepared) {
+  struct RWToken *name = &tokens->tokens[1];
+
+  if (name->id != SQL_IDENTIFIER) {
+    syntaxError(name, "statement name");
+    return NULL;
+  }
+
+  struct RWToken **args = (struct RWToken **)arena_alloc(
+      sizeof(struct RWToken *) * tokens->numTokens);
+  int numArgs = 0;
+  int t = 2;
+
+  if (tokens->tokens[t].id == SQL_LEFT_PAREN) {
+    t++;
+
+    while (true) {
+      if (!isLiteral(&tokens->tokens[t])) {
+        syntaxError(&tokens->tokens[t], "literal");
+        return NULL;
+      }
+
+      args[numArgs++] = &tokens->tokens[t++];
+
+      if (tokens->tokens[t].id != SQL_COMMA)
+        break;
+      t++;
+    }
+
+    if (tokens->tokens[t].id != SQL_RIGHT_PAREN) {
+      syntaxError(&tokens->tokens[t], ")");
+      return NULL;
+    }
+    t++;
+  }
+
+  if (tokens->tokens[t].id != SQL_SEMI_COLON) {
+    syntaxError(&tokens->tokens[t], ";");
+    return NULL;
+  }
+
+  struct Prepared **link = findPrepared(prepared, name->value);
+
+  if (link == NULL) {
+    notPrepared(name->value);
+    return NULL;
+  }
+
+  struct Prepared *p = *link;
+
+  if (numArgs != p->numParams) {
+    fprintf(session_output(),
+            "**SEMANTIC ERROR: prepared statement '%s' expects %d "
+            "parameters, found %d\n",
+            p->name, p->numParams, numArgs);
+    return NULL;
+  }
+
+  //
+  // copying the text, with each parameter replaced by its literal (a
+  // string is quoted again, with a quote it does not contain):
+  //
+  int length = strlen(p->text) + 1;
+
+  for (int a = 0; a < numArgs; a++)
+    length += strlen(args[a]->value) + 2;
+
+  char *text = (char *)malloc(sizeof(char) * length);
+  if (text == NULL)
+    panic("out of memory");
+
+  struct RWTokens body;
+  tokenize(p->text, &body);
+
+  char *cp = text;
+  int from = 0; // offset in p->text not yet copied
+  int a = 0;
+
+  for (int b = 0; b < body.numTokens; b++) {
+    if (!isParameter(&body.tokens[b]))
+      continue;
+
+    int offset = body.tokens[b].offset;
+    struct RWToken *arg = args[a++];
+
+    memcpy(cp, p->text + from, offset - from);
+    cp += offset - from;
+    from = offset + 1; // skipping the ?
+
+    if (arg->id == SQL_STR_LITERAL) {
+      char quote = (strchr(arg->value, '\'') == NULL) ? '\'' : '"';
+      cp += sprintf(cp, "%c%s%c", quote, arg->value, quote);
+    } else {
+      cp = stpcpy(cp, arg->value);
+    }
+  }
+
+  strcpy(cp, p->text + from);
+
+  return text;
+}
+
+//
+// rewrite_prepared
+//
+char *rewrite_prepared(char *statement, struct Prepared **prepared) {
+  struct RWTokens tokens;
+  tokenize(statement, &tokens);
+
+  struct RWToken *first = &tokens.tokens[0];
+
+  if (isWord(first, "PREPARE")) {
+    prepare(statement, &tokens, prepared);
+    return NULL;
+  } else if (isWord(first, "DEALLOCATE")) {
+    deallocate(&tokens, prepared);
+    return NULL;
+  } else if (isWord(first, "EXECUTE")) {
+    return executePrepared(&tokens, prepared);
+  }
+
+  return dupString(statement);
+}
+
+//
+// rewrite_freePrepared
+//
+void rewrite_freePrepared(struct Prepared *prepared) {
+  while (prepared != NULL) {
+    struct Prepared *next = prepared->next;
+
+    free(prepared->name);
+    free(prepared->text);
+    free(prepared);
+    prepared = next;
+  }
+}
+
+//
+// resolveColumn
+//
+// Finds the column in the given tables (the FROM table, and the JOIN
+// table if any), and fills in its table name and the column name as
+// spelled in the meta-data. Returns false if the column does not
+// exist; an error message was output.
+//
+static bool resolveColumn(struct COLUMN *column, struct TableMeta **tables,
+                          int numTables) {
+  for (int t = 0; t < numTables; t++) {
+    struct TableMeta *table = tables[t];
+
+    if (column->table != NULL && icmpStrings(column->table, table->name) != 0)
+      continue;
+
+    for (int c = 0; c < table->numColumns; c++) {
+      if (icmpStrings(table->columns[c].name, column->name) == 0) {
+        free(column->table);
+        free(column->name);
+        column->table = dupString(table->name);
+        column->name = dupString(table->columns[c].name);
+        return true;
+      }
+    }
+  }
+
+  if (column->table != NULL)
+    fprintf(session_output(),
+            "**SEMANTIC ERROR: column '%s.%s' does not exist\n", column->table,
+            column->name);
+  else
+    fprintf(session_output(), "**SEMANTIC ERROR: column '%s' does not exist\n",
+            column->name);
+
+  return false;
+}
+
+//
+// sameColumn
+//
+static bool sameColumn(struct COLUMN *c1, struct COLUMN *c2) {
+  return icmpStrings(c1->table, c2->table) == 0 &&
+         icmpStrings(c1->name, c2->name) == 0;
+}
+
+//
+// selectTables
+//
+// Fills in the meta-data of the SELECT's tables, the FROM table and
+// the JOIN table if any, returning their #.
+//
+static int selectTables(struct Database *db, struct SELECT *select,
+                        struct TableMeta *tables[2]) {
+  int numTables = 0;
+
+  tables[numTables++] = table_find(db, select->table);
+  if (select->join != NULL)
+    tables[numTables++] = table_find(db, select->join->table);
+
+  for (int t = 0; t < numTables; t++)
+    assert(tables[t] != NULL);
+
+  return numTables;
+}
+
+//
+// applyGroupBy
+//
+static bool applyGroupBy(struct Database *db, struct GROUPBY *groupby,
+                         struct SELECT *select) {
+  struct TableMeta *tables[2];
+  int numTables = selectTables(db, select, tables);
+
+  for (struct COLUMN *column = groupby->columns; column != NULL;
+       column = column->next) {
+    if (!resolveColumn(column, tables, numTables))
+      return false;
+  }
+
+  //
+  // every column in the select list must either be grouped on, or
+  // have a function applied to it:
+  //
+  for (struct COLUMN *column = select->columns; column != NULL;
+       column = column->next) {
+    if (column->function != NO_FUNCTION)
+      continue;
+
+    bool grouped = false;
+    for (struct COLUMN *group = groupby->columns; group != NULL;
+         group = group->next) {
+      if (sameColumn(column, group))
+        grouped = true;
+    }
+
+    if (!grouped) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: column '%s.%s' must appear in the GROUP BY "
+              "clause or be used in a function\n",
+              column->table, column->name);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool fitsInt(long long value) {
+  return value >= INT_MIN && value <= INT_MAX;
+}
+
+//
+// validValue
+//
+// Returns true if a literal of the given enum AST_LITERAL_TYPES is a
+// valid value for the column; otherwise outputs an error message.
+//
+static bool validValue(struct TableMeta *meta, struct ColumnMeta *column,
+                       int litType, char *literal) {
+  bool valid;
+
+  if (column->colType == COL_TYPE_INT)
+    valid = (litType == INTEGER_LITERAL) && fitsInt(strtoll(literal, NULL, 10));
+  else if (column->colType == COL_TYPE_REAL)
+    valid = (litType != STRING_LITERAL);
+  else
+    valid = (litType == STRING_LITERAL);
+
+  if (!valid)
+    fprintf(session_output(),
+            "**SEMANTIC ERROR: value '%s' is not valid for column '%s.%s'\n",
+            literal, meta->name, column->name);
+
+  return valid;
+}
+
+//
+// resolveTable
+//
+// Returns the meta-data of the given table of an action query, whose
+// name is then spelled as in the meta-data, or NULL if there is no
+// such table; an error message was output.
+//
+static struct TableMeta *resolveTable(struct Database *db, char **table) {
+  struct TableMeta *meta = table_find(db, *table);
+
+  if (meta == NULL) {
+    fprintf(session_output(), "**SEMANTIC ERROR: table '%s' does not exist\n",
+            *table);
+    return NULL;
+  }
+
+  free(*table);
+  *table = dupString(meta->name);
+
+  return meta;
+}
+
+//
+// columnOf
+//
+// Returns the meta-data of the column, which was resolved against the
+// table (see resolveColumn).
+//
+static struct ColumnMeta *columnOf(struct TableMeta *meta,
+                                   struct COLUMN *column) {
+  for (int c = 0; c < meta->numColumns; c++) {
+    if (strcmp(meta->columns[c].name, column->name) == 0)
+      return &meta->columns[c];
+  }
+
+  panic("column does not exist (rewrite)");
+  return NULL;
+}
+
+//
+// applyPred
+//
+// Checks a where clause against the meta-data of the given tables:
+// each column exists, each literal is a number for a number column,
+// or a string for a string column, and LIKE is on a string column.
+//
+static bool applyPred(struct PRED *pred, struct TableMeta **tables,
+                      int numTables) {
+  if (pred == NULL)
+    return true;
+
+  if (pred->predType == PRED_AND || pred->predType == PRED_OR)
+    return applyPred(pred->left, tables, numTables) &&
+           applyPred(pred->right, tables, numTables);
+  else if (pred->predType == PRED_NOT)
+    return applyPred(pred->left, tables, numTables);
+
+  struct EXPR *expr = pred->expr;
+
+  if (!resolveColumn(expr->column, tables, numTables))
+    return false;
+
+  struct TableMeta *meta = NULL;
+
+  for (int t = 0; t < numTables; t++) {
+    if (strcmp(tables[t]->name, expr->column->table) == 0)
+      meta = tables[t];
+  }
+
+  struct ColumnMeta *column = columnOf(meta, expr->column);
+
+  if (expr->operator == EXPR_LIKE && column->colType != COL_TYPE_STRING) {
+    fprintf(session_output(),
+            "**SEMANTIC ERROR: LIKE requires a string column, '%s.%s' is "
+            "not\n",
+            meta->name, column->name);
+    return false;
+  }
+
+  // a comparison has one literal, IN has a list of them
+  int numValues = (pred->predType == PRED_IN) ? pred->numValues : 1;
+
+  for (int v = 0; v < numValues; v++) {
+    int litType = (pred->predType == PRED_IN) ? pred->litTypes[v]
+                                              : expr->litType;
+    char *value = (pred->predType == PRED_IN) ? pred->values[v] : expr->value;
+
+    if ((column->colType == COL_TYPE_STRING) != (litType == STRING_LITERAL)) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: value '%s' is not valid for column "
+              "'%s.%s'\n",
+              value, meta->name, column->name);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// applyInsert
+//
+// Checks the INSERT against the table's meta-data: the table and the
+// columns given exist, each row has a value for each column, and each
+// value is of its column's type.
+//
+static bool applyInsert(struct Database *db, struct INSERT *insert) {
+  struct TableMeta *meta = resolveTable(db, &insert->table);
+
+  if (meta == NULL)
+    return false;
+
+  //
+  // the values are for the columns given, in that order, otherwise
+  // for every column of the table:
+  //
+  int numColumns = (insert->columns == NULL) ? meta->numColumns : 0;
+  int positions[meta->numColumns + 1];
+
+  for (int c = 0; insert->columns == NULL && c < meta->numColumns; c++)
+    positions[c] = c;
+
+  for (struct COLUMN *column = insert->columns; column != NULL;
+       column = column->next) {
+    if (!resolveColumn(column, &meta, 1))
+      return false;
+
+    for (struct COLUMN *other = insert->columns; other != column;
+         other = other->next) {
+      if (sameColumn(column, other)) {
+        fprintf(session_output(),
+                "**SEMANTIC ERROR: column '%s.%s' is given more than once\n",
+                column->table, column->name);
+        return false;
+      }
+    }
+
+    for (int c = 0; c < meta->numColumns; c++) {
+      if (strcmp(meta->columns[c].name, column->name) == 0)
+        positions[numColumns++] = c;
+    }
+  }
+
+  // omitted columns are empty, which a primary key cannot be
+  for (int c = 0; c < meta->numColumns; c++) {
+    bool given = false;
+
+    for (int i = 0; i < numColumns; i++)
+      given = given || (positions[i] == c);
+
+    if (!given && meta->columns[c].indexType == COL_UNIQUE_INDEXED) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: a value is required for column '%s.%s'\n",
+              meta->name, meta->columns[c].name);
+      return false;
+    }
+  }
+
+  int rowNumber = 1;
+
+  for (struct VALUES *row = insert->values; row != NULL;
+       row = row->next, rowNumber++) {
+    if (row->numValues != numColumns) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: row %d of INSERT has %d values, expected "
+              "%d\n",
+              rowNumber, row->numValues, numColumns);
+      return false;
+    }
+
+    for (int v = 0; v < row->numValues; v++) {
+      if (!validValue(meta, &meta->columns[positions[v]], row->litTypes[v],
+                      row->literals[v]))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// applyUpdate
+//
+// Checks the UPDATE against the table's meta-data: the table and the
+// columns exist, each column is set once, and each value is of its
+// column's type.
+//
+static bool applyUpdate(struct Database *db, struct UPDATE *update) {
+  struct TableMeta *meta = resolveTable(db, &update->table);
+
+  if (meta == NULL)
+    return false;
+
+  for (struct SET *set = update->set; set != NULL; set = set->next) {
+    if (!resolveColumn(set->column, &meta, 1))
+      return false;
+
+    for (struct SET *other = update->set; other != set; other = other->next) {
+      if (sameColumn(set->column, other->column)) {
+        fprintf(session_output(),
+                "**SEMANTIC ERROR: column '%s.%s' is given more than once\n",
+                set->column->table, set->column->name);
+        return false;
+      }
+    }
+
+    if (!validValue(meta, columnOf(meta, set->column), set->litType,
+                    set->value))
+      return false;
+  }
+
+  return applyPred(update->where, &meta, 1);
+}
+
+//
+// applyDelete
+//
+static bool applyDelete(struct Database *db, struct DELETE *delete) {
+  struct TableMeta *meta = resolveTable(db, &delete->table);
+
+  if (meta == NULL)
+    return false;
+
+  return applyPred(delete->where, &meta, 1);
+}
+
+//
+// countLiterals
+//
+static int countLiterals(struct PRED *pred) {
+  if (pred == NULL)
+    return 0;
+  else if (pred->predType == PRED_COMPARE)
+    return 1;
+  else if (pred->predType == PRED_IN)
+    return pred->numValues;
+  else
+    return countLiterals(pred->left) + countLiterals(pred->right);
+}
+
+//
+// bindLiterals
+//
+// Binds the statement's literals into the AST: in a SELECT, the only
+// literals are the WHERE clause's, followed by the LIMIT. A compound
+// where clause is the rewrite's own, so its literals are skipped. If
+// the AST does not have exactly that many, nothing is bound.
+//
+static void bindLiterals(struct Rewrite *rewrite, struct SELECT *select) {
+  int l = countLiterals(rewrite->pred);
+  int expected = l + (select->where != NULL) + (select->limit != NULL);
+
+  if (rewrite->numLiterals != expected)
+    return;
+
+  if (select->where != NULL) {
+    rewrite->savedValue = select->where->expr->value;
+    select->where->expr->value = rewrite->literals[l++];
+  }
+
+  if (select->limit != NULL) {
+    rewrite->savedLimit = select->limit->N;
+    select->limit->N = atoi(rewrite->literals[l++]);
+  }
+
+  rewrite->bound = true;
+}
+
+//
+// rewrite_apply
+//
+bool rewrite_apply(struct Database *db, struct Rewrite *rewrite,
+                   struct QUERY *query) {
+  if (query == rewrite->query && query->queryType == INSERT_QUERY)
+    return applyInsert(db, query->q.insert);
+  else if (query == rewrite->query && query->queryType == UPDATE_QUERY)
+    return applyUpdate(db, query->q.update);
+  else if (query == rewrite->query)
+    return applyDelete(db, query->q.delete);
+
+  if (query->queryType != SELECT_QUERY) {
+    // an extended clause of a statement the parser does not know
+    if (rewrite->groupby != NULL) {
+      fprintf(session_output(),
+              "**SEMANTIC ERROR: GROUP BY is only supported in SELECT\n");
+      return false;
+    }
+    return true;
+  }
+
+  struct SELECT *select = query->q.select;
+
+  if (rewrite->groupby != NULL && !applyGroupBy(db, rewrite->groupby, select))
+    return false;
+
+  if (rewrite->pred != NULL) {
+    struct TableMeta *tables[2];
+    int numTables = selectTables(db, select, tables);
+
+    if (!applyPred(rewrite->pred, tables, numTables))
+      return false;
+  }
+
+  bindLiterals(rewrite, select);
+
+  return true;
+}
+
+//
+// rewrite_detach
+//
+void rewrite_detach(struct Rewrite *rewrite, struct QUERY *query) {
+  if (query->queryType != SELECT_QUERY)
+    return;
+
+  struct SELECT *select = query->q.select;
+
+  if (rewrite->bound) {
+    if (select->where != NULL)
+      select->where->expr->value = rewrite->savedValue;
+    if (select->limit != NULL)
+      select->limit->N = rewrite->savedLimit;
+
+    rewrite->bound = false;
+  }
+}
+
+//
+// rewrite_destroy
+//
+void rewrite_destroy(struct Rewrite *rewrite) {
+  if (rewrite == NULL)
+    return;
+
+  if (rewrite->groupby != NULL) {
+    freeColumns(rewrite->groupby->columns);
+    free(rewrite->groupby);
+  }
+
+  freePred(rewrite->pred);
+
+  if (rewrite->query != NULL)
+    freeQuery(rewrite->query);
+
+  for (int l = 0; l < rewrite->numLiterals; l++)
+    free(rewrite->literals[l]);
+
+  free(rewrite->literals);
+  free(rewrite->shape);
+  free(rewrite->text);
+  free(rewrite);
+}
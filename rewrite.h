@@ -0,0 +1,172 @@
+/*rewrite.h*/
+
+//
+// Project: Rewriting of extended SimpleSQL statements
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+
+#include "ast.h"
+#include "database.h"
+
+//
+// The parser and analyzer accept the base subset of SQL. A statement
+// may also use extended syntax that they do not know about:
+//
+//   SELECT ... FROM ... [WHERE ...] GROUP BY column, column, ...
+//   EXPLAIN [ANALYZE] SELECT ...
+//   INSERT INTO table [(column, ...)] VALUES (literal, ...), ...;
+//   UPDATE table SET column = literal, ... [WHERE ...];
+//   DELETE FROM table [WHERE ...];
+//
+// where a WHERE clause is either "column op literal", which the parser
+// knows, or combines comparisons with AND, OR, NOT and parentheses,
+// where a comparison may also be
+//
+//   column [NOT] IN (literal, literal, ...)
+//   column [NOT] BETWEEN literal AND literal
+//   column [NOT] LIKE 'pattern'
+//
+// and a pattern matches any string for a %, and any character for a _.
+//
+// Before a statement is parsed, the extended clauses are removed
+// from its text and parsed here; the remaining text is then parsed
+// and analyzed as usual, and finally the extended clauses are
+// checked against the resulting AST; they are kept here, since the
+// AST's structs are laid out by the analyzer. An INSERT, UPDATE or
+// DELETE is parsed here in full, into rewrite->query, and is not
+// passed to the parser at all.
+//
+// The rewrite also records the statement's shape: its tokens with
+// each literal replaced by a placeholder for its type, e.g.
+//
+//   SELECT * FROM Movies WHERE Year > ?int LIMIT ?int ;
+//
+// Statements with the same shape differ only in their literals, so
+// they can share one AST (see plancache.h): rewrite_apply() binds the
+// statement's literals into the AST, and rewrite_detach() restores
+// the AST's own.
+//
+struct Rewrite {
+  char *text; // statement with the extended clauses removed
+
+  struct GROUPBY *groupby; // OPTIONAL group by clause
+  struct PRED *pred;       // OPTIONAL compound where clause of a SELECT
+  bool explain;            // true => EXPLAIN, output the plan instead
+  bool analyze;            // true => EXPLAIN ANALYZE, also run the plan
+  struct QUERY *query;     // INSERT etc.: its AST, built here, else NULL
+
+  char *shape;     // statement with literals replaced, see above
+  char **literals; // ARRAY: each literal of the statement, in order
+  int numLiterals;
+
+  bool bound;       // true => literals are bound into the AST
+  char *savedValue; // the AST's own where literal, while bound
+  int savedLimit;   // the AST's own limit, while bound
+};
+
+//
+// A prepared statement, created by
+//
+//   PREPARE name AS statement;
+//
+// where the statement has a ? in place of each parameter. It is run by
+//
+//   EXECUTE name (literal, literal, ...);
+//
+// with one literal per parameter, and dropped by DEALLOCATE name;
+//
+struct Prepared {
+  char *name;
+  char *text; // the statement, with a ? for each parameter
+  int numParams;
+  struct Prepared *next;
+};
+
+//
+// Functions:
+//
+
+//
+// rewrite_read
+//
+// Reads the next statement from the input stream, up to and
+// including the ';' that ends it (a ';' within a string literal
+// does not end the statement).
+//
+// Returns NULL on EOF. Otherwise returns the statement, which the
+// caller must free.
+//
+char *rewrite_read(FILE *input);
+
+//
+// rewrite_prepared
+//
+// Carries out a PREPARE or DEALLOCATE statement, adding to or removing
+// from the given list of prepared statements, and returns NULL. For an
+// EXECUTE statement, returns the prepared statement with the literals
+// in place of its parameters. Any other statement is returned as is.
+//
+// Returns NULL if there is an error; in this case an error message was
+// output. Otherwise the caller must free the statement returned.
+//
+char *rewrite_prepared(char *statement, struct Prepared **prepared);
+
+//
+// rewrite_freePrepared
+//
+// Frees a list of prepared statements.
+//
+void rewrite_freePrepared(struct Prepared *prepared);
+
+//
+// rewrite_statement
+//
+// Removes the extended clauses from the given statement and parses
+// them. Returns NULL if an extended clause has a syntax error; in
+// this case an error message was output. Otherwise returns a pointer
+// to a Rewrite, where text holds the statement for parser_parse(), or
+// query holds the AST of an INSERT, UPDATE or DELETE (whose literals
+// are in the query's arena, see arena.h).
+//
+// NOTE: it is the callers responsibility to free the resources
+// used by the Rewrite by calling rewrite_destroy().
+//
+struct Rewrite *rewrite_statement(char *statement);
+
+//
+// rewrite_apply
+//
+// Given the AST built from rewrite->text --- or from another statement
+// of the same shape --- checks the extended clauses for semantic errors
+// and binds the statement's literals into the AST. The clauses of a
+// SELECT stay in the Rewrite (rewrite->groupby and rewrite->pred),
+// where execute_query() finds them. Returns false if a semantic error
+// was found; in this case an error message was output.
+//
+// NOTE: the bound literals are still owned by the Rewrite, so call
+// rewrite_detach() before destroying either one.
+//
+bool rewrite_apply(struct Database *db, struct Rewrite *rewrite,
+                   struct QUERY *query);
+
+//
+// rewrite_detach
+//
+// Undoes rewrite_apply(): restores the AST's own literals, so the AST
+// outlives the Rewrite.
+//
+void rewrite_detach(struct Rewrite *rewrite, struct QUERY *query);
+
+//
+// rewrite_destroy
+//
+// Frees the memory associated with the rewrite, including any
+// extended clauses.
+//
+void rewrite_destroy(struct Rewrite *rewrite);
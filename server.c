@@ -0,0 +1,392 @@
+/*server.c*/
+
+//
+// Project: Query server for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h> // clock_gettime
+#include <unistd.h>
+
+#include "arena.h"
+#include "bufferpool.h"
+#include "database.h"
+#include "resultcache.h"
+#include "server.h"
+#include "session.h"
+#include "util.h"
+#include "wal.h"
+
+//
+// # of accepted connections that may wait for a thread; once the
+// queue is full, no more are accepted until a thread frees up.
+//
+#define SERVER_MAX_PENDING 64
+
+//
+// while the queue is full, how often (in ms) the accepting thread
+// checks whether SIGINT or SIGTERM asked the server to stop
+//
+#define SERVER_STOP_CHECK_MS 100
+
+//
+// A database that stays open for the life of the server:
+//
+struct Resident {
+  char *name;
+  struct Database *db;
+};
+
+struct Server {
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty; // signaled when a connection is queued
+  pthread_cond_t notFull;  // signaled when a connection is dequeued
+
+  int pending[SERVER_MAX_PENDING]; // circular queue of client sockets
+  int first;                       // index of the oldest in pending
+  int numPending;
+  bool stopping;
+
+  int *active; // ARRAY: socket of each thread's client, or -1
+  int numThreads;
+
+  pthread_mutex_t residentLock; // held while finding/opening a database
+  struct Resident *residents;   // ARRAY: databases opened so far
+  int numResidents;
+};
+
+static struct Server server;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int signal) {
+  (void)signal;
+  stopRequested = 1;
+}
+
+//
+// openDatabase
+//
+// Returns the open database with the given name, opening it if no
+// session has used it yet. Returns NULL if it cannot be opened.
+//
+static struct Database *openDatabase(char *name) {
+  struct Database *db = NULL;
+
+  pthread_mutex_lock(&server.residentLock);
+
+  for (int r = 0; r < server.numResidents; r++) {
+    if (strcmp(server.residents[r].name, name) == 0) {
+      db = server.residents[r].db;
+      break;
+    }
+  }
+
+  if (db == NULL) {
+    db = database_open(name);
+
+    if (db != NULL) {
+      wal_recover(db);
+
+      server.residents = (struct Resident *)realloc(
+          server.residents,
+          sizeof(struct Resident) * (server.numResidents + 1));
+      if (server.residents == NULL)
+        panic("out of memory");
+
+      server.residents[server.numResidents].name = dupString(name);
+      server.residents[server.numResidents].db = db;
+      server.numResidents++;
+    }
+  }
+
+  pthread_mutex_unlock(&server.residentLock);
+
+  return db;
+}
+
+//
+// serveClient
+//
+// Runs a session for the client connected to the given socket, and
+// then closes the socket.
+//
+static void serveClient(int client) {
+  int copy = dup(client);
+  FILE *input = fdopen(client, "r");
+  FILE *output = (copy >= 0) ? fdopen(copy, "w") : NULL;
+
+  if (input == NULL || output == NULL) {
+    // e.g. out of file descriptors: drop the connection, not the server
+    fprintf(stderr, "**Error: unable to serve client: %s\n", strerror(errno));
+
+    if (output != NULL)
+      fclose(output);
+    else if (copy >= 0)
+      close(copy);
+
+    if (input != NULL)
+      fclose(input);
+    else
+      close(client);
+
+    return;
+  }
+
+  session_setOutput(output);
+
+  char database[DATABASE_MAX_ID_LENGTH + 1]; // +1 for null terminator
+  char format[16];
+
+  snprintf(format, sizeof(format), "%%%ds", DATABASE_MAX_ID_LENGTH);
+
+  fprintf(output, "database? ");
+  fflush(output);
+
+  if (fscanf(input, format, database) == 1) {
+    struct Database *db = openDatabase(database);
+
+    if (db == NULL) {
+      fprintf(output, "**Error: unable to open database '%s'\n", database);
+    } else {
+      session_run(db, input);
+    }
+  }
+
+  session_setOutput(NULL);
+
+  fclose(output);
+  fclose(input);
+}
+
+//
+// server_work
+//
+// The body of each thread in the pool: runs a session for each
+// queued connection, until the server stops.
+//
+static void *server_work(void *arg) {
+  int thread = (int)(long)arg;
+
+  while (true) {
+    pthread_mutex_lock(&server.lock);
+
+    while (server.numPending == 0 && !server.stopping)
+      pthread_cond_wait(&server.notEmpty, &server.lock);
+
+    if (server.stopping) {
+      pthread_mutex_unlock(&server.lock);
+      break;
+    }
+
+    int client = server.pending[server.first];
+
+    server.first = (server.first + 1) % SERVER_MAX_PENDING;
+    server.numPending--;
+    server.active[thread] = client;
+
+    pthread_cond_signal(&server.notFull);
+    pthread_mutex_unlock(&server.lock);
+
+    serveClient(client);
+
+    pthread_mutex_lock(&server.lock);
+    server.active[thread] = -1;
+    pthread_mutex_unlock(&server.lock);
+  }
+
+  arena_release();
+
+  return NULL;
+}
+
+//
+// listenOn
+//
+// Creates the socket at the given path and listens on it, returning
+// the socket or -1 on error. A socket left behind by a previous
+// server is replaced.
+//
+static int listenOn(char *path) {
+  struct sockaddr_un address;
+  struct stat status;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "**Error: socket path '%s' is too long\n", path);
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+    unlink(path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (listener < 0 ||
+      bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(listener, SOMAXCONN) != 0) {
+    fprintf(stderr, "**Error: unable to listen on '%s': %s\n", path,
+            strerror(errno));
+    if (listener >= 0)
+      close(listener);
+    return -1;
+  }
+
+  return listener;
+}
+
+//
+// server_run
+//
+int server_run(char *path, int numThreads) {
+  int listener = listenOn(path);
+
+  if (listener < 0)
+    return -1;
+
+  memset(&server, 0, sizeof(server));
+  pthread_mutex_init(&server.lock, NULL);
+  pthread_mutex_init(&server.residentLock, NULL);
+  pthread_cond_init(&server.notEmpty, NULL);
+  pthread_cond_init(&server.notFull, NULL);
+
+  server.numThreads = numThreads;
+  server.active = (int *)malloc(sizeof(int) * numThreads);
+  pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * numThreads);
+  if (server.active == NULL || threads == NULL)
+    panic("out of memory");
+
+  //
+  // a client that disconnects mid-query must not kill the server, and
+  // SIGINT / SIGTERM are handled by this thread only: the pool threads
+  // inherit a mask that blocks them.
+  //
+  signal(SIGPIPE, SIG_IGN);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal; // no SA_RESTART, so accept() is interrupted
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  sigset_t stopSignals, previous;
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+
+  for (int t = 0; t < numThreads; t++) {
+    server.active[t] = -1;
+
+    if (pthread_create(&threads[t], NULL, server_work, (void *)(long)t) != 0)
+      panic("unable to create server thread");
+  }
+
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+  fprintf(stderr, "listening on '%s' with %d threads\n", path, numThreads);
+
+  //
+  // accept connections and queue them for the pool:
+  //
+  while (!stopRequested) {
+    int client = accept(listener, NULL, NULL);
+
+    if (client < 0) {
+      if (errno != EINTR)
+        fprintf(stderr, "**Error: accept failed: %s\n", strerror(errno));
+      continue;
+    }
+
+    pthread_mutex_lock(&server.lock);
+
+    // a signal does not wake the wait, so it times out now and then
+    while (server.numPending == SERVER_MAX_PENDING && !stopRequested) {
+      struct timespec deadline;
+
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += SERVER_STOP_CHECK_MS * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+      }
+
+      pthread_cond_timedwait(&server.notFull, &server.lock, &deadline);
+    }
+
+    if (stopRequested) {
+      pthread_mutex_unlock(&server.lock);
+      close(client);
+      break;
+    }
+
+    int last = (server.first + server.numPending) % SERVER_MAX_PENDING;
+
+    server.pending[last] = client;
+    server.numPending++;
+
+    pthread_cond_signal(&server.notEmpty);
+    pthread_mutex_unlock(&server.lock);
+  }
+
+  //
+  // shutdown: stop accepting, disconnect the clients (a query that is
+  // running finishes first), and wait for the threads:
+  //
+  close(listener);
+  unlink(path);
+
+  pthread_mutex_lock(&server.lock);
+
+  server.stopping = true;
+
+  for (int t = 0; t < numThreads; t++) {
+    if (server.active[t] >= 0)
+      shutdown(server.active[t], SHUT_RDWR);
+  }
+
+  pthread_cond_broadcast(&server.notEmpty);
+  pthread_mutex_unlock(&server.lock);
+
+  for (int t = 0; t < numThreads; t++)
+    pthread_join(threads[t], NULL);
+
+  for (int i = 0; i < server.numPending; i++)
+    close(server.pending[(server.first + i) % SERVER_MAX_PENDING]);
+
+  for (int r = 0; r < server.numResidents; r++) {
+    free(server.residents[r].name);
+    wal_close(server.residents[r].db);
+    database_close(server.residents[r].db);
+  }
+
+  free(server.residents);
+  free(server.active);
+  free(threads);
+
+  resultcache_clear();
+  bufferpool_release();
+
+  pthread_cond_destroy(&server.notFull);
+  pthread_cond_destroy(&server.notEmpty);
+  pthread_mutex_destroy(&server.residentLock);
+  pthread_mutex_destroy(&server.lock);
+
+  fprintf(stderr, "server stopped\n");
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+/*server.h*/
+
+//
+// Project: Query server for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+//
+// The server listens on a Unix domain socket and runs a session
+// (session.h) for each client that connects. A client first sends
+// the name of a database, followed by statements, and receives the
+// same prompts and output as the interactive program, e.g.
+//
+//   $ socat - UNIX-CONNECT:/tmp/simplesql.sock
+//   MovieLens
+//   query? SELECT * FROM Movies LIMIT 3;
+//
+// Sessions are run by a fixed pool of threads, so a long query only
+// occupies its own thread. Each database is opened by the first
+// session that names it and then stays open, shared by every later
+// session, until the server exits.
+//
+
+//
+// Functions:
+//
+
+//
+// server_run
+//
+// Listens on the socket at the given path, running sessions on
+// numThreads threads, until the server receives SIGINT or SIGTERM.
+// Returns 0 on a clean shutdown, -1 if the socket could not be
+// created (error msg already output).
+//
+int server_run(char *path, int numThreads);
@@ -0,0 +1,385 @@
+/*servertest.c*/
+
+//
+// Program to test how the server (see server.h) copes with more
+// clients than it can serve, and with running out of file
+// descriptors.
+//
+// Usage: servertest path/to/ssql
+//
+// Starts "ssql -server <socket> 1" in a temporary directory for each
+// case, with its stderr in a file there:
+//
+//   full      one client occupies the only thread, 64 more fill the
+//             queue of pending connections and 1 more waits to be
+//             queued; SIGINT must then stop the server within 2
+//             seconds, with exit status 0
+//   nofds     the server's file descriptor limit (RLIMIT_NOFILE) is
+//             lowered so that accept() gets the last free descriptor
+//             and dup() fails; the client must be disconnected without
+//             a prompt and the server must output an error, a later
+//             client must get the "database?" prompt once the limit is
+//             raised again, and SIGINT must still stop the server
+//             cleanly
+//
+// Outputs PASS or FAIL for each case, and exits with 1 if any failed.
+//
+// Randy Truong
+//
+
+#define _GNU_SOURCE // prlimit
+
+#include <dirent.h> // opendir
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h> // prlimit
+#include <sys/socket.h>
+#include <sys/un.h>   // sockaddr_un
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, execl, usleep
+
+#define SERVERTEST_PENDING 64      // SERVER_MAX_PENDING in server.c
+#define SERVERTEST_TIMEOUT_MS 2000 // how long the server may take
+#define SERVERTEST_MAX_FDS 1024    // highest fd looked for in the server
+
+static char socketPath[64];
+static char logPath[64];
+
+//
+// startServer
+//
+// Starts the server with one thread, and returns its pid once it is
+// listening, or -1 if it did not start.
+//
+static pid_t startServer(char *ssql) {
+  unlink(logPath);
+  fflush(stdout);
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+    return -1;
+
+  if (pid == 0) {
+    if (freopen(logPath, "w", stderr) == NULL ||
+        freopen("/dev/null", "w", stdout) == NULL)
+      _exit(127);
+
+    execl(ssql, ssql, "-server", socketPath, "1", (char *)NULL);
+    _exit(127);
+  }
+
+  // the server outputs "listening on ..." once it is
+  for (int ms = 0; ms < SERVERTEST_TIMEOUT_MS; ms += 10) {
+    char line[256] = "";
+    FILE *log = fopen(logPath, "r");
+
+    if (log != NULL) {
+      if (fgets(line, sizeof(line), log) == NULL)
+        line[0] = '\0';
+      fclose(log);
+    }
+
+    if (strncmp(line, "listening on", 12) == 0)
+      return pid;
+
+    usleep(10 * 1000);
+  }
+
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  return -1;
+}
+
+//
+// logged
+//
+// Returns true if the server's stderr has a line starting with the
+// text.
+//
+static bool logged(char *text) {
+  char line[256];
+  bool found = false;
+  FILE *log = fopen(logPath, "r");
+
+  if (log == NULL)
+    return false;
+
+  while (!found && fgets(line, sizeof(line), log) != NULL)
+    found = (strncmp(line, text, strlen(text)) == 0);
+
+  fclose(log);
+  return found;
+}
+
+//
+// stopServer
+//
+// Sends SIGINT to the server and waits for it to exit. Returns true if
+// it did so with status 0 within the timeout; otherwise it is killed.
+//
+static bool stopServer(pid_t pid) {
+  int status;
+
+  kill(pid, SIGINT);
+
+  for (int ms = 0; ms < SERVERTEST_TIMEOUT_MS; ms += 10) {
+    if (waitpid(pid, &status, WNOHANG) == pid)
+      return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    usleep(10 * 1000);
+  }
+
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  return false;
+}
+
+//
+// connectClient
+//
+// Connects to the server, returning the socket or -1.
+//
+static int connectClient(void) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0)
+    return -1;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//
+// receive
+//
+// Reads what the server sends the client within the timeout, up to
+// size - 1 bytes, into buffer with a '\0' after it. Returns the # of
+// bytes read, 0 if the server closed the connection, or -1 if nothing
+// came.
+//
+static int receive(int fd, char *buffer, int size) {
+  struct pollfd poller;
+
+  poller.fd = fd;
+  poller.events = POLLIN;
+
+  buffer[0] = '\0';
+
+  if (poll(&poller, 1, SERVERTEST_TIMEOUT_MS) != 1)
+    return -1;
+
+  ssize_t n = recv(fd, buffer, size - 1, 0);
+
+  if (n < 0)
+    return -1;
+
+  buffer[n] = '\0';
+  return (int)n;
+}
+
+//
+// testFull
+//
+// Fills the server's queue of pending connections, and then stops it.
+//
+static bool testFull(char *ssql) {
+  // the one being served, the queued ones, and one being accepted
+  int numClients = 1 + SERVERTEST_PENDING + 1;
+  int clients[numClients];
+  pid_t pid = startServer(ssql);
+
+  if (pid < 0) {
+    printf("FAIL: full (server did not start)\n");
+    return false;
+  }
+
+  bool connected = true;
+
+  for (int c = 0; c < numClients; c++) {
+    clients[c] = connectClient();
+    connected = connected && (clients[c] >= 0);
+  }
+
+  usleep(300 * 1000); // for the server to accept them and wait
+
+  bool stopped = stopServer(pid);
+
+  for (int c = 0; c < numClients; c++) {
+    if (clients[c] >= 0)
+      close(clients[c]);
+  }
+
+  if (!connected) {
+    printf("FAIL: full (unable to connect every client)\n");
+    return false;
+  }
+
+  if (!stopped) {
+    printf("FAIL: full (server did not stop on SIGINT)\n");
+    return false;
+  }
+
+  printf("PASS: full\n");
+  return true;
+}
+
+//
+// oneFreeFd
+//
+// Returns the file descriptor limit under which the server has
+// exactly one descriptor free, or -1 if its descriptors cannot be
+// read.
+//
+static int oneFreeFd(pid_t pid) {
+  char path[64];
+  bool isOpen[SERVERTEST_MAX_FDS + 1];
+
+  memset(isOpen, 0, sizeof(isOpen));
+  snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+
+  struct dirent *entry;
+
+  while ((entry = readdir(dir)) != NULL) {
+    int fd = atoi(entry->d_name);
+
+    if (entry->d_name[0] != '.' && fd >= 0 && fd <= SERVERTEST_MAX_FDS)
+      isOpen[fd] = true;
+  }
+
+  closedir(dir);
+
+  // fds below the limit may be used, so a limit just past the lowest
+  // free fd leaves only that one
+  for (int fd = 0; fd < SERVERTEST_MAX_FDS; fd++) {
+    if (!isOpen[fd])
+      return fd + 1;
+  }
+
+  return -1;
+}
+
+//
+// testNoFds
+//
+// Connects a client while the server cannot dup() its socket, and
+// then checks that the server still serves the next client.
+//
+static bool testNoFds(char *ssql) {
+  pid_t pid = startServer(ssql);
+
+  if (pid < 0) {
+    printf("FAIL: nofds (server did not start)\n");
+    return false;
+  }
+
+  struct rlimit previous;
+  struct rlimit lowered;
+  char *failure = NULL;
+  char reply[256];
+
+  int limit = oneFreeFd(pid);
+
+  if (limit < 0 || prlimit(pid, RLIMIT_NOFILE, NULL, &previous) != 0) {
+    stopServer(pid);
+    printf("FAIL: nofds (unable to read the server's descriptors)\n");
+    return false;
+  }
+
+  lowered.rlim_cur = limit;
+  lowered.rlim_max = previous.rlim_max;
+
+  if (prlimit(pid, RLIMIT_NOFILE, &lowered, NULL) != 0)
+    failure = "unable to lower the server's descriptor limit";
+
+  int client = (failure == NULL) ? connectClient() : -1;
+
+  if (failure == NULL && client < 0)
+    failure = "unable to connect";
+
+  if (failure == NULL && receive(client, reply, sizeof(reply)) != 0)
+    failure = (reply[0] != '\0') ? "client was served despite the limit"
+                                 : "client was not disconnected";
+
+  if (client >= 0)
+    close(client);
+
+  if (failure == NULL && !logged("**Error: unable to serve client"))
+    failure = "server did not output an error for the client";
+
+  if (prlimit(pid, RLIMIT_NOFILE, &previous, NULL) != 0 && failure == NULL)
+    failure = "unable to restore the server's descriptor limit";
+
+  client = (failure == NULL) ? connectClient() : -1;
+
+  if (failure == NULL &&
+      (client < 0 || receive(client, reply, sizeof(reply)) <= 0 ||
+       strncmp(reply, "database?", 9) != 0))
+    failure = "next client was not served";
+
+  if (client >= 0)
+    close(client);
+
+  if (!stopServer(pid) && failure == NULL)
+    failure = "server did not stop on SIGINT";
+
+  if (failure != NULL) {
+    printf("FAIL: nofds (%s)\n", failure);
+    return false;
+  }
+
+  printf("PASS: nofds\n");
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    printf("usage: %s path/to/ssql\n", argv[0]);
+    return 1;
+  }
+
+  char dir[] = "/tmp/servertest.XXXXXX";
+  char *ssql = argv[1];
+
+  if (access(ssql, X_OK) != 0) {
+    printf("**Error: no such program '%s'\n", ssql);
+    return 1;
+  }
+
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  snprintf(socketPath, sizeof(socketPath), "%s/ssql.sock", dir);
+  snprintf(logPath, sizeof(logPath), "%s/server.log", dir);
+
+  signal(SIGPIPE, SIG_IGN);
+
+  bool passed = testFull(ssql);
+
+  passed = testNoFds(ssql) && passed;
+
+  unlink(socketPath);
+  unlink(logPath);
+  rmdir(dir);
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/*session.c*/
+
+//
+// Project: Query sessions for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // dup, dup2
+
+#include "arena.h"
+#include "execute.h"
+#include "plancache.h"
+#include "resultcache.h"
+#include "session.h"
+
+static _Thread_local FILE *output = NULL; // NULL => stdout
+
+// held while the (shared) parser and analyzer run
+static pthread_mutex_t compiler = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// session_output
+//
+FILE *session_output(void) { return (output != NULL) ? output : stdout; }
+
+//
+// session_setOutput
+//
+void session_setOutput(FILE *stream) { output = stream; }
+
+//
+// redirectStdout
+//
+// Points stdout at the session's output stream, so the messages the
+// parser and analyzer print reach the session. Returns a duplicate of
+// the original stdout to restore, or -1 if nothing was redirected.
+//
+static int redirectStdout(void) {
+  FILE *stream = session_output();
+
+  if (stream == stdout)
+    return -1;
+
+  fflush(stdout);
+  fflush(stream);
+
+  int saved = dup(STDOUT_FILENO);
+
+  if (saved < 0 || dup2(fileno(stream), STDOUT_FILENO) < 0)
+    panic("unable to redirect stdout");
+
+  return saved;
+}
+
+static void restoreStdout(int saved) {
+  if (saved < 0)
+    return;
+
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+}
+
+//
+// compile
+//
+// Parses and analyzes the text of the rewritten statement, returning
+// its AST, or NULL if there was an error (msg already output).
+//
+static struct QUERY *compile(struct Database *db, struct Rewrite *rewrite) {
+  struct QUERY *query = NULL;
+
+  pthread_mutex_lock(&compiler);
+
+  int saved = redirectStdout();
+
+  //
+  // first we check for syntax errors:
+  //
+  FILE *input = fmemopen(rewrite->text, strlen(rewrite->text), "r");
+  if (input == NULL)
+    panic("out of memory");
+
+  struct TokenQueue *tokens = parser_parse(input);
+
+  fclose(input);
+
+  //
+  // if the parse was successful, analyze the query for semantic
+  // errors, and build AST if successful:
+  //
+  if (tokens != NULL) {
+    query = analyzer_build(db, tokens);
+
+    tokenqueue_destroy(tokens); // done with the tokens, free memory:
+  }
+
+  restoreStdout(saved);
+
+  pthread_mutex_unlock(&compiler);
+
+  return query;
+}
+
+//
+// showCache
+//
+// If the statement is SHOW CACHE, outputs the result cache's and the
+// session's plan cache's counters and returns true.
+//
+static bool showCache(char *text, struct PlanCache *plans) {
+  char show[8], cache[8], semicolon[2];
+
+  if (sscanf(text, " %7[A-Za-z] %7[A-Za-z] %1[;]", show, cache, semicolon) !=
+          3 ||
+      icmpStrings(show, "show") != 0 || icmpStrings(cache, "cache") != 0)
+    return false;
+
+  FILE *stream = session_output();
+
+  resultcache_print(stream);
+  fprintf(stream, "**PLAN CACHE: %ld hits, %ld misses, %d plans\n",
+          plans->hits, plans->misses, plans->numEntries);
+
+  return true;
+}
+
+//
+// session_run
+//
+void session_run(struct Database *db, FILE *input) {
+  FILE *stream = session_output();
+  struct PlanCache *plans = plancache_create(PLANCACHE_SIZE);
+  struct Prepared *prepared = NULL; // this session's prepared statements
+
+  while (true) {
+    //
+    // everything the previous query allocated from the arena (its
+    // operators, tokens, etc.) is released in one go:
+    //
+    arena_reset();
+
+    fprintf(stream, "query? ");
+    fflush(stream);
+
+    //
+    // read the next statement, and set aside any extended clauses
+    // (e.g. GROUP BY) that the parser does not know about:
+    //
+    char *text = rewrite_read(input);
+
+    if (text == NULL) // EOF
+      break;
+
+    if (showCache(text, plans)) {
+      free(text);
+      continue;
+    }
+
+    // PREPARE / EXECUTE / DEALLOCATE:
+    char *statement = rewrite_prepared(text, &prepared);
+
+    free(text);
+
+    if (statement == NULL) // done, or error msg already output
+      continue;
+
+    struct Rewrite *rewrite = rewrite_statement(statement);
+
+    free(statement);
+
+    if (rewrite == NULL) // syntax error, msg already output
+      continue;
+
+    //
+    // an INSERT was parsed by the rewrite, otherwise reuse the AST of
+    // an earlier statement of the same shape, or else parse and
+    // analyze this one:
+    //
+    struct QUERY *query = rewrite->query;
+    bool cached = false;
+
+    if (query == NULL) {
+      query = plancache_lookup(plans, rewrite->shape);
+      cached = (query != NULL);
+
+      if (!cached)
+        query = compile(db, rewrite);
+    }
+
+    if (query == NULL) {
+      //
+      // syntax or semantic error (msg already output), loop around
+      // and try another query:
+      //
+      rewrite_destroy(rewrite);
+      continue;
+    }
+
+    bool applied = rewrite_apply(db, rewrite, query);
+
+    if (applied && rewrite->explain) {
+      execute_explain(db, query, rewrite);
+    } else if (applied) {
+      //
+      // a SELECT whose result is cached, and whose tables have not
+      // changed since, is answered without executing it:
+      //
+      struct ResultKey key;
+      bool cacheable = resultcache_key(db, rewrite, query, &key);
+      struct ResultCacheEntry *entry =
+          cacheable ? resultcache_lookup(&key) : NULL;
+
+      if (entry != NULL) {
+        results_print(entry->rs);
+        resultcache_release(entry);
+      } else {
+        // Creating a resultset struct
+        struct ResultSet *rSet = results_create();
+
+        // Executing the query
+        execute_query(db, query, rewrite, rSet);
+
+        // The cache takes the Resultset, otherwise free its memory
+        if (cacheable && rSet->numCols > 0)
+          resultcache_insert(&key, rSet);
+        else
+          results_destroy(rSet);
+      }
+    }
+    // else semantic error in an extended clause, msg already output
+
+    //
+    // keep the AST for the next statement of this shape, if its
+    // literals could be bound, otherwise free it (an INSERT's AST is
+    // freed along with the rewrite):
+    //
+    bool bindable = rewrite->bound;
+    bool owned = (query == rewrite->query);
+
+    rewrite_detach(rewrite, query);
+
+    if (!cached && !owned && bindable)
+      plancache_insert(plans, rewrite->shape, query);
+    else if (!cached && !owned)
+      analyzer_destroy(query);
+
+    rewrite_destroy(rewrite);
+
+    fflush(stream);
+  }
+
+  rewrite_freePrepared(prepared);
+  plancache_destroy(plans);
+}
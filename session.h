@@ -0,0 +1,55 @@
+/*session.h*/
+
+//
+// Project: Query sessions for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdio.h>
+
+#include "database.h"
+
+//
+// A session reads statements from an input stream and executes
+// them against an open database until EOF. The interactive program
+// runs one session on stdin; the server (server.h) runs one per
+// client connection, each on its own thread.
+//
+// Everything a session outputs --- prompts, result sets and error
+// messages --- goes to the calling thread's output stream, which is
+// stdout unless the thread sets it with session_setOutput().
+//
+// The parser and analyzer are shared by every thread and print their
+// error messages to stdout, so they are run by one session at a time.
+// While they run, stdout is pointed at the session's output stream.
+//
+
+//
+// Functions:
+//
+
+//
+// session_output
+//
+// Returns the calling thread's output stream.
+//
+FILE *session_output(void);
+
+//
+// session_setOutput
+//
+// Sets the calling thread's output stream, e.g. a client's socket.
+//
+void session_setOutput(FILE *output);
+
+//
+// session_run
+//
+// Prompts for, reads and executes statements from input against
+// the database until EOF. Call parser_init() once before the first
+// session is run.
+//
+void session_run(struct Database *db, FILE *input);
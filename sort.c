@@ -0,0 +1,623 @@
+/*sort.c*/
+
+//
+// Project: Sort operator for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "operator.h"
+#include "util.h"
+
+//
+// Without a limit, tuples are collected in memory until the memory
+// budget is reached; they are then sorted and written to a temporary
+// file as a sorted "run", and collection starts over. At the end the
+// runs (plus the tuples still in memory) are merged, k-way, using a
+// heap of the runs' current tuples.
+//
+// With a limit of N, a heap of the best N tuples seen so far is kept
+// instead; the root is the worst of these, and is replaced whenever
+// a better tuple arrives. So at most N tuples are ever kept.
+//
+// In both cases the sort is stable: tuples with equal keys are output
+// in the order they arrived.
+//
+
+//
+// A sorted run that was spilled to a temporary file:
+//
+struct SortRun {
+  FILE *file;
+  struct TupleValue *values; // current tuple of the run
+  char *strings;             // holds the current tuple's strings
+  int stringsSize;
+  bool done; // true => no more tuples in the run
+};
+
+struct SortState {
+  int key;        // index of the column to sort on
+  bool ascending; // true => ascending, false => descending
+  int N;          // limit on the # of tuples output, -1 => no limit
+  long memoryBudget;
+
+  int width; // # of values per tuple
+
+  //
+  // tuples held in memory, numColumns values each; seqs[i] is the
+  // arrival order of tuple i, for stability:
+  //
+  struct TupleValue *values;
+  long *seqs;
+  int numTuples;
+  int size; // # of tuples the arrays have room for
+  long nextSeq;
+
+  int *order; // ARRAY: positions of the in-memory tuples, sorted
+
+  struct SortRun *runs; // ARRAY of spilled runs
+  int numRuns;
+  int *heap; // ARRAY: heap of run #s during the merge (numRuns + 1)
+  int heapSize;
+
+  bool built;  // true => child has been read
+  int next;    // next position in order (no runs spilled)
+  int output;  // # of tuples output so far
+  char *buffer; // holds the output tuple's strings during the merge
+  int bufferSize;
+
+  long maxBytes; // most bytes of tuples held in memory at once
+};
+
+//
+// compareTuples
+//
+// Compares two tuples by the sort key, taking the direction into
+// account; tuples with equal keys compare by arrival order.
+//
+static int compareTuples(struct SortState *sort, struct TupleValue *t1,
+                         long seq1, struct TupleValue *t2, long seq2) {
+  int cmp = operator_compareValues(&t1[sort->key], &t2[sort->key]);
+
+  if (!sort->ascending)
+    cmp = -cmp;
+
+  if (cmp != 0)
+    return cmp;
+
+  return (seq1 > seq2) - (seq1 < seq2);
+}
+
+static int compareAt(struct SortState *sort, int p1, int p2) {
+  return compareTuples(sort, &sort->values[p1 * sort->width], sort->seqs[p1],
+                       &sort->values[p2 * sort->width], sort->seqs[p2]);
+}
+
+//
+// mergeSort
+//
+// Sorts the positions in order[lo..hi) of the in-memory tuples,
+// using temp as scratch space.
+//
+static void mergeSort(struct SortState *sort, int *order, int *temp, int lo,
+                      int hi) {
+  if (hi - lo < 2)
+    return;
+
+  int mid = lo + (hi - lo) / 2;
+
+  mergeSort(sort, order, temp, lo, mid);
+  mergeSort(sort, order, temp, mid, hi);
+
+  int i = lo, j = mid, k = lo;
+  while (i < mid && j < hi) {
+    if (compareAt(sort, order[i], order[j]) <= 0)
+      temp[k++] = order[i++];
+    else
+      temp[k++] = order[j++];
+  }
+  while (i < mid)
+    temp[k++] = order[i++];
+  while (j < hi)
+    temp[k++] = order[j++];
+
+  memcpy(&order[lo], &temp[lo], sizeof(int) * (hi - lo));
+}
+
+//
+// sort_inMemory
+//
+// Sorts the tuples currently held in memory into sort->order.
+//
+static void sort_inMemory(struct SortState *sort) {
+  free(sort->order);
+
+  sort->order = (int *)malloc(sizeof(int) * (sort->numTuples + 1));
+  int *temp = (int *)malloc(sizeof(int) * (sort->numTuples + 1));
+  if (sort->order == NULL || temp == NULL)
+    panic("out of memory");
+
+  for (int i = 0; i < sort->numTuples; i++)
+    sort->order[i] = i;
+
+  mergeSort(sort, sort->order, temp, 0, sort->numTuples);
+
+  free(temp);
+}
+
+//
+// sort_grow
+//
+// Makes room for at least one more tuple in memory.
+//
+static void sort_grow(struct SortState *sort) {
+  if (sort->numTuples < sort->size)
+    return;
+
+  sort->size = (sort->size == 0) ? 64 : sort->size * 2;
+  sort->values = (struct TupleValue *)realloc(
+      sort->values, sizeof(struct TupleValue) * sort->size * sort->width);
+  sort->seqs = (long *)realloc(sort->seqs, sizeof(long) * sort->size);
+
+  if (sort->values == NULL || sort->seqs == NULL)
+    panic("out of memory");
+
+  long tupleBytes = sizeof(struct TupleValue) * sort->width + sizeof(long);
+  long bytes = sort->size * tupleBytes;
+  if (bytes > sort->maxBytes)
+    sort->maxBytes = bytes;
+}
+
+//
+// sort_spill
+//
+// Sorts the tuples in memory and writes them to a new run.
+//
+static void sort_spill(struct SortState *sort) {
+  sort_inMemory(sort);
+
+  FILE *file = tmpfile();
+  if (file == NULL)
+    panic("unable to create temporary file for sorting");
+
+  for (int i = 0; i < sort->numTuples; i++) {
+    struct TupleValue *values = &sort->values[sort->order[i] * sort->width];
+
+    for (int c = 0; c < sort->width; c++) {
+      struct TupleValue *value = &values[c];
+
+      if (value->valueType == COL_TYPE_INT) {
+        fwrite(&value->value.i, sizeof(int), 1, file);
+      } else if (value->valueType == COL_TYPE_REAL) {
+        fwrite(&value->value.r, sizeof(double), 1, file);
+      } else {
+        fwrite(&value->length, sizeof(int), 1, file);
+        fwrite(value->value.s, sizeof(char), value->length, file);
+      }
+    }
+  }
+
+  if (ferror(file))
+    panic("unable to write temporary file for sorting");
+
+  rewind(file);
+
+  sort->runs = (struct SortRun *)realloc(
+      sort->runs, sizeof(struct SortRun) * (sort->numRuns + 1));
+  if (sort->runs == NULL)
+    panic("out of memory");
+
+  struct SortRun *run = &sort->runs[sort->numRuns++];
+  run->file = file;
+  run->values =
+      (struct TupleValue *)malloc(sizeof(struct TupleValue) * sort->width);
+  run->strings = NULL;
+  run->stringsSize = 0;
+  run->done = false;
+  if (run->values == NULL)
+    panic("out of memory");
+
+  sort->numTuples = 0;
+}
+
+//
+// run_read
+//
+// Reads the next tuple of the run into run->values, setting run->done
+// if there are no more.
+//
+static void run_read(struct SortState *sort, struct SortRun *run,
+                     struct OpColumn *columns) {
+  int offsets[sort->width]; // where each string starts in run->strings
+  int used = 0;
+
+  for (int c = 0; c < sort->width; c++) {
+    struct TupleValue *value = &run->values[c];
+    size_t n = 0;
+
+    value->valueType = columns[c].colType;
+
+    if (value->valueType == COL_TYPE_INT) {
+      n = fread(&value->value.i, sizeof(int), 1, run->file);
+    } else if (value->valueType == COL_TYPE_REAL) {
+      n = fread(&value->value.r, sizeof(double), 1, run->file);
+    } else {
+      n = fread(&value->length, sizeof(int), 1, run->file);
+
+      if (n == 1 && used + value->length + 1 > run->stringsSize) {
+        run->stringsSize = 2 * (used + value->length + 1);
+        run->strings = (char *)realloc(run->strings, run->stringsSize);
+        if (run->strings == NULL)
+          panic("out of memory");
+      }
+
+      if (n == 1 && fread(run->strings + used, sizeof(char), value->length,
+                          run->file) != (size_t)value->length)
+        panic("unable to read temporary file for sorting");
+
+      offsets[c] = used;
+      used += value->length;
+    }
+
+    if (n != 1) {
+      run->done = true;
+      return;
+    }
+  }
+
+  // run->strings may have moved while reading, so point into it now
+  for (int c = 0; c < sort->width; c++) {
+    if (run->values[c].valueType == COL_TYPE_STRING)
+      run->values[c].value.s = run->strings + offsets[c];
+  }
+}
+
+//
+// heap of runs, ordered by each run's current tuple; ties go to the
+// earlier run, which holds the earlier tuples:
+//
+static bool runBefore(struct SortState *sort, int r1, int r2) {
+  int cmp = compareTuples(sort, sort->runs[r1].values, r1,
+                          sort->runs[r2].values, r2);
+  return cmp < 0;
+}
+
+static void heap_siftDown(struct SortState *sort, int i) {
+  while (true) {
+    int best = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+
+    if (left < sort->heapSize &&
+        runBefore(sort, sort->heap[left], sort->heap[best]))
+      best = left;
+    if (right < sort->heapSize &&
+        runBefore(sort, sort->heap[right], sort->heap[best]))
+      best = right;
+
+    if (best == i)
+      return;
+
+    int temp = sort->heap[i];
+    sort->heap[i] = sort->heap[best];
+    sort->heap[best] = temp;
+    i = best;
+  }
+}
+
+//
+// topN_siftDown, topN_siftUp
+//
+// The in-memory tuples form a heap of the best N so far, where the
+// root is the worst; positions in sort->order form the heap.
+//
+static void topN_siftDown(struct SortState *sort, int i) {
+  while (true) {
+    int worst = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+
+    if (left < sort->numTuples &&
+        compareAt(sort, sort->order[left], sort->order[worst]) > 0)
+      worst = left;
+    if (right < sort->numTuples &&
+        compareAt(sort, sort->order[right], sort->order[worst]) > 0)
+      worst = right;
+
+    if (worst == i)
+      return;
+
+    int temp = sort->order[i];
+    sort->order[i] = sort->order[worst];
+    sort->order[worst] = temp;
+    i = worst;
+  }
+}
+
+static void topN_siftUp(struct SortState *sort, int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (compareAt(sort, sort->order[i], sort->order[parent]) <= 0)
+      return;
+
+    int temp = sort->order[i];
+    sort->order[i] = sort->order[parent];
+    sort->order[parent] = temp;
+    i = parent;
+  }
+}
+
+//
+// sort_topN
+//
+// Reads child, keeping only the best N tuples.
+//
+static void sort_topN(struct Operator *op) {
+  struct SortState *sort = (struct SortState *)op->state;
+  struct Tuple *tuple = NULL;
+
+  sort->order = (int *)malloc(sizeof(int) * (sort->N + 1));
+  if (sort->order == NULL)
+    panic("out of memory");
+
+  while ((tuple = operator_next(op->child)) != NULL) {
+    long seq = sort->nextSeq++;
+
+    if (sort->numTuples < sort->N) {
+      sort_grow(sort);
+
+      int p = sort->numTuples;
+      memcpy(&sort->values[p * sort->width], tuple->values,
+             sizeof(struct TupleValue) * sort->width);
+      sort->seqs[p] = seq;
+      sort->order[p] = p;
+      sort->numTuples++;
+
+      topN_siftUp(sort, sort->numTuples - 1);
+    } else {
+      // replace the worst of the N if this one is better
+      int root = sort->order[0];
+      if (compareTuples(sort, tuple->values, seq,
+                        &sort->values[root * sort->width],
+                        sort->seqs[root]) >= 0)
+        continue;
+
+      memcpy(&sort->values[root * sort->width], tuple->values,
+             sizeof(struct TupleValue) * sort->width);
+      sort->seqs[root] = seq;
+
+      topN_siftDown(sort, 0);
+    }
+  }
+
+  sort_inMemory(sort);
+}
+
+//
+// sort_build
+//
+// Reads child, spilling sorted runs as needed, and prepares to output.
+//
+static void sort_build(struct Operator *op) {
+  struct SortState *sort = (struct SortState *)op->state;
+
+  sort->built = true;
+
+  if (sort->N >= 0) {
+    if (sort->N > 0)
+      sort_topN(op);
+    return;
+  }
+
+  long tupleBytes = sizeof(struct TupleValue) * sort->width + sizeof(long);
+  struct Tuple *tuple = NULL;
+
+  while ((tuple = operator_next(op->child)) != NULL) {
+    if (sort->numTuples > 0 &&
+        (sort->numTuples + 1) * tupleBytes > sort->memoryBudget)
+      sort_spill(sort);
+
+    sort_grow(sort);
+
+    int p = sort->numTuples++;
+    memcpy(&sort->values[p * sort->width], tuple->values,
+           sizeof(struct TupleValue) * sort->width);
+    sort->seqs[p] = sort->nextSeq++;
+  }
+
+  if (sort->numRuns == 0) {
+    sort_inMemory(sort);
+    return;
+  }
+
+  // the tuples still in memory form the final run, then merge:
+  if (sort->numTuples > 0)
+    sort_spill(sort);
+
+  free(sort->values);
+  free(sort->seqs);
+  sort->values = NULL;
+  sort->seqs = NULL;
+  sort->size = 0;
+
+  sort->heap = (int *)malloc(sizeof(int) * (sort->numRuns + 1));
+  if (sort->heap == NULL)
+    panic("out of memory");
+
+  sort->heapSize = 0;
+  for (int r = 0; r < sort->numRuns; r++) {
+    run_read(sort, &sort->runs[r], op->columns);
+    if (!sort->runs[r].done)
+      sort->heap[sort->heapSize++] = r;
+  }
+
+  for (int i = sort->heapSize / 2 - 1; i >= 0; i--)
+    heap_siftDown(sort, i);
+}
+
+//
+// sort_next
+//
+// The strings of a tuple that comes from a spilled run are only valid
+// until the next call.
+//
+static struct Tuple *sort_next(struct Operator *op) {
+  struct SortState *sort = (struct SortState *)op->state;
+
+  if (!sort->built)
+    sort_build(op);
+
+  if (sort->N >= 0 && sort->output >= sort->N)
+    return NULL;
+
+  if (sort->numRuns == 0) {
+    if (sort->next >= sort->numTuples)
+      return NULL;
+
+    int p = sort->order[sort->next++];
+    memcpy(op->tuple.values, &sort->values[p * sort->width],
+           sizeof(struct TupleValue) * sort->width);
+  } else {
+    if (sort->heapSize == 0)
+      return NULL;
+
+    struct SortRun *run = &sort->runs[sort->heap[0]];
+
+    memcpy(op->tuple.values, run->values,
+           sizeof(struct TupleValue) * sort->width);
+
+    // the run's string buffer is reused by the next read, so the output
+    // tuple's strings are copied to our own buffer first
+    int total = 0;
+    for (int c = 0; c < sort->width; c++) {
+      if (op->tuple.values[c].valueType == COL_TYPE_STRING)
+        total += op->tuple.values[c].length;
+    }
+
+    if (total + 1 > sort->bufferSize) {
+      sort->bufferSize = 2 * (total + 1);
+      sort->buffer = (char *)realloc(sort->buffer, sort->bufferSize);
+      if (sort->buffer == NULL)
+        panic("out of memory");
+    }
+
+    char *cp = sort->buffer;
+    for (int c = 0; c < sort->width; c++) {
+      struct TupleValue *value = &op->tuple.values[c];
+      if (value->valueType == COL_TYPE_STRING) {
+        memcpy(cp, value->value.s, value->length);
+        value->value.s = cp;
+        cp += value->length;
+      }
+    }
+
+    run_read(sort, run, op->columns);
+    if (run->done)
+      sort->heap[0] = sort->heap[--sort->heapSize];
+
+    heap_siftDown(sort, 0);
+  }
+
+  sort->output++;
+  return &op->tuple;
+}
+
+static void sort_destroy(struct Operator *op) {
+  struct SortState *sort = (struct SortState *)op->state;
+
+  for (int r = 0; r < sort->numRuns; r++) {
+    fclose(sort->runs[r].file);
+    free(sort->runs[r].values);
+    free(sort->runs[r].strings);
+  }
+
+  free(sort->runs);
+  free(sort->heap);
+  free(sort->values);
+  free(sort->seqs);
+  free(sort->order);
+  free(sort->buffer);
+}
+
+static void sort_explain(struct Operator *op, struct OpExplain *info) {
+  struct SortState *sort = (struct SortState *)op->state;
+  struct OpColumn *key = &op->columns[sort->key];
+
+  operator_appendDetail(info, "%s.%s %s", key->tableName, key->colName,
+                        sort->ascending ? "ASC" : "DESC");
+
+  if (sort->N >= 0)
+    operator_appendDetail(info, ", top %d", sort->N);
+  if (sort->numRuns > 0)
+    operator_appendDetail(info, ", %d runs spilled", sort->numRuns);
+
+  info->memory = sort->maxBytes;
+}
+
+//
+// operator_sort
+//
+struct Operator *operator_sort(struct Operator *child, int key, bool ascending,
+                               int N, long memoryBudget) {
+  assert(key >= 0 && key < child->numColumns);
+
+  struct Operator *op = operator_create(OP_SORT, child, child->numColumns);
+
+  memcpy(op->columns, child->columns,
+         sizeof(struct OpColumn) * child->numColumns);
+
+  struct SortState *sort =
+      (struct SortState *)arena_alloc(sizeof(struct SortState));
+
+  sort->key = key;
+  sort->ascending = ascending;
+  sort->width = child->numColumns;
+  sort->memoryBudget = memoryBudget;
+
+  //
+  // a top-N heap only works if the N tuples fit in the budget,
+  // otherwise sort everything (spilling as needed) and stop after N:
+  //
+  long heapBytes =
+      (long)N * (sizeof(struct TupleValue) * sort->width + sizeof(long));
+  bool useHeap = (N >= 0 && heapBytes <= memoryBudget);
+
+  sort->N = useHeap ? N : -1;
+
+  sort->values = NULL;
+  sort->seqs = NULL;
+  sort->numTuples = 0;
+  sort->size = 0;
+  sort->nextSeq = 0;
+  sort->order = NULL;
+  sort->runs = NULL;
+  sort->numRuns = 0;
+  sort->heap = NULL;
+  sort->heapSize = 0;
+  sort->built = false;
+  sort->next = 0;
+  sort->output = 0;
+  sort->buffer = NULL;
+  sort->bufferSize = 0;
+  sort->maxBytes = 0;
+
+  if (N >= 0 && N < op->estimatedRows)
+    op->estimatedRows = N;
+
+  op->state = sort;
+  op->next = sort_next;
+  op->destroy = sort_destroy;
+  op->explain = sort_explain;
+
+  if (N >= 0 && !useHeap)
+    return operator_limit(op, N);
+
+  return op;
+}
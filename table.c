@@ -0,0 +1,929 @@
+/*table.c*/
+
+//
+// Project: Table storage for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // stat
+
+#include "bufferpool.h"
+#include "session.h"
+#include "table.h"
+#include "util.h"
+
+//
+// table_find
+//
+struct TableMeta *table_find(struct Database *db, char *name) {
+  for (int t = 0; t < db->numTables; t++) {
+    if (icmpStrings(db->tables[t].name, name) == 0)
+      return &db->tables[t];
+  }
+
+  return NULL;
+}
+
+//
+// table_findColumn
+//
+int table_findColumn(struct TableMeta *meta, char *name) {
+  for (int c = 0; c < meta->numColumns; c++) {
+    if (icmpStrings(meta->columns[c].name, name) == 0)
+      return c;
+  }
+
+  return -1;
+}
+
+//
+// table_path
+//
+void table_path(char *path, struct Database *db, char *tableName,
+                char *extension) {
+  snprintf(path, TABLE_MAX_PATH_LENGTH, "%s/%s%s", db->name, tableName,
+           extension);
+}
+
+//
+// The read-write lock of each table, see table_lockWrite(); a table's
+// lock is created when first needed and kept:
+//
+struct TableLock {
+  struct TableMeta *meta;
+  pthread_rwlock_t lock;
+  struct TableLock *next;
+};
+
+static pthread_mutex_t locksLock = PTHREAD_MUTEX_INITIALIZER;
+static struct TableLock *locks = NULL;
+
+//
+// lockOf
+//
+// Returns the read-write lock of the given table.
+//
+static pthread_rwlock_t *lockOf(struct TableMeta *meta) {
+  pthread_mutex_lock(&locksLock);
+
+  struct TableLock *entry = locks;
+
+  while (entry != NULL && entry->meta != meta)
+    entry = entry->next;
+
+  if (entry == NULL) {
+    entry = (struct TableLock *)malloc(sizeof(struct TableLock));
+    if (entry == NULL)
+      panic("out of memory");
+
+    entry->meta = meta;
+    pthread_rwlock_init(&entry->lock, NULL);
+    entry->next = locks;
+    locks = entry;
+  }
+
+  pthread_mutex_unlock(&locksLock);
+
+  return &entry->lock;
+}
+
+//
+// table_lockWrite, table_unlockWrite
+//
+void table_lockWrite(struct TableMeta *meta) {
+  pthread_rwlock_wrlock(lockOf(meta));
+}
+
+void table_unlockWrite(struct TableMeta *meta) {
+  pthread_rwlock_unlock(lockOf(meta));
+}
+
+//
+// The header of a column file:
+//
+#define TABLE_COLUMN_MAGIC "SSQLCOL1"
+
+struct ColumnHeader {
+  char magic[8];
+  int byteOrder;          // 1, as written by the converting machine
+  int colType;            // enum ColumnType (database.h)
+  long long dataSize;     // size of the data file converted from
+  long long dataModified; // modification time of that data file (ns)
+  int numRecords;
+  int numCodes; // > 0 => a dictionary-encoded string column (table.h)
+};
+
+//
+// openColumn
+//
+// Maps the column file at the given path, checking its header against
+// the column type. Returns false (with nothing mapped) if the file does
+// not exist or is not a valid column file.
+//
+static bool openColumn(char *path, int colType, struct ColumnHeader *header,
+                       struct TableColumn *column) {
+  column->file = bufferpool_open(path);
+
+  if (column->file == NULL)
+    return false;
+
+  column->data = column->file->data;
+  column->size = column->file->size;
+
+  bool valid = (column->size >= sizeof(struct ColumnHeader));
+
+  if (valid) {
+    memcpy(header, column->data, sizeof(struct ColumnHeader));
+    valid = (memcmp(header->magic, TABLE_COLUMN_MAGIC, 8) == 0) &&
+            (header->byteOrder == 1) && (header->colType == colType) &&
+            (header->numRecords >= 0);
+  }
+
+  if (valid) {
+    char *values = column->data + sizeof(struct ColumnHeader);
+    size_t available = column->size - sizeof(struct ColumnHeader);
+    size_t N = header->numRecords;
+    size_t K = (header->numCodes > 0) ? header->numCodes : 0;
+
+    column->ints = (int *)values;
+    column->reals = (double *)values;
+    column->offsets = (unsigned int *)values;
+    column->heap = values + (sizeof(unsigned int) * (N + 1));
+    column->codes = NULL;
+    column->numCodes = 0;
+
+    if (K > 0) { // the dictionary follows the codes
+      column->codes = (int *)values;
+      column->numCodes = K;
+      column->offsets = (unsigned int *)(values + (sizeof(int) * N));
+      column->heap = (char *)(column->offsets + K + 1);
+    }
+
+    // the # of bytes before the heap
+    size_t offsets = (K > 0) ? (sizeof(int) * N) +
+                                   (sizeof(unsigned int) * (K + 1))
+                             : sizeof(unsigned int) * (N + 1);
+
+    if (colType == COL_TYPE_INT)
+      valid = (available >= sizeof(int) * N) && (K == 0);
+    else if (colType == COL_TYPE_REAL)
+      valid = (available >= sizeof(double) * N) && (K == 0);
+    else
+      valid = (available >= offsets) &&
+              (available - offsets >= column->offsets[(K > 0) ? K : N]);
+  }
+
+  if (!valid)
+    bufferpool_close(column->file);
+
+  return valid;
+}
+
+//
+// openColumns
+//
+// Maps the table's column files, if they all exist and were converted
+// from the same data file --- the current one, if haveData. Returns
+// false (with nothing mapped) otherwise.
+//
+static bool openColumns(struct Database *db, struct Table *table,
+                        bool haveData) {
+  struct TableMeta *meta = table->meta;
+
+  table->columns = (struct TableColumn *)malloc(sizeof(struct TableColumn) *
+                                                (meta->numColumns + 1));
+  if (table->columns == NULL)
+    panic("out of memory");
+
+  struct ColumnHeader first;
+  memset(&first, 0, sizeof(first));
+
+  int numOpen = 0;
+  bool valid = true;
+
+  for (int c = 0; c < meta->numColumns && valid; c++) {
+    char extension[DATABASE_MAX_ID_LENGTH + 8];
+    char path[TABLE_MAX_PATH_LENGTH];
+    struct ColumnHeader header;
+
+    snprintf(extension, sizeof(extension), ".%s.col", meta->columns[c].name);
+    table_path(path, db, meta->name, extension);
+
+    valid = openColumn(path, meta->columns[c].colType, &header,
+                       &table->columns[c]);
+    if (!valid)
+      break;
+
+    numOpen++;
+
+    if (c == 0)
+      first = header;
+
+    valid = (header.numRecords == first.numRecords) &&
+            (header.dataSize == first.dataSize) &&
+            (header.dataModified == first.dataModified);
+
+    if (haveData)
+      valid = valid && (header.dataSize == (long long)table->size) &&
+              (header.dataModified == table->modified);
+  }
+
+  if (!valid || numOpen == 0) {
+    for (int c = 0; c < numOpen; c++)
+      bufferpool_close(table->columns[c].file);
+
+    free(table->columns);
+    table->columns = NULL;
+    return false;
+  }
+
+  table->format = TABLE_COLUMNAR;
+  table->numRecords = first.numRecords;
+  table->size = first.dataSize;
+  table->modified = first.dataModified;
+
+  return true;
+}
+
+//
+// table_open
+//
+struct Table *table_open(struct Database *db, struct TableMeta *meta) {
+  char path[TABLE_MAX_PATH_LENGTH];
+
+  table_path(path, db, meta->name, ".data");
+
+  struct Table *table = (struct Table *)malloc(sizeof(struct Table));
+  if (table == NULL)
+    panic("out of memory");
+
+  table->meta = meta;
+  table->format = TABLE_TEXT;
+  table->data = NULL;
+  table->size = 0;
+  table->file = NULL;
+  table->recordLength = meta->recordSize + 2; // ends with $\n
+  table->numRecords = 0;
+  table->columns = NULL;
+  table->modified = 0;
+  table->bytesRead = 0;
+  table->lock = lockOf(meta);
+
+  // a change in progress is finished before the table is looked at
+  pthread_rwlock_rdlock(table->lock);
+
+  struct stat info;
+  bool haveData = (stat(path, &info) == 0);
+
+  if (haveData) {
+    table->size = info.st_size;
+    table->modified =
+        (info.st_mtim.tv_sec * 1000000000LL) + info.st_mtim.tv_nsec;
+  }
+
+  // the column files are preferred, as long as they are up to date
+  if (openColumns(db, table, haveData))
+    return table;
+
+  if (haveData)
+    table->file = bufferpool_open(path);
+
+  if (table->file == NULL) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: table's data file '%s' not found.\n", path);
+    pthread_rwlock_unlock(table->lock);
+    free(table);
+    return NULL;
+  }
+
+  table->data = table->file->data;
+  table->size = table->file->size;
+  table->modified = table->file->modified;
+
+  // the final record may be missing its newline
+  table->numRecords = table->size / table->recordLength;
+  if (table->size % table->recordLength >= (size_t)meta->recordSize)
+    table->numRecords++;
+
+  return table;
+}
+
+//
+// table_close
+//
+void table_close(struct Table *table) {
+  if (table == NULL)
+    return;
+
+  if (table->format == TABLE_COLUMNAR) {
+    for (int c = 0; c < table->meta->numColumns; c++)
+      bufferpool_close(table->columns[c].file);
+    free(table->columns);
+  } else {
+    bufferpool_close(table->file);
+  }
+
+  pthread_rwlock_unlock(table->lock);
+  free(table);
+}
+
+//
+// table_deleted
+//
+bool table_deleted(struct Table *table, int recordNum) {
+  if (table->format != TABLE_TEXT)
+    return false;
+
+  size_t terminator =
+      ((size_t)recordNum * table->recordLength) + table->meta->recordSize;
+
+  // the final record may be missing its terminator
+  return terminator < table->size && table->data[terminator] == TABLE_DELETED;
+}
+
+//
+// emptyValue
+//
+// Sets the value of a column that was not read.
+//
+static void emptyValue(struct TupleValue *value) {
+  if (value->valueType == COL_TYPE_REAL) {
+    value->value.r = 0.0;
+  } else if (value->valueType == COL_TYPE_STRING) {
+    value->value.s = "";
+    value->length = 0;
+  } else {
+    value->value.i = 0;
+  }
+}
+
+//
+// table_read
+//
+void table_read(struct Table *table, int recordNum, bool *columns,
+                struct TupleValue *values) {
+  if (table->format == TABLE_TEXT) {
+    table_parseRecord(table, table_record(table, recordNum), columns, values);
+    table->bytesRead += table->recordLength;
+    return;
+  }
+
+  assert(recordNum >= 0 && recordNum < table->numRecords);
+
+  struct TableMeta *meta = table->meta;
+
+  for (int c = 0; c < meta->numColumns; c++) {
+    struct TupleValue *value = &values[c];
+    struct TableColumn *column = &table->columns[c];
+
+    value->valueType = meta->columns[c].colType;
+
+    if (columns != NULL && !columns[c]) {
+      emptyValue(value);
+    } else if (value->valueType == COL_TYPE_INT) {
+      value->value.i = column->ints[recordNum];
+      table->bytesRead += sizeof(int);
+    } else if (value->valueType == COL_TYPE_REAL) {
+      value->value.r = column->reals[recordNum];
+      table->bytesRead += sizeof(double);
+    } else if (column->codes != NULL) {
+      int code = column->codes[recordNum];
+      unsigned int start = column->offsets[code];
+      value->value.s = column->heap + start;
+      value->length = column->offsets[code + 1] - start;
+      table->bytesRead += sizeof(int);
+    } else {
+      unsigned int start = column->offsets[recordNum];
+      value->value.s = column->heap + start;
+      value->length = column->offsets[recordNum + 1] - start;
+      table->bytesRead += sizeof(unsigned int) + value->length;
+    }
+  }
+}
+
+//
+// table_column
+//
+void *table_column(struct Table *table, int column, int start, int count,
+                   void *buffer) {
+  struct TableMeta *meta = table->meta;
+  int colType = meta->columns[column].colType;
+
+  assert(colType == COL_TYPE_INT || colType == COL_TYPE_REAL ||
+         table_encoded(table, column));
+  assert(start >= 0 && count >= 0 && start + count <= table->numRecords);
+
+  if (table->format == TABLE_COLUMNAR) {
+    if (colType == COL_TYPE_STRING) {
+      table->bytesRead += (long long)count * sizeof(int);
+      return table->columns[column].codes + start;
+    } else if (colType == COL_TYPE_INT) {
+      table->bytesRead += (long long)count * sizeof(int);
+      return table->columns[column].ints + start;
+    } else {
+      table->bytesRead += (long long)count * sizeof(double);
+      return table->columns[column].reals + start;
+    }
+  }
+
+  table->bytesRead += (long long)count * table->recordLength;
+
+  bool columns[meta->numColumns];
+  for (int i = 0; i < meta->numColumns; i++)
+    columns[i] = (i == column);
+
+  struct TupleValue values[meta->numColumns];
+
+  for (int r = 0; r < count; r++) {
+    table_parseRecord(table, table_record(table, start + r), columns, values);
+
+    if (colType == COL_TYPE_INT)
+      ((int *)buffer)[r] = values[column].value.i;
+    else
+      ((double *)buffer)[r] = values[column].value.r;
+  }
+
+  return buffer;
+}
+
+//
+// table_encoded
+//
+bool table_encoded(struct Table *table, int column) {
+  assert(column >= 0 && column < table->meta->numColumns);
+
+  return table->format == TABLE_COLUMNAR &&
+         table->columns[column].codes != NULL;
+}
+
+//
+// table_codes
+//
+void table_codes(struct Table *table, int column, char *literal, int *first,
+                 int *last) {
+  assert(table_encoded(table, column));
+
+  struct TableColumn *dictionary = &table->columns[column];
+  int length = strlen(literal);
+
+  // binary searches for the first string >= and > the literal
+  for (int pass = 0; pass < 2; pass++) {
+    int lo = 0, hi = dictionary->numCodes;
+
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      unsigned int start = dictionary->offsets[mid];
+      int cmp = operator_compareString(
+          dictionary->heap + start, dictionary->offsets[mid + 1] - start,
+          literal, length);
+
+      if (cmp < 0 || (pass == 1 && cmp == 0))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    *((pass == 0) ? first : last) = lo;
+  }
+}
+
+//
+// table_record
+//
+char *table_record(struct Table *table, int recordNum) {
+  assert(table->format == TABLE_TEXT);
+  assert(recordNum >= 0 && recordNum < table->numRecords);
+
+  return table->data + ((size_t)recordNum * table->recordLength);
+}
+
+//
+// table_parseRecord
+//
+void table_parseRecord(struct Table *table, char *record, bool *columns,
+                       struct TupleValue *values) {
+  struct TableMeta *meta = table->meta;
+  char *cp = record;
+  char *end = record + meta->recordSize;
+
+  for (int i = 0; i < meta->numColumns; i++) {
+    struct TupleValue *value = &values[i];
+    value->valueType = meta->columns[i].colType;
+
+    bool wanted = (columns == NULL || columns[i]);
+
+    if (value->valueType == COL_TYPE_INT || value->valueType == COL_TYPE_REAL) {
+      // atoi/atof stop at the space that follows the value
+      if (!wanted)
+        emptyValue(value);
+      else if (value->valueType == COL_TYPE_INT)
+        value->value.i = atoi(cp);
+      else
+        value->value.r = atof(cp);
+
+      cp = (char *)memchr(cp, ' ', end - cp);
+      assert(cp != NULL);
+      cp++;
+    } else {
+      // strings are quoted with ' or ", and may contain the other quote
+      char quote = *cp;
+      char *close = (char *)memchr(cp + 1, quote, end - (cp + 1));
+      assert(close != NULL);
+
+      value->value.s = cp + 1;
+      value->length = close - (cp + 1);
+      cp = close + 2;
+
+      if (!wanted)
+        emptyValue(value);
+    }
+  }
+}
+
+//
+// table_formatValue
+//
+char *table_formatValue(char *cp, char *end, char *literal, int colType) {
+  int length = strlen(literal);
+  int quotes = (colType == COL_TYPE_STRING) ? 2 : 0;
+
+  // the value, and the space that follows it
+  if (length + quotes + 1 > end - cp)
+    return NULL;
+
+  char quote = (strchr(literal, '\'') == NULL) ? '\'' : '"';
+
+  if (quotes > 0)
+    *cp++ = quote;
+
+  memcpy(cp, literal, length);
+  cp += length;
+
+  if (quotes > 0)
+    *cp++ = quote;
+
+  *cp++ = ' ';
+
+  return cp;
+}
+
+//
+// A distinct string of a column being dictionary-encoded:
+//
+struct DictionaryEntry {
+  char *s; // points into the table's data, not null-terminated
+  int length;
+  int code; // while building: order in which it was found
+};
+
+static unsigned int hashString(char *s, int length) {
+  unsigned int hash = 2166136261u; // FNV-1a
+
+  for (int i = 0; i < length; i++) {
+    hash ^= (unsigned char)s[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+//
+// compareEntries
+//
+// Orders strings as operator_compareString() does, and strings that
+// it finds equal (e.g. 'W' and 'w') by their bytes.
+//
+static int compareEntries(const void *a, const void *b) {
+  struct DictionaryEntry *e1 = (struct DictionaryEntry *)a;
+  struct DictionaryEntry *e2 = (struct DictionaryEntry *)b;
+
+  int cmp = operator_compareString(e1->s, e1->length, e2->s, e2->length);
+  if (cmp != 0)
+    return cmp;
+
+  int n = (e1->length < e2->length) ? e1->length : e2->length;
+  cmp = memcmp(e1->s, e2->s, n);
+
+  return (cmp != 0) ? cmp : e1->length - e2->length;
+}
+
+//
+// buildDictionary
+//
+// Finds the distinct strings of string column c, storing them in
+// increasing order in dictionary (an array of TABLE_DICTIONARY_MAX
+// entries), and the code of each record's string in codes. Returns
+// the # of distinct strings, or 0 if the column is not to be
+// dictionary-encoded: it has more than TABLE_DICTIONARY_MAX distinct
+// strings, or encoding it would not make its file smaller.
+//
+static int buildDictionary(struct Table *table, int c,
+                           struct TupleValue *values,
+                           struct DictionaryEntry *dictionary, int *codes) {
+  struct TableMeta *meta = table->meta;
+  int N = table->numRecords;
+
+  bool columns[meta->numColumns];
+  for (int i = 0; i < meta->numColumns; i++)
+    columns[i] = (i == c);
+
+  // open addressing, with room to spare:
+  int numSlots = 2 * TABLE_DICTIONARY_MAX;
+  int *slots = (int *)malloc(sizeof(int) * numSlots);
+  if (slots == NULL)
+    panic("out of memory");
+
+  for (int i = 0; i < numSlots; i++)
+    slots[i] = -1;
+
+  int K = 0;
+  long long plainBytes = 0;
+  long long dictionaryBytes = 0;
+
+  for (int r = 0; r < N; r++) {
+    table_read(table, r, columns, values);
+
+    char *s = values[c].value.s;
+    int length = values[c].length;
+    unsigned int slot = hashString(s, length) & (numSlots - 1);
+
+    while (slots[slot] >= 0 &&
+           (dictionary[slots[slot]].length != length ||
+            memcmp(dictionary[slots[slot]].s, s, length) != 0))
+      slot = (slot + 1) & (numSlots - 1);
+
+    if (slots[slot] < 0) { // a new string:
+      if (K == TABLE_DICTIONARY_MAX) {
+        K = -1;
+        break;
+      }
+
+      dictionary[K].s = s;
+      dictionary[K].length = length;
+      dictionary[K].code = K;
+      slots[slot] = K++;
+      dictionaryBytes += length;
+    }
+
+    codes[r] = slots[slot];
+    plainBytes += length;
+  }
+
+  free(slots);
+
+  // the codes and dictionary, against the offsets and all the strings
+  long long encoded = (long long)sizeof(int) * N +
+                      (long long)sizeof(unsigned int) * (K + 1) +
+                      dictionaryBytes;
+  long long plain = (long long)sizeof(unsigned int) * (N + 1) + plainBytes;
+
+  if (K <= 0 || encoded >= plain)
+    return 0;
+
+  // the codes are renumbered in the strings' order
+  qsort(dictionary, K, sizeof(struct DictionaryEntry), compareEntries);
+
+  int rank[K];
+  for (int k = 0; k < K; k++)
+    rank[dictionary[k].code] = k;
+
+  for (int r = 0; r < N; r++)
+    codes[r] = rank[codes[r]];
+
+  return K;
+}
+
+//
+// writeColumn
+//
+// Writes column c of the table to its column file, via a temporary
+// file. Returns false if the file could not be written.
+//
+static bool writeColumn(struct Database *db, struct Table *table, int c,
+                        struct TupleValue *values) {
+  struct TableMeta *meta = table->meta;
+  char extension[DATABASE_MAX_ID_LENGTH + 8];
+  char path[TABLE_MAX_PATH_LENGTH];
+  char temp[TABLE_MAX_PATH_LENGTH + 8];
+
+  snprintf(extension, sizeof(extension), ".%s.col", meta->columns[c].name);
+  table_path(path, db, meta->name, extension);
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  FILE *file = fopen(temp, "wb");
+  if (file == NULL) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: unable to write column file '%s'.\n", path);
+    return false;
+  }
+
+  // only column c is read from each record
+  bool columns[meta->numColumns];
+  for (int i = 0; i < meta->numColumns; i++)
+    columns[i] = (i == c);
+
+  int colType = meta->columns[c].colType;
+  int N = table->numRecords;
+
+  // a string column may be dictionary-encoded
+  struct DictionaryEntry *dictionary = NULL;
+  int *codes = NULL;
+  int numCodes = 0;
+
+  if (colType == COL_TYPE_STRING) {
+    dictionary = (struct DictionaryEntry *)malloc(
+        sizeof(struct DictionaryEntry) * TABLE_DICTIONARY_MAX);
+    codes = (int *)malloc(sizeof(int) * (N + 1));
+    if (dictionary == NULL || codes == NULL)
+      panic("out of memory");
+
+    numCodes = buildDictionary(table, c, values, dictionary, codes);
+  }
+
+  struct ColumnHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TABLE_COLUMN_MAGIC, 8);
+  header.byteOrder = 1;
+  header.colType = colType;
+  header.dataSize = table->size;
+  header.dataModified = table->modified;
+  header.numRecords = N;
+  header.numCodes = numCodes;
+
+  bool written = (fwrite(&header, sizeof(header), 1, file) == 1);
+
+  if (colType == COL_TYPE_INT || colType == COL_TYPE_REAL) {
+    for (int r = 0; r < N && written; r++) {
+      table_read(table, r, columns, values);
+      if (colType == COL_TYPE_INT)
+        written = (fwrite(&values[c].value.i, sizeof(int), 1, file) == 1);
+      else
+        written = (fwrite(&values[c].value.r, sizeof(double), 1, file) == 1);
+    }
+  } else if (numCodes > 0) {
+    // the codes, then the dictionary's offsets and strings
+    written = written && (fwrite(codes, sizeof(int), N, file) == (size_t)N);
+
+    unsigned int offset = 0;
+
+    for (int k = 0; k <= numCodes && written; k++) {
+      written = (fwrite(&offset, sizeof(offset), 1, file) == 1);
+      if (k < numCodes)
+        offset += dictionary[k].length;
+    }
+
+    for (int k = 0; k < numCodes && written; k++)
+      written = (fwrite(dictionary[k].s, sizeof(char), dictionary[k].length,
+                        file) == (size_t)dictionary[k].length);
+  } else {
+    // the offsets first, then the strings themselves
+    unsigned int offset = 0;
+    written = (fwrite(&offset, sizeof(offset), 1, file) == 1);
+
+    for (int r = 0; r < N && written; r++) {
+      table_read(table, r, columns, values);
+      // the heap is limited to 4GB
+      written = ((unsigned int)values[c].length <= ~0U - offset);
+      offset += values[c].length;
+      written = written && (fwrite(&offset, sizeof(offset), 1, file) == 1);
+    }
+
+    for (int r = 0; r < N && written; r++) {
+      table_read(table, r, columns, values);
+      written = (fwrite(values[c].value.s, sizeof(char), values[c].length,
+                        file) == (size_t)values[c].length);
+    }
+  }
+
+  free(dictionary);
+  free(codes);
+
+  if (fclose(file) != 0 || !written || rename(temp, path) != 0) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: unable to write column file '%s'.\n", path);
+    remove(temp);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// compact
+//
+// Rewrites the data file of the table without its deleted records,
+// via a temporary file. Returns false if the file could not be
+// written; an error message was output.
+//
+static bool compact(struct Database *db, struct Table *table) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  char temp[TABLE_MAX_PATH_LENGTH + 8];
+
+  table_path(path, db, table->meta->name, ".data");
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  FILE *file = fopen(temp, "wb");
+  if (file == NULL) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: unable to write data file '%s'.\n", path);
+    return false;
+  }
+
+  bool written = true;
+
+  for (int r = 0; r < table->numRecords && written; r++) {
+    if (table_deleted(table, r))
+      continue;
+
+    // the final record may be missing its terminator
+    written = (fwrite(table_record(table, r), sizeof(char),
+                      table->meta->recordSize,
+                      file) == (size_t)table->meta->recordSize) &&
+              (fputs("$\n", file) != EOF);
+  }
+
+  if (fclose(file) != 0 || !written || rename(temp, path) != 0) {
+    fprintf(session_output(),
+            "**INTERNAL ERROR: unable to write data file '%s'.\n", path);
+    remove(temp);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// table_convert
+//
+bool table_convert(struct Database *db, struct TableMeta *meta) {
+  struct Table *table = table_open(db, meta);
+  if (table == NULL) // unable to open, msg already output
+    return false;
+
+  // column files have no deleted records, so the data file is
+  // compacted first (which changes the # of each record after one)
+  bool deleted = false;
+
+  for (int r = 0; r < table->numRecords && !deleted; r++)
+    deleted = table_deleted(table, r);
+
+  if (deleted) {
+    bool compacted = compact(db, table);
+
+    table_close(table);
+
+    table = compacted ? table_open(db, meta) : NULL;
+    if (table == NULL) // msg already output
+      return false;
+  }
+
+  struct TupleValue *values = (struct TupleValue *)malloc(
+      sizeof(struct TupleValue) * (meta->numColumns + 1));
+  if (values == NULL)
+    panic("out of memory");
+
+  bool success = true;
+
+  for (int c = 0; c < meta->numColumns && success; c++)
+    success = writeColumn(db, table, c, values);
+
+  free(values);
+  table_close(table);
+
+  return success;
+}
+
+//
+// table_version
+//
+bool table_version(struct Database *db, struct TableMeta *meta,
+                   struct TableVersion *version) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  struct stat info;
+
+  table_path(path, db, meta->name, ".data");
+
+  if (stat(path, &info) != 0) {
+    char extension[DATABASE_MAX_ID_LENGTH + 8];
+
+    snprintf(extension, sizeof(extension), ".%s.col", meta->columns[0].name);
+    table_path(path, db, meta->name, extension);
+
+    if (stat(path, &info) != 0)
+      return false;
+  }
+
+  version->size = info.st_size;
+  version->modified =
+      (info.st_mtim.tv_sec * 1000000000LL) + info.st_mtim.tv_nsec;
+  version->inode = info.st_ino;
+
+  return true;
+}
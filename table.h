@@ -0,0 +1,283 @@
+/*table.h*/
+
+//
+// Project: Table storage for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stddef.h>  // size_t
+
+#include "bufferpool.h"
+#include "database.h"
+#include "operator.h"
+
+//
+// Every record in a "<table>.data" file has exactly recordSize
+// bytes followed by a "$\n" terminator, e.g.
+//
+//   62 6 ...............$
+//
+// so record i starts at byte offset i * (recordSize + 2). A Table
+// maps the entire data file into memory, which lets us address any
+// record directly and hand out values that point into the mapping
+// instead of copying them.
+//
+// A DELETE (see modify.h) leaves the record in place and changes its
+// terminator to "#\n", so the other records keep their positions;
+// scans skip deleted records, see table_deleted().
+//
+#define TABLE_MAX_PATH_LENGTH ((3 * DATABASE_MAX_ID_LENGTH) + 16)
+
+#define TABLE_DELETED '#' // replaces the '$' of a deleted record
+
+//
+// A table may instead be stored in columnar form (see table_convert),
+// as one "<table>.<column>.col" file per column:
+//
+//   header | int[numRecords]                      (int column)
+//   header | double[numRecords]                   (real column)
+//   header | offsets[numRecords + 1] | string heap (string column)
+//   header | codes[numRecords] | offsets[numCodes + 1] | string heap
+//                                       (dictionary-encoded string column)
+//
+// Values are in the machine's native (little-endian) form, so reading
+// them needs no parsing, and the dots padding the strings are gone:
+// string i is heap[offsets[i] .. offsets[i+1]). A scan that needs only
+// some of the columns never touches the other files.
+//
+// A string column with at most TABLE_DICTIONARY_MAX distinct values,
+// e.g. a day type or a genre, is dictionary-encoded when that makes
+// its file smaller: the heap holds each distinct string once, and each
+// record holds the code of its string, i.e. its position in the heap.
+// The strings are in increasing order (see operator_compareString), so
+// codes compare the way their strings do, and a comparison of the
+// column with a literal becomes a comparison of ints (see
+// table_codes).
+//
+// The header records the size and modification time of the data file
+// the column was converted from; if the data file has since changed,
+// the column files are ignored and the data file is read instead.
+//
+enum TableFormat { TABLE_TEXT = 0, TABLE_COLUMNAR };
+
+#define TABLE_DICTIONARY_MAX 4096
+
+struct TableColumn {
+  struct PoolFile *file; // the column file, in the buffer pool
+  char *data;            // contents of the column file
+  size_t size;           // # of bytes in data
+
+  int *ints;             // COL_TYPE_INT: value of each record
+  double *reals;         // COL_TYPE_REAL: value of each record
+  unsigned int *offsets; // COL_TYPE_STRING: start of each string in heap
+  char *heap;            // COL_TYPE_STRING: the strings, back to back
+
+  int *codes;   // dictionary-encoded: code of each record, NULL => none
+  int numCodes; // dictionary-encoded: # of strings in heap
+};
+
+struct Table {
+  struct TableMeta *meta; // schema of the table
+  int format;             // enum TableFormat
+
+  struct PoolFile *file; // TABLE_TEXT: the data file, in the buffer pool
+  char *data;            // TABLE_TEXT: contents of the data file
+  size_t size;           // # of bytes in the data file
+  int recordLength;      // recordSize + 2 ($\n terminator)
+  int numRecords;        // # of complete records
+
+  struct TableColumn *columns; // TABLE_COLUMNAR: ARRAY, one per column
+
+  long long modified; // modification time of the data file (ns)
+
+  long long bytesRead; // # of bytes read by table_read/table_column
+
+  pthread_rwlock_t *lock; // held for reading while the table is open
+};
+
+//
+// Identifies the contents of a table's files: if any of these change,
+// so may the table.
+//
+struct TableVersion {
+  long long size;     // # of bytes in the data file
+  long long modified; // modification time of the data file (ns)
+  long long inode;    // inode # of the data file
+};
+
+//
+// Functions:
+//
+
+//
+// table_find
+//
+// Returns the meta data of the database's table with the given name
+// (compared case-insensitively), or NULL if there is no such table.
+//
+struct TableMeta *table_find(struct Database *db, char *name);
+
+//
+// table_findColumn
+//
+// Returns the index (0-based) of the table's column with the given
+// name (compared case-insensitively), or -1 if there is no such column.
+//
+int table_findColumn(struct TableMeta *meta, char *name);
+
+//
+// table_path
+//
+// Builds the path "<database>/<table><extension>" into the given
+// buffer, which must hold TABLE_MAX_PATH_LENGTH chars. For example,
+// pass ".data" to obtain the path of the table's data file.
+//
+void table_path(char *path, struct Database *db, char *tableName,
+                char *extension);
+
+//
+// table_open
+//
+// Opens the given table and maps it into memory: its column files if
+// they are up to date with the data file (or there is no data file),
+// and otherwise the data file. The mappings come from the buffer
+// pool, so a table opened by an earlier query is not mapped again.
+//
+// Returns NULL if neither could be opened; in this case
+// an error message was output. Otherwise returns a pointer to a
+// Table; call table_close() when you are done with it.
+//
+struct Table *table_open(struct Database *db, struct TableMeta *meta);
+
+//
+// table_close
+//
+// Releases the table's files (back to the buffer pool, see
+// bufferpool.h) and frees the memory associated with the table.
+//
+void table_close(struct Table *table);
+
+//
+// table_lockWrite, table_unlockWrite
+//
+// Records are changed in place (see wal.h), so each table has a
+// read-write lock: table_open() takes it for reading until
+// table_close(), and the data file is only written while holding it
+// for writing, so no query sees a record half-written. A thread must
+// not hold the table open while it takes the lock for writing.
+//
+void table_lockWrite(struct TableMeta *meta);
+void table_unlockWrite(struct TableMeta *meta);
+
+//
+// table_deleted
+//
+// Returns true if record recordNum (0-based, 0 <= recordNum <
+// table->numRecords) was deleted, in which case it is not part of the
+// table. Column files never hold deleted records.
+//
+bool table_deleted(struct Table *table, int recordNum);
+
+//
+// table_read
+//
+// Stores the values of record recordNum (0-based, 0 <= recordNum <
+// table->numRecords) in values, an array of size meta->numColumns.
+// Only the columns i with columns[i] true are read (pass NULL to read
+// every column), the others are set to 0 or "". Strings are returned
+// as a pointer into the mapping plus a length, they are not copied
+// and not null-terminated.
+//
+void table_read(struct Table *table, int recordNum, bool *columns,
+                struct TupleValue *values);
+
+//
+// table_column
+//
+// Returns the values of the given int or real column (0-based) for
+// records start .. start+count-1, as an array of count ints or
+// doubles, or the codes of a dictionary-encoded string column, as an
+// array of count ints. The values of a TABLE_COLUMNAR table are
+// returned in place, straight from the mapping; otherwise they are
+// parsed into buffer, which must have room for count doubles, and
+// buffer is returned.
+//
+void *table_column(struct Table *table, int column, int start, int count,
+                   void *buffer);
+
+//
+// table_encoded
+//
+// Returns true if the given column (0-based) is a dictionary-encoded
+// string column, false if not.
+//
+bool table_encoded(struct Table *table, int column);
+
+//
+// table_codes
+//
+// Given a dictionary-encoded column (0-based), finds the codes of the
+// strings equal to the literal: codes first .. last-1, where first ==
+// last if there are none. Every code before first is of a smaller
+// string, and every code from last on of a larger one.
+//
+void table_codes(struct Table *table, int column, char *literal, int *first,
+                 int *last);
+
+//
+// table_record
+//
+// Returns a pointer to the start of record recordNum (0-based,
+// 0 <= recordNum < table->numRecords) within the mapping of a
+// TABLE_TEXT table. The record is NOT null-terminated.
+//
+char *table_record(struct Table *table, int recordNum);
+
+//
+// table_parseRecord
+//
+// Breaks the given record of a TABLE_TEXT table into one value per
+// column, storing them in values (an array of size meta->numColumns),
+// as described for table_read().
+//
+void table_parseRecord(struct Table *table, char *record, bool *columns,
+                       struct TupleValue *values);
+
+//
+// table_formatValue
+//
+// Writes a value of the given column type, in string form as in the
+// AST, into a record at cp, followed by the space that ends it; a
+// string is quoted with a quote it does not contain. Returns where the
+// next value goes, or NULL if the value does not fit before end.
+//
+char *table_formatValue(char *cp, char *end, char *literal, int colType);
+
+//
+// table_convert
+//
+// Writes the given table in columnar form, one column file per column
+// (see TableColumn). Each file is written to a temporary file and then
+// renamed, so a reader never sees a partially-written column. The
+// deleted records are first dropped from the data file, which is
+// rewritten in the same way; so the database must not be in use.
+//
+// Returns false if the table could not be opened or a column file
+// could not be written; in this case an error message was output.
+//
+bool table_convert(struct Database *db, struct TableMeta *meta);
+
+//
+// table_version
+//
+// Stores the current version of the given table's data file --- or,
+// if the table only has column files, of its first column file ---
+// in version. Returns false if neither file exists.
+//
+bool table_version(struct Database *db, struct TableMeta *meta,
+                   struct TableVersion *version);
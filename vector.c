@@ -0,0 +1,312 @@
+/*vector.c*/
+
+//
+// Project: Vectorized predicate evaluation for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <stdbool.h> // true, false
+
+#include "ast.h"
+#include "vector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECTOR_X86
+#endif
+
+//
+// Each kernel has one loop per operator, so there is no branching
+// on the operator within a loop. A SIMD loop compares WIDTH values
+// at a time, turning the result into a bit mask (bit k set => value
+// i+k satisfies the comparison); the scalar loop handles the values
+// left over. The scalar loop stores every position and only advances
+// past the ones that satisfy the comparison, so it does not branch
+// on the data either.
+//
+#define SCALAR_LOOP(CONDITION)                                                 \
+  for (; i < count; i++) {                                                     \
+    selection[n] = i;                                                          \
+    n += (CONDITION);                                                          \
+  }
+
+#define SIMD_LOOP(WIDTH, MASK)                                                 \
+  for (; i + (WIDTH) <= count; i += (WIDTH))                                   \
+    n = appendMask((MASK), i, selection, n);
+
+//
+// vector_supports
+//
+bool vector_supports(int operator) {
+  switch (operator) {
+  case EXPR_LT:
+  case EXPR_LTE:
+  case EXPR_GT:
+  case EXPR_GTE:
+  case EXPR_EQUAL:
+  case EXPR_NOT_EQUAL:
+    return true;
+  }
+
+  return false;
+}
+
+//
+// scalar kernels: evaluate values[i .. count-1], appending to the
+// n positions already selected, and return the new # selected.
+//
+static int selectIntsScalar(const int *values, int i, int count,
+                            int operator, int literal, int *selection,
+                            int n) {
+  switch (operator) {
+  case EXPR_LT:
+    SCALAR_LOOP(values[i] < literal);
+    break;
+  case EXPR_LTE:
+    SCALAR_LOOP(values[i] <= literal);
+    break;
+  case EXPR_GT:
+    SCALAR_LOOP(values[i] > literal);
+    break;
+  case EXPR_GTE:
+    SCALAR_LOOP(values[i] >= literal);
+    break;
+  case EXPR_EQUAL:
+    SCALAR_LOOP(values[i] == literal);
+    break;
+  case EXPR_NOT_EQUAL:
+    SCALAR_LOOP(values[i] != literal);
+    break;
+  }
+
+  return n;
+}
+
+static int selectRealsScalar(const double *values, int i, int count,
+                             int operator, double literal, int *selection,
+                             int n) {
+  switch (operator) {
+  case EXPR_LT:
+    SCALAR_LOOP(values[i] < literal);
+    break;
+  case EXPR_LTE:
+    SCALAR_LOOP(values[i] <= literal);
+    break;
+  case EXPR_GT:
+    SCALAR_LOOP(values[i] > literal);
+    break;
+  case EXPR_GTE:
+    SCALAR_LOOP(values[i] >= literal);
+    break;
+  case EXPR_EQUAL:
+    SCALAR_LOOP(values[i] == literal);
+    break;
+  case EXPR_NOT_EQUAL:
+    SCALAR_LOOP(values[i] != literal);
+    break;
+  }
+
+  return n;
+}
+
+#ifdef VECTOR_X86
+
+//
+// appendMask
+//
+// Appends base + k to the selection for each bit k set in the mask.
+//
+static inline int appendMask(unsigned int mask, int base, int *selection,
+                             int n) {
+  while (mask != 0) {
+    selection[n++] = base + __builtin_ctz(mask);
+    mask &= mask - 1;
+  }
+
+  return n;
+}
+
+//
+// AVX2 kernels, 8 ints or 4 reals at a time. SSE2/AVX2 only compare
+// ints for > and =, so the other operators negate the mask: a >= b is
+// !(a < b), a <= b is !(a > b), and a <> b is !(a = b).
+//
+#define AVX2_INTS(CMP)                                                         \
+  ((unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(CMP)))
+#define AVX2_LOAD_INTS _mm256_loadu_si256((const __m256i *)(values + i))
+
+__attribute__((target("avx2"))) static int
+selectIntsAVX2(const int *values, int count, int operator, int literal,
+               int *selection) {
+  __m256i lit = _mm256_set1_epi32(literal);
+  int i = 0;
+  int n = 0;
+
+  switch (operator) {
+  case EXPR_LT:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpgt_epi32(lit, AVX2_LOAD_INTS)));
+    break;
+  case EXPR_LTE:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpgt_epi32(AVX2_LOAD_INTS, lit)) ^ 0xFF);
+    break;
+  case EXPR_GT:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpgt_epi32(AVX2_LOAD_INTS, lit)));
+    break;
+  case EXPR_GTE:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpgt_epi32(lit, AVX2_LOAD_INTS)) ^ 0xFF);
+    break;
+  case EXPR_EQUAL:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpeq_epi32(AVX2_LOAD_INTS, lit)));
+    break;
+  case EXPR_NOT_EQUAL:
+    SIMD_LOOP(8, AVX2_INTS(_mm256_cmpeq_epi32(AVX2_LOAD_INTS, lit)) ^ 0xFF);
+    break;
+  }
+
+  return selectIntsScalar(values, i, count, operator, literal, selection, n);
+}
+
+#define AVX2_REALS(PREDICATE)                                                  \
+  ((unsigned int)_mm256_movemask_pd(_mm256_cmp_pd(                             \
+      _mm256_loadu_pd(values + i), lit, (PREDICATE))))
+
+__attribute__((target("avx2"))) static int
+selectRealsAVX2(const double *values, int count, int operator,
+                double literal, int *selection) {
+  __m256d lit = _mm256_set1_pd(literal);
+  int i = 0;
+  int n = 0;
+
+  switch (operator) {
+  case EXPR_LT:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_LT_OQ));
+    break;
+  case EXPR_LTE:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_LE_OQ));
+    break;
+  case EXPR_GT:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_GT_OQ));
+    break;
+  case EXPR_GTE:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_GE_OQ));
+    break;
+  case EXPR_EQUAL:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_EQ_OQ));
+    break;
+  case EXPR_NOT_EQUAL:
+    SIMD_LOOP(4, AVX2_REALS(_CMP_NEQ_UQ));
+    break;
+  }
+
+  return selectRealsScalar(values, i, count, operator, literal, selection,
+                           n);
+}
+
+#ifdef __SSE2__
+
+//
+// SSE2 kernels, for x86 CPUs without AVX2:
+//
+#define SSE2_INTS(CMP) ((unsigned int)_mm_movemask_ps(_mm_castsi128_ps(CMP)))
+#define SSE2_LOAD_INTS _mm_loadu_si128((const __m128i *)(values + i))
+
+static int selectIntsSSE2(const int *values, int count, int operator,
+                          int literal, int *selection) {
+  __m128i lit = _mm_set1_epi32(literal);
+  int i = 0;
+  int n = 0;
+
+  switch (operator) {
+  case EXPR_LT:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmplt_epi32(SSE2_LOAD_INTS, lit)));
+    break;
+  case EXPR_LTE:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmpgt_epi32(SSE2_LOAD_INTS, lit)) ^ 0xF);
+    break;
+  case EXPR_GT:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmpgt_epi32(SSE2_LOAD_INTS, lit)));
+    break;
+  case EXPR_GTE:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmplt_epi32(SSE2_LOAD_INTS, lit)) ^ 0xF);
+    break;
+  case EXPR_EQUAL:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmpeq_epi32(SSE2_LOAD_INTS, lit)));
+    break;
+  case EXPR_NOT_EQUAL:
+    SIMD_LOOP(4, SSE2_INTS(_mm_cmpeq_epi32(SSE2_LOAD_INTS, lit)) ^ 0xF);
+    break;
+  }
+
+  return selectIntsScalar(values, i, count, operator, literal, selection, n);
+}
+
+#define SSE2_REALS(CMP)                                                        \
+  ((unsigned int)_mm_movemask_pd(CMP(_mm_loadu_pd(values + i), lit)))
+
+static int selectRealsSSE2(const double *values, int count, int operator,
+                           double literal, int *selection) {
+  __m128d lit = _mm_set1_pd(literal);
+  int i = 0;
+  int n = 0;
+
+  switch (operator) {
+  case EXPR_LT:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmplt_pd));
+    break;
+  case EXPR_LTE:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmple_pd));
+    break;
+  case EXPR_GT:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmpgt_pd));
+    break;
+  case EXPR_GTE:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmpge_pd));
+    break;
+  case EXPR_EQUAL:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmpeq_pd));
+    break;
+  case EXPR_NOT_EQUAL:
+    SIMD_LOOP(2, SSE2_REALS(_mm_cmpneq_pd));
+    break;
+  }
+
+  return selectRealsScalar(values, i, count, operator, literal, selection,
+                           n);
+}
+
+#endif // __SSE2__
+#endif // VECTOR_X86
+
+//
+// vector_selectInts
+//
+int vector_selectInts(const int *values, int count, int operator,
+                      int literal, int *selection) {
+#ifdef VECTOR_X86
+  if (__builtin_cpu_supports("avx2"))
+    return selectIntsAVX2(values, count, operator, literal, selection);
+#ifdef __SSE2__
+  return selectIntsSSE2(values, count, operator, literal, selection);
+#endif
+#endif
+
+  return selectIntsScalar(values, 0, count, operator, literal, selection, 0);
+}
+
+//
+// vector_selectReals
+//
+int vector_selectReals(const double *values, int count, int operator,
+                       double literal, int *selection) {
+#ifdef VECTOR_X86
+  if (__builtin_cpu_supports("avx2"))
+    return selectRealsAVX2(values, count, operator, literal, selection);
+#ifdef __SSE2__
+  return selectRealsSSE2(values, count, operator, literal, selection);
+#endif
+#endif
+
+  return selectRealsScalar(values, 0, count, operator, literal, selection,
+                           0);
+}
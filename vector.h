@@ -0,0 +1,56 @@
+/*vector.h*/
+
+//
+// Project: Vectorized predicate evaluation for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+
+//
+// A WHERE clause comparing an int or real column to a literal is
+// evaluated a batch of values at a time rather than one tuple at a
+// time. A kernel compares an entire array of values against the
+// literal and produces a selection vector: the positions (0-based,
+// in increasing order) of the values that satisfy the comparison.
+// Only the records in the selection are then read in full.
+//
+// On x86 the kernels compare 8 ints or 4 reals per instruction with
+// AVX2 when the CPU supports it, and 4 ints or 2 reals with SSE2
+// otherwise; elsewhere they fall back to a scalar loop.
+//
+#define VECTOR_BATCH_SIZE 1024
+
+//
+// Functions:
+//
+
+//
+// vector_supports
+//
+// Returns true if the given operator (enum AST_EXPR_OPERATORS) can
+// be evaluated by the kernels: <, <=, >, >=, = and <>.
+//
+bool vector_supports(int operator);
+
+//
+// vector_selectInts
+//
+// Compares values[0 .. count-1] against the literal with the given
+// operator, storing the positions of the values that satisfy it in
+// selection (an array of size count). Returns the # of positions
+// stored.
+//
+int vector_selectInts(const int *values, int count, int operator,
+                      int literal, int *selection);
+
+//
+// vector_selectReals
+//
+// Same as vector_selectInts(), for an array of reals.
+//
+int vector_selectReals(const double *values, int count, int operator,
+                       double literal, int *selection);
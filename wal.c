@@ -0,0 +1,914 @@
+/*wal.c*/
+
+//
+// Project: Write-ahead log for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <errno.h>
+#include <fcntl.h> // open
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stddef.h>  // offsetof
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // fstat, futimens
+#include <sys/uio.h>  // writev, pwritev
+#include <time.h>     // clock_gettime
+#include <unistd.h>   // fsync, ftruncate, pread, usleep
+
+#include "session.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+#define WAL_MAGIC 0x4c415753U // "SWAL", starts each entry of the log
+#define WAL_MAX_BUFFERS 1024  // max # of buffers per writev (IOV_MAX)
+#define WAL_CHECKPOINT (16LL * 1024 * 1024) // default, see wal.h
+
+#define CHECKSUM_START 2166136261U // see checksum()
+
+//
+// Each entry of the log is one change: a header, and then each of its
+// writes, as a WriteHeader followed by the bytes written.
+//
+struct EntryHeader {
+  unsigned int magic;
+  unsigned int checksum; // of the rest of the entry, see checksum()
+  long long length;      // # of bytes in the entry after the header
+  char table[DATABASE_MAX_ID_LENGTH + 1];
+  int numWrites;
+  int unused; // keeps the size of the header a multiple of 8
+};
+
+struct WriteHeader {
+  long long offset; // where in the data file
+  int length;       // # of bytes that follow
+  int unused;
+};
+
+//
+// The log of an open database:
+//
+struct Wal {
+  struct Database *db;
+  char path[TABLE_MAX_PATH_LENGTH];
+  int fd;         // -1 => unable to open or redo the log
+  long long size; // # of bytes in the log
+  bool *written;  // ARRAY: true => table written since the last checkpoint
+  bool failed;    // true => a group was logged but not written, see checkpoint
+  struct Wal *next;
+};
+
+//
+// A group waiting to be logged and written, and its changes:
+//
+struct Pending {
+  struct WalGroup group;
+  struct Wal *wal;
+  struct WalChange *first; // the change that started the group
+  struct WalChange **changes; // ARRAY: the changes prepared
+  int numChanges;
+};
+
+// held while the list of logs is changed
+static pthread_mutex_t walLock = PTHREAD_MUTEX_INITIALIZER;
+static struct Wal *wals = NULL;
+
+// held while the queue is changed, and a group is chosen
+static pthread_mutex_t commitLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t committed = PTHREAD_COND_INITIALIZER;
+
+static struct WalChange *queue = NULL; // oldest first
+static struct WalChange **queueTail = &queue;
+static bool committing = false; // true => a group is being written
+static long delay = -1;         // -1 => not read from the environment yet
+static long long limit = -1;    // -1 => not read from the environment yet
+
+//
+// commitDelay
+//
+// Returns the # of microseconds a group waits for more changes: the
+// value of the SIMPLESQL_COMMIT_DELAY environment variable if set,
+// otherwise 0. The caller holds commitLock.
+//
+static long commitDelay(void) {
+  if (delay < 0) {
+    char *value = getenv("SIMPLESQL_COMMIT_DELAY");
+
+    delay = (value != NULL && atol(value) > 0) ? atol(value) : 0;
+  }
+
+  return delay;
+}
+
+//
+// checkpointLimit
+//
+// Returns the # of bytes the log may grow to before a checkpoint: the
+// value of the SIMPLESQL_CHECKPOINT environment variable if set,
+// otherwise 16 MB. Only called while writing a group.
+//
+static long long checkpointLimit(void) {
+  if (limit < 0) {
+    char *value = getenv("SIMPLESQL_CHECKPOINT");
+
+    limit = (value != NULL && atoll(value) > 0) ? atoll(value)
+                                                : WAL_CHECKPOINT;
+  }
+
+  return limit;
+}
+
+//
+// checksum
+//
+// Adds the bytes to a running checksum (32-bit FNV-1a), which starts
+// at CHECKSUM_START.
+//
+static unsigned int checksum(unsigned int sum, const void *bytes,
+                             size_t length) {
+  const unsigned char *cp = (const unsigned char *)bytes;
+
+  for (size_t i = 0; i < length; i++)
+    sum = (sum ^ cp[i]) * 16777619U;
+
+  return sum;
+}
+
+//
+// headerChecksum
+//
+// Starts the checksum of an entry with its header, after the checksum
+// itself.
+//
+static unsigned int headerChecksum(struct EntryHeader *header) {
+  size_t start = offsetof(struct EntryHeader, length);
+
+  return checksum(CHECKSUM_START, (char *)header + start,
+                  sizeof(struct EntryHeader) - start);
+}
+
+//
+// writeAll
+//
+// Writes the buffers with as few writes as possible, at the given
+// offset, or at the end of a file opened with O_APPEND if offset < 0.
+// Returns false if they could not all be written.
+//
+static bool writeAll(int fd, struct iovec *iov, int count, long long offset) {
+  while (count > 0) {
+    int numBuffers = (count < WAL_MAX_BUFFERS) ? count : WAL_MAX_BUFFERS;
+    ssize_t n = (offset < 0) ? writev(fd, iov, numBuffers)
+                             : pwritev(fd, iov, numBuffers, offset);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    if (n <= 0)
+      return false;
+
+    if (offset >= 0)
+      offset += n;
+
+    // skipping what was written, which may end within a buffer
+    while (count > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+
+  return true;
+}
+
+//
+// writeChange
+//
+// Writes the change's writes to the data file, with one write per run
+// of them that are back to back. Returns false if they could not all
+// be written.
+//
+static bool writeChange(int fd, struct WalChange *change) {
+  struct iovec iov[WAL_MAX_BUFFERS];
+  int w = 0;
+
+  while (w < change->numWrites) {
+    long long offset = change->writes[w].offset;
+    long long next = offset;
+    int count = 0;
+
+    while (w < change->numWrites && count < WAL_MAX_BUFFERS &&
+           change->writes[w].offset == next) {
+      iov[count].iov_base = change->writes[w].bytes;
+      iov[count].iov_len = change->writes[w].length;
+      next += change->writes[w].length;
+      count++;
+      w++;
+    }
+
+    if (!writeAll(fd, iov, count, offset))
+      return false;
+  }
+
+  return true;
+}
+
+//
+// modifiedOf
+//
+// Returns the modification time of the file, in ns.
+//
+static long long modifiedOf(struct stat *info) {
+  return (info->st_mtim.tv_sec * 1000000000LL) + info->st_mtim.tv_nsec;
+}
+
+//
+// touch
+//
+// Sets the modification time of a data file that was just written to
+// later than it was before (modified). Indexes and caches tell that a
+// table changed by the size and modification time of its data file,
+// but a change in place keeps the size, and the file system may only
+// keep the time to the clock tick.
+//
+static void touch(int fd, long long modified) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  long long ns = (now.tv_sec * 1000000000LL) + now.tv_nsec;
+
+  if (ns <= modified)
+    ns = modified + 1;
+
+  struct timespec times[2];
+
+  times[0].tv_sec = 0;
+  times[0].tv_nsec = UTIME_OMIT; // the access time is left alone
+  times[1].tv_sec = ns / 1000000000LL;
+  times[1].tv_nsec = ns % 1000000000LL;
+
+  futimens(fd, times);
+}
+
+//
+// openData
+//
+// Opens the data file of the table for writing, storing its size and
+// modification time. Returns -1 if it cannot be opened.
+//
+static int openData(struct Database *db, struct TableMeta *meta,
+                    long long *size, long long *modified) {
+  char path[TABLE_MAX_PATH_LENGTH];
+  struct stat info;
+
+  table_path(path, db, meta->name, ".data");
+
+  int fd = open(path, O_WRONLY);
+
+  if (fd >= 0 && fstat(fd, &info) != 0) {
+    close(fd);
+    fd = -1;
+  }
+
+  if (fd >= 0) {
+    *size = info.st_size;
+    *modified = modifiedOf(&info);
+  }
+
+  return fd;
+}
+
+//
+// redoEntry
+//
+// Writes the entry's writes to the data file. Returns false if the
+// entry is not well-formed or could not be written.
+//
+static bool redoEntry(int fd, struct EntryHeader *header, char *body) {
+  char *cp = body;
+  char *end = body + header->length;
+
+  for (int w = 0; w < header->numWrites; w++) {
+    struct WriteHeader write;
+
+    if ((size_t)(end - cp) < sizeof(write))
+      return false;
+
+    memcpy(&write, cp, sizeof(write));
+    cp += sizeof(write);
+
+    if (write.length < 0 || write.length > end - cp || write.offset < 0)
+      return false;
+
+    struct iovec iov;
+    iov.iov_base = cp;
+    iov.iov_len = write.length;
+
+    if (!writeAll(fd, &iov, 1, write.offset))
+      return false;
+
+    cp += write.length;
+  }
+
+  return true;
+}
+
+//
+// redoLog
+//
+// Writes the changes in the log again, in order, stopping at the first
+// incomplete entry, then fsyncs the data files and empties the log.
+// Stores the # of changes redone, and returns false if this fails.
+//
+static bool redoLog(struct Wal *wal, int *numRedone) {
+  struct Database *db = wal->db;
+  struct stat info;
+
+  *numRedone = 0;
+
+  if (fstat(wal->fd, &info) != 0)
+    return false;
+
+  if (info.st_size == 0)
+    return true;
+
+  size_t size = info.st_size;
+  char *log = (char *)malloc(size);
+  if (log == NULL)
+    panic("out of memory");
+
+  int N = db->numTables;
+  int fds[N + 1];
+  long long sizes[N + 1];
+  long long modified[N + 1];
+
+  for (int t = 0; t < N; t++)
+    fds[t] = -1;
+
+  bool success = (pread(wal->fd, log, size, 0) == (ssize_t)size);
+  size_t pos = 0;
+
+  while (success && size - pos >= sizeof(struct EntryHeader)) {
+    struct EntryHeader header;
+    char *body = log + pos + sizeof(header);
+
+    memcpy(&header, log + pos, sizeof(header));
+
+    // the entry being written when the crash came ends the log
+    if (header.magic != WAL_MAGIC || header.length < 0 ||
+        (size_t)header.length > size - pos - sizeof(header) ||
+        checksum(headerChecksum(&header), body, header.length) !=
+            header.checksum)
+      break;
+
+    pos += sizeof(header) + header.length;
+
+    header.table[DATABASE_MAX_ID_LENGTH] = '\0';
+
+    struct TableMeta *meta = table_find(db, header.table);
+
+    if (meta == NULL) // no longer in the database
+      continue;
+
+    int t = meta - db->tables; // its index, for fds[] etc.
+
+    if (fds[t] < 0)
+      fds[t] = openData(db, meta, &sizes[t], &modified[t]);
+
+    // queries may be running if this is a checkpoint
+    table_lockWrite(meta);
+    success = (fds[t] >= 0) && redoEntry(fds[t], &header, body);
+    table_unlockWrite(meta);
+
+    (*numRedone)++;
+  }
+
+  for (int t = 0; t < N; t++) {
+    if (fds[t] < 0)
+      continue;
+
+    success = success && (fsync(fds[t]) == 0);
+    touch(fds[t], modified[t]);
+    close(fds[t]);
+  }
+
+  free(log);
+
+  return success && ftruncate(wal->fd, 0) == 0 && fsync(wal->fd) == 0;
+}
+
+//
+// redo
+//
+// Redoes the log of the database being opened. If this fails, the log
+// is closed so no more changes are made.
+//
+static void redo(struct Wal *wal) {
+  int numRedone;
+
+  if (redoLog(wal, &numRedone)) {
+    if (numRedone > 0)
+      fprintf(session_output(), "**RECOVERED: %d changes from log '%s'\n",
+              numRedone, wal->path);
+    return;
+  }
+
+  fprintf(session_output(), "**INTERNAL ERROR: unable to redo log '%s'.\n",
+          wal->path);
+
+  close(wal->fd);
+  wal->fd = -1;
+}
+
+//
+// walOf
+//
+// Returns the log of the database, opening (and redoing) it if it is
+// not open yet.
+//
+static struct Wal *walOf(struct Database *db) {
+  pthread_mutex_lock(&walLock);
+
+  struct Wal *wal = wals;
+
+  while (wal != NULL && wal->db != db)
+    wal = wal->next;
+
+  if (wal == NULL) {
+    wal = (struct Wal *)malloc(sizeof(struct Wal));
+    if (wal == NULL)
+      panic("out of memory");
+
+    wal->db = db;
+    table_path(wal->path, db, db->name, ".wal");
+    wal->fd = open(wal->path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    wal->size = 0;
+    wal->failed = false;
+    wal->written = (bool *)calloc(db->numTables + 1, sizeof(bool));
+    if (wal->written == NULL)
+      panic("out of memory");
+
+    if (wal->fd >= 0)
+      redo(wal);
+
+    wal->next = wals;
+    wals = wal;
+  }
+
+  pthread_mutex_unlock(&walLock);
+
+  return wal;
+}
+
+//
+// checkpoint
+//
+// fsyncs the data files written since the last checkpoint, and then
+// empties the log. If a group could not be written since, the log is
+// redone instead, and kept if that fails too. Returns false if this
+// fails; an error message was output.
+//
+static bool checkpoint(struct Wal *wal) {
+  struct Database *db = wal->db;
+
+  if (wal->fd < 0 || wal->size == 0)
+    return true;
+
+  if (wal->failed) {
+    int numRedone;
+
+    if (!redoLog(wal, &numRedone)) {
+      fprintf(session_output(),
+              "**INTERNAL ERROR: unable to redo log '%s', it is kept "
+              "until the database is next opened.\n",
+              wal->path);
+      return false;
+    }
+
+    wal->failed = false;
+    wal->size = 0;
+    memset(wal->written, 0, sizeof(bool) * db->numTables);
+    return true;
+  }
+
+  bool synced = true;
+
+  for (int t = 0; t < db->numTables && synced; t++) {
+    if (!wal->written[t])
+      continue;
+
+    char path[TABLE_MAX_PATH_LENGTH];
+
+    table_path(path, db, db->tables[t].name, ".data");
+
+    int fd = open(path, O_RDONLY);
+
+    synced = (fd >= 0) && (fsync(fd) == 0);
+
+    if (fd >= 0)
+      close(fd);
+  }
+
+  if (synced && ftruncate(wal->fd, 0) == 0 && fsync(wal->fd) == 0) {
+    wal->size = 0;
+    memset(wal->written, 0, sizeof(bool) * db->numTables);
+    return true;
+  }
+
+  fprintf(session_output(),
+          "**INTERNAL ERROR: unable to checkpoint log '%s'.\n", wal->path);
+  return false;
+}
+
+//
+// logChanges
+//
+// Appends an entry for each change of the pending groups of the log's
+// database to the log, with one write, and fsyncs it. Returns false if
+// the entries could not be logged; an error message was output to
+// each change's session.
+//
+static bool logChanges(struct Wal *wal, struct Pending *pending,
+                       int numPending) {
+  int numEntries = 0;
+  int numWrites = 0;
+
+  for (int p = 0; p < numPending; p++) {
+    if (pending[p].wal != wal)
+      continue;
+
+    for (int c = 0; c < pending[p].numChanges; c++) {
+      numEntries++;
+      numWrites += pending[p].changes[c]->numWrites;
+    }
+  }
+
+  if (numEntries == 0)
+    return true;
+
+  struct EntryHeader *entries = (struct EntryHeader *)malloc(
+      sizeof(struct EntryHeader) * numEntries);
+  struct WriteHeader *writes = (struct WriteHeader *)malloc(
+      sizeof(struct WriteHeader) * (numWrites + 1));
+  struct iovec *iov = (struct iovec *)malloc(
+      sizeof(struct iovec) * (numEntries + (2 * numWrites)));
+  if (entries == NULL || writes == NULL || iov == NULL)
+    panic("out of memory");
+
+  int e = 0, w = 0, count = 0;
+  long long length = 0;
+
+  for (int p = 0; p < numPending; p++) {
+    if (pending[p].wal != wal)
+      continue;
+
+    for (int c = 0; c < pending[p].numChanges; c++) {
+      struct WalChange *change = pending[p].changes[c];
+      struct EntryHeader *header = &entries[e++];
+
+      memset(header, 0, sizeof(struct EntryHeader));
+      header->magic = WAL_MAGIC;
+      strncpy(header->table, change->meta->name, DATABASE_MAX_ID_LENGTH);
+      header->numWrites = change->numWrites;
+
+      for (int i = 0; i < change->numWrites; i++)
+        header->length += sizeof(struct WriteHeader) + change->writes[i].length;
+
+      unsigned int sum = headerChecksum(header);
+
+      iov[count].iov_base = header;
+      iov[count++].iov_len = sizeof(struct EntryHeader);
+
+      for (int i = 0; i < change->numWrites; i++) {
+        struct WriteHeader *write = &writes[w++];
+
+        memset(write, 0, sizeof(struct WriteHeader));
+        write->offset = change->writes[i].offset;
+        write->length = change->writes[i].length;
+
+        sum = checksum(sum, write, sizeof(struct WriteHeader));
+        sum = checksum(sum, change->writes[i].bytes, write->length);
+
+        iov[count].iov_base = write;
+        iov[count++].iov_len = sizeof(struct WriteHeader);
+        iov[count].iov_base = change->writes[i].bytes;
+        iov[count++].iov_len = write->length;
+      }
+
+      header->checksum = sum;
+      length += sizeof(struct EntryHeader) + header->length;
+    }
+  }
+
+  bool logged = (wal->fd >= 0) && writeAll(wal->fd, iov, count, -1) &&
+                (fsync(wal->fd) == 0);
+
+  free(entries);
+  free(writes);
+  free(iov);
+
+  if (logged) {
+    wal->size += length;
+    return true;
+  }
+
+  // dropping whatever part was written
+  if (wal->fd >= 0 && ftruncate(wal->fd, wal->size) != 0) {
+    close(wal->fd);
+    wal->fd = -1;
+  }
+
+  for (int p = 0; p < numPending; p++) {
+    if (pending[p].wal != wal)
+      continue;
+
+    for (int c = 0; c < pending[p].numChanges; c++)
+      fprintf(pending[p].changes[c]->output,
+              "**INTERNAL ERROR: unable to write log '%s'.\n", wal->path);
+  }
+
+  return false;
+}
+
+//
+// writeGroup
+//
+// Writes the changes of the group, which were logged, to the table's
+// data file, holding the table's lock so no query sees them half
+// done. An error message is output to each change's session if this
+// fails, in which case the log is redone at the next checkpoint rather
+// than emptied.
+//
+static void writeGroup(struct Pending *pending) {
+  struct WalGroup *group = &pending->group;
+  long long size, modified;
+  bool written = true;
+
+  int fd = openData(group->db, group->meta, &size, &modified);
+
+  table_lockWrite(group->meta);
+
+  for (int c = 0; c < pending->numChanges && written; c++)
+    written = (fd >= 0) && writeChange(fd, pending->changes[c]);
+
+  if (fd >= 0)
+    touch(fd, modified);
+
+  table_unlockWrite(group->meta);
+
+  if (fd >= 0)
+    close(fd);
+
+  pending->wal->written[group->meta - group->db->tables] = true;
+
+  if (!written)
+    pending->wal->failed = true;
+
+  for (int c = 0; c < pending->numChanges; c++) {
+    struct WalChange *change = pending->changes[c];
+
+    if (written)
+      change->committed = true;
+    else
+      fprintf(change->output,
+              "**INTERNAL ERROR: unable to write data file of table '%s', "
+              "it is redone from the log at the next checkpoint.\n",
+              group->meta->name);
+  }
+}
+
+//
+// flush
+//
+// Logs the changes of the pending groups, with one write and fsync per
+// database, and then writes them to the data files. Once the groups
+// are written, checkpoints each log that has grown too large.
+//
+static void flush(struct Pending *pending, int numPending) {
+  // e.g. closing the tables the changes were prepared with
+  for (int p = 0; p < numPending; p++) {
+    session_setOutput(pending[p].first->output);
+
+    if (pending[p].first->release != NULL)
+      pending[p].first->release(&pending[p].group);
+  }
+
+  bool logged[numPending + 1];
+
+  // each database's changes are logged along with its first group
+  for (int p = 0; p < numPending; p++) {
+    int q = 0;
+
+    while (q < p && pending[q].wal != pending[p].wal)
+      q++;
+
+    logged[p] = (q < p) ? logged[q]
+                        : logChanges(pending[p].wal, pending, numPending);
+  }
+
+  for (int p = 0; p < numPending; p++) {
+    bool any = false;
+
+    for (int c = 0; c < pending[p].numChanges; c++)
+      any = any || (pending[p].changes[c]->numWrites > 0);
+
+    if (!logged[p])
+      continue;
+
+    if (!any) { // nothing to write, e.g. a DELETE that matched no rows
+      for (int c = 0; c < pending[p].numChanges; c++)
+        pending[p].changes[c]->committed = true;
+      continue;
+    }
+
+    writeGroup(&pending[p]);
+
+    session_setOutput(pending[p].first->output);
+
+    // e.g. bringing the table's indexes up to date
+    if (pending[p].first->finish != NULL)
+      pending[p].first->finish(&pending[p].group);
+  }
+
+  for (int p = 0; p < numPending; p++) {
+    if (pending[p].wal->size > checkpointLimit())
+      checkpoint(pending[p].wal);
+
+    free(pending[p].changes);
+  }
+}
+
+//
+// writeChanges
+//
+// Prepares, logs and writes the queued changes, in order: a group per
+// table, flushed whenever a change must see the changes before it.
+//
+static void writeChanges(struct WalChange *changes) {
+  FILE *output = session_output();
+  int N = 0;
+
+  for (struct WalChange *c = changes; c != NULL; c = c->next)
+    N++;
+
+  struct Pending *pending =
+      (struct Pending *)malloc(sizeof(struct Pending) * N);
+  if (pending == NULL)
+    panic("out of memory");
+
+  int numPending = 0;
+
+  for (struct WalChange *c = changes; c != NULL; c = c->next) {
+    struct Pending *group = NULL;
+
+    for (int p = 0; p < numPending; p++) {
+      if (pending[p].group.db == c->db && pending[p].group.meta == c->meta)
+        group = &pending[p];
+    }
+
+    // only appends may join a group, anything else reads the table
+    if (group != NULL && !(c->append && group->first->append)) {
+      flush(pending, numPending);
+      numPending = 0;
+      group = NULL;
+    }
+
+    if (group == NULL) {
+      group = &pending[numPending++];
+
+      group->group.db = c->db;
+      group->group.meta = c->meta;
+      group->group.state = NULL;
+      group->wal = walOf(c->db);
+      group->first = c;
+      group->numChanges = 0;
+      group->changes =
+          (struct WalChange **)malloc(sizeof(struct WalChange *) * N);
+      if (group->changes == NULL)
+        panic("out of memory");
+
+      int fd = openData(c->db, c->meta, &group->group.size,
+                        &group->group.modified);
+
+      if (fd >= 0)
+        close(fd);
+      else
+        group->group.size = -1;
+
+      group->group.end = group->group.size;
+    }
+
+    c->writes = NULL;
+    c->numWrites = 0;
+    c->numRows = 0;
+
+    session_setOutput(c->output);
+
+    if (c->prepare(c, &group->group))
+      group->changes[group->numChanges++] = c;
+  }
+
+  flush(pending, numPending);
+
+  free(pending);
+
+  session_setOutput(output);
+}
+
+//
+// wal_recover
+//
+void wal_recover(struct Database *db) { walOf(db); }
+
+//
+// wal_commit
+//
+void wal_commit(struct WalChange *change) {
+  change->output = session_output();
+  change->committed = false;
+  change->done = false;
+  change->next = NULL;
+
+  pthread_mutex_lock(&commitLock);
+
+  *queueTail = change;
+  queueTail = &change->next;
+
+  while (!change->done) {
+    if (committing) {
+      pthread_cond_wait(&committed, &commitLock);
+      continue;
+    }
+
+    committing = true;
+
+    if (commitDelay() > 0) { // letting more changes join the group
+      pthread_mutex_unlock(&commitLock);
+      usleep(commitDelay());
+      pthread_mutex_lock(&commitLock);
+    }
+
+    struct WalChange *changes = queue;
+
+    queue = NULL;
+    queueTail = &queue;
+
+    pthread_mutex_unlock(&commitLock);
+
+    writeChanges(changes);
+
+    pthread_mutex_lock(&commitLock);
+
+    // their sessions may free the changes once done
+    while (changes != NULL) {
+      struct WalChange *next = changes->next;
+
+      changes->done = true;
+      changes = next;
+    }
+
+    committing = false;
+    pthread_cond_broadcast(&committed);
+  }
+
+  pthread_mutex_unlock(&commitLock);
+}
+
+//
+// wal_close
+//
+void wal_close(struct Database *db) {
+  pthread_mutex_lock(&walLock);
+
+  struct Wal **link = &wals;
+
+  while (*link != NULL && (*link)->db != db)
+    link = &(*link)->next;
+
+  struct Wal *wal = *link;
+
+  if (wal != NULL)
+    *link = wal->next;
+
+  pthread_mutex_unlock(&walLock);
+
+  if (wal == NULL)
+    return;
+
+  checkpoint(wal);
+
+  if (wal->fd >= 0)
+    close(wal->fd);
+
+  free(wal->written);
+  free(wal);
+}
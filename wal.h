@@ -0,0 +1,131 @@
+/*wal.h*/
+
+//
+// Project: Write-ahead log for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+#include <stdio.h>
+
+#include "database.h"
+
+//
+// INSERT, UPDATE and DELETE write a table's data file in place (see
+// insert.h and modify.h), so a crash in the middle of one could leave
+// a table half-changed. Each change is therefore first appended to
+// the database's log, "<database>/<database>.wal", as the bytes it
+// writes to the data file and where. Once the log is fsync'd the
+// change is durable, and only then is the data file written, without
+// an fsync: the log can redo it.
+//
+// When the database is next opened (see wal_recover), every change in
+// the log is written again, which is harmless for those that already
+// were. A change whose log entry is incomplete (its checksum does not
+// match) was never reported as done, and is dropped.
+//
+// Checkpoints: once the log grows past 16 MB (set SIMPLESQL_CHECKPOINT
+// to the # of bytes to change it), and when the database is closed,
+// the data files written since the last checkpoint are fsync'd and the
+// log is emptied. If a change was logged but could not be written to
+// its data file, the log is redone instead, and kept if that fails.
+//
+// Group commit: changes from concurrent sessions (see server.h) are
+// logged together. While one group is being logged and written, the
+// others queue up; the next to go then logs every queued change with
+// one write and one fsync. Appends to a table (INSERTs) are written
+// together, but a change that reads the table (UPDATE, DELETE) waits
+// for the changes to it queued before it to be written. Set the
+// SIMPLESQL_COMMIT_DELAY environment variable to a # of microseconds
+// to have each group wait that long for more changes to join it,
+// trading latency for fewer fsyncs.
+//
+
+//
+// A write to a table's data file:
+//
+struct WalWrite {
+  long long offset; // where in the data file
+  char *bytes;      // what to write there (not owned)
+  int length;       // # of bytes
+};
+
+//
+// The changes of a group to the same table, which are written
+// together:
+//
+struct WalGroup {
+  struct Database *db;
+  struct TableMeta *meta;
+  long long size;     // # of bytes in the data file before, -1 => none
+  long long modified; // modification time of the data file before (ns)
+  long long end;      // where the group's next record is appended
+  void *state;        // for the changes' callbacks, initially NULL
+};
+
+//
+// A change to a table, e.g. an INSERT:
+//
+struct WalChange {
+  struct Database *db;
+  struct TableMeta *meta;
+  bool append; // true => only appends records, see group commit above
+
+  //
+  // Called in the order the changes were queued, by the thread writing
+  // the group, with the change's session output (see session.h):
+  //
+  // prepare fills in the change's writes and # of rows, or else
+  // outputs an error message and returns false. It may keep the table
+  // open in the group's state until release, which is called before
+  // any of the group's writes. finish is called after them, if there
+  // were any. The group's changes all have the same callbacks.
+  //
+  bool (*prepare)(struct WalChange *change, struct WalGroup *group);
+  void (*release)(struct WalGroup *group); // NULL => none
+  void (*finish)(struct WalGroup *group);  // NULL => none
+  void *arg; // the INSERT, UPDATE or DELETE being done
+
+  struct WalWrite *writes; // ARRAY, in increasing order of offset
+  int numWrites;
+  int numRows; // # of rows inserted, updated or deleted
+
+  FILE *output;   // the session output of whoever queued the change
+  bool committed; // true => logged and written
+  bool done;      // true => committed, or failed
+  struct WalChange *next;
+};
+
+//
+// Functions:
+//
+
+//
+// wal_recover
+//
+// Opens the log of the database, which has just been opened (see
+// database_open), redoing the changes in it and then emptying it. An
+// error message is output if the log cannot be redone; it is then kept
+// for the next time.
+//
+void wal_recover(struct Database *db);
+
+//
+// wal_commit
+//
+// Queues the change, whose db, meta, append, callbacks and arg are
+// set, and returns once it is logged and written (change->committed)
+// or has failed, in which case an error message was output.
+//
+void wal_commit(struct WalChange *change);
+
+//
+// wal_close
+//
+// Checkpoints the log of the database and closes it; call this before
+// database_close().
+//
+void wal_close(struct Database *db);
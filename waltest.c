@@ -0,0 +1,307 @@
+/*waltest.c*/
+
+//
+// Program to test that the write-ahead log (see wal.h) redoes only the
+// complete entries at its start when the database is reopened.
+//
+// Usage: waltest
+//
+// Creates a database with one table of 4 records in a temporary
+// directory. For each case below, a child process commits 3 changes
+// to the table, each overwriting one record, and exits without
+// closing the log, as if it crashed. The data file is then put back
+// as it was, the log is damaged as the case says, and the database is
+// reopened (see wal_recover):
+//
+//   intact     the log is left alone, all 3 changes are redone
+//   torn       the last entry ends halfway, only the first 2 are
+//   checksum   a byte of the last entry is changed, only the first 2
+//
+// Each case passes if the data file then holds exactly the changes
+// that should have been redone, and the log is empty. Outputs PASS or
+// FAIL for each case, and exits with 1 if any failed.
+//
+// Randy Truong
+//
+
+#include <fcntl.h>   // open
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // mkdir, stat
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, pipe, truncate
+
+#include "database.h"
+#include "table.h"
+#include "util.h"
+#include "wal.h"
+
+#define WALTEST_DATABASE "WalTest"
+#define WALTEST_TABLE "Records"
+#define WALTEST_RECORD_SIZE 8 // "0.....$\n"
+#define WALTEST_RECORDS 4
+#define WALTEST_CHANGES 3
+
+enum Damage { DAMAGE_NONE, DAMAGE_TORN, DAMAGE_CHECKSUM };
+
+//
+// writeFile
+//
+// Replaces the file at the given path with the string.
+//
+static void writeFile(char *path, char *contents) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    panic("unable to write test database");
+
+  fputs(contents, file);
+  fclose(file);
+}
+
+//
+// record
+//
+// Stores the record that change c writes (0 => as created), e.g.
+// "2.....$\n" for change 2.
+//
+static void record(char *bytes, int c) {
+  memcpy(bytes, "0.....$\n", WALTEST_RECORD_SIZE);
+  bytes[0] = (char)('0' + c);
+}
+
+//
+// expected
+//
+// Stores the data file as it is after the first numChanges changes
+// (change c overwrites record c - 1), with a '\0' after it.
+//
+static void expected(char *data, int numChanges) {
+  for (int r = 0; r < WALTEST_RECORDS; r++)
+    record(data + (r * WALTEST_RECORD_SIZE), (r < numChanges) ? r + 1 : 0);
+
+  data[WALTEST_RECORDS * WALTEST_RECORD_SIZE] = '\0';
+}
+
+//
+// prepareChange
+//
+// The change's one write was filled in by commitChanges.
+//
+static bool prepareChange(struct WalChange *change, struct WalGroup *group) {
+  (void)group;
+
+  change->writes = (struct WalWrite *)change->arg;
+  change->numWrites = 1;
+  change->numRows = 1;
+  return true;
+}
+
+//
+// commitChanges
+//
+// Run by the child: commits the changes, one at a time, writing the
+// size of the log after each to the pipe, and then exits without
+// closing the log.
+//
+static void commitChanges(int pipeFd) {
+  struct Database *db = database_open(WALTEST_DATABASE);
+  if (db == NULL)
+    panic("unable to open test database");
+
+  wal_recover(db);
+
+  char path[TABLE_MAX_PATH_LENGTH];
+  struct stat info;
+
+  table_path(path, db, db->name, ".wal");
+
+  for (int c = 1; c <= WALTEST_CHANGES; c++) {
+    char bytes[WALTEST_RECORD_SIZE];
+    struct WalWrite walWrite;
+    struct WalChange change;
+
+    record(bytes, c);
+    walWrite.offset = (long long)(c - 1) * WALTEST_RECORD_SIZE;
+    walWrite.bytes = bytes;
+    walWrite.length = WALTEST_RECORD_SIZE;
+
+    memset(&change, 0, sizeof(change));
+    change.db = db;
+    change.meta = &db->tables[0];
+    change.append = false;
+    change.prepare = prepareChange;
+    change.arg = &walWrite;
+
+    wal_commit(&change);
+
+    long long size = (change.committed && stat(path, &info) == 0)
+                         ? (long long)info.st_size
+                         : -1;
+
+    if (write(pipeFd, &size, sizeof(size)) != sizeof(size))
+      _exit(1);
+  }
+
+  fflush(stdout);
+  _exit(0); // as if crashed: the log is not checkpointed
+}
+
+//
+// runCase
+//
+// Commits the changes in a child process, damages the log, and then
+// recovers it. Returns true if exactly the changes before the damage
+// were redone and the log is empty.
+//
+static bool runCase(char *name, enum Damage damage) {
+  char dataPath[TABLE_MAX_PATH_LENGTH];
+  char logPath[TABLE_MAX_PATH_LENGTH];
+  char data[(WALTEST_RECORDS * WALTEST_RECORD_SIZE) + 1];
+
+  snprintf(dataPath, sizeof(dataPath), "%s/%s.data", WALTEST_DATABASE,
+           WALTEST_TABLE);
+  snprintf(logPath, sizeof(logPath), "%s/%s.wal", WALTEST_DATABASE,
+           WALTEST_DATABASE);
+
+  expected(data, 0);
+  writeFile(dataPath, data);
+  unlink(logPath);
+
+  // the log's size after each change, from the child
+  long long sizes[WALTEST_CHANGES];
+  int fds[2];
+
+  if (pipe(fds) != 0)
+    panic("unable to create pipe");
+
+  fflush(stdout);
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+    panic("unable to fork");
+
+  if (pid == 0) {
+    close(fds[0]);
+    commitChanges(fds[1]);
+  }
+
+  close(fds[1]);
+
+  bool ok = true;
+  int status;
+
+  for (int c = 0; c < WALTEST_CHANGES; c++)
+    ok = ok &&
+         (read(fds[0], &sizes[c], sizeof(sizes[c])) == sizeof(sizes[c])) &&
+         (sizes[c] > 0);
+
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+
+  if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("FAIL: %s (the changes could not be committed)\n", name);
+    return false;
+  }
+
+  // the data file as if none of the changes had been written
+  writeFile(dataPath, data);
+
+  long long start = sizes[WALTEST_CHANGES - 2]; // of the last entry
+  long long end = sizes[WALTEST_CHANGES - 1];
+  int numRedone = WALTEST_CHANGES - 1;
+
+  if (damage == DAMAGE_NONE)
+    numRedone = WALTEST_CHANGES;
+  else if (damage == DAMAGE_TORN)
+    ok = (truncate(logPath, start + ((end - start) / 2)) == 0);
+  else {
+    // the last byte of the entry is the last byte of its record
+    int fd = open(logPath, O_RDWR);
+    char byte = '!';
+
+    ok = (fd >= 0) && (pwrite(fd, &byte, 1, end - 1) == 1);
+
+    if (fd >= 0)
+      close(fd);
+  }
+
+  if (!ok) {
+    printf("FAIL: %s (unable to damage the log)\n", name);
+    return false;
+  }
+
+  struct Database *db = database_open(WALTEST_DATABASE);
+  if (db == NULL)
+    panic("unable to open test database");
+
+  wal_recover(db);
+  wal_close(db);
+  database_close(db);
+
+  char want[sizeof(data)];
+  char got[sizeof(data) + 1];
+  struct stat info;
+  FILE *file = fopen(dataPath, "r");
+  size_t length = 0;
+
+  expected(want, numRedone);
+
+  if (file != NULL) {
+    length = fread(got, 1, sizeof(got) - 1, file);
+    fclose(file);
+  }
+
+  got[length] = '\0';
+
+  if (strcmp(got, want) != 0) {
+    printf("FAIL: %s (data file is \"%s\", expected \"%s\")\n", name, got,
+           want);
+    return false;
+  }
+
+  if (stat(logPath, &info) != 0 || info.st_size != 0) {
+    printf("FAIL: %s (log was not emptied)\n", name);
+    return false;
+  }
+
+  printf("PASS: %s\n", name);
+  return true;
+}
+
+int main(void) {
+  char dir[] = "/tmp/waltest.XXXXXX";
+
+  // the log's checkpoints must not empty it before the "crash"
+  unsetenv("SIMPLESQL_CHECKPOINT");
+
+  if (mkdtemp(dir) == NULL || chdir(dir) != 0 ||
+      mkdir(WALTEST_DATABASE, 0755) != 0)
+    panic("unable to create test database");
+
+  char meta[64];
+
+  writeFile(WALTEST_DATABASE "/" WALTEST_DATABASE ".meta",
+            "1\n" WALTEST_TABLE "\n");
+  snprintf(meta, sizeof(meta), "%d\n1\nID 1 0\n", WALTEST_RECORD_SIZE);
+  writeFile(WALTEST_DATABASE "/" WALTEST_TABLE ".meta", meta);
+
+  bool passed = runCase("intact", DAMAGE_NONE);
+
+  passed = runCase("torn", DAMAGE_TORN) && passed;
+  passed = runCase("checksum", DAMAGE_CHECKSUM) && passed;
+
+  // removing the test database
+  unlink(WALTEST_DATABASE "/" WALTEST_TABLE ".data");
+  unlink(WALTEST_DATABASE "/" WALTEST_TABLE ".meta");
+  unlink(WALTEST_DATABASE "/" WALTEST_DATABASE ".meta");
+  unlink(WALTEST_DATABASE "/" WALTEST_DATABASE ".wal");
+  rmdir(WALTEST_DATABASE);
+
+  if (chdir("/") == 0)
+    rmdir(dir);
+
+  return passed ? 0 : 1;
+}
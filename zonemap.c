@@ -0,0 +1,341 @@
+/*zonemap.c*/
+
+//
+// Project: Zone maps for SimpleSQL
+//
+// Randy Truong
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h> // true, false
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "util.h"
+#include "zonemap.h"
+
+//
+// The zone map file is a header followed by the array of zones:
+//
+#define ZONEMAP_MAGIC "SSQLZMP1"
+
+struct ZoneMapHeader {
+  char magic[8];
+  long long dataSize;     // size of the data file the map was built from
+  long long dataModified; // modification time of that data file (ns)
+  int colType;
+  int numRecords;
+  int numZones;
+  int unused;
+};
+
+// held while a zone map is read, or built and written
+static pthread_mutex_t zoneLock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// zoneString
+//
+// Returns the value of the string column in the given record.
+//
+static struct TupleValue *zoneString(struct ZoneMap *map, int recordNum) {
+  table_read(map->table, recordNum, map->columns, map->values);
+
+  return &map->values[map->column];
+}
+
+//
+// buildStrings
+//
+// Fills in the zone of records [first, last) of a string column.
+//
+static void buildStrings(struct ZoneMap *map, int first, int last,
+                         struct Zone *zone) {
+  // the strings point into the table's data, so stay valid
+  struct TupleValue min = *zoneString(map, first);
+  struct TupleValue max = min;
+
+  zone->min.i = first;
+  zone->max.i = first;
+
+  for (int r = first + 1; r < last; r++) {
+    struct TupleValue *value = zoneString(map, r);
+
+    if (operator_compareString(value->value.s, value->length, min.value.s,
+                               min.length) < 0) {
+      min = *value;
+      zone->min.i = r;
+    }
+
+    if (operator_compareString(value->value.s, value->length, max.value.s,
+                               max.length) > 0) {
+      max = *value;
+      zone->max.i = r;
+    }
+  }
+}
+
+//
+// zonemap_build
+//
+// Builds the zones of the map from the table's data.
+//
+static void zonemap_build(struct ZoneMap *map) {
+  int N = map->table->numRecords;
+
+  map->numZones = (N + ZONEMAP_BLOCK_SIZE - 1) / ZONEMAP_BLOCK_SIZE;
+  map->zones = (struct Zone *)malloc(sizeof(struct Zone) * (map->numZones + 1));
+  if (map->zones == NULL)
+    panic("out of memory");
+
+  // a block of an int or real column is read at once, see table_column()
+  double *buffer = NULL;
+
+  if (map->colType != COL_TYPE_STRING) {
+    buffer = (double *)malloc(sizeof(double) * ZONEMAP_BLOCK_SIZE);
+    if (buffer == NULL)
+      panic("out of memory");
+  }
+
+  for (int z = 0; z < map->numZones; z++) {
+    struct Zone *zone = &map->zones[z];
+    int first = z * ZONEMAP_BLOCK_SIZE;
+    int count = (N - first < ZONEMAP_BLOCK_SIZE) ? N - first
+                                                 : ZONEMAP_BLOCK_SIZE;
+
+    if (map->colType == COL_TYPE_STRING) {
+      buildStrings(map, first, first + count, zone);
+    } else if (map->colType == COL_TYPE_INT) {
+      int *values = (int *)table_column(map->table, map->column, first, count,
+                                        buffer);
+
+      zone->min.i = zone->max.i = values[0];
+
+      for (int i = 1; i < count; i++) {
+        if (values[i] < zone->min.i)
+          zone->min.i = values[i];
+        if (values[i] > zone->max.i)
+          zone->max.i = values[i];
+      }
+    } else {
+      double *values = (double *)table_column(map->table, map->column, first,
+                                              count, buffer);
+
+      zone->min.r = zone->max.r = values[0];
+
+      for (int i = 1; i < count; i++) {
+        if (values[i] < zone->min.r)
+          zone->min.r = values[i];
+        if (values[i] > zone->max.r)
+          zone->max.r = values[i];
+      }
+    }
+  }
+
+  free(buffer);
+}
+
+//
+// zonemap_read
+//
+// Reads the zone map file, returning true if it exists and matches
+// the table's data file, and false if it must be rebuilt.
+//
+static bool zonemap_read(struct ZoneMap *map, char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+
+  struct Table *table = map->table;
+  struct ZoneMapHeader header;
+  bool valid = (fread(&header, sizeof(header), 1, file) == 1) &&
+               (memcmp(header.magic, ZONEMAP_MAGIC, 8) == 0) &&
+               (header.dataSize == (long long)table->size) &&
+               (header.dataModified == table->modified) &&
+               (header.colType == map->colType) &&
+               (header.numRecords == table->numRecords) &&
+               (header.numZones == (table->numRecords + ZONEMAP_BLOCK_SIZE -
+                                    1) / ZONEMAP_BLOCK_SIZE);
+
+  if (valid) {
+    int N = header.numZones;
+
+    map->numZones = N;
+    map->zones = (struct Zone *)malloc(sizeof(struct Zone) * (N + 1));
+    if (map->zones == NULL)
+      panic("out of memory");
+
+    if (fread(map->zones, sizeof(struct Zone), N, file) != (size_t)N) {
+      free(map->zones);
+      map->zones = NULL;
+      valid = false;
+    }
+  }
+
+  fclose(file);
+  return valid;
+}
+
+//
+// zonemap_write
+//
+// Writes the zone map file; it is written to a temporary file and
+// then renamed, so a reader never sees a partially-written map.
+//
+static void zonemap_write(struct ZoneMap *map, char *path) {
+  char temp[TABLE_MAX_PATH_LENGTH + 8];
+
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  FILE *file = fopen(temp, "wb");
+  if (file == NULL) // e.g. read-only database, keep it in memory
+    return;
+
+  struct ZoneMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ZONEMAP_MAGIC, 8);
+  header.dataSize = map->table->size;
+  header.dataModified = map->table->modified;
+  header.colType = map->colType;
+  header.numRecords = map->table->numRecords;
+  header.numZones = map->numZones;
+
+  bool written = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+                 (fwrite(map->zones, sizeof(struct Zone), map->numZones,
+                         file) == (size_t)map->numZones);
+
+  if (fclose(file) != 0 || !written || rename(temp, path) != 0)
+    remove(temp);
+}
+
+//
+// zonemap_open
+//
+struct ZoneMap *zonemap_open(struct Database *db, struct Table *table,
+                             int column) {
+  struct TableMeta *meta = table->meta;
+
+  assert(column >= 0 && column < meta->numColumns);
+
+  struct ZoneMap *map = (struct ZoneMap *)malloc(sizeof(struct ZoneMap));
+  if (map == NULL)
+    panic("out of memory");
+
+  map->table = table;
+  map->column = column;
+  map->colType = meta->columns[column].colType;
+  map->zones = NULL;
+  map->numZones = 0;
+  map->values = (struct TupleValue *)malloc(sizeof(struct TupleValue) *
+                                            (meta->numColumns + 1));
+  map->columns = (bool *)malloc(sizeof(bool) * (meta->numColumns + 1));
+  if (map->values == NULL || map->columns == NULL)
+    panic("out of memory");
+
+  for (int i = 0; i < meta->numColumns; i++)
+    map->columns[i] = (i == column);
+
+  char path[TABLE_MAX_PATH_LENGTH];
+  char extension[DATABASE_MAX_ID_LENGTH + 8];
+
+  snprintf(extension, sizeof(extension), ".%s.zmap",
+           meta->columns[column].name);
+  table_path(path, db, meta->name, extension);
+
+  // as for an index, only the first of concurrent sessions builds it
+  pthread_mutex_lock(&zoneLock);
+
+  if (!zonemap_read(map, path)) {
+    zonemap_build(map);
+    zonemap_write(map, path);
+  }
+
+  pthread_mutex_unlock(&zoneLock);
+
+  return map;
+}
+
+//
+// zonemap_close
+//
+void zonemap_close(struct ZoneMap *map) {
+  if (map == NULL)
+    return;
+
+  free(map->zones);
+  free(map->values);
+  free(map->columns);
+  free(map);
+}
+
+//
+// zonemap_supports
+//
+bool zonemap_supports(int operator) {
+  switch (operator) {
+  case EXPR_LT:
+  case EXPR_LTE:
+  case EXPR_GT:
+  case EXPR_GTE:
+  case EXPR_EQUAL:
+  case EXPR_NOT_EQUAL:
+    return true;
+  }
+
+  return false;
+}
+
+//
+// compareBound
+//
+// Compares the zone's min (max = false) or max (max = true) against
+// the literal, returning < 0, 0, or > 0.
+//
+static int compareBound(struct ZoneMap *map, struct Zone *zone, bool max,
+                        char *literal) {
+  if (map->colType == COL_TYPE_INT) {
+    int bound = max ? zone->max.i : zone->min.i;
+    int value = atoi(literal);
+    return (bound > value) - (bound < value);
+  } else if (map->colType == COL_TYPE_REAL) {
+    double bound = max ? zone->max.r : zone->min.r;
+    double value = atof(literal);
+    return (bound > value) - (bound < value);
+  } else {
+    struct TupleValue *bound = zoneString(map, max ? zone->max.i : zone->min.i);
+    return operator_compareString(bound->value.s, bound->length, literal,
+                                  strlen(literal));
+  }
+}
+
+//
+// zonemap_mayMatch
+//
+bool zonemap_mayMatch(struct ZoneMap *map, int zone, int operator,
+                      char *literal) {
+  assert(zonemap_supports(operator));
+  assert(zone >= 0 && zone < map->numZones);
+
+  struct Zone *z = &map->zones[zone];
+
+  switch (operator) {
+  case EXPR_LT:
+    return compareBound(map, z, false, literal) < 0;
+  case EXPR_LTE:
+    return compareBound(map, z, false, literal) <= 0;
+  case EXPR_GT:
+    return compareBound(map, z, true, literal) > 0;
+  case EXPR_GTE:
+    return compareBound(map, z, true, literal) >= 0;
+  case EXPR_EQUAL:
+    return compareBound(map, z, false, literal) <= 0 &&
+           compareBound(map, z, true, literal) >= 0;
+  case EXPR_NOT_EQUAL: // only a block holding nothing but the literal
+    return compareBound(map, z, false, literal) != 0 ||
+           compareBound(map, z, true, literal) != 0;
+  }
+
+  return true;
+}
@@ -0,0 +1,99 @@
+/*zonemap.h*/
+
+//
+// Project: Zone maps for SimpleSQL
+//
+// Randy Truong
+//
+
+#pragma once
+
+#include <stdbool.h> // true, false
+
+#include "database.h"
+#include "table.h"
+
+//
+// A zone map on a column of a table summarizes each block of
+// ZONEMAP_BLOCK_SIZE consecutive records by the smallest and largest
+// value of the column in the block. A scan comparing the column to a
+// literal can then skip every block whose range cannot satisfy the
+// comparison, e.g. all the blocks before and after the dates asked
+// for, when the table is ordered by date. Unlike an index, it works
+// for any column, and only pays off if the column is clustered.
+//
+// Zone maps are built the first time a scan compares the column, and
+// are stored next to the data file as "<database>/<table>.<column>.zmap".
+// Like an index file, the zone map file records the size and
+// modification time of the data file it was built from, and is rebuilt
+// when the data file changes (e.g. after an INSERT, UPDATE or DELETE).
+// Deleted records still count towards their block's range.
+//
+#define ZONEMAP_BLOCK_SIZE 4096
+
+struct Zone {
+  //
+  // smallest and largest value in the block; a string column stores
+  // the record #s of the records holding them in i, as an index does
+  //
+  union {
+    int i;
+    double r;
+  } min, max;
+};
+
+struct ZoneMap {
+  struct Table *table; // table the zone map is on (not owned)
+  int column;          // 0-based index of the column in the table
+  int colType;         // enum ColumnType (database.h)
+
+  struct Zone *zones; // ARRAY: zone z covers records z*ZONEMAP_BLOCK_SIZE...
+  int numZones;
+  struct TupleValue *values; // ARRAY used to read a record's columns
+  bool *columns;             // ARRAY: true for the summarized column only
+};
+
+//
+// Functions:
+//
+
+//
+// zonemap_open
+//
+// Returns the zone map on the given column (0-based) of the table,
+// building it from the data file if the zone map file does not exist
+// or is out of date. If the file cannot be written, the zone map is
+// still returned but only kept in memory.
+//
+// NOTE: it is the callers responsibility to free the resources
+// used by the zone map by calling zonemap_close().
+//
+struct ZoneMap *zonemap_open(struct Database *db, struct Table *table,
+                             int column);
+
+//
+// zonemap_close
+//
+// Frees the memory associated with the zone map; the table is not
+// closed.
+//
+void zonemap_close(struct ZoneMap *map);
+
+//
+// zonemap_supports
+//
+// Returns true if a zone map can rule out blocks for a comparison
+// with the given operator (enum AST_EXPR_OPERATORS), false if not.
+//
+bool zonemap_supports(int operator);
+
+//
+// zonemap_mayMatch
+//
+// Returns false if no record of zone # zone can satisfy "value
+// <operator> literal", where the literal is in string form as in the
+// AST, and true if some may. The operator must be supported, see
+// zonemap_supports().
+//
+bool zonemap_mayMatch(struct ZoneMap *map, int zone, int operator,
+                      char *literal);